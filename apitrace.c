@@ -0,0 +1,238 @@
+/* DirectSound API call tracing
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/* With DSOAL_APITRACE set, the public API calls that change state are
+ * recorded to a file, in the format described in apitrace.h, for dsreplay to
+ * play back. The file is created at a fixed size and mapped, and each call
+ * reserves its record with one atomic add and copies it in, so recording
+ * takes no locks and no system calls. When the file is full, further records
+ * are dropped and counted. The file is truncated to what was recorded when
+ * the process exits; if it crashes instead, the records written so far are
+ * still there, followed by zeros.
+ */
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dsound_private.h"
+
+
+BOOL ApiTraceEnabled = FALSE;
+
+static HANDLE trace_file = INVALID_HANDLE_VALUE;
+static HANDLE trace_map;
+static BYTE *trace_view;
+static LONG trace_capacity;
+static volatile LONG trace_used;
+static volatile LONG trace_dropped;
+static BOOL trace_data;
+
+static LONGLONG trace_start;
+static LONGLONG trace_freq;
+
+
+static LONGLONG ApiTrace_Now(void)
+{
+    LARGE_INTEGER now;
+    LONGLONG t;
+
+    QueryPerformanceCounter(&now);
+    t = now.QuadPart - trace_start;
+    return t/trace_freq*1000000000 + t%trace_freq*1000000000/trace_freq;
+}
+
+static ULONGLONG ApiTrace_Hash(ULONGLONG hash, const BYTE *data, DWORD len)
+{
+    DWORD i;
+    for(i = 0;i < len;++i)
+    {
+        hash ^= data[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static void ApiTrace_Write(WORD call, HRESULT hr, const void *object, const void *object2,
+    const DWORD *args, DWORD nargs, const void *data1, DWORD len1, const void *data2,
+    DWORD len2)
+{
+    DSoalTraceRecord *rec;
+    LONGLONG time = ApiTrace_Now();
+    DWORD size;
+    LONG ofs;
+
+    size = (sizeof(*rec) + len1 + len2 + 7) & ~7u;
+    if(trace_used >= trace_capacity ||
+       (ofs=InterlockedExchangeAdd(&trace_used, size)) > trace_capacity - (LONG)size)
+    {
+        if(InterlockedIncrement(&trace_dropped) == 1)
+            WARN("API trace file is full, dropping calls\n");
+        return;
+    }
+
+    rec = (DSoalTraceRecord*)(trace_view + sizeof(DSoalTraceHeader) + ofs);
+    rec->call = call;
+    rec->nargs = (WORD)nargs;
+    rec->thread = GetCurrentThreadId();
+    rec->result = hr;
+    rec->time = time;
+    rec->object = (ULONGLONG)(ULONG_PTR)object;
+    rec->object2 = (ULONGLONG)(ULONG_PTR)object2;
+    memset(rec->args, 0, sizeof(rec->args));
+    memcpy(rec->args, args, nargs*sizeof(*args));
+    if(len1) memcpy(rec+1, data1, len1);
+    if(len2) memcpy((BYTE*)(rec+1) + len1, data2, len2);
+    /* Written last, so a reader scanning a trace cut short by a crash stops
+     * at the first incomplete record.
+     */
+    rec->size = size;
+}
+
+void ApiTrace_Init(const char *path)
+{
+    DSoalTraceHeader *hdr;
+    LARGE_INTEGER now, freq;
+    const char *str;
+    DWORD mb = 64;
+
+    if(!QueryPerformanceFrequency(&freq) || freq.QuadPart <= 0)
+        return;
+
+    str = getenv("DSOAL_APITRACE_SIZE");
+    if(str && *str && atoi(str) > 0)
+        mb = atoi(str);
+    if(mb > 1024) mb = 1024;
+    str = getenv("DSOAL_APITRACE_DATA");
+    if(str && *str && atoi(str) != 0)
+        trace_data = TRUE;
+
+    trace_file = CreateFileA(path, GENERIC_READ|GENERIC_WRITE, FILE_SHARE_READ, NULL,
+                             CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(trace_file == INVALID_HANDLE_VALUE)
+    {
+        ERR("Failed to create API trace file %s: %lu\n", path, GetLastError());
+        return;
+    }
+
+    trace_capacity = (LONG)(mb*1024*1024 - sizeof(DSoalTraceHeader));
+    trace_map = CreateFileMappingA(trace_file, NULL, PAGE_READWRITE, 0, mb*1024*1024, NULL);
+    if(trace_map)
+        trace_view = MapViewOfFile(trace_map, FILE_MAP_WRITE, 0, 0, 0);
+    if(!trace_view)
+    {
+        ERR("Failed to map %luMB API trace file: %lu\n", mb, GetLastError());
+        if(trace_map) CloseHandle(trace_map);
+        trace_map = NULL;
+        CloseHandle(trace_file);
+        trace_file = INVALID_HANDLE_VALUE;
+        return;
+    }
+
+    hdr = (DSoalTraceHeader*)trace_view;
+    hdr->magic = DSOAL_TRACE_MAGIC;
+    hdr->version = DSOAL_TRACE_VERSION;
+    hdr->header_size = sizeof(*hdr);
+    hdr->flags = trace_data ? DSOAL_TRACE_DATA : 0;
+
+    QueryPerformanceCounter(&now);
+    trace_start = now.QuadPart;
+    trace_freq = freq.QuadPart;
+
+    TRACE("Tracing API calls to %s (%luMB%s)\n", path, mb, trace_data ? ", with data" : "");
+    ApiTraceEnabled = TRUE;
+}
+
+void ApiTrace_Record(WORD call, HRESULT hr, const void *object, const void *object2,
+    const void *payload, DWORD payload_size, DWORD nargs, ...)
+{
+    DWORD args[DSOAL_TRACE_MAX_ARGS];
+    va_list ap;
+    DWORD i;
+
+    va_start(ap, nargs);
+    for(i = 0;i < nargs;++i)
+        args[i] = va_arg(ap, DWORD);
+    va_end(ap);
+
+    ApiTrace_Write(call, hr, object, object2, args, nargs, payload, payload_size, NULL, 0);
+}
+
+/* Records an Unlock of a buffer whose data starts at base. The app's pointers
+ * are stored as offsets, and the data written as-is or as a hash.
+ */
+void ApiTrace_RecordUnlock(const void *object, HRESULT hr, const BYTE *base,
+    const void *ptr1, DWORD len1, const void *ptr2, DWORD len2)
+{
+    DWORD args[4];
+
+    if(!ptr2) len2 = 0;
+    args[0] = (DWORD)((const BYTE*)ptr1 - base);
+    args[1] = len1;
+    args[2] = ptr2 ? (DWORD)((const BYTE*)ptr2 - base) : 0;
+    args[3] = len2;
+
+    if(trace_data)
+        ApiTrace_Write(DSTraceUnlock, hr, object, NULL, args, 4, ptr1, len1, ptr2, len2);
+    else
+    {
+        ULONGLONG hash = 0xcbf29ce484222325ull;
+        hash = ApiTrace_Hash(hash, ptr1, len1);
+        hash = ApiTrace_Hash(hash, ptr2, len2);
+        ApiTrace_Write(DSTraceUnlock, hr, object, NULL, args, 4, &hash, sizeof(hash), NULL, 0);
+    }
+}
+
+/* Called at process exit, when no other thread can be recording. */
+void ApiTrace_Shutdown(void)
+{
+    DSoalTraceHeader *hdr = (DSoalTraceHeader*)trace_view;
+    LARGE_INTEGER end;
+    LONG used = 0;
+
+    if(!ApiTraceEnabled)
+        return;
+    ApiTraceEnabled = FALSE;
+
+    /* Reservations that didn't fit pushed trace_used past the end, so find
+     * where the last complete record ends instead.
+     */
+    while(used <= trace_capacity - (LONG)sizeof(DSoalTraceRecord))
+    {
+        const DSoalTraceRecord *rec;
+        rec = (const DSoalTraceRecord*)(trace_view + sizeof(*hdr) + used);
+        if(rec->size == 0 || rec->size > (DWORD)(trace_capacity - used))
+            break;
+        used += rec->size;
+    }
+    hdr->used = used;
+    hdr->dropped = trace_dropped;
+    if(trace_dropped)
+        WARN("API trace dropped %ld calls; set DSOAL_APITRACE_SIZE higher\n", trace_dropped);
+    TRACE("API trace recorded %ld bytes\n", used);
+
+    UnmapViewOfFile(trace_view);
+    CloseHandle(trace_map);
+    trace_view = NULL;
+    trace_map = NULL;
+
+    end.QuadPart = sizeof(*hdr) + used;
+    if(SetFilePointerEx(trace_file, end, NULL, FILE_BEGIN))
+        SetEndOfFile(trace_file);
+    CloseHandle(trace_file);
+    trace_file = INVALID_HANDLE_VALUE;
+}
@@ -0,0 +1,129 @@
+/* DirectSound API call trace format
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef DSOAL_APITRACE_H
+#define DSOAL_APITRACE_H
+
+/* A trace file, written with DSOAL_APITRACE set, is a DSoalTraceHeader
+ * followed by header.used bytes of records, in the order they were made.
+ * Each record is a DSoalTraceRecord followed by a call-specific payload, and
+ * its size is a multiple of 8. If the process didn't exit cleanly, used is 0
+ * and the records run until one with a size of 0.
+ *
+ * Calls that change no state aren't recorded, except for GetStatus and
+ * GetCurrentPosition on secondary buffers, which apps poll. That includes
+ * SetSpeakerConfig, which is a no-op. Calls rejected by argument checks
+ * before they do anything aren't recorded either. Capture (the
+ * IDirectSoundCapture and IDirectSoundCaptureBuffer interfaces) isn't traced.
+ *
+ * Objects are identified by the address of their implementation, which is
+ * stable for the object's lifetime but may be reused after it's released.
+ * object is the object called on; object2 is an object the call created, or
+ * is otherwise about. Float arguments are stored as their bit patterns.
+ */
+#define DSOAL_TRACE_MAGIC    0x52545344 /* "DSTR" */
+#define DSOAL_TRACE_VERSION  1
+#define DSOAL_TRACE_MAX_ARGS 8
+
+/* Set in header flags when Unlock records hold the written data, rather than
+ * a 64-bit FNV-1a hash of it.
+ */
+#define DSOAL_TRACE_DATA     0x1
+
+typedef struct DSoalTraceHeader {
+    DWORD magic;
+    DWORD version;
+    DWORD header_size;
+    DWORD flags;
+    ULONGLONG used;
+    /* Records that didn't fit in the file. */
+    DWORD dropped;
+    DWORD reserved;
+} DSoalTraceHeader;
+
+enum DSoalTraceCall {
+    /* IDirectSound8. object is the device. */
+    DSTraceDeviceCreate,        /* args: is_8; payload: the device GUID */
+    DSTraceDeviceRelease,
+    DSTraceSetCooperativeLevel, /* args: level */
+    DSTraceCreateBuffer,        /* object2: new buffer; args: flags, bytes;
+                                 * payload: the format, if the description has
+                                 * one (see DSTraceSetFormat) */
+    DSTraceDuplicateBuffer,     /* object: source buffer, object2: new buffer */
+
+    /* IDirectSoundBuffer, on secondary or primary buffers. */
+    DSTraceBufferRelease,
+    DSTracePlay,                /* args: priority, flags */
+    DSTraceStop,
+    DSTraceSetVolume,           /* args: volume */
+    DSTraceSetPan,              /* args: pan */
+    DSTraceSetFrequency,        /* args: frequency */
+    DSTraceSetCurrentPosition,  /* args: position */
+    DSTraceGetCurrentPosition,  /* args: play, write */
+    DSTraceGetStatus,           /* args: status */
+    DSTraceSetFormat,           /* payload: PCMWAVEFORMAT for WAVE_FORMAT_PCM,
+                                 * otherwise WAVEFORMATEX and cbSize extra
+                                 * bytes */
+    DSTraceUnlock,              /* args: ofs1, len1, ofs2, len2; payload: the
+                                 * data written, or its hash */
+
+    /* IDirectSoundNotify. */
+    DSTraceSetNotificationPositions, /* args: count, entry size; payload: the
+                                      * DSBPOSITIONNOTIFY array as passed */
+
+    /* IDirectSound3DBuffer. The last arg is always the apply flag. */
+    DSTrace3DSetPosition,       /* args: x, y, z, apply */
+    DSTrace3DSetVelocity,       /* args: x, y, z, apply */
+    DSTrace3DSetMinDistance,    /* args: distance, apply */
+    DSTrace3DSetMaxDistance,    /* args: distance, apply */
+    DSTrace3DSetMode,           /* args: mode, apply */
+    DSTrace3DSetConeAngles,     /* args: inside, outside, apply */
+    DSTrace3DSetConeOrientation,/* args: x, y, z, apply */
+    DSTrace3DSetConeOutsideVolume, /* args: volume, apply */
+    DSTrace3DSetAllParameters,  /* args: apply; payload: DS3DBUFFER */
+
+    /* IDirectSound3DListener, on the primary buffer. */
+    DSTraceListenerSetPosition, /* args: x, y, z, apply */
+    DSTraceListenerSetVelocity, /* args: x, y, z, apply */
+    DSTraceListenerSetOrientation, /* args: front x, y, z, top x, y, z, apply */
+    DSTraceListenerSetDistanceFactor, /* args: factor, apply */
+    DSTraceListenerSetRolloffFactor,  /* args: factor, apply */
+    DSTraceListenerSetDopplerFactor,  /* args: factor, apply */
+    DSTraceListenerSetAllParameters,  /* args: apply; payload: DS3DLISTENER */
+    DSTraceCommitDeferredSettings,
+
+    /* IKsPropertySet on secondary buffers. */
+    DSTracePropertySet,         /* args: property id, then the property set
+                                 * GUID as 4 DWORDs; payload: the data */
+
+    DSTraceCallCount
+};
+
+typedef struct DSoalTraceRecord {
+    DWORD size;
+    WORD call;
+    WORD nargs;
+    DWORD thread;
+    LONG result;
+    /* Nanoseconds since the capture started, when the call returned. */
+    LONGLONG time;
+    ULONGLONG object;
+    ULONGLONG object2;
+    DWORD args[DSOAL_TRACE_MAX_ARGS];
+} DSoalTraceRecord;
+
+#endif /* DSOAL_APITRACE_H */
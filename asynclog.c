@@ -0,0 +1,510 @@
+/* Asynchronous binary logging
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/* With DSOAL_LOGASYNC set, log messages aren't formatted by the thread that
+ * logs them. Each message is stored as a fixed-size record holding the time,
+ * the call site and the raw arguments, with strings copied in since they may
+ * not outlive the call. Each thread has its own single-producer ring of
+ * records, so logging takes no locks and allocates nothing after a thread's
+ * first message. A background thread merges the rings in time order, formats
+ * the records and writes them out, and whatever is left is written when the
+ * process exits. When a ring is full, messages are dropped and counted.
+ *
+ * Since messages are written later, the last few may be lost if the process
+ * crashes.
+ */
+
+#include <stdarg.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "dsound_private.h"
+
+
+#define ASYNCLOG_RING_SIZE  1024
+#define ASYNCLOG_STRINGS    160
+#define ASYNCLOG_FLUSH_MS   50
+
+/* String arguments that couldn't be stored. */
+#define ASYNCLOG_NULLSTR    0xffff
+#define ASYNCLOG_NOROOM     0xfffe
+
+enum LogArgType {
+    LogArgInt,
+    LogArgLong,
+    LogArgLongLong,
+    LogArgPtr,
+    LogArgDouble,
+    LogArgStr,
+    LogArgWStr,
+};
+
+/* Sites the parser can't handle are formatted by the logging thread into the
+ * record's string space instead.
+ */
+enum LogSiteState {
+    LogSiteUnparsed,
+    LogSiteParsed,
+    LogSitePreformat,
+};
+
+typedef struct LogRecord {
+    LONGLONG time;
+    LogSite *site;
+    DWORD thread;
+    BYTE preformatted;
+    WORD strused;
+    ULONGLONG args[ASYNCLOG_MAX_ARGS];
+    char strings[ASYNCLOG_STRINGS];
+} LogRecord;
+
+typedef struct LogRing {
+    struct LogRing *next;
+    /* Thread that writes to this ring, or 0 when it's free for the next new
+     * thread to take.
+     */
+    volatile LONG owner;
+    /* head is only advanced by the owner, tail only by the flusher. */
+    volatile LONG head;
+    volatile LONG tail;
+    volatile LONG dropped;
+    /* Flusher state. */
+    LONG drain_head;
+    LONG dropped_reported;
+    LogRecord records[ASYNCLOG_RING_SIZE];
+} LogRing;
+
+BOOL AsyncLogEnabled;
+
+static DWORD AsyncLogTls = TLS_OUT_OF_INDEXES;
+static LogRing *volatile RingList;
+static LONGLONG log_start, log_freq = 1;
+static volatile LONG log_draining;
+
+
+/* Finds the next conversion in fmt. Returns a pointer past it and sets *spec
+ * to its start and *type to the argument it takes, or returns NULL at the end
+ * of the string. Sets *type to -1 for conversions that can't be recorded.
+ */
+static const char *next_spec(const char *fmt, const char **spec, int *type)
+{
+    int len = 0;
+
+    while(*fmt)
+    {
+        if(*fmt++ != '%')
+            continue;
+        if(*fmt == '%')
+        {
+            ++fmt;
+            continue;
+        }
+
+        *spec = fmt-1;
+        while(*fmt && strchr("-+ #0", *fmt))
+            ++fmt;
+        if(*fmt == '*')
+        {
+            *type = -1;
+            return fmt;
+        }
+        while(isdigit((unsigned char)*fmt))
+            ++fmt;
+        if(*fmt == '.')
+        {
+            ++fmt;
+            if(*fmt == '*')
+            {
+                *type = -1;
+                return fmt;
+            }
+            while(isdigit((unsigned char)*fmt))
+                ++fmt;
+        }
+
+        if(fmt[0] == 'h')
+            fmt += (fmt[1] == 'h') ? 2 : 1;
+        else if(fmt[0] == 'l' && fmt[1] == 'l')
+        {
+            len = 2;
+            fmt += 2;
+        }
+        else if(fmt[0] == 'l')
+        {
+            len = 1;
+            fmt += 1;
+        }
+        else if(fmt[0] == 'I' && fmt[1] == '6' && fmt[2] == '4')
+        {
+            len = 2;
+            fmt += 3;
+        }
+
+        switch(*fmt)
+        {
+        case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+            *type = (len == 2) ? LogArgLongLong : (len == 1) ? LogArgLong : LogArgInt;
+            break;
+        case 'p':
+            *type = LogArgPtr;
+            break;
+        case 's':
+            *type = (len == 1) ? LogArgWStr : LogArgStr;
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            *type = LogArgDouble;
+            break;
+        default:
+            *type = -1;
+            break;
+        }
+        return *fmt ? fmt+1 : fmt;
+    }
+    return NULL;
+}
+
+static enum LogSiteState parse_site(LogSite *site)
+{
+    const char *fmt = site->fmt, *spec;
+    BYTE nargs = 0;
+    int type;
+
+    while((fmt=next_spec(fmt, &spec, &type)) != NULL)
+    {
+        if(type < 0 || nargs == ASYNCLOG_MAX_ARGS)
+            return LogSitePreformat;
+        site->types[nargs++] = (BYTE)type;
+    }
+    site->nargs = nargs;
+    return LogSiteParsed;
+}
+
+static LogRing *get_ring(void)
+{
+    LogRing *ring = TlsGetValue(AsyncLogTls);
+    LONG tid;
+
+    if(LIKELY(ring != NULL))
+        return ring;
+
+    /* Take over the ring of a thread that exited, or make a new one. */
+    tid = (LONG)GetCurrentThreadId();
+    for(ring = RingList;ring;ring = ring->next)
+    {
+        if(ring->owner == 0 && InterlockedCompareExchange(&ring->owner, tid, 0) == 0)
+            break;
+    }
+    if(!ring)
+    {
+        ring = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*ring));
+        if(!ring) return NULL;
+        ring->owner = tid;
+        do {
+            ring->next = RingList;
+        } while(InterlockedCompareExchangePointer((void*volatile*)&RingList, ring,
+                                                  ring->next) != ring->next);
+    }
+    TlsSetValue(AsyncLogTls, ring);
+    return ring;
+}
+
+static WORD store_string(LogRecord *rec, const char *str)
+{
+    WORD start = rec->strused;
+    size_t len;
+
+    if(!str) return ASYNCLOG_NULLSTR;
+    if(ASYNCLOG_STRINGS - start < 4) return ASYNCLOG_NOROOM;
+
+    len = strlen(str);
+    if(len > (size_t)(ASYNCLOG_STRINGS - start - 1))
+        len = ASYNCLOG_STRINGS - start - 1;
+    memcpy(rec->strings + start, str, len);
+    rec->strings[start + len] = 0;
+    rec->strused = (WORD)(start + len + 1);
+    return start;
+}
+
+static WORD store_wstring(LogRecord *rec, const WCHAR *str)
+{
+    WORD start = rec->strused;
+    size_t i = 0;
+
+    if(!str) return ASYNCLOG_NULLSTR;
+    if(ASYNCLOG_STRINGS - start < 4) return ASYNCLOG_NOROOM;
+
+    for(;str[i] && i < (size_t)(ASYNCLOG_STRINGS - start - 1);++i)
+        rec->strings[start + i] = (str[i] < 0x80) ? (char)str[i] : '?';
+    rec->strings[start + i] = 0;
+    rec->strused = (WORD)(start + i + 1);
+    return start;
+}
+
+void AsyncLog_Write(LogSite *site, ...)
+{
+    enum LogSiteState state = site->state;
+    LARGE_INTEGER now;
+    LogRecord *rec;
+    LogRing *ring;
+    va_list ap;
+    LONG head;
+    BYTE i;
+
+    va_start(ap, site);
+    ring = get_ring();
+    if(UNLIKELY(!ring))
+    {
+        vfprintf(LogFile, site->fmt, ap);
+        fflush(LogFile);
+        va_end(ap);
+        return;
+    }
+
+    head = ring->head;
+    if(UNLIKELY(head - ring->tail >= ASYNCLOG_RING_SIZE))
+    {
+        InterlockedIncrement(&ring->dropped);
+        va_end(ap);
+        return;
+    }
+
+    if(UNLIKELY(state == LogSiteUnparsed))
+    {
+        /* Threads racing here all store the same thing. */
+        state = parse_site(site);
+        InterlockedExchange(&site->state, state);
+    }
+
+    QueryPerformanceCounter(&now);
+    rec = &ring->records[head % ASYNCLOG_RING_SIZE];
+    rec->time = now.QuadPart;
+    rec->site = site;
+    rec->thread = (DWORD)ring->owner;
+    rec->strused = 0;
+    rec->preformatted = (state == LogSitePreformat);
+    if(rec->preformatted)
+        vsnprintf(rec->strings, sizeof(rec->strings), site->fmt, ap);
+    else for(i = 0;i < site->nargs;++i)
+    {
+        switch(site->types[i])
+        {
+        case LogArgInt: rec->args[i] = (ULONGLONG)va_arg(ap, int); break;
+        case LogArgLong: rec->args[i] = (ULONGLONG)va_arg(ap, long); break;
+        case LogArgLongLong: rec->args[i] = (ULONGLONG)va_arg(ap, LONGLONG); break;
+        case LogArgPtr: rec->args[i] = (ULONG_PTR)va_arg(ap, void*); break;
+        case LogArgDouble:
+        {
+            double val = va_arg(ap, double);
+            memcpy(&rec->args[i], &val, sizeof(val));
+            break;
+        }
+        case LogArgStr: rec->args[i] = store_string(rec, va_arg(ap, const char*)); break;
+        case LogArgWStr: rec->args[i] = store_wstring(rec, va_arg(ap, const WCHAR*)); break;
+        }
+    }
+    va_end(ap);
+
+    /* Publishes the record to the flusher. */
+    InterlockedExchange(&ring->head, head+1);
+}
+
+
+static void format_record(FILE *f, const LogRecord *rec)
+{
+    LONGLONG us = (rec->time - log_start) * 1000000 / log_freq;
+    const char *fmt = rec->site->fmt, *spec, *next;
+    char specbuf[32];
+    int type, i = 0;
+
+    fprintf(f, "%lu.%06lu ", (ULONG)(us/1000000), (ULONG)(us%1000000));
+    if(rec->preformatted)
+    {
+        fputs(rec->strings, f);
+        return;
+    }
+
+    while((next=next_spec(fmt, &spec, &type)) != NULL)
+    {
+        size_t len = next - spec;
+        ULONGLONG arg = rec->args[i++];
+
+        /* Text before the conversion, with %% unescaped. */
+        for(;fmt != spec;++fmt)
+        {
+            fputc(*fmt, f);
+            if(fmt[0] == '%' && fmt[1] == '%')
+                ++fmt;
+        }
+        fmt = next;
+
+        if(len >= sizeof(specbuf)) len = sizeof(specbuf)-1;
+        memcpy(specbuf, spec, len);
+        specbuf[len] = 0;
+
+        switch(type)
+        {
+        case LogArgInt: fprintf(f, specbuf, (int)arg); break;
+        case LogArgLong: fprintf(f, specbuf, (long)arg); break;
+        case LogArgLongLong: fprintf(f, specbuf, (LONGLONG)arg); break;
+        case LogArgPtr: fprintf(f, specbuf, (void*)(ULONG_PTR)arg); break;
+        case LogArgDouble:
+        {
+            double val;
+            memcpy(&val, &arg, sizeof(val));
+            fprintf(f, specbuf, val);
+            break;
+        }
+        case LogArgStr:
+        case LogArgWStr:
+            if(arg == ASYNCLOG_NULLSTR)
+                fputs("(null)", f);
+            else if(arg == ASYNCLOG_NOROOM)
+                fputs("...", f);
+            else if(type == LogArgStr)
+                fprintf(f, specbuf, rec->strings + arg);
+            else
+                fputs(rec->strings + arg, f);
+            break;
+        }
+    }
+    for(;*fmt;++fmt)
+    {
+        fputc(*fmt, f);
+        if(fmt[0] == '%' && fmt[1] == '%')
+            ++fmt;
+    }
+}
+
+/* Writes out the records logged so far, oldest first across all threads. */
+static void AsyncLog_Drain(void)
+{
+    BOOL wrote = FALSE;
+    LogRing *ring;
+
+    for(ring = RingList;ring;ring = ring->next)
+    {
+        LONG dropped = ring->dropped;
+        ring->drain_head = ring->head;
+        if(dropped != ring->dropped_reported)
+        {
+            fprintf(LogFile, "%04lx:asynclog: dropped %ld messages\n", (ULONG)ring->owner,
+                    dropped - ring->dropped_reported);
+            ring->dropped_reported = dropped;
+            wrote = TRUE;
+        }
+    }
+    MemoryBarrier();
+
+    for(;;)
+    {
+        LogRing *oldest = NULL;
+        const LogRecord *rec;
+
+        for(ring = RingList;ring;ring = ring->next)
+        {
+            if(ring->tail == ring->drain_head)
+                continue;
+            if(!oldest || ring->records[ring->tail % ASYNCLOG_RING_SIZE].time <
+                          oldest->records[oldest->tail % ASYNCLOG_RING_SIZE].time)
+                oldest = ring;
+        }
+        if(!oldest) break;
+
+        rec = &oldest->records[oldest->tail % ASYNCLOG_RING_SIZE];
+        format_record(LogFile, rec);
+        InterlockedExchange(&oldest->tail, oldest->tail+1);
+        wrote = TRUE;
+    }
+
+    if(wrote)
+        fflush(LogFile);
+}
+
+static DWORD CALLBACK AsyncLog_Thread(void *arg)
+{
+    (void)arg;
+    for(;;)
+    {
+        Sleep(ASYNCLOG_FLUSH_MS);
+        if(InterlockedCompareExchange(&log_draining, TRUE, FALSE) == FALSE)
+        {
+            AsyncLog_Drain();
+            InterlockedExchange(&log_draining, FALSE);
+        }
+    }
+    return 0;
+}
+
+void AsyncLog_Init(void)
+{
+    LARGE_INTEGER now, freq;
+    HANDLE thread;
+
+    if(!QueryPerformanceFrequency(&freq) || freq.QuadPart <= 0)
+        return;
+    AsyncLogTls = TlsAlloc();
+    if(AsyncLogTls == TLS_OUT_OF_INDEXES)
+        return;
+
+    QueryPerformanceCounter(&now);
+    log_start = now.QuadPart;
+    log_freq = freq.QuadPart;
+
+    thread = CreateThread(NULL, 0, AsyncLog_Thread, NULL, 0, NULL);
+    if(!thread)
+    {
+        TlsFree(AsyncLogTls);
+        AsyncLogTls = TLS_OUT_OF_INDEXES;
+        return;
+    }
+    SetThreadPriority(thread, THREAD_PRIORITY_BELOW_NORMAL);
+    CloseHandle(thread);
+
+    AsyncLogEnabled = TRUE;
+}
+
+/* Frees the exiting thread's ring for reuse. Records still in it are written
+ * out as usual.
+ */
+void AsyncLog_ThreadDetach(void)
+{
+    LogRing *ring;
+
+    if(AsyncLogTls == TLS_OUT_OF_INDEXES)
+        return;
+    ring = TlsGetValue(AsyncLogTls);
+    if(ring)
+    {
+        TlsSetValue(AsyncLogTls, NULL);
+        InterlockedExchange(&ring->owner, 0);
+    }
+}
+
+/* Writes out everything left and goes back to synchronous logging. Called on
+ * process detach, when the flusher thread is already gone, so its drain flag
+ * is ignored.
+ */
+void AsyncLog_Shutdown(void)
+{
+    if(!AsyncLogEnabled)
+        return;
+
+    AsyncLogEnabled = FALSE;
+    AsyncLog_Drain();
+    TlsFree(AsyncLogTls);
+    AsyncLogTls = TLS_OUT_OF_INDEXES;
+}
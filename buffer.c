@@ -77,7 +77,11 @@ static inline DSBuffer *impl_from_IKsPropertySet(IKsPropertySet *iface)
 }
 
 
-/* Should be called with critsect held and context set.. */
+/* Should be called with critsect held and context set.. Besides buffers with
+ * notifications, playing static buffers are also kept in the list so the
+ * mixer notices when they end, and may still be there if they were stopped
+ * and restarted before the mixer removed them.
+ */
 static void DSBuffer_addnotify(DSBuffer *buf)
 {
     DSPrimary *prim = buf->primary;
@@ -89,7 +93,7 @@ static void DSBuffer_addnotify(DSBuffer *buf)
     {
         if(buf == list[i])
         {
-            ERR("Buffer %p already in notification list\n", buf);
+            TRACE("Buffer %p already in notification list\n", buf);
             return;
         }
     }
@@ -103,6 +107,116 @@ static void DSBuffer_addnotify(DSBuffer *buf)
     prim->notifies = list;
 }
 
+/* Sets the buffer's location, and updates the primary's voice census. */
+static void DSBuffer_SetLocStatus(DSBuffer *buf, DWORD loc_status)
+{
+    DSPrimary *prim = buf->primary;
+
+    if(buf->loc_status == DSBSTATUS_LOCHARDWARE)
+        prim->nhw_voices--;
+    else if(buf->loc_status == DSBSTATUS_LOCSOFTWARE)
+        prim->nsw_voices--;
+
+    buf->loc_status = loc_status;
+    if(loc_status == DSBSTATUS_LOCHARDWARE)
+        prim->nhw_voices++;
+    else if(loc_status == DSBSTATUS_LOCSOFTWARE)
+        prim->nsw_voices++;
+}
+
+/* Refills the streaming queue of a playing buffer and (re)starts its source
+ * if needed. Should be called with critsect held and context set.
+ */
+void DSBuffer_stream(DSBuffer *buf, BYTE *scratch_mem)
+{
+    DSData *data = buf->buffer;
+    DWORD alcalls = buf->share->mix_alcalls;
+    ALint done = 0, queued = QBUFFERS, state = AL_PLAYING;
+    BOOL underran;
+    LONG depth;
+    ALuint which;
+
+    alGetSourceiDirect(buf->ctx, buf->source, AL_BUFFERS_QUEUED, &queued);
+    alGetSourceiDirect(buf->ctx, buf->source, AL_SOURCE_STATE, &state);
+    alGetSourceiDirect(buf->ctx, buf->source, AL_BUFFERS_PROCESSED, &done);
+
+    if(done > 0)
+    {
+        ALuint bids[QBUFFERS_MAX];
+        queued -= done;
+
+        alSourceUnqueueBuffersDirect(buf->ctx, buf->source, done, bids);
+        buf->queue_base = (buf->queue_base + buf->segsize*done) % data->buf_size;
+    }
+
+    /* Queue deeper after an underrun to ride out the next late update, and
+     * give the extra segments back once it's been stable for a while.
+     */
+    underran = DSCore_StreamUnderran(state == AL_STOPPED, buf->isplaying, buf->islooping,
+                                     buf->data_offset, data->buf_size);
+    depth = DSCore_StreamDepth(buf->queue_depth, underran, GetTickCount(),
+                               &buf->last_underrun);
+    if(underran)
+    {
+        DeviceShare *share = buf->share;
+
+        buf->underruns++;
+        share->stream_stats.underruns++;
+        LIVESTATS_ADD(share, stream_underruns, 1);
+        if(depth > buf->queue_depth)
+        {
+            share->stream_stats.deepened++;
+            LIVESTATS_ADD(share, stream_deepened, 1);
+            TRACE("Buffer %p underrun %lu, queue depth now %ld\n", buf, buf->underruns,
+                  depth);
+        }
+        else
+            WARN("Buffer %p underrun %lu at max queue depth\n", buf, buf->underruns);
+    }
+    else if(depth < buf->queue_depth)
+    {
+        buf->share->stream_stats.shrunk++;
+        LIVESTATS_ADD(buf->share, stream_shrunk, 1);
+        TRACE("Buffer %p stable, queue depth now %ld\n", buf, depth);
+    }
+    buf->queue_depth = depth;
+
+    while(queued < buf->queue_depth)
+    {
+        DWORD ofs = buf->data_offset;
+        const BYTE *segment;
+
+        segment = DSCore_StreamSegment(data->data, data->buf_size, &ofs, buf->segsize,
+            buf->islooping, (data->format.Format.wBitsPerSample==8) ? 128 : 0, scratch_mem);
+        if(!segment) break;
+        buf->data_offset = ofs;
+
+        which = buf->stream_bids[buf->curidx];
+        alBufferDataDirect(buf->ctx, which, data->buf_format, segment, buf->segsize,
+                           data->format.Format.nSamplesPerSec);
+        alSourceQueueBuffersDirect(buf->ctx, buf->source, 1, &which);
+        buf->curidx = (buf->curidx+1)%QBUFFERS_MAX;
+        queued++;
+
+        buf->stats.buffer_data_calls++;
+        buf->stats.bytes_streamed += buf->segsize;
+        LIVESTATS_ADD(buf->share, stream_refills, 1);
+        LIVESTATS_ADD(buf->share, stream_bytes, buf->segsize);
+    }
+
+    if(!queued)
+    {
+        buf->data_offset = 0;
+        buf->queue_base = data->buf_size;
+        buf->curidx = 0;
+        DSBuffer_SetPlaying(buf, FALSE);
+    }
+    else if(state != AL_PLAYING)
+        alSourcePlayDirect(buf->ctx, buf->source);
+
+    buf->stats.mixer_al_calls += buf->share->mix_alcalls - alcalls;
+}
+
 
 static const char *get_fmtstr_PCM(const DSPrimary *prim, const WAVEFORMATEX *format, WAVEFORMATEXTENSIBLE *out)
 {
@@ -389,9 +503,9 @@ static HRESULT DSData_Create(DSData **ppv, const DSBUFFERDESC *desc, DSPrimary *
         ERR("Unhandled formattag 0x%04x\n", format->wFormatTag);
     if(!fmt_str) goto fail;
 
-    alGetError();
-    pBuffer->buf_format = alGetEnumValue(fmt_str);
-    if(alGetError() != AL_NO_ERROR || pBuffer->buf_format == 0 ||
+    alGetErrorDirect(prim->ctx);
+    pBuffer->buf_format = alGetEnumValueDirect(prim->ctx, fmt_str);
+    if(alGetErrorDirect(prim->ctx) != AL_NO_ERROR || pBuffer->buf_format == 0 ||
        pBuffer->buf_format == -1)
     {
         WARN("Could not get OpenAL format from %s\n", fmt_str);
@@ -403,18 +517,18 @@ static HRESULT DSData_Create(DSData **ppv, const DSBUFFERDESC *desc, DSPrimary *
     {
         pBuffer->data = (BYTE*)(pBuffer+1);
 
-        alGenBuffers(1, &pBuffer->bid);
-        checkALError();
+        alGenBuffersDirect(prim->ctx, 1, &pBuffer->bid);
+        checkALError(prim->ctx);
     }
     else
     {
         const ALbitfieldSOFT map_bits = AL_MAP_READ_BIT_SOFT | AL_MAP_WRITE_BIT_SOFT |
                                         AL_MAP_PERSISTENT_BIT_SOFT;
-        alGenBuffers(1, &pBuffer->bid);
-        alBufferStorageSOFT(pBuffer->bid, pBuffer->buf_format, NULL, pBuffer->buf_size,
-                            pBuffer->format.Format.nSamplesPerSec, map_bits);
-        pBuffer->data = alMapBufferSOFT(pBuffer->bid, 0, pBuffer->buf_size, map_bits);
-        checkALError();
+        alGenBuffersDirect(prim->ctx, 1, &pBuffer->bid);
+        alBufferStorageDirectSOFT(prim->ctx, pBuffer->bid, pBuffer->buf_format, NULL, pBuffer->buf_size,
+                                  pBuffer->format.Format.nSamplesPerSec, map_bits);
+        pBuffer->data = alMapBufferDirectSOFT(prim->ctx, pBuffer->bid, 0, pBuffer->buf_size, map_bits);
+        checkALError(prim->ctx);
 
         if(!pBuffer->data) goto fail;
     }
@@ -442,9 +556,9 @@ static void DSData_Release(DSData *This)
     {
         DSPrimary *prim = This->primary;
         if(HAS_EXTENSION(prim->share, SOFTX_MAP_BUFFER))
-            alUnmapBufferSOFT(This->bid);
-        alDeleteBuffers(1, &This->bid);
-        checkALError();
+            alUnmapBufferDirectSOFT(prim->ctx, This->bid);
+        alDeleteBuffersDirect(prim->ctx, 1, &This->bid);
+        checkALError(prim->ctx);
     }
     HeapFree(GetProcessHeap(), 0, This);
 }
@@ -456,7 +570,7 @@ HRESULT DSBuffer_Create(DSBuffer **ppv, DSPrimary *prim, IDirectSoundBuffer *ori
     DWORD i;
 
     *ppv = NULL;
-    EnterCriticalSection(&prim->share->crst);
+    DSShare_Lock(prim->share);
     for(i = 0;i < prim->NumBufferGroups;++i)
     {
         if(prim->BufferGroups[i].FreeBuffers)
@@ -496,7 +610,7 @@ HRESULT DSBuffer_Create(DSBuffer **ppv, DSPrimary *prim, IDirectSoundBuffer *ori
             }
         }
     }
-    LeaveCriticalSection(&prim->share->crst);
+    DSShare_Unlock(prim->share);
     if(!This)
     {
         WARN("Out of memory allocating buffers\n");
@@ -569,8 +683,9 @@ void DSBuffer_Destroy(DSBuffer *This)
 
     if(!prim) return;
     TRACE("Destroying %p\n", This);
+    APITRACE(DSTraceBufferRelease, S_OK, This, NULL, NULL, 0, 0);
 
-    EnterCriticalSection(&prim->share->crst);
+    DSShare_Lock(prim->share);
     /* Remove from list, if in list */
     for(i = 0;i < prim->nnotifies;++i)
     {
@@ -581,22 +696,28 @@ void DSBuffer_Destroy(DSBuffer *This)
         }
     }
 
+    DSPrimary_cancelstart(prim, This);
+    if(This->underruns > 0)
+        TRACE("Buffer %p had %lu underruns, final queue depth %d\n", This, This->underruns,
+              This->queue_depth);
     setALContext(This->ctx);
     if(This->source)
     {
         DeviceShare *share = This->share;
 
-        alDeleteSources(1, &This->source);
+        alDeleteSourcesDirect(This->ctx, 1, &This->source);
         This->source = 0;
-        checkALError();
+        checkALError(This->ctx);
 
         if(This->loc_status == DSBSTATUS_LOCHARDWARE)
             share->sources.availhw_num += 1;
         else
             share->sources.availsw_num += 1;
     }
+    DSBuffer_SetPlaying(This, FALSE);
+    DSBuffer_SetLocStatus(This, 0);
     if(This->stream_bids[0])
-        alDeleteBuffers(QBUFFERS, This->stream_bids);
+        alDeleteBuffersDirect(This->ctx, QBUFFERS_MAX, This->stream_bids);
 
     if(This->buffer)
         DSData_Release(This->buffer);
@@ -615,7 +736,7 @@ void DSBuffer_Destroy(DSBuffer *This)
             break;
         }
     }
-    LeaveCriticalSection(&prim->share->crst);
+    DSShare_Unlock(prim->share);
 }
 
 HRESULT DSBuffer_GetInterface(DSBuffer *buf, REFIID riid, void **ppv)
@@ -667,16 +788,16 @@ static HRESULT DSBuffer_SetLoc(DSBuffer *buf, DWORD loc_status)
      */
     if(buf->source)
     {
-        alDeleteSources(1, &buf->source);
+        alDeleteSourcesDirect(buf->ctx, 1, &buf->source);
         buf->source = 0;
-        checkALError();
+        checkALError(buf->ctx);
 
         if(buf->loc_status == DSBSTATUS_LOCHARDWARE)
             share->sources.availhw_num += 1;
         else
             share->sources.availsw_num += 1;
     }
-    buf->loc_status = 0;
+    DSBuffer_SetLocStatus(buf, 0);
 
     if(!loc_status)
     {
@@ -701,12 +822,11 @@ static HRESULT DSBuffer_SetLoc(DSBuffer *buf, DWORD loc_status)
         share->sources.availhw_num -= 1;
     else
         share->sources.availsw_num -= 1;
-    alGenSources(1, &buf->source);
-    alSourcef(buf->source, AL_GAIN, mB_to_gain((float)buf->current.vol));
-    alSourcef(buf->source, AL_PITCH,
-        buf->current.frequency ? (float)buf->current.frequency/data->format.Format.nSamplesPerSec
-                               : 1.0f);
-    checkALError();
+    alGenSourcesDirect(buf->ctx, 1, &buf->source);
+    alSourcefDirect(buf->ctx, buf->source, AL_GAIN, mB_to_gain((float)buf->current.vol));
+    alSourcefDirect(buf->ctx, buf->source, AL_PITCH,
+                    DSCore_Pitch(buf->current.frequency, data->format.Format.nSamplesPerSec));
+    checkALError(buf->ctx);
 
     /* TODO: Don't set EAX parameters or connect to effect slots for software
      * buffers. Need to check if EAX buffer properties are still tracked, or if
@@ -722,63 +842,63 @@ static HRESULT DSBuffer_SetLoc(DSBuffer *buf, DWORD loc_status)
         const ALuint source = buf->source;
         const DS3DBUFFER *params = &buf->current.ds3d;
 
-        alSource3f(source, AL_POSITION, params->vPosition.x, params->vPosition.y,
-                                       -params->vPosition.z);
-        alSource3f(source, AL_VELOCITY, params->vVelocity.x, params->vVelocity.y,
-                                       -params->vVelocity.z);
-        alSourcei(source, AL_CONE_INNER_ANGLE, params->dwInsideConeAngle);
-        alSourcei(source, AL_CONE_OUTER_ANGLE, params->dwOutsideConeAngle);
-        alSource3f(source, AL_DIRECTION, params->vConeOrientation.x,
-                                         params->vConeOrientation.y,
-                                        -params->vConeOrientation.z);
-        alSourcef(source, AL_CONE_OUTER_GAIN, mB_to_gain((float)params->lConeOutsideVolume));
-        alSourcef(source, AL_REFERENCE_DISTANCE, params->flMinDistance);
-        alSourcef(source, AL_MAX_DISTANCE, params->flMaxDistance);
+        alSource3fDirect(buf->ctx, source, AL_POSITION, params->vPosition.x, params->vPosition.y,
+                                                       -params->vPosition.z);
+        alSource3fDirect(buf->ctx, source, AL_VELOCITY, params->vVelocity.x, params->vVelocity.y,
+                                                       -params->vVelocity.z);
+        alSourceiDirect(buf->ctx, source, AL_CONE_INNER_ANGLE, params->dwInsideConeAngle);
+        alSourceiDirect(buf->ctx, source, AL_CONE_OUTER_ANGLE, params->dwOutsideConeAngle);
+        alSource3fDirect(buf->ctx, source, AL_DIRECTION, params->vConeOrientation.x,
+                                                         params->vConeOrientation.y,
+                                                        -params->vConeOrientation.z);
+        alSourcefDirect(buf->ctx, source, AL_CONE_OUTER_GAIN, mB_to_gain((float)params->lConeOutsideVolume));
+        alSourcefDirect(buf->ctx, source, AL_REFERENCE_DISTANCE, params->flMinDistance);
+        alSourcefDirect(buf->ctx, source, AL_MAX_DISTANCE, params->flMaxDistance);
         if(HAS_EXTENSION(share, SOFT_SOURCE_SPATIALIZE))
-            alSourcei(source, AL_SOURCE_SPATIALIZE_SOFT,
+            alSourceiDirect(buf->ctx, source, AL_SOURCE_SPATIALIZE_SOFT,
                 (params->dwMode==DS3DMODE_DISABLE) ? AL_FALSE : AL_TRUE
             );
-        alSourcei(source, AL_SOURCE_RELATIVE,
+        alSourceiDirect(buf->ctx, source, AL_SOURCE_RELATIVE,
             (params->dwMode!=DS3DMODE_NORMAL) ? AL_TRUE : AL_FALSE
         );
 
-        alSourcef(source, AL_ROLLOFF_FACTOR, prim->current.ds3d.flRolloffFactor);
-        checkALError();
+        alSourcefDirect(buf->ctx, source, AL_ROLLOFF_FACTOR, prim->current.ds3d.flRolloffFactor);
+        checkALError(buf->ctx);
     }
     else
     {
         const ALuint source = buf->source;
-        const ALfloat x = (ALfloat)(buf->current.pan-DSBPAN_LEFT)/(DSBPAN_RIGHT-DSBPAN_LEFT) -
-                          0.5f;
-
-        alSource3f(source, AL_POSITION, x, 0.0f, -sqrtf(1.0f - x*x));
-        alSource3f(source, AL_VELOCITY, 0.0f, 0.0f, 0.0f);
-        alSource3f(source, AL_DIRECTION, 0.0f, 0.0f, 0.0f);
-        alSourcef(source, AL_CONE_OUTER_GAIN, 1.0f);
-        alSourcef(source, AL_REFERENCE_DISTANCE, 1.0f);
-        alSourcef(source, AL_MAX_DISTANCE, 1000.0f);
-        alSourcef(source, AL_ROLLOFF_FACTOR, 0.0f);
-        alSourcef(source, AL_DOPPLER_FACTOR, 0.0f);
-        alSourcei(source, AL_CONE_INNER_ANGLE, 360);
-        alSourcei(source, AL_CONE_OUTER_ANGLE, 360);
-        alSourcei(source, AL_SOURCE_RELATIVE, AL_TRUE);
+        ALfloat pos[3];
+
+        DSCore_PanPosition(buf->current.pan, pos);
+        alSourcefvDirect(buf->ctx, source, AL_POSITION, pos);
+        alSource3fDirect(buf->ctx, source, AL_VELOCITY, 0.0f, 0.0f, 0.0f);
+        alSource3fDirect(buf->ctx, source, AL_DIRECTION, 0.0f, 0.0f, 0.0f);
+        alSourcefDirect(buf->ctx, source, AL_CONE_OUTER_GAIN, 1.0f);
+        alSourcefDirect(buf->ctx, source, AL_REFERENCE_DISTANCE, 1.0f);
+        alSourcefDirect(buf->ctx, source, AL_MAX_DISTANCE, 1000.0f);
+        alSourcefDirect(buf->ctx, source, AL_ROLLOFF_FACTOR, 0.0f);
+        alSourcefDirect(buf->ctx, source, AL_DOPPLER_FACTOR, 0.0f);
+        alSourceiDirect(buf->ctx, source, AL_CONE_INNER_ANGLE, 360);
+        alSourceiDirect(buf->ctx, source, AL_CONE_OUTER_ANGLE, 360);
+        alSourceiDirect(buf->ctx, source, AL_SOURCE_RELATIVE, AL_TRUE);
         if(HAS_EXTENSION(share, SOFT_SOURCE_SPATIALIZE))
         {
             /* Set to auto so panning works for mono, and multi-channel works
              * as expected.
              */
-            alSourcei(source, AL_SOURCE_SPATIALIZE_SOFT, AL_AUTO_SOFT);
+            alSourceiDirect(buf->ctx, source, AL_SOURCE_SPATIALIZE_SOFT, AL_AUTO_SOFT);
         }
         if(HAS_EXTENSION(share, EXT_EAX))
         {
             static const GUID NullSlots[EAX_MAX_ACTIVE_FXSLOTS] = { { 0 } };
-            EAXSet(&EAXPROPERTYID_EAX40_Source, EAXSOURCE_ACTIVEFXSLOTID, source, (void*)NullSlots,
+            EAXSetDirect(buf->ctx, &EAXPROPERTYID_EAX40_Source, EAXSOURCE_ACTIVEFXSLOTID, source, (void*)NullSlots,
                 sizeof(NullSlots));
         }
-        checkALError();
+        checkALError(buf->ctx);
     }
 
-    buf->loc_status = loc_status;
+    DSBuffer_SetLocStatus(buf, loc_status);
     return DS_OK;
 }
 
@@ -844,6 +964,115 @@ static HRESULT WINAPI DSBuffer_GetCaps(IDirectSoundBuffer8 *iface, DSBCAPS *caps
     return S_OK;
 }
 
+/* Returns how far, in bytes, the audible position lags behind the source's
+ * mixing position, or 0 if it can't be measured.
+ */
+static ALsizei DSBuffer_latency(DSBuffer *buf)
+{
+    const WAVEFORMATEX *format = &buf->buffer->format.Format;
+    ALdouble offlat[2] = { 0.0, 0.0 };
+
+    if(!HAS_EXTENSION(buf->share, SOFT_SOURCE_LATENCY))
+        return 0;
+
+    alGetSourcedvDirectSOFT(buf->ctx, buf->source, AL_SEC_OFFSET_LATENCY_SOFT, offlat);
+    if(!(offlat[1] > 0.0))
+        return 0;
+    return (ALsizei)(offlat[1]*format->nSamplesPerSec + 0.5) * format->nBlockAlign;
+}
+
+/* Returns the QPC time in nanoseconds. */
+static LONGLONG DSBuffer_clocknow(const DeviceShare *share)
+{
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return now.QuadPart/share->tick_freq*1000000000 +
+           now.QuadPart%share->tick_freq*1000000000/share->tick_freq;
+}
+
+/* Returns the source's byte offset. OpenAL only advances it once per mixer
+ * update, so when the device clock is available, the offset is paired with
+ * the device time it was mixed at and extrapolated to now, using the QPC
+ * clock and the source's playback rate. The extrapolation is capped at one
+ * update, and *interp is set to the most it may have overshot by. Looping
+ * and end-of-buffer are left to the caller.
+ */
+static ALint DSBuffer_getoffset(DSBuffer *buf, ALsizei *interp)
+{
+    const WAVEFORMATEX *format = &buf->buffer->format.Format;
+    DeviceShare *share = buf->share;
+    ALint64SOFT offclock[2] = { 0, 0 };
+    LONGLONG now, lag, elapsed, period;
+    DWORD rate;
+    ALint ofs;
+
+    *interp = 0;
+    /* Loopback devices run on a virtual clock, which wall-clock time can't
+     * extrapolate.
+     */
+    if(!HAS_EXTENSION(share, SOFT_DEVICE_CLOCK) || !HAS_EXTENSION(share, SOFT_SOURCE_LATENCY) ||
+       share->loopback)
+    {
+        ofs = 0;
+        alGetSourceiDirect(buf->ctx, buf->source, AL_BYTE_OFFSET, &ofs);
+        return ofs;
+    }
+
+    alGetSourcei64vDirectSOFT(buf->ctx, buf->source, AL_SAMPLE_OFFSET_CLOCK_SOFT, offclock);
+    ofs = (ALint)(offclock[0] >> 32) * format->nBlockAlign;
+
+    /* The device clock advances in update-sized steps, so the smallest lag
+     * seen between it and the QPC clock is the closest to when an update
+     * actually happened. Restart the search every second to follow drift
+     * between the two clocks.
+     */
+    now = DSBuffer_clocknow(share);
+    lag = now - offclock[1];
+    if(!buf->clock_lag_time || now - buf->clock_lag_time > 1000000000 || lag < buf->clock_lag)
+    {
+        if(!buf->clock_lag_time || now - buf->clock_lag_time > 1000000000)
+            buf->clock_lag_time = now;
+        buf->clock_lag = lag;
+    }
+
+    period = 1000000000 / buf->primary->refresh;
+    elapsed = now - buf->clock_lag - offclock[1];
+    if(elapsed <= 0) return ofs;
+    if(elapsed > period) elapsed = period;
+
+    rate = buf->current.frequency ? buf->current.frequency : format->nSamplesPerSec;
+    ofs += (ALint)(elapsed * rate / 1000000000) * format->nBlockAlign;
+    *interp = (ALsizei)((period * rate + 999999999) / 1000000000) * format->nBlockAlign;
+    return ofs;
+}
+
+/* Keeps an interpolated play cursor from going backwards when a mixer update
+ * lands short of the previous estimate. Anything behind the last reported
+ * position by no more than the extrapolation limit is held there, anything
+ * else is real movement (including wrapping around a looping buffer).
+ */
+static ALsizei DSBuffer_monotonic(DSBuffer *buf, ALsizei pos, ALsizei interp)
+{
+    const ALsizei size = buf->buffer->buf_size;
+
+    if(interp > 0 && buf->cursor_valid)
+    {
+        ALsizei back = (buf->lastcursor - pos + size) % size;
+        if(back > 0 && back <= interp)
+            pos = buf->lastcursor;
+    }
+    buf->lastcursor = pos;
+    buf->cursor_valid = (interp > 0);
+    return pos;
+}
+
+/* Returns the safety margin kept past the mixing position, in bytes. */
+static ALsizei DSBuffer_margin(const DSBuffer *buf)
+{
+    const WAVEFORMATEX *format = &buf->buffer->format.Format;
+    return (ALsizei)((DWORD64)WriteMargin * format->nSamplesPerSec / 1000) * format->nBlockAlign;
+}
+
 HRESULT WINAPI DSBuffer_GetCurrentPosition(IDirectSoundBuffer8 *iface, DWORD *playpos, DWORD *curpos)
 {
     DSBuffer *This = impl_from_IDirectSoundBuffer8(iface);
@@ -858,23 +1087,37 @@ HRESULT WINAPI DSBuffer_GetCurrentPosition(IDirectSoundBuffer8 *iface, DWORD *pl
         ALint queued = QBUFFERS;
         ALint status = AL_INITIAL;
         ALint ofs = 0;
+        ALsizei latency = 0;
+        ALsizei interp = 0;
 
-        EnterCriticalSection(&This->share->crst);
+        DSShare_Lock(This->share);
 
         if(LIKELY(This->source))
         {
             setALContext(This->ctx);
-            alGetSourcei(This->source, AL_BUFFERS_QUEUED, &queued);
-            alGetSourcei(This->source, AL_BYTE_OFFSET, &ofs);
-            alGetSourcei(This->source, AL_SOURCE_STATE, &status);
-            checkALError();
+            alGetSourceiDirect(This->ctx, This->source, AL_BUFFERS_QUEUED, &queued);
+            ofs = DSBuffer_getoffset(This, &interp);
+            alGetSourceiDirect(This->ctx, This->source, AL_SOURCE_STATE, &status);
+            if(status == AL_PLAYING)
+                latency = DSBuffer_latency(This);
+            checkALError(This->ctx);
             popALContext();
         }
 
+        /* Report what's being heard, which lags behind the mixing position
+         * by the device latency. Don't go back before the current queue.
+         */
         if(status == AL_STOPPED)
             pos = This->segsize*queued + This->queue_base;
         else
-            pos = ofs + This->queue_base;
+        {
+            /* Don't extrapolate to the end of the queue, the source stopping
+             * is what says it got there.
+             */
+            if(interp > 0 && ofs >= This->segsize*queued)
+                ofs = This->segsize*queued - data->format.Format.nBlockAlign;
+            pos = ofs - ((latency < ofs) ? latency : ofs) + This->queue_base;
+        }
         if(pos >= data->buf_size)
         {
             if(This->islooping)
@@ -882,35 +1125,75 @@ HRESULT WINAPI DSBuffer_GetCurrentPosition(IDirectSoundBuffer8 *iface, DWORD *pl
             else if(This->isplaying)
             {
                 pos = data->buf_size;
-                alSourceStop(This->source);
-                alSourcei(This->source, AL_BUFFER, 0);
+                alSourceStopDirect(This->ctx, This->source);
+                alSourceiDirect(This->ctx, This->source, AL_BUFFER, 0);
                 This->curidx = 0;
-                This->isplaying = FALSE;
+                DSBuffer_SetPlaying(This, FALSE);
             }
         }
+        /* Everything up to data_offset was already given to OpenAL, so the
+         * write cursor is past the queued data, plus the safety margin.
+         */
         if(This->isplaying)
-            writecursor = (This->segsize*QBUFFERS + pos) % data->buf_size;
+        {
+            if(status == AL_PLAYING && pos < data->buf_size)
+                pos = DSBuffer_monotonic(This, pos, interp);
+            writecursor = (This->data_offset + DSBuffer_margin(This)) % data->buf_size;
+        }
         else
             writecursor = pos % data->buf_size;
 
-        LeaveCriticalSection(&This->share->crst);
+        DSShare_Unlock(This->share);
     }
     else
     {
         const WAVEFORMATEX *format = &data->format.Format;
         ALint status = AL_INITIAL;
         ALint ofs = 0;
+        ALsizei latency = 0;
+        ALsizei interp = 0;
+
+        /* The cursor interpolation state is shared with other threads
+         * querying this buffer, and reset by Play and SetCurrentPosition.
+         */
+        DSShare_Lock(This->share);
 
         if(LIKELY(This->source))
         {
             setALContext(This->ctx);
-            alGetSourcei(This->source, AL_BYTE_OFFSET, &ofs);
-            alGetSourcei(This->source, AL_SOURCE_STATE, &status);
-            checkALError();
+            ofs = DSBuffer_getoffset(This, &interp);
+            alGetSourceiDirect(This->ctx, This->source, AL_SOURCE_STATE, &status);
+            if(status == AL_PLAYING)
+                latency = DSBuffer_latency(This);
+            checkALError(This->ctx);
             popALContext();
         }
 
-        if(status == AL_PLAYING)
+        if(status == AL_PLAYING && HAS_EXTENSION(This->share, SOFT_SOURCE_LATENCY))
+        {
+            /* The play cursor is what's being heard. OpenAL may already have
+             * mixed up to a device update past its offset, so the write lead
+             * is the device latency, plus an update, plus the safety margin.
+             */
+            if(ofs >= data->buf_size)
+            {
+                /* Extrapolated past the end, wrap around or hold at the end
+                 * until the source stops.
+                 */
+                if(This->islooping)
+                    ofs %= data->buf_size;
+                else
+                    ofs = data->buf_size;
+            }
+            if(latency > ofs) latency = ofs;
+            pos = ofs - latency;
+            if(pos < data->buf_size)
+                pos = DSBuffer_monotonic(This, pos, interp);
+            writecursor = format->nSamplesPerSec / This->primary->refresh;
+            writecursor *= format->nBlockAlign;
+            writecursor += latency + DSBuffer_margin(This);
+        }
+        else if(status == AL_PLAYING)
         {
             pos = ofs;
             writecursor = format->nSamplesPerSec / This->primary->refresh;
@@ -934,6 +1217,7 @@ HRESULT WINAPI DSBuffer_GetCurrentPosition(IDirectSoundBuffer8 *iface, DWORD *pl
             }
             writecursor = 0;
         }
+        DSShare_Unlock(This->share);
         writecursor = (writecursor + pos) % data->buf_size;
     }
     TRACE("%p Play pos = %u, write pos = %u\n", This, pos, writecursor);
@@ -1079,18 +1363,22 @@ HRESULT WINAPI DSBuffer_GetStatus(IDirectSoundBuffer8 *iface, DWORD *status)
         if(LIKELY(This->source))
         {
             setALContext(This->ctx);
-            alGetSourcei(This->source, AL_SOURCE_STATE, &state);
-            alGetSourcei(This->source, AL_LOOPING, &looping);
-            checkALError();
+            alGetSourceiDirect(This->ctx, This->source, AL_SOURCE_STATE, &state);
+            alGetSourceiDirect(This->ctx, This->source, AL_LOOPING, &looping);
+            checkALError(This->ctx);
             popALContext();
+            if(This->start_pending)
+                state = AL_PLAYING;
         }
     }
     else
     {
-        EnterCriticalSection(&This->share->crst);
+        /* These are only changed with the device lock held, and reading them
+         * without it gives the same answer a caller racing the mixer would
+         * get anyway. Don't stall behind the mixer for a status query.
+         */
         state = This->isplaying ? AL_PLAYING : AL_PAUSED;
         looping = This->islooping;
-        LeaveCriticalSection(&This->share->crst);
     }
 
     if((This->buffer->dsbflags&DSBCAPS_LOCDEFER))
@@ -1111,7 +1399,7 @@ HRESULT WINAPI DSBuffer_Initialize(IDirectSoundBuffer8 *iface, IDirectSound *ds,
 
     TRACE("(%p)->(%p, %p)\n", iface, ds, desc);
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
     setALContext(This->ctx);
 
     hr = DSERR_ALREADYINITIALIZED;
@@ -1172,8 +1460,9 @@ HRESULT WINAPI DSBuffer_Initialize(IDirectSoundBuffer8 *iface, IDirectSound *ds,
         This->segsize += data->format.Format.nBlockAlign - 1;
         This->segsize -= This->segsize%data->format.Format.nBlockAlign;
 
-        alGenBuffers(QBUFFERS, This->stream_bids);
-        checkALError();
+        This->queue_depth = QBUFFERS;
+        alGenBuffersDirect(This->ctx, QBUFFERS_MAX, This->stream_bids);
+        checkALError(This->ctx);
     }
     if(!(data->dsbflags&DSBCAPS_CTRL3D))
     {
@@ -1195,12 +1484,12 @@ out:
     This->init_done = SUCCEEDED(hr);
 
     popALContext();
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
 
     return hr;
 }
 
-static HRESULT WINAPI DSBuffer_Lock(IDirectSoundBuffer8 *iface, DWORD ofs, DWORD bytes, void **ptr1, DWORD *len1, void **ptr2, DWORD *len2, DWORD flags)
+static HRESULT DSBuffer_DoLock(IDirectSoundBuffer8 *iface, DWORD ofs, DWORD bytes, void **ptr1, DWORD *len1, void **ptr2, DWORD *len2, DWORD flags)
 {
     DSBuffer *This = impl_from_IDirectSoundBuffer8(iface);
     DWORD remain;
@@ -1260,6 +1549,17 @@ static HRESULT WINAPI DSBuffer_Lock(IDirectSoundBuffer8 *iface, DWORD ofs, DWORD
     return DS_OK;
 }
 
+static HRESULT WINAPI DSBuffer_Lock(IDirectSoundBuffer8 *iface, DWORD ofs, DWORD bytes, void **ptr1, DWORD *len1, void **ptr2, DWORD *len2, DWORD flags)
+{
+    DSBuffer *This = impl_from_IDirectSoundBuffer8(iface);
+    LONGLONG start = DSBuffer_clocknow(This->share);
+    HRESULT hr = DSBuffer_DoLock(iface, ofs, bytes, ptr1, len1, ptr2, len2, flags);
+
+    InterlockedIncrement(&This->stats.lock_calls);
+    InterlockedExchangeAdd64(&This->stats.lock_time, DSBuffer_clocknow(This->share) - start);
+    return hr;
+}
+
 static HRESULT WINAPI DSBuffer_Play(IDirectSoundBuffer8 *iface, DWORD res1, DWORD prio, DWORD flags)
 {
     DSBuffer *This = impl_from_IDirectSoundBuffer8(iface);
@@ -1269,7 +1569,7 @@ static HRESULT WINAPI DSBuffer_Play(IDirectSoundBuffer8 *iface, DWORD res1, DWOR
 
     TRACE("(%p)->(%lu, %lu, %lu)\n", iface, res1, prio, flags);
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
     setALContext(This->ctx);
 
     hr = DSERR_BUFFERLOST;
@@ -1301,10 +1601,12 @@ static HRESULT WINAPI DSBuffer_Play(IDirectSoundBuffer8 *iface, DWORD res1, DWOR
                 if(This->isplaying)
                     state = AL_PLAYING;
             }
+            else if(This->start_pending)
+                state = AL_PLAYING;
             else
             {
-                alGetSourcei(This->source, AL_SOURCE_STATE, &state);
-                checkALError();
+                alGetSourceiDirect(This->ctx, This->source, AL_SOURCE_STATE, &state);
+                checkALError(This->ctx);
             }
 
             if(state == AL_PLAYING)
@@ -1324,52 +1626,80 @@ static HRESULT WINAPI DSBuffer_Play(IDirectSoundBuffer8 *iface, DWORD res1, DWOR
         goto out;
     }
 
+    This->islooping = !!(flags&DSBPLAY_LOOPING);
     if(This->segsize != 0)
     {
-        This->islooping = !!(flags&DSBPLAY_LOOPING);
         if(This->isplaying) state = AL_PLAYING;
     }
     else
     {
-        alSourcei(This->source, AL_LOOPING, (flags&DSBPLAY_LOOPING) ? AL_TRUE : AL_FALSE);
-        alGetSourcei(This->source, AL_SOURCE_STATE, &state);
-        checkALError();
+        alSourceiDirect(This->ctx, This->source, AL_LOOPING, (flags&DSBPLAY_LOOPING) ? AL_TRUE : AL_FALSE);
+        alGetSourceiDirect(This->ctx, This->source, AL_SOURCE_STATE, &state);
+        checkALError(This->ctx);
+        if(This->start_pending)
+            state = AL_PLAYING;
     }
 
     hr = S_OK;
     if(state == AL_PLAYING)
         goto out;
+    This->cursor_valid = FALSE;
 
     if(This->segsize == 0)
     {
         if(state == AL_INITIAL)
         {
-            alSourcei(This->source, AL_BUFFER, data->bid);
-            alSourcei(This->source, AL_BYTE_OFFSET, This->lastpos % data->buf_size);
+            alSourceiDirect(This->ctx, This->source, AL_BUFFER, data->bid);
+            alSourceiDirect(This->ctx, This->source, AL_BYTE_OFFSET, This->lastpos % data->buf_size);
+        }
+        /* While the app has deferred 3D settings pending for this buffer or
+         * the listener, batch the start until they're committed (or the next
+         * mixer update), so buffers played in the same frame start together
+         * and with their new settings.
+         */
+        if((This->dirty.flags || This->primary->dirty.flags) &&
+           This->primary->npending_starts < This->primary->sizepending_starts)
+        {
+            DSPrimary *prim = This->primary;
+            prim->pending_starts[prim->npending_starts++] = This;
+            This->start_pending = TRUE;
         }
-        alSourcePlay(This->source);
+        else
+            alSourcePlayDirect(This->ctx, This->source);
     }
     else
     {
-        alSourceRewind(This->source);
-        alSourcei(This->source, AL_BUFFER, 0);
+        alSourceRewindDirect(This->ctx, This->source);
+        alSourceiDirect(This->ctx, This->source, AL_BUFFER, 0);
         This->queue_base = This->data_offset % data->buf_size;
         This->curidx = 0;
     }
-    if(alGetError() != AL_NO_ERROR)
+    if(alGetErrorDirect(This->ctx) != AL_NO_ERROR)
     {
         ERR("Couldn't start source\n");
         hr = DSERR_GENERIC;
         goto out;
     }
-    This->isplaying = TRUE;
+    DSBuffer_SetPlaying(This, TRUE);
+    DSShare_starttimer(This->share);
 
-    if(This->nnotify)
+    if(This->segsize != 0)
+    {
+        /* Queue the first segments and start the source now, instead of
+         * waiting for the next mixer update.
+         */
+        BYTE scratch_mem[2048];
+        DSBuffer_stream(This, scratch_mem);
+        checkALError(This->ctx);
+    }
+
+    if(This->nnotify || This->segsize == 0)
         DSBuffer_addnotify(This);
 
 out:
     popALContext();
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
+    APITRACE(DSTracePlay, hr, This, NULL, NULL, 0, 2, prio, flags);
     return hr;
 }
 
@@ -1385,36 +1715,40 @@ static HRESULT WINAPI DSBuffer_SetCurrentPosition(IDirectSoundBuffer8 *iface, DW
         return DSERR_INVALIDPARAM;
     pos -= pos%data->format.Format.nBlockAlign;
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
 
     if(This->segsize != 0)
     {
+        This->queue_base = This->data_offset = pos;
+        This->curidx = 0;
         if(This->isplaying)
         {
+            BYTE scratch_mem[2048];
+
             setALContext(This->ctx);
-            /* Perform a flush, so the next timer update will restart at the
-             * proper position */
-            alSourceRewind(This->source);
-            alSourcei(This->source, AL_BUFFER, 0);
-            checkALError();
+            /* Flush the queue and restart from the new position right away. */
+            alSourceRewindDirect(This->ctx, This->source);
+            alSourceiDirect(This->ctx, This->source, AL_BUFFER, 0);
+            DSBuffer_stream(This, scratch_mem);
+            checkALError(This->ctx);
             popALContext();
         }
-        This->queue_base = This->data_offset = pos;
-        This->curidx = 0;
     }
     else
     {
         if(LIKELY(This->source))
         {
             setALContext(This->ctx);
-            alSourcei(This->source, AL_BYTE_OFFSET, pos);
-            checkALError();
+            alSourceiDirect(This->ctx, This->source, AL_BYTE_OFFSET, pos);
+            checkALError(This->ctx);
             popALContext();
         }
     }
     This->lastpos = pos;
+    This->cursor_valid = FALSE;
 
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
+    APITRACE(DSTraceSetCurrentPosition, DS_OK, This, NULL, NULL, 0, 1, pos);
     return DS_OK;
 }
 
@@ -1446,11 +1780,12 @@ static HRESULT WINAPI DSBuffer_SetVolume(IDirectSoundBuffer8 *iface, LONG vol)
         if(LIKELY(This->source))
         {
             setALContext(This->ctx);
-            alSourcef(This->source, AL_GAIN, mB_to_gain((float)vol));
+            alSourcefDirect(This->ctx, This->source, AL_GAIN, mB_to_gain((float)vol));
             popALContext();
         }
     }
 
+    APITRACE(DSTraceSetVolume, hr, This, NULL, NULL, 0, 1, (DWORD)vol);
     return hr;
 }
 
@@ -1475,21 +1810,16 @@ static HRESULT WINAPI DSBuffer_SetPan(IDirectSoundBuffer8 *iface, LONG pan)
         if(LIKELY(This->source && !(This->buffer->dsbflags&DSBCAPS_CTRL3D)))
         {
             ALfloat pos[3];
-            pos[0] = (ALfloat)(pan-DSBPAN_LEFT)/(ALfloat)(DSBPAN_RIGHT-DSBPAN_LEFT) - 0.5f;
-            pos[1] = 0.0f;
-            /* NOTE: Strict movement along the X plane can cause the sound to
-             * jump between left and right sharply. Using a curved path helps
-             * smooth it out.
-             */
-            pos[2] = -sqrtf(1.0f - pos[0]*pos[0]);
+            DSCore_PanPosition(pan, pos);
 
             setALContext(This->ctx);
-            alSourcefv(This->source, AL_POSITION, pos);
-            checkALError();
+            alSourcefvDirect(This->ctx, This->source, AL_POSITION, pos);
+            checkALError(This->ctx);
             popALContext();
         }
     }
 
+    APITRACE(DSTraceSetPan, hr, This, NULL, NULL, 0, 1, (DWORD)pan);
     return hr;
 }
 
@@ -1516,14 +1846,14 @@ static HRESULT WINAPI DSBuffer_SetFrequency(IDirectSoundBuffer8 *iface, DWORD fr
         if(LIKELY(This->source))
         {
             setALContext(This->ctx);
-            alSourcef(This->source, AL_PITCH,
-                This->current.frequency / (ALfloat)data->format.Format.nSamplesPerSec
-            );
-            checkALError();
+            alSourcefDirect(This->ctx, This->source, AL_PITCH,
+                DSCore_Pitch(This->current.frequency, data->format.Format.nSamplesPerSec));
+            checkALError(This->ctx);
             popALContext();
         }
     }
 
+    APITRACE(DSTraceSetFrequency, hr, This, NULL, NULL, 0, 1, freq);
     return hr;
 }
 
@@ -1533,21 +1863,26 @@ static HRESULT WINAPI DSBuffer_Stop(IDirectSoundBuffer8 *iface)
 
     TRACE("(%p)->()\n", iface);
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
     if(LIKELY(This->source))
     {
         const ALuint source = This->source;
         ALint state, ofs;
 
         setALContext(This->ctx);
-        alSourcePause(source);
-        alGetSourcei(source, AL_BYTE_OFFSET, &ofs);
-        alGetSourcei(source, AL_SOURCE_STATE, &state);
-        checkALError();
-
-        This->isplaying = FALSE;
+        DSPrimary_cancelstart(This->primary, This);
+        alSourcePauseDirect(This->ctx, source);
+        alGetSourceiDirect(This->ctx, source, AL_BYTE_OFFSET, &ofs);
+        alGetSourceiDirect(This->ctx, source, AL_SOURCE_STATE, &state);
+        checkALError(This->ctx);
+
+        DSBuffer_SetPlaying(This, FALSE);
+        This->cursor_valid = FALSE;
         if(This->nnotify)
-            DSPrimary_triggernots(This->primary);
+        {
+            DWORD pos = 0;
+            DSPrimary_triggernots(This->primary, &pos, ~0u);
+        }
         /* Ensure the notification's last tracked position is updated, as well
          * as the queue offsets for streaming sources.
          */
@@ -1558,7 +1893,7 @@ static HRESULT WINAPI DSBuffer_Stop(IDirectSoundBuffer8 *iface)
             DSData *data = This->buffer;
             ALint done = 0;
 
-            alGetSourcei(This->source, AL_BUFFERS_PROCESSED, &done);
+            alGetSourceiDirect(This->ctx, This->source, AL_BUFFERS_PROCESSED, &done);
             This->queue_base += This->segsize*done + ofs;
             if(This->queue_base >= data->buf_size)
             {
@@ -1569,9 +1904,9 @@ static HRESULT WINAPI DSBuffer_Stop(IDirectSoundBuffer8 *iface)
             }
             This->lastpos = This->queue_base;
 
-            alSourceRewind(This->source);
-            alSourcei(This->source, AL_BUFFER, 0);
-            checkALError();
+            alSourceRewindDirect(This->ctx, This->source);
+            alSourceiDirect(This->ctx, This->source, AL_BUFFER, 0);
+            checkALError(This->ctx);
 
             This->curidx = 0;
             This->data_offset = This->lastpos % data->buf_size;
@@ -1579,12 +1914,13 @@ static HRESULT WINAPI DSBuffer_Stop(IDirectSoundBuffer8 *iface)
         This->islooping = FALSE;
         popALContext();
     }
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
 
+    APITRACE(DSTraceStop, S_OK, This, NULL, NULL, 0, 0);
     return S_OK;
 }
 
-static HRESULT WINAPI DSBuffer_Unlock(IDirectSoundBuffer8 *iface, void *ptr1, DWORD len1, void *ptr2, DWORD len2)
+static HRESULT DSBuffer_DoUnlock(IDirectSoundBuffer8 *iface, void *ptr1, DWORD len1, void *ptr2, DWORD len2)
 {
     DSBuffer *This = impl_from_IDirectSoundBuffer8(iface);
     DSData *buf = This->buffer;
@@ -1621,17 +1957,18 @@ static HRESULT WINAPI DSBuffer_Unlock(IDirectSoundBuffer8 *iface, void *ptr1, DW
     if(HAS_EXTENSION(This->share, SOFTX_MAP_BUFFER))
     {
         setALContext(This->ctx);
-        alFlushMappedBufferSOFT(buf->bid, 0, buf->buf_size);
-        checkALError();
+        alFlushMappedBufferDirectSOFT(This->ctx, buf->bid, 0, buf->buf_size);
+        checkALError(This->ctx);
         popALContext();
     }
     else if(This->segsize == 0)
     {
         setALContext(This->ctx);
-        alBufferData(buf->bid, buf->buf_format, buf->data, buf->buf_size,
-                     buf->format.Format.nSamplesPerSec);
-        checkALError();
+        alBufferDataDirect(This->ctx, buf->bid, buf->buf_format, buf->data, buf->buf_size,
+                           buf->format.Format.nSamplesPerSec);
+        checkALError(This->ctx);
         popALContext();
+        This->stats.buffer_data_calls++;
     }
 
 out:
@@ -1641,6 +1978,19 @@ out:
     return hr;
 }
 
+static HRESULT WINAPI DSBuffer_Unlock(IDirectSoundBuffer8 *iface, void *ptr1, DWORD len1, void *ptr2, DWORD len2)
+{
+    DSBuffer *This = impl_from_IDirectSoundBuffer8(iface);
+    LONGLONG start = DSBuffer_clocknow(This->share);
+    HRESULT hr = DSBuffer_DoUnlock(iface, ptr1, len1, ptr2, len2);
+
+    InterlockedIncrement(&This->stats.lock_calls);
+    InterlockedExchangeAdd64(&This->stats.lock_time, DSBuffer_clocknow(This->share) - start);
+    if(UNLIKELY(ApiTraceEnabled) && SUCCEEDED(hr))
+        ApiTrace_RecordUnlock(This, hr, This->buffer->data, ptr1, len1, ptr2, len2);
+    return hr;
+}
+
 static HRESULT WINAPI DSBuffer_Restore(IDirectSoundBuffer8 *iface)
 {
     DSBuffer *This = impl_from_IDirectSoundBuffer8(iface);
@@ -1648,7 +1998,7 @@ static HRESULT WINAPI DSBuffer_Restore(IDirectSoundBuffer8 *iface)
 
     TRACE("(%p)->()\n", iface);
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
     if(This->primary->parent->prio_level < DSSCL_WRITEPRIMARY ||
        (IDirectSoundBuffer*)&This->IDirectSoundBuffer8_iface == This->primary->write_emu)
     {
@@ -1657,7 +2007,7 @@ static HRESULT WINAPI DSBuffer_Restore(IDirectSoundBuffer8 *iface)
     }
     else
         hr = DSERR_BUFFERLOST;
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
 
     return hr;
 }
@@ -1685,13 +2035,13 @@ static HRESULT WINAPI DSBuffer_SetFX(IDirectSoundBuffer8 *iface, DWORD fxcount,
         return DSERR_INVALIDCALL;
     }
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
 
     setALContext(This->ctx);
     if(LIKELY(This->source))
     {
-        alGetSourcei(This->source, AL_SOURCE_STATE, &state);
-        checkALError();
+        alGetSourceiDirect(This->ctx, This->source, AL_SOURCE_STATE, &state);
+        checkALError(This->ctx);
     }
     popALContext();
     if(This->segsize != 0 && state != AL_PLAYING)
@@ -1732,7 +2082,7 @@ static HRESULT WINAPI DSBuffer_SetFX(IDirectSoundBuffer8 *iface, DWORD fxcount,
     hr = DS_INCOMPLETE;
 
 done:
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
 
     return hr;
 }
@@ -1751,7 +2101,7 @@ static HRESULT WINAPI DSBuffer_AcquireResources(IDirectSoundBuffer8 *iface, DWOR
         return DSERR_INVALIDPARAM;
     }
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
     setALContext(This->ctx);
 
     hr = DS_OK;
@@ -1778,10 +2128,12 @@ static HRESULT WINAPI DSBuffer_AcquireResources(IDirectSoundBuffer8 *iface, DWOR
                 if(This->isplaying)
                     state = AL_PLAYING;
             }
+            else if(This->start_pending)
+                state = AL_PLAYING;
             else
             {
-                alGetSourcei(This->source, AL_SOURCE_STATE, &state);
-                checkALError();
+                alGetSourceiDirect(This->ctx, This->source, AL_SOURCE_STATE, &state);
+                checkALError(This->ctx);
             }
 
             if(state == AL_PLAYING)
@@ -1796,7 +2148,7 @@ static HRESULT WINAPI DSBuffer_AcquireResources(IDirectSoundBuffer8 *iface, DWOR
 
 out:
     popALContext();
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
     return hr;
 }
 
@@ -1807,17 +2159,36 @@ static HRESULT WINAPI DSBuffer_GetObjectInPath(IDirectSoundBuffer8 *iface, REFGU
     return E_NOTIMPL;
 }
 
+/* The app-facing entries for the queries other functions here make too, so
+ * only the app's calls are traced.
+ */
+static HRESULT WINAPI DSBuffer_AppGetCurrentPosition(IDirectSoundBuffer8 *iface, DWORD *playpos, DWORD *curpos)
+{
+    HRESULT hr = DSBuffer_GetCurrentPosition(iface, playpos, curpos);
+    APITRACE(DSTraceGetCurrentPosition, hr, impl_from_IDirectSoundBuffer8(iface), NULL, NULL, 0, 2,
+             playpos ? *playpos : 0, curpos ? *curpos : 0);
+    return hr;
+}
+
+static HRESULT WINAPI DSBuffer_AppGetStatus(IDirectSoundBuffer8 *iface, DWORD *status)
+{
+    HRESULT hr = DSBuffer_GetStatus(iface, status);
+    APITRACE(DSTraceGetStatus, hr, impl_from_IDirectSoundBuffer8(iface), NULL, NULL, 0, 1,
+             SUCCEEDED(hr) ? *status : 0);
+    return hr;
+}
+
 static IDirectSoundBuffer8Vtbl DSBuffer_Vtbl = {
     DSBuffer_QueryInterface,
     DSBuffer_AddRef,
     DSBuffer_Release,
     DSBuffer_GetCaps,
-    DSBuffer_GetCurrentPosition,
+    DSBuffer_AppGetCurrentPosition,
     DSBuffer_GetFormat,
     DSBuffer_GetVolume,
     DSBuffer_GetPan,
     DSBuffer_GetFrequency,
-    DSBuffer_GetStatus,
+    DSBuffer_AppGetStatus,
     DSBuffer_Initialize,
     DSBuffer_Lock,
     DSBuffer_Play,
@@ -1841,6 +2212,7 @@ void DSBuffer_SetParams(DSBuffer *This, const DS3DBUFFER *params, LONG flags)
     union BufferParamFlags dirty = { flags };
 
     /* Copy deferred parameters first. */
+    AcquireSRWLockExclusive(&This->share->params_lock);
     if(dirty.bit.pos)
         This->current.ds3d.vPosition = params->vPosition;
     if(dirty.bit.vel)
@@ -1860,38 +2232,39 @@ void DSBuffer_SetParams(DSBuffer *This, const DS3DBUFFER *params, LONG flags)
         This->current.ds3d.flMaxDistance = params->flMaxDistance;
     if(dirty.bit.mode)
         This->current.ds3d.dwMode = params->dwMode;
+    ReleaseSRWLockExclusive(&This->share->params_lock);
 
     /* Now apply what's changed to OpenAL. */
     if(UNLIKELY(!source)) return;
 
     if(dirty.bit.pos)
-        alSource3f(source, AL_POSITION, params->vPosition.x, params->vPosition.y,
-                                       -params->vPosition.z);
+        alSource3fDirect(This->ctx, source, AL_POSITION, params->vPosition.x, params->vPosition.y,
+                                                        -params->vPosition.z);
     if(dirty.bit.vel)
-        alSource3f(source, AL_VELOCITY, params->vVelocity.x, params->vVelocity.y,
-                                       -params->vVelocity.z);
+        alSource3fDirect(This->ctx, source, AL_VELOCITY, params->vVelocity.x, params->vVelocity.y,
+                                                        -params->vVelocity.z);
     if(dirty.bit.cone_angles)
     {
-        alSourcei(source, AL_CONE_INNER_ANGLE, params->dwInsideConeAngle);
-        alSourcei(source, AL_CONE_OUTER_ANGLE, params->dwOutsideConeAngle);
+        alSourceiDirect(This->ctx, source, AL_CONE_INNER_ANGLE, params->dwInsideConeAngle);
+        alSourceiDirect(This->ctx, source, AL_CONE_OUTER_ANGLE, params->dwOutsideConeAngle);
     }
     if(dirty.bit.cone_orient)
-        alSource3f(source, AL_DIRECTION, params->vConeOrientation.x,
-                                         params->vConeOrientation.y,
-                                        -params->vConeOrientation.z);
+        alSource3fDirect(This->ctx, source, AL_DIRECTION, params->vConeOrientation.x,
+                                                          params->vConeOrientation.y,
+                                                         -params->vConeOrientation.z);
     if(dirty.bit.cone_outsidevolume)
-        alSourcef(source, AL_CONE_OUTER_GAIN, mB_to_gain((float)params->lConeOutsideVolume));
+        alSourcefDirect(This->ctx, source, AL_CONE_OUTER_GAIN, mB_to_gain((float)params->lConeOutsideVolume));
     if(dirty.bit.min_distance)
-        alSourcef(source, AL_REFERENCE_DISTANCE, params->flMinDistance);
+        alSourcefDirect(This->ctx, source, AL_REFERENCE_DISTANCE, params->flMinDistance);
     if(dirty.bit.max_distance)
-        alSourcef(source, AL_MAX_DISTANCE, params->flMaxDistance);
+        alSourcefDirect(This->ctx, source, AL_MAX_DISTANCE, params->flMaxDistance);
     if(dirty.bit.mode)
     {
         if(HAS_EXTENSION(This->share, SOFT_SOURCE_SPATIALIZE))
-            alSourcei(source, AL_SOURCE_SPATIALIZE_SOFT,
+            alSourceiDirect(This->ctx, source, AL_SOURCE_SPATIALIZE_SOFT,
                 (params->dwMode==DS3DMODE_DISABLE) ? AL_FALSE : AL_TRUE
             );
-        alSourcei(source, AL_SOURCE_RELATIVE,
+        alSourceiDirect(This->ctx, source, AL_SOURCE_RELATIVE,
             (params->dwMode!=DS3DMODE_NORMAL) ? AL_TRUE : AL_FALSE
         );
     }
@@ -1932,6 +2305,7 @@ static ULONG WINAPI DSBuffer3D_Release(IDirectSound3DBuffer *iface)
 static HRESULT WINAPI DSBuffer3D_GetConeAngles(IDirectSound3DBuffer *iface, DWORD *pdwInsideConeAngle, DWORD *pdwOutsideConeAngle)
 {
     DSBuffer *This = impl_from_IDirectSound3DBuffer(iface);
+    LONGLONG lockstart;
 
     TRACE("(%p)->(%p, %p)\n", This, pdwInsideConeAngle, pdwOutsideConeAngle);
     if(!pdwInsideConeAngle || !pdwOutsideConeAngle)
@@ -1940,10 +2314,10 @@ static HRESULT WINAPI DSBuffer3D_GetConeAngles(IDirectSound3DBuffer *iface, DWOR
         return DSERR_INVALIDPARAM;
     }
 
-    EnterCriticalSection(&This->share->crst);
+    lockstart = DSShare_LockParams(This->share);
     *pdwInsideConeAngle = This->current.ds3d.dwInsideConeAngle;
     *pdwOutsideConeAngle = This->current.ds3d.dwOutsideConeAngle;
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_UnlockParams(This->share, lockstart);
 
     return S_OK;
 }
@@ -1951,6 +2325,7 @@ static HRESULT WINAPI DSBuffer3D_GetConeAngles(IDirectSound3DBuffer *iface, DWOR
 static HRESULT WINAPI DSBuffer3D_GetConeOrientation(IDirectSound3DBuffer *iface, D3DVECTOR *orient)
 {
     DSBuffer *This = impl_from_IDirectSound3DBuffer(iface);
+    LONGLONG lockstart;
 
     TRACE("(%p)->(%p)\n", This, orient);
     if(!orient)
@@ -1959,9 +2334,9 @@ static HRESULT WINAPI DSBuffer3D_GetConeOrientation(IDirectSound3DBuffer *iface,
         return DSERR_INVALIDPARAM;
     }
 
-    EnterCriticalSection(&This->share->crst);
+    lockstart = DSShare_LockParams(This->share);
     *orient = This->current.ds3d.vConeOrientation;
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_UnlockParams(This->share, lockstart);
 
     return S_OK;
 }
@@ -2029,6 +2404,7 @@ static HRESULT WINAPI DSBuffer3D_GetMode(IDirectSound3DBuffer *iface, DWORD *mod
 static HRESULT WINAPI DSBuffer3D_GetPosition(IDirectSound3DBuffer *iface, D3DVECTOR *pos)
 {
     DSBuffer *This = impl_from_IDirectSound3DBuffer(iface);
+    LONGLONG lockstart;
 
     TRACE("(%p)->(%p)\n", This, pos);
     if(!pos)
@@ -2037,9 +2413,9 @@ static HRESULT WINAPI DSBuffer3D_GetPosition(IDirectSound3DBuffer *iface, D3DVEC
         return DSERR_INVALIDPARAM;
     }
 
-    EnterCriticalSection(&This->share->crst);
+    lockstart = DSShare_LockParams(This->share);
     *pos = This->current.ds3d.vPosition;
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_UnlockParams(This->share, lockstart);
 
     return S_OK;
 }
@@ -2047,6 +2423,7 @@ static HRESULT WINAPI DSBuffer3D_GetPosition(IDirectSound3DBuffer *iface, D3DVEC
 static HRESULT WINAPI DSBuffer3D_GetVelocity(IDirectSound3DBuffer *iface, D3DVECTOR *vel)
 {
     DSBuffer *This = impl_from_IDirectSound3DBuffer(iface);
+    LONGLONG lockstart;
 
     TRACE("(%p)->(%p)\n", This, vel);
     if(!vel)
@@ -2055,9 +2432,9 @@ static HRESULT WINAPI DSBuffer3D_GetVelocity(IDirectSound3DBuffer *iface, D3DVEC
         return DSERR_INVALIDPARAM;
     }
 
-    EnterCriticalSection(&This->share->crst);
+    lockstart = DSShare_LockParams(This->share);
     *vel = This->current.ds3d.vVelocity;
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_UnlockParams(This->share, lockstart);
 
     return S_OK;
 }
@@ -2065,6 +2442,7 @@ static HRESULT WINAPI DSBuffer3D_GetVelocity(IDirectSound3DBuffer *iface, D3DVEC
 static HRESULT WINAPI DSBuffer3D_GetAllParameters(IDirectSound3DBuffer *iface, DS3DBUFFER *ds3dbuffer)
 {
     DSBuffer *This = impl_from_IDirectSound3DBuffer(iface);
+    LONGLONG lockstart;
 
     TRACE("(%p)->(%p)\n", iface, ds3dbuffer);
 
@@ -2074,7 +2452,7 @@ static HRESULT WINAPI DSBuffer3D_GetAllParameters(IDirectSound3DBuffer *iface, D
         return DSERR_INVALIDPARAM;
     }
 
-    EnterCriticalSection(&This->share->crst);
+    lockstart = DSShare_LockParams(This->share);
     ds3dbuffer->vPosition = This->current.ds3d.vPosition;
     ds3dbuffer->vVelocity = This->current.ds3d.vVelocity;
     ds3dbuffer->dwInsideConeAngle = This->current.ds3d.dwInsideConeAngle;
@@ -2084,7 +2462,7 @@ static HRESULT WINAPI DSBuffer3D_GetAllParameters(IDirectSound3DBuffer *iface, D
     ds3dbuffer->flMinDistance = This->current.ds3d.flMinDistance;
     ds3dbuffer->flMaxDistance = This->current.ds3d.flMaxDistance;
     ds3dbuffer->dwMode = This->current.ds3d.dwMode;
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_UnlockParams(This->share, lockstart);
 
     return DS_OK;
 }
@@ -2100,7 +2478,7 @@ static HRESULT WINAPI DSBuffer3D_SetConeAngles(IDirectSound3DBuffer *iface, DWOR
         return DSERR_INVALIDPARAM;
     }
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
     if(apply == DS3D_DEFERRED)
     {
         This->deferred.ds3d.dwInsideConeAngle = dwInsideConeAngle;
@@ -2110,18 +2488,22 @@ static HRESULT WINAPI DSBuffer3D_SetConeAngles(IDirectSound3DBuffer *iface, DWOR
     else
     {
         setALContext(This->ctx);
+        AcquireSRWLockExclusive(&This->share->params_lock);
         This->current.ds3d.dwInsideConeAngle = dwInsideConeAngle;
         This->current.ds3d.dwOutsideConeAngle = dwOutsideConeAngle;
+        ReleaseSRWLockExclusive(&This->share->params_lock);
         if(LIKELY(This->source))
         {
-            alSourcei(This->source, AL_CONE_INNER_ANGLE, dwInsideConeAngle);
-            alSourcei(This->source, AL_CONE_OUTER_ANGLE, dwOutsideConeAngle);
-            checkALError();
+            alSourceiDirect(This->ctx, This->source, AL_CONE_INNER_ANGLE, dwInsideConeAngle);
+            alSourceiDirect(This->ctx, This->source, AL_CONE_OUTER_ANGLE, dwOutsideConeAngle);
+            checkALError(This->ctx);
         }
         popALContext();
     }
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
 
+    APITRACE(DSTrace3DSetConeAngles, S_OK, This, NULL, NULL, 0, 3,
+             dwInsideConeAngle, dwOutsideConeAngle, apply);
     return S_OK;
 }
 
@@ -2131,7 +2513,7 @@ static HRESULT WINAPI DSBuffer3D_SetConeOrientation(IDirectSound3DBuffer *iface,
 
     TRACE("(%p)->(%f, %f, %f, %lu)\n", This, x, y, z, apply);
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
     if(apply == DS3D_DEFERRED)
     {
         This->deferred.ds3d.vConeOrientation.x = x;
@@ -2142,18 +2524,22 @@ static HRESULT WINAPI DSBuffer3D_SetConeOrientation(IDirectSound3DBuffer *iface,
     else
     {
         setALContext(This->ctx);
+        AcquireSRWLockExclusive(&This->share->params_lock);
         This->current.ds3d.vConeOrientation.x = x;
         This->current.ds3d.vConeOrientation.y = y;
         This->current.ds3d.vConeOrientation.z = z;
+        ReleaseSRWLockExclusive(&This->share->params_lock);
         if(LIKELY(This->source))
         {
-            alSource3f(This->source, AL_DIRECTION, x, y, -z);
-            checkALError();
+            alSource3fDirect(This->ctx, This->source, AL_DIRECTION, x, y, -z);
+            checkALError(This->ctx);
         }
         popALContext();
     }
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
 
+    APITRACE(DSTrace3DSetConeOrientation, S_OK, This, NULL, NULL, 0, 4,
+             ApiTrace_Float(x), ApiTrace_Float(y), ApiTrace_Float(z), apply);
     return S_OK;
 }
 
@@ -2168,7 +2554,7 @@ static HRESULT WINAPI DSBuffer3D_SetConeOutsideVolume(IDirectSound3DBuffer *ifac
         return DSERR_INVALIDPARAM;
     }
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
     if(apply == DS3D_DEFERRED)
     {
         This->deferred.ds3d.lConeOutsideVolume = vol;
@@ -2177,16 +2563,20 @@ static HRESULT WINAPI DSBuffer3D_SetConeOutsideVolume(IDirectSound3DBuffer *ifac
     else
     {
         setALContext(This->ctx);
+        AcquireSRWLockExclusive(&This->share->params_lock);
         This->current.ds3d.lConeOutsideVolume = vol;
+        ReleaseSRWLockExclusive(&This->share->params_lock);
         if(LIKELY(This->source))
         {
-            alSourcef(This->source, AL_CONE_OUTER_GAIN, mB_to_gain((float)vol));
-            checkALError();
+            alSourcefDirect(This->ctx, This->source, AL_CONE_OUTER_GAIN, mB_to_gain((float)vol));
+            checkALError(This->ctx);
         }
         popALContext();
     }
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
 
+    APITRACE(DSTrace3DSetConeOutsideVolume, S_OK, This, NULL, NULL, 0, 2,
+             (DWORD)vol, apply);
     return S_OK;
 }
 
@@ -2201,7 +2591,7 @@ static HRESULT WINAPI DSBuffer3D_SetMaxDistance(IDirectSound3DBuffer *iface, D3D
         return DSERR_INVALIDPARAM;
     }
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
     if(apply == DS3D_DEFERRED)
     {
         This->deferred.ds3d.flMaxDistance = maxdist;
@@ -2210,16 +2600,20 @@ static HRESULT WINAPI DSBuffer3D_SetMaxDistance(IDirectSound3DBuffer *iface, D3D
     else
     {
         setALContext(This->ctx);
+        AcquireSRWLockExclusive(&This->share->params_lock);
         This->current.ds3d.flMaxDistance = maxdist;
+        ReleaseSRWLockExclusive(&This->share->params_lock);
         if(LIKELY(This->source))
         {
-            alSourcef(This->source, AL_MAX_DISTANCE, maxdist);
-            checkALError();
+            alSourcefDirect(This->ctx, This->source, AL_MAX_DISTANCE, maxdist);
+            checkALError(This->ctx);
         }
         popALContext();
     }
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
 
+    APITRACE(DSTrace3DSetMaxDistance, S_OK, This, NULL, NULL, 0, 2,
+             ApiTrace_Float(maxdist), apply);
     return S_OK;
 }
 
@@ -2234,7 +2628,7 @@ static HRESULT WINAPI DSBuffer3D_SetMinDistance(IDirectSound3DBuffer *iface, D3D
         return DSERR_INVALIDPARAM;
     }
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
     if(apply == DS3D_DEFERRED)
     {
         This->deferred.ds3d.flMinDistance = mindist;
@@ -2243,16 +2637,20 @@ static HRESULT WINAPI DSBuffer3D_SetMinDistance(IDirectSound3DBuffer *iface, D3D
     else
     {
         setALContext(This->ctx);
+        AcquireSRWLockExclusive(&This->share->params_lock);
         This->current.ds3d.flMinDistance = mindist;
+        ReleaseSRWLockExclusive(&This->share->params_lock);
         if(LIKELY(This->source))
         {
-            alSourcef(This->source, AL_REFERENCE_DISTANCE, mindist);
-            checkALError();
+            alSourcefDirect(This->ctx, This->source, AL_REFERENCE_DISTANCE, mindist);
+            checkALError(This->ctx);
         }
         popALContext();
     }
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
 
+    APITRACE(DSTrace3DSetMinDistance, S_OK, This, NULL, NULL, 0, 2,
+             ApiTrace_Float(mindist), apply);
     return S_OK;
 }
 
@@ -2268,7 +2666,7 @@ static HRESULT WINAPI DSBuffer3D_SetMode(IDirectSound3DBuffer *iface, DWORD mode
         return DSERR_INVALIDPARAM;
     }
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
     if(apply == DS3D_DEFERRED)
     {
         This->deferred.ds3d.dwMode = mode;
@@ -2277,20 +2675,23 @@ static HRESULT WINAPI DSBuffer3D_SetMode(IDirectSound3DBuffer *iface, DWORD mode
     else
     {
         setALContext(This->ctx);
+        AcquireSRWLockExclusive(&This->share->params_lock);
         This->current.ds3d.dwMode = mode;
+        ReleaseSRWLockExclusive(&This->share->params_lock);
         if(LIKELY(This->source))
         {
             if(HAS_EXTENSION(This->share, SOFT_SOURCE_SPATIALIZE))
-                alSourcei(This->source, AL_SOURCE_SPATIALIZE_SOFT,
-                          (mode==DS3DMODE_DISABLE) ? AL_FALSE : AL_TRUE);
-            alSourcei(This->source, AL_SOURCE_RELATIVE,
-                      (mode != DS3DMODE_NORMAL) ? AL_TRUE : AL_FALSE);
-            checkALError();
+                alSourceiDirect(This->ctx, This->source, AL_SOURCE_SPATIALIZE_SOFT,
+                                (mode==DS3DMODE_DISABLE) ? AL_FALSE : AL_TRUE);
+            alSourceiDirect(This->ctx, This->source, AL_SOURCE_RELATIVE,
+                            (mode != DS3DMODE_NORMAL) ? AL_TRUE : AL_FALSE);
+            checkALError(This->ctx);
         }
         popALContext();
     }
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
 
+    APITRACE(DSTrace3DSetMode, S_OK, This, NULL, NULL, 0, 2, mode, apply);
     return S_OK;
 }
 
@@ -2300,7 +2701,7 @@ static HRESULT WINAPI DSBuffer3D_SetPosition(IDirectSound3DBuffer *iface, D3DVAL
 
     TRACE("(%p)->(%f, %f, %f, %lu)\n", This, x, y, z, apply);
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
     if(apply == DS3D_DEFERRED)
     {
         This->deferred.ds3d.vPosition.x = x;
@@ -2308,21 +2709,29 @@ static HRESULT WINAPI DSBuffer3D_SetPosition(IDirectSound3DBuffer *iface, D3DVAL
         This->deferred.ds3d.vPosition.z = z;
         This->dirty.bit.pos = 1;
     }
-    else
+    else if(This->current.ds3d.vPosition.x != x || This->current.ds3d.vPosition.y != y ||
+            This->current.ds3d.vPosition.z != z)
     {
+        /* The source always has the current position, so re-setting it (as
+         * apps often do for sounds on static objects) needs no AL call.
+         */
         setALContext(This->ctx);
+        AcquireSRWLockExclusive(&This->share->params_lock);
         This->current.ds3d.vPosition.x = x;
         This->current.ds3d.vPosition.y = y;
         This->current.ds3d.vPosition.z = z;
+        ReleaseSRWLockExclusive(&This->share->params_lock);
         if(LIKELY(This->source))
         {
-            alSource3f(This->source, AL_POSITION, x, y, -z);
-            checkALError();
+            alSource3fDirect(This->ctx, This->source, AL_POSITION, x, y, -z);
+            checkALError(This->ctx);
         }
         popALContext();
     }
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
 
+    APITRACE(DSTrace3DSetPosition, S_OK, This, NULL, NULL, 0, 4,
+             ApiTrace_Float(x), ApiTrace_Float(y), ApiTrace_Float(z), apply);
     return S_OK;
 }
 
@@ -2332,7 +2741,7 @@ static HRESULT WINAPI DSBuffer3D_SetVelocity(IDirectSound3DBuffer *iface, D3DVAL
 
     TRACE("(%p)->(%f, %f, %f, %lu)\n", This, x, y, z, apply);
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
     if(apply == DS3D_DEFERRED)
     {
         This->deferred.ds3d.vVelocity.x = x;
@@ -2343,18 +2752,22 @@ static HRESULT WINAPI DSBuffer3D_SetVelocity(IDirectSound3DBuffer *iface, D3DVAL
     else
     {
         setALContext(This->ctx);
+        AcquireSRWLockExclusive(&This->share->params_lock);
         This->current.ds3d.vVelocity.x = x;
         This->current.ds3d.vVelocity.y = y;
         This->current.ds3d.vVelocity.z = z;
+        ReleaseSRWLockExclusive(&This->share->params_lock);
         if(LIKELY(This->source))
         {
-            alSource3f(This->source, AL_VELOCITY, x, y, -z);
-            checkALError();
+            alSource3fDirect(This->ctx, This->source, AL_VELOCITY, x, y, -z);
+            checkALError(This->ctx);
         }
         popALContext();
     }
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
 
+    APITRACE(DSTrace3DSetVelocity, S_OK, This, NULL, NULL, 0, 4,
+             ApiTrace_Float(x), ApiTrace_Float(y), ApiTrace_Float(z), apply);
     return S_OK;
 }
 
@@ -2406,7 +2819,7 @@ static HRESULT WINAPI DSBuffer3D_SetAllParameters(IDirectSound3DBuffer *iface, c
 
     if(apply == DS3D_DEFERRED)
     {
-        EnterCriticalSection(&This->share->crst);
+        DSShare_Lock(This->share);
         This->deferred.ds3d = *ds3dbuffer;
         This->deferred.ds3d.dwSize = sizeof(This->deferred.ds3d);
         This->dirty.bit.pos = 1;
@@ -2417,7 +2830,7 @@ static HRESULT WINAPI DSBuffer3D_SetAllParameters(IDirectSound3DBuffer *iface, c
         This->dirty.bit.min_distance = 1;
         This->dirty.bit.max_distance = 1;
         This->dirty.bit.mode = 1;
-        LeaveCriticalSection(&This->share->crst);
+        DSShare_Unlock(This->share);
     }
     else
     {
@@ -2431,14 +2844,16 @@ static HRESULT WINAPI DSBuffer3D_SetAllParameters(IDirectSound3DBuffer *iface, c
         dirty.bit.max_distance = 1;
         dirty.bit.mode = 1;
 
-        EnterCriticalSection(&This->share->crst);
+        DSShare_Lock(This->share);
         setALContext(This->ctx);
         DSBuffer_SetParams(This, ds3dbuffer, dirty.flags);
-        checkALError();
+        checkALError(This->ctx);
         popALContext();
-        LeaveCriticalSection(&This->share->crst);
+        DSShare_Unlock(This->share);
     }
 
+    APITRACE(DSTrace3DSetAllParameters, S_OK, This, NULL, ds3dbuffer, sizeof(*ds3dbuffer), 1,
+             apply);
     return S_OK;
 }
 
@@ -2509,7 +2924,7 @@ static HRESULT WINAPI DSBufferNot_SetNotificationPositions(IDirectSoundNotify *i
 
     TRACE("(%p)->(%lu, %p))\n", iface, count, notifications);
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
     hr = DSERR_INVALIDPARAM;
     if(count && !notifications)
         goto out;
@@ -2553,7 +2968,10 @@ static HRESULT WINAPI DSBufferNot_SetNotificationPositions(IDirectSoundNotify *i
     }
 
 out:
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
+    APITRACE(DSTraceSetNotificationPositions, hr, This, NULL, notifications,
+             notifications ? count*sizeof(*notifications) : 0, 2, count,
+             (DWORD)sizeof(*notifications));
     return hr;
 }
 
@@ -2582,6 +3000,7 @@ static const char *debug_bufferprop(const GUID *guid)
     HANDLE_ID(DSPROPSETID_EAX10_BufferProperties);
     HANDLE_ID(DSPROPSETID_EAX10_ListenerProperties);
     HANDLE_ID(DSPROPSETID_VoiceManager);
+    HANDLE_ID(DSPROPSETID_DSOAL_BufferStats);
     HANDLE_ID(DSPROPSETID_ZOOMFX_BufferProperties);
     HANDLE_ID(DSPROPSETID_I3DL2_ListenerProperties);
     HANDLE_ID(DSPROPSETID_I3DL2_BufferProperties);
@@ -2646,7 +3065,7 @@ static HRESULT WINAPI DSBufferProp_Get(IKsPropertySet *iface,
         return E_POINTER;
     }
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
     if(IsEqualIID(guidPropSet, &EAXPROPERTYID_EAX40_Source)
         || IsEqualIID(guidPropSet, &DSPROPSETID_EAX30_BufferProperties)
         || IsEqualIID(guidPropSet, &DSPROPSETID_EAX20_BufferProperties)
@@ -2660,15 +3079,17 @@ static HRESULT WINAPI DSBufferProp_Get(IKsPropertySet *iface,
         || IsEqualIID(guidPropSet, &DSPROPSETID_EAX10_BufferProperties)
         || IsEqualIID(guidPropSet, &DSPROPSETID_EAX10_ListenerProperties))
     {
-        err = EAXGet(guidPropSet, dwPropID, This->source, pPropData, cbPropData);
+        err = EAXGetDirect(This->ctx, guidPropSet, dwPropID, This->source, pPropData, cbPropData);
         if(err != AL_NO_ERROR) hr = E_FAIL;
         else hr = DS_OK;
     }
     else if(IsEqualIID(guidPropSet, &DSPROPSETID_VoiceManager))
         hr = VoiceMan_Get(This, dwPropID, pPropData, cbPropData, pcbReturned);
+    else if(IsEqualIID(guidPropSet, &DSPROPSETID_DSOAL_BufferStats))
+        hr = BufStats_Get(This, dwPropID, pPropData, cbPropData, pcbReturned);
     else
         FIXME("Unhandled propset: %s\n", debug_bufferprop(guidPropSet));
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
 
     return hr;
 }
@@ -2690,7 +3111,7 @@ static HRESULT WINAPI DSBufferProp_Set(IKsPropertySet *iface,
         return E_POINTER;
     }
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
     if(IsEqualIID(guidPropSet, &EAXPROPERTYID_EAX40_Source)
         || IsEqualIID(guidPropSet, &DSPROPSETID_EAX30_BufferProperties)
         || IsEqualIID(guidPropSet, &DSPROPSETID_EAX20_BufferProperties)
@@ -2714,10 +3135,12 @@ static HRESULT WINAPI DSBufferProp_Set(IKsPropertySet *iface,
          * both the EAX and standard properties get batched together.
          * CommitDeferredSettings will apply and process updates.
          */
-        if(immediate) alDeferUpdatesSOFT();
-        err = EAXSet(guidPropSet, dwPropID, This->source, pPropData, cbPropData);
+        if(immediate) alDeferUpdatesDirectSOFT(prim->ctx);
+        err = EAXSetDirect(prim->ctx, guidPropSet, dwPropID, This->source, pPropData, cbPropData);
         if(err != AL_NO_ERROR) hr = E_FAIL;
         else hr = DS_OK;
+        LIVESTATS_ADD(This->share, eax_sets, 1);
+        LIVESTATS_ADD(This->share, eax_set_errors, (hr != DS_OK));
 
         if(immediate)
         {
@@ -2727,7 +3150,7 @@ static HRESULT WINAPI DSBufferProp_Set(IKsPropertySet *iface,
                 DSPrimary3D_CommitDeferredSettings(&prim->IDirectSound3DListener_iface);
             }
             else
-                alProcessUpdatesSOFT();
+                alProcessUpdatesDirectSOFT(prim->ctx);
         }
 
         popALContext();
@@ -2736,10 +3159,18 @@ static HRESULT WINAPI DSBufferProp_Set(IKsPropertySet *iface,
     {
         hr = VoiceMan_Set(This, dwPropID, pPropData, cbPropData);
     }
+    else if(IsEqualIID(guidPropSet, &DSPROPSETID_DSOAL_BufferStats))
+        hr = BufStats_Set(This, dwPropID, pPropData, cbPropData);
     else
         FIXME("Unhandled propset: %s\n", debug_bufferprop(guidPropSet));
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
 
+    if(UNLIKELY(ApiTraceEnabled))
+    {
+        const DWORD *set = (const DWORD*)guidPropSet;
+        ApiTrace_Record(DSTracePropertySet, hr, This, NULL, pPropData, cbPropData, 5,
+                        dwPropID, set[0], set[1], set[2], set[3]);
+    }
     return hr;
 }
 
@@ -2757,7 +3188,7 @@ static HRESULT WINAPI DSBufferProp_QuerySupport(IKsPropertySet *iface,
         return E_POINTER;
     *pTypeSupport = 0;
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
     if(IsEqualIID(guidPropSet, &EAXPROPERTYID_EAX40_Source))
         hr = EAX4Source_Query(This, dwPropID, pTypeSupport);
     else if(IsEqualIID(guidPropSet, &DSPROPSETID_EAX30_BufferProperties))
@@ -2781,9 +3212,11 @@ static HRESULT WINAPI DSBufferProp_QuerySupport(IKsPropertySet *iface,
         hr = EAX1Buffer_Query(This, dwPropID, pTypeSupport);
     else if(IsEqualIID(guidPropSet, &DSPROPSETID_VoiceManager))
         hr = VoiceMan_Query(This, dwPropID, pTypeSupport);
+    else if(IsEqualIID(guidPropSet, &DSPROPSETID_DSOAL_BufferStats))
+        hr = BufStats_Query(This, dwPropID, pTypeSupport);
     else
         FIXME("Unhandled propset: %s (propid: %lu)\n", debug_bufferprop(guidPropSet), dwPropID);
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
 
     return hr;
 }
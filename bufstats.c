@@ -0,0 +1,112 @@
+/* DSOAL per-buffer performance counters
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "dsound_private.h"
+
+
+HRESULT BufStats_Query(DSBuffer *buf, DWORD propid, ULONG *pTypeSupport)
+{
+    (void)buf;
+
+    switch(propid)
+    {
+    case DSPROPERTY_DSOAL_BUFFERSTATS:
+        *pTypeSupport = KSPROPERTY_SUPPORT_GET;
+        return DS_OK;
+
+    case DSPROPERTY_DSOAL_BUFFERSTATS_RESET:
+        *pTypeSupport = KSPROPERTY_SUPPORT_SET;
+        return DS_OK;
+    }
+    FIXME("Unhandled propid: 0x%08lx\n", propid);
+    return E_PROP_ID_UNSUPPORTED;
+}
+
+/* Called with the device lock held. */
+HRESULT BufStats_Set(DSBuffer *buf, DWORD propid, void *pPropData, ULONG cbPropData)
+{
+    (void)pPropData;
+    (void)cbPropData;
+
+    switch(propid)
+    {
+    case DSPROPERTY_DSOAL_BUFFERSTATS_RESET:
+        TRACE("DSPROPERTY_DSOAL_BUFFERSTATS_RESET\n");
+        buf->stats.bytes_streamed = 0;
+        buf->stats.buffer_data_calls = 0;
+        buf->stats.notifications = 0;
+        buf->stats.mixer_al_calls = 0;
+        InterlockedExchange(&buf->stats.lock_calls, 0);
+        InterlockedExchange64(&buf->stats.lock_time, 0);
+        buf->underruns = 0;
+        return DS_OK;
+    }
+    FIXME("Unhandled propid: 0x%08lx\n", propid);
+    return E_PROP_ID_UNSUPPORTED;
+}
+
+/* Called with the device lock held. */
+HRESULT BufStats_Get(DSBuffer *buf, DWORD propid, void *pPropData, ULONG cbPropData, ULONG *pcbReturned)
+{
+    DSoalBufferStats local, *stats = &local;
+    ULONG size;
+
+    switch(propid)
+    {
+    case DSPROPERTY_DSOAL_BUFFERSTATS:
+        if(cbPropData < DSOAL_BUFFERSTATS_SIZE_V1)
+            return DSERR_INVALIDPARAM;
+        size = (cbPropData < sizeof(*stats)) ? cbPropData : sizeof(*stats);
+
+        memset(stats, 0, sizeof(*stats));
+        stats->size = size;
+        stats->bytes_streamed = buf->stats.bytes_streamed;
+        stats->underruns = buf->underruns;
+        stats->buffer_data_calls = buf->stats.buffer_data_calls;
+        stats->notifications = buf->stats.notifications;
+        stats->mixer_al_calls = buf->stats.mixer_al_calls;
+        stats->lock_calls = buf->stats.lock_calls;
+        stats->lock_time_ns = InterlockedCompareExchange64(&buf->stats.lock_time, 0, 0);
+
+        if(buf->segsize != 0 && buf->isplaying)
+        {
+            const WAVEFORMATEX *format = &buf->buffer->format.Format;
+            ALint queued = 0, ofs = 0, ahead;
+
+            setALContext(buf->ctx);
+            alGetSourceiDirect(buf->ctx, buf->source, AL_BUFFERS_QUEUED, &queued);
+            alGetSourceiDirect(buf->ctx, buf->source, AL_BYTE_OFFSET, &ofs);
+            checkALError(buf->ctx);
+            popALContext();
+
+            ahead = queued*buf->segsize - ofs;
+            stats->queue_depth = queued;
+            if(ahead > 0)
+                stats->queue_latency_us = (DWORD)((ULONGLONG)ahead * 1000000 /
+                                                  format->nAvgBytesPerSec);
+        }
+
+        /* Only as much as the caller's version of the struct holds. */
+        memcpy(pPropData, stats, size);
+        *pcbReturned = size;
+        TRACE("DSPROPERTY_DSOAL_BUFFERSTATS get: %lu bytes, %lu underruns, %lu notifications\n",
+              size, stats->underruns, stats->notifications);
+        return DS_OK;
+    }
+    FIXME("Unhandled propid: 0x%08lx\n", propid);
+    return E_PROP_ID_UNSUPPORTED;
+}
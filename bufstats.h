@@ -0,0 +1,83 @@
+/* DSOAL per-buffer performance counters
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef DSOAL_BUFSTATS_H
+#define DSOAL_BUFSTATS_H
+
+#include <stddef.h>
+
+/* A DSOAL-specific property set on secondary buffers' IKsPropertySet, for
+ * apps and middleware that want to attribute audio cost to sounds. Query for
+ * support first; other DirectSound implementations won't have it.
+ *
+ * DSPROPERTY_DSOAL_BUFFERSTATS (get): fills a DSoalBufferStats. Callers set
+ *   nothing, but must pass at least DSOAL_BUFFERSTATS_SIZE_V1 bytes. New
+ *   fields are only added at the end: DSOAL writes as much of its struct as
+ *   fits, and sets size and the returned byte count to what it wrote, so
+ *   callers built against an older or newer header both work and can tell
+ *   which fields were filled.
+ * DSPROPERTY_DSOAL_BUFFERSTATS_RESET (set, no data): zeroes the counters.
+ */
+DEFINE_GUID(DSPROPSETID_DSOAL_BufferStats, 0x86af8598, 0x3e3c, 0x43d1, 0xbc, 0x8a, 0xbe, 0x3e, 0x53, 0x8b, 0xf1, 0xf7);
+
+enum {
+    DSPROPERTY_DSOAL_BUFFERSTATS,
+    DSPROPERTY_DSOAL_BUFFERSTATS_RESET
+};
+
+typedef struct DSoalBufferStats {
+    DWORD size;
+
+    /* Streaming buffers: data queued to OpenAL, and how often the queue ran
+     * dry while playing.
+     */
+    ULONGLONG bytes_streamed;
+    DWORD underruns;
+
+    /* alBufferData calls for this buffer, from streaming refills and from
+     * Unlock re-uploading a static buffer.
+     */
+    DWORD buffer_data_calls;
+
+    /* Position notification events signaled. */
+    DWORD notifications;
+
+    /* OpenAL calls the mixer thread made for this buffer, for refills and
+     * notification checks. Calls made on the app's threads (Play, Unlock,
+     * parameter changes, etc.) aren't included. Only counted with
+     * DSOAL_MIXSTATS set, since counting costs a TLS lookup per call, and
+     * zero otherwise.
+     */
+    DWORD mixer_al_calls;
+
+    /* Lock and Unlock calls, and the total time spent in them. */
+    DWORD lock_calls;
+    ULONGLONG lock_time_ns;
+
+    /* Current streaming queue: segments queued, and how much audio they hold
+     * ahead of the play position. Zero for static buffers.
+     */
+    DWORD queue_depth;
+    DWORD queue_latency_us;
+} DSoalBufferStats;
+
+/* The size of the first version of DSoalBufferStats, the least a caller may
+ * pass.
+ */
+#define DSOAL_BUFFERSTATS_SIZE_V1 (offsetof(DSoalBufferStats, queue_latency_us) + sizeof(DWORD))
+
+#endif /* DSOAL_BUFSTATS_H */
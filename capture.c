@@ -24,6 +24,7 @@
 #include <dsound.h>
 
 #include "dsound_private.h"
+#include "convert.h"
 
 #ifndef DSCBPN_OFFSET_STOP
 #define DSCBPN_OFFSET_STOP          0xffffffff
@@ -66,17 +67,42 @@ struct DSCBuffer {
     DSBPOSITIONNOTIFY *notify;
     DWORD nnotify;
 
-    HANDLE thread_hdl;
-    DWORD thread_id;
-
-    HANDLE queue_timer;
-    HANDLE timer_evt;
-    volatile LONG quit_now;
-
+    /* Whether the buffer is in the capture scheduler's list. Guarded by the
+     * scheduler lock.
+     */
+    BOOL scheduled;
+
+    /* When the device can't capture the app's format directly, it captures
+     * into conv_buf in the closest format it has, and convert turns that into
+     * the app's format (counted in samples, not frames).
+     */
+    void (*convert)(void *dst, const void *src, DWORD count);
+    BYTE *conv_buf;
+    DWORD conv_frames;
+
+    /* The capture thread is the only writer of the buffer's data and pos.
+     * After new data is in place, it publishes pos in the low 32 bits of
+     * cursors, and the CURSOR_* state flags and ahead in the high 32 bits, so
+     * GetCurrentPosition can read a matching set without taking crst or
+     * calling into the driver.
+     */
     DWORD pos;
+    volatile LONGLONG cursors;
     BOOL playing, looping;
+
+    /* How many frames the device has captured past pos, as of the capture
+     * thread's last read: the backlog it hasn't read yet, plus the device
+     * latency when the device supports ALC_SOFT_device_clock.
+     */
+    BOOL has_clock;
+    DWORD latency;
+    DWORD ahead;
 };
 
+#define CURSOR_PLAYING 1
+#define CURSOR_LOOPING 2
+#define CURSOR_AHEAD_SHIFT 2
+
 static IDirectSoundCaptureVtbl DSC_Vtbl;
 static IUnknownVtbl DSC_Unknown_Vtbl;
 static IDirectSoundCaptureBuffer8Vtbl DSCBuffer_Vtbl;
@@ -120,84 +146,410 @@ static void trigger_notifies(DSCBuffer *buf, DWORD lastpos, DWORD curpos)
     }
 }
 
-static DWORD CALLBACK DSCBuffer_thread(void *param)
+/* Captures frames into dst through the conversion buffer. */
+static void DSCBuffer_captureconv(DSCBuffer *This, BYTE *dst, DWORD frames)
 {
-    DSCBuffer *This = param;
-    CRITICAL_SECTION *crst = &This->parent->crst;
+    const DWORD channels = This->format.Format.nChannels;
 
-    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+    while(frames > 0)
+    {
+        DWORD todo = (frames < This->conv_frames) ? frames : This->conv_frames;
+
+        alcCaptureSamples(This->device, This->conv_buf, todo);
+        This->convert(dst, This->conv_buf, todo*channels);
+
+        dst += todo * This->format.Format.nBlockAlign;
+        frames -= todo;
+    }
+}
 
-    while(WaitForSingleObject(This->timer_evt, INFINITE) == WAIT_OBJECT_0 && !This->quit_now)
+/* Publishes the read position and capture state for lock-free readers. Must
+ * be called with the parent's crst held.
+ */
+static void DSCBuffer_publish(DSCBuffer *This)
+{
+    LONGLONG flags = (This->playing ? CURSOR_PLAYING : 0) |
+                     (This->looping ? CURSOR_LOOPING : 0);
+
+    if(This->playing)
     {
-        ALCint avail = 0;
+        /* Keep the top bit clear so the shift below stays in range. */
+        DWORD ahead = (This->ahead < (0x7fffffffu>>CURSOR_AHEAD_SHIFT)) ? This->ahead :
+                      (0x7fffffffu>>CURSOR_AHEAD_SHIFT);
+        flags |= (LONGLONG)ahead << CURSOR_AHEAD_SHIFT;
+    }
+    /* The interlocked exchange is a full barrier, so the data written before
+     * it is visible to anyone who sees the new position.
+     */
+    InterlockedExchange64(&This->cursors, (flags << 32) | This->pos);
+}
+
+/* Returns the device's capture latency in frames, or 0 if it can't be
+ * measured. Must be called with the parent's crst held.
+ */
+static LONG DSCBuffer_getlatency(DSCBuffer *This)
+{
+    ALCint64SOFT latency = 0;
 
-        alcGetIntegerv(This->device, ALC_CAPTURE_SAMPLES, 1, &avail);
-        if(avail == 0 || !This->playing) continue;
+    if(!This->has_clock)
+        return 0;
 
-        EnterCriticalSection(crst);
-        if(!This->playing)
-        {
-            LeaveCriticalSection(crst);
-            continue;
-        }
-    more_samples:
+    alcGetInteger64vSOFT(This->device, ALC_DEVICE_LATENCY_SOFT, 1, &latency);
+    if(alcGetError(This->device) != ALC_NO_ERROR || latency <= 0)
+        return 0;
+    return (LONG)(latency * This->format.Format.nSamplesPerSec / 1000000000);
+}
+
+/* Reads what the device has captured into the buffer and triggers the
+ * notifications passed. Returns FALSE once the buffer is no longer capturing.
+ * Must be called with the parent's crst held.
+ */
+static BOOL DSCBuffer_service(DSCBuffer *This)
+{
+    ALCint avail = 0;
+    DWORD lastpos;
+
+    if(!This->playing)
+        return FALSE;
+
+    alcGetIntegerv(This->device, ALC_CAPTURE_SAMPLES, 1, &avail);
+    while(avail > 0)
+    {
         avail *= This->format.Format.nBlockAlign;
         if((DWORD)avail > This->buf_size - This->pos)
             avail = This->buf_size - This->pos;
 
-        alcCaptureSamples(This->device, This->buf+This->pos,
-                          avail/This->format.Format.nBlockAlign);
-        trigger_notifies(This, This->pos, This->pos + avail);
+        if(!This->convert)
+            alcCaptureSamples(This->device, This->buf+This->pos,
+                              avail/This->format.Format.nBlockAlign);
+        else
+            DSCBuffer_captureconv(This, This->buf+This->pos,
+                                  avail/This->format.Format.nBlockAlign);
+        lastpos = This->pos;
         This->pos += avail;
-
         if(This->pos == This->buf_size)
-        {
             This->pos = 0;
+        /* The backlog was just read, what's arrived since is measured below. */
+        This->ahead = This->latency;
+        if(This->pos != 0 || This->looping)
+            DSCBuffer_publish(This);
+        /* Publish before notifying, so an app woken by the notification sees
+         * the new position.
+         */
+        trigger_notifies(This, lastpos, lastpos + avail);
+
+        avail = 0;
+        if(This->pos == 0)
+        {
             if(!This->looping)
             {
                 DWORD i;
+
+                This->playing = 0;
+                alcCaptureStop(This->device);
+                DSCBuffer_publish(This);
+
                 for(i = 0;i < This->nnotify;++i)
                 {
                     if(This->notify[i].dwOffset == DSCBPN_OFFSET_STOP)
                         SetEvent(This->notify[i].hEventNotify);
                 }
+                return FALSE;
+            }
+            alcGetIntegerv(This->device, ALC_CAPTURE_SAMPLES, 1, &avail);
+        }
+    }
 
-                This->playing = 0;
-                alcCaptureStop(This->device);
+    /* Measure how far the device is past the read position for
+     * GetCurrentPosition, here rather than on the app's thread.
+     */
+    alcGetIntegerv(This->device, ALC_CAPTURE_SAMPLES, 1, &avail);
+    This->latency = DSCBuffer_getlatency(This);
+    This->ahead = ((avail > 0) ? (DWORD)avail : 0) + This->latency;
+    DSCBuffer_publish(This);
+
+    return TRUE;
+}
+
+/* Returns how many milliseconds of capture remain until the next point that
+ * needs servicing on time, a notification offset or the end of a non-looping
+ * buffer. Must be called with the parent's crst held.
+ */
+static DWORD DSCBuffer_nextdue(const DSCBuffer *This)
+{
+    DWORD dist = This->looping ? This->buf_size : This->buf_size - This->pos;
+    DWORD i;
+
+    for(i = 0;i < This->nnotify;++i)
+    {
+        DWORD ofs = This->notify[i].dwOffset;
+        if(ofs == DSCBPN_OFFSET_STOP)
+            continue;
+        /* A notification is passed once data past its offset is read. */
+        ofs = (ofs - This->pos + This->buf_size) % This->buf_size;
+        ofs += This->format.Format.nBlockAlign;
+        if(ofs < dist) dist = ofs;
+    }
+    return (DWORD)((DWORD64)dist * 1000 / This->format.Format.nAvgBytesPerSec);
+}
+
+
+/* Process-wide capture scheduler. A single thread driven by one timer
+ * services every capturing buffer, instead of a thread and timer each. Buffers
+ * are added by Start and dropped once they stop capturing, and the timer is
+ * parked while the list is empty. The lock order is the scheduler lock, then
+ * a device's crst.
+ */
+#define CAPTURE_PERIOD (1000 / FAKE_REFRESH_COUNT * 2 / 3)
+/* Most periods a read may be put off for in chunked mode. The device's
+ * capture ring is sized to hold twice that.
+ */
+#define CAPTURE_MAX_CHUNK 4
+
+static struct {
+    /* Guards the buffer list and the timer. */
+    SRWLOCK lock;
+    /* Serializes starting and stopping the thread. */
+    SRWLOCK life_lock;
+    LONG users;
+
+    DSCBuffer **bufs;
+    DWORD nbufs, sizebufs;
+
+    HANDLE thread_hdl;
+    HANDLE queue_timer;
+    HANDLE timer_evt;
+    volatile LONG quit_now;
+    DWORD period;
+
+    DWORD wakeups, parks, rearms;
+} CaptureSched = { SRWLOCK_INIT, SRWLOCK_INIT };
+
+static void CALLBACK CaptureSched_timer(void *arg, BOOLEAN unused)
+{
+    (void)unused;
+    SetEvent((HANDLE)arg);
+}
+
+/* Must be called with the scheduler lock held. */
+static void CaptureSched_settimer(DWORD period)
+{
+    if(!CaptureSched.queue_timer)
+    {
+        TRACE("Calling capture timer every %lu ms\n", period);
+        CaptureSched.rearms++;
+        if(!CreateTimerQueueTimer(&CaptureSched.queue_timer, NULL, CaptureSched_timer,
+                                  CaptureSched.timer_evt, period, period,
+                                  WT_EXECUTEINTIMERTHREAD))
+        {
+            ERR("Failed to create capture timer: %lu\n", GetLastError());
+            CaptureSched.queue_timer = NULL;
+        }
+    }
+    else if(period != CaptureSched.period)
+        ChangeTimerQueueTimer(NULL, CaptureSched.queue_timer, period, period);
+    CaptureSched.period = period;
+}
+
+/* Must be called with the scheduler lock held. */
+static void CaptureSched_park(void)
+{
+    if(!CaptureSched.queue_timer)
+        return;
+
+    /* Wait for a callback in flight, so it can't signal the event after it's
+     * closed. The callback takes no locks, so holding the scheduler lock here
+     * is fine.
+     */
+    DeleteTimerQueueTimer(NULL, CaptureSched.queue_timer, INVALID_HANDLE_VALUE);
+    CaptureSched.queue_timer = NULL;
+    CaptureSched.parks++;
+}
+
+static DWORD CALLBACK CaptureSched_thread(void *param)
+{
+    (void)param;
+
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+
+    TRACE("Capture scheduler loop start\n");
+    while(WaitForSingleObject(CaptureSched.timer_evt, INFINITE) == WAIT_OBJECT_0 &&
+          !CaptureSched.quit_now)
+    {
+        DWORD due = CAPTURE_PERIOD * CAPTURE_MAX_CHUNK;
+        DWORD i = 0;
+
+        CaptureSched.wakeups++;
+
+        AcquireSRWLockExclusive(&CaptureSched.lock);
+        while(i < CaptureSched.nbufs)
+        {
+            DSCBuffer *buf = CaptureSched.bufs[i];
+            BOOL capturing;
+
+            EnterCriticalSection(&buf->parent->crst);
+            capturing = DSCBuffer_service(buf);
+            if(capturing && CaptureChunks)
+            {
+                DWORD bufdue = DSCBuffer_nextdue(buf);
+                if(bufdue < due) due = bufdue;
             }
+            LeaveCriticalSection(&buf->parent->crst);
+
+            if(capturing)
+                ++i;
             else
             {
-                alcGetIntegerv(This->device, ALC_CAPTURE_SAMPLES, 1, &avail);
-                if(avail) goto more_samples;
+                buf->scheduled = FALSE;
+                CaptureSched.bufs[i] = CaptureSched.bufs[--CaptureSched.nbufs];
             }
         }
 
-        LeaveCriticalSection(crst);
+        if(CaptureSched.nbufs == 0)
+            CaptureSched_park();
+        else if(CaptureChunks)
+        {
+            /* Nothing needs servicing for a while, so read bigger chunks
+             * less often.
+             */
+            CaptureSched_settimer((due > CAPTURE_PERIOD) ? due : CAPTURE_PERIOD);
+        }
+        ReleaseSRWLockExclusive(&CaptureSched.lock);
     }
+    TRACE("Capture scheduler loop quit\n");
 
     return 0;
 }
 
+/* Adds a buffer to the scheduler's list, re-arming the timer if needed. Must
+ * not be called with the buffer's crst held.
+ */
+static void CaptureSched_add(DSCBuffer *buf)
+{
+    AcquireSRWLockExclusive(&CaptureSched.lock);
+    if(!buf->scheduled)
+    {
+        if(CaptureSched.nbufs == CaptureSched.sizebufs)
+        {
+            DWORD newsize = CaptureSched.sizebufs ? CaptureSched.sizebufs*2 : 4;
+            DSCBuffer **bufs;
 
-static void CALLBACK DSCBuffer_timer(void *arg, BOOLEAN unused)
+            if(CaptureSched.bufs)
+                bufs = HeapReAlloc(GetProcessHeap(), 0, CaptureSched.bufs,
+                                   newsize*sizeof(*bufs));
+            else
+                bufs = HeapAlloc(GetProcessHeap(), 0, newsize*sizeof(*bufs));
+            if(!bufs)
+            {
+                ERR("Out of memory scheduling capture buffer %p\n", buf);
+                ReleaseSRWLockExclusive(&CaptureSched.lock);
+                return;
+            }
+            CaptureSched.bufs = bufs;
+            CaptureSched.sizebufs = newsize;
+        }
+        CaptureSched.bufs[CaptureSched.nbufs++] = buf;
+        buf->scheduled = TRUE;
+    }
+    /* Go back to the normal period until the thread has seen the new
+     * buffer's notifications.
+     */
+    CaptureSched_settimer(CAPTURE_PERIOD);
+    ReleaseSRWLockExclusive(&CaptureSched.lock);
+}
+
+/* Drops a buffer from the scheduler's list. Once this returns, the scheduler
+ * thread is no longer touching it. With if_stopped, a buffer that's capturing
+ * again (Start was called after Stop left crst) stays in the list. Must not
+ * be called with the buffer's crst held.
+ */
+static void CaptureSched_remove(DSCBuffer *buf, BOOL if_stopped)
 {
-    (void)unused;
-    SetEvent((HANDLE)arg);
+    DWORD i;
+
+    AcquireSRWLockExclusive(&CaptureSched.lock);
+    if(if_stopped && buf->scheduled)
+    {
+        BOOL playing;
+        EnterCriticalSection(&buf->parent->crst);
+        playing = buf->playing;
+        LeaveCriticalSection(&buf->parent->crst);
+        if(playing)
+        {
+            ReleaseSRWLockExclusive(&CaptureSched.lock);
+            return;
+        }
+    }
+    for(i = 0;buf->scheduled && i < CaptureSched.nbufs;++i)
+    {
+        if(CaptureSched.bufs[i] == buf)
+        {
+            CaptureSched.bufs[i] = CaptureSched.bufs[--CaptureSched.nbufs];
+            buf->scheduled = FALSE;
+        }
+    }
+    if(CaptureSched.nbufs == 0)
+        CaptureSched_park();
+    ReleaseSRWLockExclusive(&CaptureSched.lock);
 }
 
-static void DSCBuffer_starttimer(DSCBuffer *This)
+/* Starts the scheduler thread for the first capture buffer. */
+static HRESULT CaptureSched_AddRef(void)
 {
-    ALint refresh = FAKE_REFRESH_COUNT;
-    DWORD triggertime;
+    HRESULT hr = S_OK;
 
-    if(This->queue_timer)
-        return;
+    AcquireSRWLockExclusive(&CaptureSched.life_lock);
+    if(CaptureSched.users++ == 0)
+    {
+        CaptureSched.quit_now = FALSE;
+        CaptureSched.timer_evt = CreateEventA(NULL, FALSE, FALSE, NULL);
+        if(CaptureSched.timer_evt)
+            CaptureSched.thread_hdl = CreateThread(NULL, 0, CaptureSched_thread, NULL, 0, NULL);
+        if(!CaptureSched.thread_hdl)
+        {
+            if(CaptureSched.timer_evt)
+                CloseHandle(CaptureSched.timer_evt);
+            CaptureSched.timer_evt = NULL;
+            CaptureSched.users--;
+            hr = E_FAIL;
+        }
+    }
+    ReleaseSRWLockExclusive(&CaptureSched.life_lock);
+
+    return hr;
+}
+
+/* Stops the scheduler thread with the last capture buffer. */
+static void CaptureSched_Release(void)
+{
+    AcquireSRWLockExclusive(&CaptureSched.life_lock);
+    if(--CaptureSched.users == 0)
+    {
+        AcquireSRWLockExclusive(&CaptureSched.lock);
+        if(CaptureSched.queue_timer)
+            DeleteTimerQueueTimer(NULL, CaptureSched.queue_timer, INVALID_HANDLE_VALUE);
+        CaptureSched.queue_timer = NULL;
+        ReleaseSRWLockExclusive(&CaptureSched.lock);
 
-    triggertime = 1000 / refresh * 2 / 3;
-    TRACE("Calling timer every %lu ms for %i refreshes per second\n", triggertime, refresh);
+        InterlockedExchange(&CaptureSched.quit_now, TRUE);
+        SetEvent(CaptureSched.timer_evt);
 
-    CreateTimerQueueTimer(&This->queue_timer, NULL, DSCBuffer_timer, This->timer_evt,
-                          triggertime, triggertime, WT_EXECUTEINTIMERTHREAD);
+        if(WaitForSingleObject(CaptureSched.thread_hdl, 1000) != WAIT_OBJECT_0)
+            ERR("Thread wait timed out\n");
+        CloseHandle(CaptureSched.thread_hdl);
+        CaptureSched.thread_hdl = NULL;
+
+        CloseHandle(CaptureSched.timer_evt);
+        CaptureSched.timer_evt = NULL;
+
+        TRACE("Capture timer wakeups: %lu, parked: %lu, re-armed: %lu\n",
+              CaptureSched.wakeups, CaptureSched.parks, CaptureSched.rearms);
+
+        HeapFree(GetProcessHeap(), 0, CaptureSched.bufs);
+        CaptureSched.bufs = NULL;
+        CaptureSched.nbufs = CaptureSched.sizebufs = 0;
+    }
+    ReleaseSRWLockExclusive(&CaptureSched.life_lock);
 }
 
 static HRESULT DSCBuffer_Create(DSCBuffer **buf, DSCImpl *parent)
@@ -212,48 +564,19 @@ static HRESULT DSCBuffer_Create(DSCBuffer **buf, DSCImpl *parent)
 
     This->parent = parent;
 
-    This->quit_now = FALSE;
-    This->timer_evt = CreateEventA(NULL, FALSE, FALSE, NULL);
-    if(!This->timer_evt) goto fail;
-
-    This->queue_timer = NULL;
-
-    This->thread_hdl = CreateThread(NULL, 0, DSCBuffer_thread, This, 0, &This->thread_id);
-    if(!This->thread_hdl) goto fail;
+    if(FAILED(CaptureSched_AddRef()))
+    {
+        HeapFree(GetProcessHeap(), 0, This);
+        return E_FAIL;
+    }
 
     *buf = This;
     return S_OK;
-
-fail:
-    if(This->timer_evt)
-        CloseHandle(This->timer_evt);
-    This->timer_evt = NULL;
-
-    HeapFree(GetProcessHeap(), 0, This);
-    return E_FAIL;
 }
 
 static void DSCBuffer_Destroy(DSCBuffer *This)
 {
-    if(This->queue_timer)
-        DeleteTimerQueueTimer(NULL, This->queue_timer, INVALID_HANDLE_VALUE);
-    This->queue_timer = NULL;
-
-    if(This->thread_hdl)
-    {
-        InterlockedExchange(&This->quit_now, TRUE);
-        SetEvent(This->timer_evt);
-
-        if(WaitForSingleObject(This->thread_hdl, 1000) != WAIT_OBJECT_0)
-            ERR("Thread wait timed out\n");
-
-        CloseHandle(This->thread_hdl);
-        This->thread_hdl = NULL;
-    }
-
-    if(This->timer_evt)
-        CloseHandle(This->timer_evt);
-    This->timer_evt = NULL;
+    CaptureSched_remove(This, FALSE);
 
     if(This->device)
     {
@@ -264,8 +587,11 @@ static void DSCBuffer_Destroy(DSCBuffer *This)
     This->parent->buf = NULL;
 
     HeapFree(GetProcessHeap(), 0, This->notify);
+    HeapFree(GetProcessHeap(), 0, This->conv_buf);
     HeapFree(GetProcessHeap(), 0, This->buf);
     HeapFree(GetProcessHeap(), 0, This);
+
+    CaptureSched_Release();
 }
 
 static inline DSCBuffer *impl_from_IDirectSoundCaptureBuffer8(IDirectSoundCaptureBuffer8 *iface)
@@ -342,26 +668,37 @@ static HRESULT WINAPI DSCBuffer_GetCaps(IDirectSoundCaptureBuffer8 *iface, DSCBC
 static HRESULT WINAPI DSCBuffer_GetCurrentPosition(IDirectSoundCaptureBuffer8 *iface, DWORD *cappos, DWORD *readpos)
 {
     DSCBuffer *This = impl_from_IDirectSoundCaptureBuffer8(iface);
-    DWORD pos1, pos2;
+    LONGLONG cursors;
+    DWORD pos, flags;
 
-    EnterCriticalSection(&This->parent->crst);
-    pos1 = This->pos;
-    if(This->playing)
+    /* An interlocked no-op is an atomic 64-bit read on 32-bit targets too. */
+    cursors = InterlockedCompareExchange64(&This->cursors, 0, 0);
+    pos = (DWORD)cursors;
+    flags = (DWORD)(cursors >> 32);
+
+    if(readpos) *readpos = pos;
+    if(cappos)
     {
-        pos2 = This->format.Format.nSamplesPerSec / 100;
-        pos2 *= This->format.Format.nBlockAlign;
-        pos2 += pos1;
-        if (!This->looping && pos2 >= This->buf_size)
-            pos2 = 0;
-        else
-            pos2 %= This->buf_size;
+        if((flags&CURSOR_PLAYING))
+        {
+            /* Everything before the read position is in the buffer. The
+             * device is capturing past that by what the capture thread last
+             * measured it to hold, plus its latency.
+             */
+            DWORD64 cap = pos + (DWORD64)(flags >> CURSOR_AHEAD_SHIFT) *
+                                This->format.Format.nBlockAlign;
+            /* A non-looping buffer stops at the end, wrapping the read
+             * position to 0, so hold the capture position at the last frame
+             * until then.
+             */
+            if(!(flags&CURSOR_LOOPING))
+                pos = (cap < This->buf_size) ? (DWORD)cap :
+                      This->buf_size - This->format.Format.nBlockAlign;
+            else
+                pos = (DWORD)(cap % This->buf_size);
+        }
+        *cappos = pos;
     }
-    else
-        pos2 = pos1;
-    LeaveCriticalSection(&This->parent->crst);
-
-    if(cappos) *cappos = pos1;
-    if(readpos) *readpos = pos2;
 
     return S_OK;
 }
@@ -415,9 +752,59 @@ static HRESULT WINAPI DSCBuffer_GetStatus(IDirectSoundCaptureBuffer8 *iface, DWO
     return S_OK;
 }
 
+enum CaptureSampleType {
+    CaptureInt,
+    CaptureFloat
+};
+
+/* Channel layouts that can be captured, with the OpenAL formats for them. */
+static const struct CaptureLayout {
+    DWORD mask;
+    WORD channels;
+    ALenum fmt8, fmt16, fmt32f;
+} capture_layouts[] = {
+    { SPEAKER_FRONT_CENTER, 1,
+      AL_FORMAT_MONO8, AL_FORMAT_MONO16, AL_FORMAT_MONO_FLOAT32 },
+    { SPEAKER_FRONT_LEFT|SPEAKER_FRONT_RIGHT, 2,
+      AL_FORMAT_STEREO8, AL_FORMAT_STEREO16, AL_FORMAT_STEREO_FLOAT32 },
+    { SPEAKER_BACK_LEFT|SPEAKER_BACK_RIGHT, 2,
+      AL_FORMAT_REAR8, AL_FORMAT_REAR16, AL_FORMAT_REAR32 },
+    { SPEAKER_FRONT_LEFT|SPEAKER_FRONT_RIGHT|SPEAKER_BACK_LEFT|SPEAKER_BACK_RIGHT, 4,
+      AL_FORMAT_QUAD8, AL_FORMAT_QUAD16, AL_FORMAT_QUAD32 },
+    { SPEAKER_FRONT_LEFT|SPEAKER_FRONT_RIGHT|SPEAKER_FRONT_CENTER|SPEAKER_LOW_FREQUENCY|
+      SPEAKER_BACK_LEFT|SPEAKER_BACK_RIGHT, 6,
+      AL_FORMAT_51CHN8, AL_FORMAT_51CHN16, AL_FORMAT_51CHN32 },
+    { SPEAKER_FRONT_LEFT|SPEAKER_FRONT_RIGHT|SPEAKER_FRONT_CENTER|SPEAKER_LOW_FREQUENCY|
+      SPEAKER_BACK_CENTER|SPEAKER_SIDE_LEFT|SPEAKER_SIDE_RIGHT, 7,
+      AL_FORMAT_61CHN8, AL_FORMAT_61CHN16, AL_FORMAT_61CHN32 },
+    { SPEAKER_FRONT_LEFT|SPEAKER_FRONT_RIGHT|SPEAKER_FRONT_CENTER|SPEAKER_LOW_FREQUENCY|
+      SPEAKER_BACK_LEFT|SPEAKER_BACK_RIGHT|SPEAKER_SIDE_LEFT|SPEAKER_SIDE_RIGHT, 8,
+      AL_FORMAT_71CHN8, AL_FORMAT_71CHN16, AL_FORMAT_71CHN32 },
+};
+
+/* Finds the layout for a channel mask, or for the channel count alone when
+ * the mask is 0.
+ */
+static const struct CaptureLayout *get_capture_layout(DWORD mask, WORD channels)
+{
+    size_t i;
+    for(i = 0;i < sizeof(capture_layouts)/sizeof(capture_layouts[0]);++i)
+    {
+        if(capture_layouts[i].channels != channels)
+            continue;
+        if(!mask || capture_layouts[i].mask == mask)
+            return &capture_layouts[i];
+    }
+    return NULL;
+}
+
 static HRESULT WINAPI DSCBuffer_Initialize(IDirectSoundCaptureBuffer8 *iface, IDirectSoundCapture *parent, const DSCBUFFERDESC *desc)
 {
     DSCBuffer *This = impl_from_IDirectSoundCaptureBuffer8(iface);
+    void (*convert)(void*, const void*, DWORD) = NULL;
+    void (*fallback_convert)(void*, const void*, DWORD) = NULL;
+    const struct CaptureLayout *layout;
+    enum CaptureSampleType type;
     WAVEFORMATEX *format;
     ALenum buf_format = -1;
 
@@ -430,7 +817,7 @@ static HRESULT WINAPI DSCBuffer_Initialize(IDirectSoundCaptureBuffer8 *iface, ID
         return DSERR_INVALIDPARAM;
 
     format = desc->lpwfxFormat;
-    if(format->nChannels <= 0 || format->nChannels > 2)
+    if(format->nChannels <= 0 || format->nChannels > 8)
     {
         WARN("Invalid Channels %d\n", format->nChannels);
         return DSERR_INVALIDPARAM;
@@ -460,35 +847,12 @@ static HRESULT WINAPI DSCBuffer_Initialize(IDirectSoundCaptureBuffer8 *iface, ID
         return DSERR_INVALIDPARAM;
     }
 
-    if(format->wFormatTag == WAVE_FORMAT_PCM)
+    if(format->wFormatTag == WAVE_FORMAT_PCM || format->wFormatTag == WAVE_FORMAT_IEEE_FLOAT)
     {
-        if(format->nChannels == 1)
-        {
-            switch(format->wBitsPerSample)
-            {
-                case 8: buf_format = AL_FORMAT_MONO8; break;
-                case 16: buf_format = AL_FORMAT_MONO16; break;
-                default:
-                    WARN("Unsupported bpp %u\n", format->wBitsPerSample);
-                    return DSERR_BADFORMAT;
-            }
-        }
-        else if(format->nChannels == 2)
-        {
-            switch(format->wBitsPerSample)
-            {
-                case 8: buf_format = AL_FORMAT_STEREO8; break;
-                case 16: buf_format = AL_FORMAT_STEREO16; break;
-                default:
-                    WARN("Unsupported bpp %u\n", format->wBitsPerSample);
-                    return DSERR_BADFORMAT;
-            }
-        }
-        else
-            WARN("Unsupported channels: %d\n", format->nChannels);
-
         This->format.Format = *format;
         This->format.Format.cbSize = 0;
+        layout = get_capture_layout(0, format->nChannels);
+        type = (format->wFormatTag == WAVE_FORMAT_IEEE_FLOAT) ? CaptureFloat : CaptureInt;
     }
     else if(format->wFormatTag == WAVE_FORMAT_EXTENSIBLE)
     {
@@ -501,48 +865,53 @@ static HRESULT WINAPI DSCBuffer_Initialize(IDirectSoundCaptureBuffer8 *iface, ID
             return DSERR_CONTROLUNAVAIL;
 
         wfe = CONTAINING_RECORD(format, WAVEFORMATEXTENSIBLE, Format);
-        if(!IsEqualGUID(&wfe->SubFormat, &KSDATAFORMAT_SUBTYPE_PCM))
+        if(IsEqualGUID(&wfe->SubFormat, &KSDATAFORMAT_SUBTYPE_PCM))
+            type = CaptureInt;
+        else if(IsEqualGUID(&wfe->SubFormat, &KSDATAFORMAT_SUBTYPE_IEEE_FLOAT))
+            type = CaptureFloat;
+        else
             return DSERR_BADFORMAT;
         if(wfe->Samples.wValidBitsPerSample &&
            wfe->Samples.wValidBitsPerSample != wfe->Format.wBitsPerSample)
             return DSERR_BADFORMAT;
 
-        if(wfe->Format.nChannels == 1 && wfe->dwChannelMask == SPEAKER_FRONT_CENTER)
-        {
-            switch(wfe->Format.wBitsPerSample)
-            {
-                case 8: buf_format = AL_FORMAT_MONO8; break;
-                case 16: buf_format = AL_FORMAT_MONO16; break;
-                default:
-                    WARN("Unsupported bpp %u\n", wfe->Format.wBitsPerSample);
-                    return DSERR_BADFORMAT;
-            }
-        }
-        else if(wfe->Format.nChannels == 2 && wfe->dwChannelMask == (SPEAKER_FRONT_LEFT|SPEAKER_FRONT_RIGHT))
-        {
-            switch(wfe->Format.wBitsPerSample)
-            {
-                case 8: buf_format = AL_FORMAT_STEREO8; break;
-                case 16: buf_format = AL_FORMAT_STEREO16; break;
-                default:
-                    WARN("Unsupported bpp %u\n", wfe->Format.wBitsPerSample);
-                    return DSERR_BADFORMAT;
-            }
-        }
-        else
-            WARN("Unsupported channels: %d -- 0x%08lu\n", wfe->Format.nChannels, wfe->dwChannelMask);
-
         This->format = *wfe;
         This->format.Format.cbSize = sizeof(This->format) - sizeof(This->format.Format);
         This->format.Samples.wValidBitsPerSample = This->format.Format.wBitsPerSample;
+        layout = get_capture_layout(wfe->dwChannelMask, wfe->Format.nChannels);
     }
     else
+    {
         WARN("Unhandled formattag %x\n", format->wFormatTag);
+        return DSERR_BADFORMAT;
+    }
 
-    if(buf_format <= 0)
+    if(!layout)
     {
-        WARN("Could not get OpenAL format\n");
-        return DSERR_INVALIDPARAM;
+        WARN("Unsupported channels: %d -- 0x%08lx\n", This->format.Format.nChannels,
+             This->format.dwChannelMask);
+        return DSERR_BADFORMAT;
+    }
+
+    /* Pick the device format matching the app's, and a 16-bit fallback with a
+     * converter if the device may not capture that directly.
+     */
+    switch(This->format.Format.wBitsPerSample | (type<<8))
+    {
+        case 8 | (CaptureInt<<8): buf_format = layout->fmt8; break;
+        case 16 | (CaptureInt<<8): buf_format = layout->fmt16; break;
+        case 32 | (CaptureInt<<8):
+            buf_format = layout->fmt32f;
+            convert = convert_f32_s32;
+            fallback_convert = convert_s16_s32;
+            break;
+        case 32 | (CaptureFloat<<8):
+            buf_format = layout->fmt32f;
+            fallback_convert = convert_s16_f32;
+            break;
+        default:
+            WARN("Unsupported bpp %u\n", This->format.Format.wBitsPerSample);
+            return DSERR_BADFORMAT;
     }
 
     if(desc->dwBufferBytes < This->format.Format.nBlockAlign ||
@@ -564,14 +933,43 @@ static HRESULT WINAPI DSCBuffer_Initialize(IDirectSoundCaptureBuffer8 *iface, ID
 
     This->device = alcCaptureOpenDevice(This->parent->device_name,
         This->format.Format.nSamplesPerSec, buf_format,
-        This->format.Format.nSamplesPerSec / FAKE_REFRESH_COUNT * 2
+        This->format.Format.nSamplesPerSec / FAKE_REFRESH_COUNT * 2 * CAPTURE_MAX_CHUNK
     );
+    if(!This->device && fallback_convert)
+    {
+        TRACE("Couldn't open device with 0x%x, trying 16-bit with conversion\n", buf_format);
+        buf_format = layout->fmt16;
+        convert = fallback_convert;
+        This->device = alcCaptureOpenDevice(This->parent->device_name,
+            This->format.Format.nSamplesPerSec, buf_format,
+            This->format.Format.nSamplesPerSec / FAKE_REFRESH_COUNT * 2 * CAPTURE_MAX_CHUNK
+        );
+    }
     if(!This->device)
     {
         ERR("Couldn't open device %s 0x%x@%lu, reason: %04x\n", This->parent->device_name,
             buf_format, This->format.Format.nSamplesPerSec, alcGetError(NULL));
         return DSERR_INVALIDPARAM;
     }
+    This->has_clock = palcGetInteger64vSOFT &&
+                      alcIsExtensionPresent(This->device, "ALC_SOFT_device_clock");
+
+    if(convert)
+    {
+        DWORD samplesize = (buf_format == layout->fmt16) ? 2 : 4;
+
+        This->conv_frames = 1024;
+        This->conv_buf = HeapAlloc(GetProcessHeap(), 0,
+            This->conv_frames * This->format.Format.nChannels * samplesize);
+        if(!This->conv_buf)
+        {
+            WARN("Out of memory\n");
+            alcCaptureCloseDevice(This->device);
+            This->device = NULL;
+            return DSERR_OUTOFMEMORY;
+        }
+        This->convert = convert;
+    }
 
     return S_OK;
 }
@@ -644,12 +1042,16 @@ static HRESULT WINAPI DSCBuffer_Start(IDirectSoundCaptureBuffer8 *iface, DWORD f
     EnterCriticalSection(&This->parent->crst);
     if(!This->playing)
     {
-        DSCBuffer_starttimer(This);
         This->playing = 1;
         alcCaptureStart(This->device);
+        This->latency = DSCBuffer_getlatency(This);
+        This->ahead = This->latency;
     }
     This->looping |= !!(flags & DSCBSTART_LOOPING);
+    DSCBuffer_publish(This);
     LeaveCriticalSection(&This->parent->crst);
+
+    CaptureSched_add(This);
     return S_OK;
 }
 
@@ -671,8 +1073,11 @@ static HRESULT WINAPI DSCBuffer_Stop(IDirectSoundCaptureBuffer8 *iface)
 
         This->playing = This->looping = 0;
         alcCaptureStop(This->device);
+        DSCBuffer_publish(This);
     }
     LeaveCriticalSection(&This->parent->crst);
+
+    CaptureSched_remove(This, TRUE);
     return S_OK;
 }
 
@@ -892,10 +1297,16 @@ HRESULT DSOUND_CaptureCreate8(REFIID riid, void **cap)
 
 static void DSCImpl_Destroy(DSCImpl *This)
 {
+    DSCBuffer *buf;
+
+    /* Destroying the buffer takes the scheduler lock, which comes before
+     * crst, so it can't be done with crst held.
+     */
     EnterCriticalSection(&This->crst);
-    if (This->buf)
-        DSCBuffer_Destroy(This->buf);
+    buf = This->buf;
     LeaveCriticalSection(&This->crst);
+    if(buf)
+        DSCBuffer_Destroy(buf);
 
     HeapFree(GetProcessHeap(), 0, This->device_name);
 
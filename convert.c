@@ -0,0 +1,101 @@
+/* Sample format converters
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "platform.h"
+#include "convert.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HAVE_SSE2 1
+#endif
+
+
+/* Sample converters, from the format the device captured in to the app's.
+ * The SSE2 paths handle whole vectors and leave the remainder to the scalar
+ * loop.
+ */
+void convert_s16_f32(void *dst, const void *src, DWORD count)
+{
+    const short *in = src;
+    float *out = dst;
+    DWORD i = 0;
+#ifdef HAVE_SSE2
+    const __m128 scale = _mm_set1_ps(1.0f/32768.0f);
+    for(;i+8 <= count;i += 8)
+    {
+        __m128i s = _mm_loadu_si128((const __m128i*)(in+i));
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+        _mm_storeu_ps(out+i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(out+i+4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+#endif
+    for(;i < count;++i)
+        out[i] = in[i] * (1.0f/32768.0f);
+}
+
+void convert_s16_s32(void *dst, const void *src, DWORD count)
+{
+    const short *in = src;
+    int *out = dst;
+    DWORD i = 0;
+#ifdef HAVE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for(;i+8 <= count;i += 8)
+    {
+        /* Interleaving zeros below each sample shifts it up by 16 bits. */
+        __m128i s = _mm_loadu_si128((const __m128i*)(in+i));
+        _mm_storeu_si128((__m128i*)(out+i), _mm_unpacklo_epi16(zero, s));
+        _mm_storeu_si128((__m128i*)(out+i+4), _mm_unpackhi_epi16(zero, s));
+    }
+#endif
+    for(;i < count;++i)
+        out[i] = (int)in[i] * 65536;
+}
+
+void convert_f32_s32(void *dst, const void *src, DWORD count)
+{
+    /* 2^31 doesn't fit, so clamp to the largest float below it. Both paths
+     * truncate toward zero and clamp NaN to the maximum, so a sample converts
+     * the same wherever it lands in the buffer.
+     */
+    static const float maxval = 2147483520.0f;
+    const float *in = src;
+    int *out = dst;
+    DWORD i = 0;
+#ifdef HAVE_SSE2
+    const __m128 scale = _mm_set1_ps(2147483648.0f);
+    const __m128 vmax = _mm_set1_ps(maxval);
+    const __m128 vmin = _mm_set1_ps(-2147483648.0f);
+    for(;i+4 <= count;i += 4)
+    {
+        __m128 f = _mm_mul_ps(_mm_loadu_ps(in+i), scale);
+        f = _mm_max_ps(_mm_min_ps(f, vmax), vmin);
+        _mm_storeu_si128((__m128i*)(out+i), _mm_cvttps_epi32(f));
+    }
+#endif
+    for(;i < count;++i)
+    {
+        float f = in[i] * 2147483648.0f;
+        /* Written to match _mm_min_ps/_mm_max_ps, which pick the second
+         * operand when either is NaN.
+         */
+        f = (f < maxval) ? f : maxval;
+        f = (f > -2147483648.0f) ? f : -2147483648.0f;
+        out[i] = (int)f;
+    }
+}
@@ -0,0 +1,30 @@
+/* Sample format converters
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef DSOAL_CONVERT_H
+#define DSOAL_CONVERT_H
+
+/* Each converter takes count samples (not frames) from src and writes them to
+ * dst. Buffers needn't be aligned.
+ */
+typedef void (*SampleConverter)(void *dst, const void *src, DWORD count);
+
+void convert_s16_f32(void *dst, const void *src, DWORD count);
+void convert_s16_s32(void *dst, const void *src, DWORD count);
+void convert_f32_s32(void *dst, const void *src, DWORD count);
+
+#endif /* DSOAL_CONVERT_H */
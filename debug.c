@@ -10,17 +10,20 @@
 #include "dsound.h"
 
 /* allocate some tmp string space */
-/* FIXME: this is not 100% thread-safe */
+/* The buffers are fixed, so a string stays valid until 64 more have been
+ * made, even when another thread is making them. The largest request is from
+ * wine_dbgstr_wn, 12 + 300 bytes.
+ */
+#define TEMP_BUFFER_SIZE 320
 static char *get_temp_buffer( size_t size )
 {
-    static char *list[32];
+    static char list[64][TEMP_BUFFER_SIZE];
     static LONG pos;
-    char *ret;
     int idx;
 
-    idx = InterlockedExchangeAdd( &pos, 1 ) % (sizeof(list)/sizeof(list[0]));
-    if ((ret = realloc( list[idx], size ))) list[idx] = ret;
-    return ret;
+    (void)size;
+    idx = (ULONG)InterlockedExchangeAdd( &pos, 1 ) % (sizeof(list)/sizeof(list[0]));
+    return list[idx];
 }
 
 
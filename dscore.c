@@ -0,0 +1,124 @@
+/* DSOAL platform-independent core
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include <string.h>
+
+#include "dscore.h"
+
+
+/* Positions a 2D buffer's source for a pan from DSBPAN_LEFT (-10000) to
+ * DSBPAN_RIGHT (10000), in OpenAL coordinates.
+ */
+void DSCore_PanPosition(LONG pan, float pos[3])
+{
+    pos[0] = (float)(pan+10000) / 20000.0f - 0.5f;
+    pos[1] = 0.0f;
+    /* NOTE: Strict movement along the X plane can cause the sound to jump
+     * between left and right sharply. Using a curved path helps smooth it
+     * out.
+     */
+    pos[2] = -sqrtf(1.0f - pos[0]*pos[0]);
+}
+
+/* Gets the next streaming segment of segsize bytes from a buffer of size
+ * bytes, starting at *ofs, and moves *ofs past it. The segment is returned in
+ * place when it doesn't reach the end of the buffer. Otherwise it's assembled
+ * in scratch, wrapping around to the start for looping buffers or padded with
+ * silence for others. Returns NULL when a non-looping buffer has no data left.
+ */
+const BYTE *DSCore_StreamSegment(const BYTE *data, DWORD size, DWORD *ofs, DWORD segsize,
+    BOOL looping, BYTE silence, BYTE *scratch)
+{
+    DWORD pos = *ofs;
+    DWORD rem = size - pos;
+
+    if(segsize < rem)
+    {
+        *ofs = pos + segsize;
+        return data + pos;
+    }
+
+    if(rem > 2048) rem = 2048;
+    if(looping)
+    {
+        memcpy(scratch, data + pos, rem);
+        while(rem < segsize)
+        {
+            DWORD todo = segsize - rem;
+            if(todo > size)
+                todo = size;
+            memcpy(scratch + rem, data, todo);
+            rem += todo;
+        }
+        *ofs = (pos+segsize) % size;
+        return scratch;
+    }
+
+    if(rem == 0)
+        return NULL;
+    memcpy(scratch, data + pos, rem);
+    memset(scratch+rem, silence, segsize - rem);
+    *ofs = size;
+    return scratch;
+}
+
+/* Returns the number of segments a stream should keep queued, given its
+ * current depth and whether it just underran. An underrun deepens the queue
+ * by one, up to QBUFFERS_MAX, to ride out the next late update. After
+ * QBUFFERS_STABLE_MS without one, the queue gives a segment back, down to
+ * QBUFFERS. *last_underrun holds the tick count the period is measured from,
+ * and is updated with now when either happens.
+ */
+LONG DSCore_StreamDepth(LONG depth, BOOL underran, DWORD now, DWORD *last_underrun)
+{
+    if(underran)
+    {
+        *last_underrun = now;
+        if(depth < QBUFFERS_MAX)
+            depth++;
+    }
+    else if(depth > QBUFFERS && now-*last_underrun >= QBUFFERS_STABLE_MS)
+    {
+        *last_underrun = now;
+        depth--;
+    }
+    return depth;
+}
+
+/* Gets a streaming buffer's play position from queue_ofs, how far its source
+ * is into the queue (or the end of the queue once it stopped), and queue_base,
+ * the buffer offset the queue starts at. A looping buffer wraps around. For a
+ * non-looping one, returns TRUE once it got to the end, with *pos at size.
+ */
+BOOL DSCore_StreamPosition(DWORD queue_ofs, DWORD queue_base, DWORD size, BOOL looping,
+    DWORD *pos)
+{
+    DWORD ofs = queue_ofs + queue_base;
+
+    if(ofs < size)
+    {
+        *pos = ofs;
+        return FALSE;
+    }
+    if(looping)
+    {
+        *pos = ofs % size;
+        return FALSE;
+    }
+    *pos = size;
+    return TRUE;
+}
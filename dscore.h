@@ -0,0 +1,86 @@
+/* DSOAL platform-independent core
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef DSOAL_DSCORE_H
+#define DSOAL_DSCORE_H
+
+#include <math.h>
+
+#include "platform.h"
+
+/* The mixer's per-buffer work that doesn't touch COM, Win32 or OpenAL: the
+ * stream feeder's segment assembly and queue depth adjustment, streaming play
+ * positions, notification position checks, and the conversion of DirectSound
+ * parameters to OpenAL ones. The DLL makes the OpenAL queries and calls and
+ * signals the events around these. It's built into the DLL, and natively with
+ * DSOAL_NATIVE_CORE for profiling and testing.
+ */
+
+/* Amount of buffers that have to be queued when
+ * bufferdatastatic and buffersubdata are not available */
+#define QBUFFERS 4
+/* Most buffers a streaming source may queue after deepening its queue for
+ * underruns, and how long it must play without one to give a buffer back.
+ */
+#define QBUFFERS_MAX 8
+#define QBUFFERS_STABLE_MS 10000
+
+static inline LONG gain_to_mB(float gain)
+{
+    return (gain > 1e-5f) ? (LONG)(log10f(gain) * 2000.0f) : -10000l;
+}
+static inline float mB_to_gain(float millibels)
+{
+    return (millibels > -10000.0f) ? powf(10.0f, millibels/2000.0f) : 0.0f;
+}
+
+/* The OpenAL pitch for a buffer's frequency, where 0 means the format's. */
+static inline float DSCore_Pitch(DWORD frequency, DWORD format_rate)
+{
+    return frequency ? (float)frequency / (float)format_rate : 1.0f;
+}
+
+/* Whether a notification at offset ofs was reached moving from lastpos to
+ * curpos. curpos below lastpos means the position wrapped around.
+ */
+static inline BOOL DSCore_Reached(DWORD ofs, DWORD lastpos, DWORD curpos)
+{
+    if(curpos < lastpos)
+        return ofs < curpos || ofs >= lastpos;
+    return ofs >= lastpos && ofs < curpos;
+}
+
+/* Whether a streaming source that stopped by itself ran out of queued
+ * segments, rather than reaching the end of a non-looping buffer. Only a
+ * buffer that's still supposed to be playing can underrun.
+ */
+static inline BOOL DSCore_StreamUnderran(BOOL stopped, BOOL playing, BOOL looping,
+    DWORD data_offset, DWORD size)
+{
+    return stopped && playing && (looping || data_offset < size);
+}
+
+void DSCore_PanPosition(LONG pan, float pos[3]);
+
+LONG DSCore_StreamDepth(LONG depth, BOOL underran, DWORD now, DWORD *last_underrun);
+BOOL DSCore_StreamPosition(DWORD queue_ofs, DWORD queue_base, DWORD size, BOOL looping,
+    DWORD *pos);
+
+const BYTE *DSCore_StreamSegment(const BYTE *data, DWORD size, DWORD *ofs, DWORD segsize,
+    BOOL looping, BYTE silence, BYTE *scratch);
+
+#endif /* DSOAL_DSCORE_H */
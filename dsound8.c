@@ -36,35 +36,439 @@
 #endif
 
 
+/* Number of notification buffers checked per lock-held slice of a tick. */
+#define MIXER_NOTIFY_SLICE 64
+
+static LONGLONG DSShare_now(void)
+{
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return now.QuadPart;
+}
+
+
+/* Mixer thread profile. Histogram buckets are log2 microseconds (or calls, for
+ * the AL call counts), so bucket n holds values below 2^n. Only the mixer
+ * thread updates it, except for the time the timer last fired.
+ */
+#define MIXSTATS_BUCKETS 16
+
+typedef struct MixHist {
+    DWORD count;
+    DWORD max;
+    DWORD hist[MIXSTATS_BUCKETS];
+} MixHist;
+
+enum MixPhase {
+    MixPhaseLockWait,
+    MixPhaseRender,
+    MixPhaseStarts,
+    MixPhaseNotifies,
+    MixPhaseStreaming,
+    MixPhaseCount
+};
+
+typedef struct MixStats {
+    volatile LONGLONG signaled;
+    LONGLONG last_wake;
+    LONGLONG period;
+    DWORD last_alcalls;
+    HANDLE dump_event;
+    LONG dump_gen;
+
+    MixHist wake_latency;
+    MixHist period_jitter;
+    MixHist tick_time;
+    MixHist phases[MixPhaseCount];
+    MixHist tick_alcalls;
+} MixStats;
+
+/* The dump event is manual-reset and shared by all of the process's devices.
+ * The first mixer thread to see it signaled resets it and bumps this, and
+ * each device dumps its profile when it sees a new generation.
+ */
+static volatile LONG MixStatsDumpGen;
+
+static void MixHist_Add(MixHist *hist, DWORD val)
+{
+    DWORD bucket = 0;
+    while(bucket < MIXSTATS_BUCKETS-1 && (val>>bucket) != 0)
+        ++bucket;
+    hist->hist[bucket]++;
+    hist->count++;
+    if(val > hist->max)
+        hist->max = val;
+}
+
+static DWORD DSShare_us(const DeviceShare *share, LONGLONG ticks)
+{
+    ticks = ticks * 1000000 / share->tick_freq;
+    return (ticks < 0) ? 0 : (ticks > 0x7fffffff) ? 0x7fffffff : (DWORD)ticks;
+}
+
+/* Returns the start time for a profiled phase, or 0 when not profiling. */
+static inline LONGLONG DSShare_phasestart(const DeviceShare *share)
+{
+    return UNLIKELY(share->mix_stats != NULL) ? DSShare_now() : 0;
+}
+
+static inline void DSShare_phaseend(DeviceShare *share, enum MixPhase phase, LONGLONG start)
+{
+    if(UNLIKELY(start != 0))
+        MixHist_Add(&share->mix_stats->phases[phase], DSShare_us(share, DSShare_now() - start));
+}
+
+static void MixHist_Dump(const char *name, const MixHist *hist)
+{
+    int b;
+
+    fprintf(LogFile, "  %-24s count %8lu max %8lu:", name, hist->count, hist->max);
+    for(b = 0;b < MIXSTATS_BUCKETS;++b)
+        fprintf(LogFile, " %lu", hist->hist[b]);
+    fprintf(LogFile, "\n");
+}
+
+static void DSShare_dumpmixstats(const DeviceShare *share)
+{
+    static const char *const phase_names[MixPhaseCount] = {
+        "lock wait (us)", "loopback render (us)", "batched starts (us)",
+        "notifications (us)", "streaming (us)"
+    };
+    const MixStats *stats = share->mix_stats;
+    int i;
+
+    fprintf(LogFile, "Mixer profile for device %p (log2 buckets <1 <2 <4 ... >=16384):\n", share);
+    MixHist_Dump("wake latency (us)", &stats->wake_latency);
+    MixHist_Dump("period jitter (us)", &stats->period_jitter);
+    MixHist_Dump("tick time (us)", &stats->tick_time);
+    for(i = 0;i < MixPhaseCount;++i)
+        MixHist_Dump(phase_names[i], &stats->phases[i]);
+    MixHist_Dump("AL calls per tick", &stats->tick_alcalls);
+    fflush(LogFile);
+}
+
+/* Records how late the mixer thread woke after the timer fired, and how far
+ * the time since the last wakeup strayed from the timer period.
+ */
+static void DSShare_mixstatswake(DeviceShare *share, LONGLONG now)
+{
+    MixStats *stats = share->mix_stats;
+    LONGLONG signaled = InterlockedExchange64(&stats->signaled, 0);
+
+    if(signaled != 0)
+        MixHist_Add(&stats->wake_latency, DSShare_us(share, now - signaled));
+    if(stats->last_wake != 0 && stats->period != 0)
+    {
+        LONGLONG diff = now - stats->last_wake - stats->period;
+        MixHist_Add(&stats->period_jitter, DSShare_us(share, (diff < 0) ? -diff : diff));
+    }
+    stats->last_wake = now;
+}
+
+static void DSShare_mixstatstick(DeviceShare *share, LONGLONG tick_start, LONGLONG now)
+{
+    MixStats *stats = share->mix_stats;
+
+    MixHist_Add(&stats->tick_time, DSShare_us(share, now - tick_start));
+    MixHist_Add(&stats->tick_alcalls, share->mix_alcalls - stats->last_alcalls);
+    stats->last_alcalls = share->mix_alcalls;
+    if(stats->dump_event && WaitForSingleObject(stats->dump_event, 0) == WAIT_OBJECT_0)
+    {
+        ResetEvent(stats->dump_event);
+        InterlockedIncrement(&MixStatsDumpGen);
+    }
+    if(stats->dump_gen != MixStatsDumpGen)
+    {
+        stats->dump_gen = MixStatsDumpGen;
+        DSShare_dumpmixstats(share);
+    }
+}
+
+/* Runs one slice of the mixer tick, either a chunk of the current primary's
+ * notification list or one of its buffer groups for streaming. Must be
+ * called with crst held. Returns TRUE when the pass over all primaries is
+ * complete.
+ */
+static BOOL DSShare_mixslice(DeviceShare *share, BYTE *scratch_mem)
+{
+    if(share->tick_prim < share->nprimaries)
+    {
+        DSPrimary *prim = share->primaries[share->tick_prim];
+        BOOL done;
+
+        if(!share->tick_streaming)
+        {
+            /* Batched starts wait at most until the next update. */
+            LONGLONG start;
+            if(share->tick_pos == 0)
+            {
+                start = DSShare_phasestart(share);
+                DSPrimary_startpending(prim);
+                DSShare_phaseend(share, MixPhaseStarts, start);
+            }
+            start = DSShare_phasestart(share);
+            done = DSPrimary_triggernots(prim, &share->tick_pos, MIXER_NOTIFY_SLICE);
+            DSShare_phaseend(share, MixPhaseNotifies, start);
+            if(done && !HAS_EXTENSION(share, SOFTX_MAP_BUFFER))
+            {
+                share->tick_streaming = TRUE;
+                share->tick_pos = 0;
+                done = FALSE;
+            }
+        }
+        else
+        {
+            LONGLONG start = DSShare_phasestart(share);
+            done = DSPrimary_streamfeeder(prim, &share->tick_pos, scratch_mem);
+            DSShare_phaseend(share, MixPhaseStreaming, start);
+        }
+        if(!done)
+            return FALSE;
+
+        share->tick_streaming = FALSE;
+        share->tick_pos = 0;
+        if(++share->tick_prim < share->nprimaries)
+            return FALSE;
+    }
+
+    share->tick_prim = 0;
+    share->tick_streaming = FALSE;
+    share->tick_pos = 0;
+    return TRUE;
+}
+
+/* Returns TRUE when no primary has anything for the mixer to do. Must be
+ * called with crst held.
+ */
+static BOOL DSShare_isidle(const DeviceShare *share)
+{
+    ALsizei i;
+    for(i = 0;i < share->nprimaries;++i)
+    {
+        const DSPrimary *prim = share->primaries[i];
+        if(prim->nplaying > 0 || prim->nnotifies > 0 || prim->npending_starts > 0)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static void DSShare_stoptimer(DeviceShare *share)
+{
+    if(share->loopback_running)
+    {
+        share->loopback_running = FALSE;
+        share->timer_stats.parks++;
+    }
+    if(!share->queue_timer)
+        return;
+
+    /* Wait for a callback in flight, so none can touch the share after it's
+     * destroyed. The callback takes no locks, so this can't deadlock.
+     */
+    DeleteTimerQueueTimer(NULL, share->queue_timer, INVALID_HANDLE_VALUE);
+    share->queue_timer = NULL;
+    share->timer_stats.parks++;
+    TRACE("Parked mixer timer for shared device %p\n", share);
+}
+
+/* Loopback output is written as 16-bit stereo. */
+#define LOOPBACK_CHANNELS 2
+#define LOOPBACK_FREQ 44100
+
+static void write_le32(FILE *f, DWORD val)
+{
+    BYTE data[4] = { (BYTE)val, (BYTE)(val>>8), (BYTE)(val>>16), (BYTE)(val>>24) };
+    fwrite(data, 1, 4, f);
+}
+
+static void write_le16(FILE *f, WORD val)
+{
+    BYTE data[2] = { (BYTE)val, (BYTE)(val>>8) };
+    fwrite(data, 1, 2, f);
+}
+
+/* Writes the WAV header for the loopback output, with datasize bytes of
+ * samples following it.
+ */
+static void DSShare_writewavheader(DeviceShare *share, DWORD datasize)
+{
+    FILE *f = share->loopback_file;
+
+    fseek(f, 0, SEEK_SET);
+    fwrite("RIFF", 1, 4, f);
+    write_le32(f, 36 + datasize);
+    fwrite("WAVEfmt ", 1, 8, f);
+    write_le32(f, 16);
+    write_le16(f, WAVE_FORMAT_PCM);
+    write_le16(f, LOOPBACK_CHANNELS);
+    write_le32(f, share->loopback_freq);
+    write_le32(f, share->loopback_freq * LOOPBACK_CHANNELS * 2);
+    write_le16(f, LOOPBACK_CHANNELS * 2);
+    write_le16(f, 16);
+    fwrite("data", 1, 4, f);
+    write_le32(f, datasize);
+}
+
+/* Renders one update on a loopback device, advancing its clock. Must be
+ * called with crst held.
+ */
+static void DSShare_render(DeviceShare *share)
+{
+    alcRenderSamplesSOFT(share->device, share->loopback_buf, share->loopback_update);
+    share->loopback_frames += share->loopback_update;
+
+    if(share->loopback_file)
+    {
+        /* WAV data is little-endian, as are the targets this runs on. */
+        fwrite(share->loopback_buf, LOOPBACK_CHANNELS*sizeof(ALshort), share->loopback_update,
+               share->loopback_file);
+    }
+}
+
+/* Unthrottled loopback devices run the next tick immediately while there's
+ * anything to mix, otherwise the thread waits for the timer.
+ */
+static DWORD DSShare_waittime(const DeviceShare *share)
+{
+    if(share->loopback && LoopbackSpeed == 0 && share->loopback_running)
+        return 0;
+    return INFINITE;
+}
+
+/* Stores the voice census and this tick's timings in the live statistics
+ * block. Called by the mixer thread with the device lock held.
+ */
+static void DSShare_publishlive(DeviceShare *share, LONGLONG tick_time, LONGLONG tick_hold)
+{
+    DSoalLiveStats *live = share->live;
+    DWORD buffers = 0, playing = 0, hw = 0, sw = 0;
+    DWORD tick_us = DSShare_us(share, tick_time);
+    DWORD hold_us = DSShare_us(share, tick_hold);
+    ALsizei i;
+    DWORD g;
+
+    for(i = 0;i < share->nprimaries;++i)
+    {
+        DSPrimary *prim = share->primaries[i];
+        for(g = 0;g < prim->NumBufferGroups;++g)
+            buffers += POPCNT64(~prim->BufferGroups[g].FreeBuffers);
+        playing += prim->nplaying;
+        hw += prim->nhw_voices;
+        sw += prim->nsw_voices;
+    }
+
+    live->buffers = buffers;
+    live->playing = playing;
+    live->hw_voices = hw;
+    live->sw_voices = sw;
+    live->virtual_voices = buffers - hw - sw;
+    live->hw_sources_max = share->sources.maxhw_alloc;
+    live->hw_sources_free = share->sources.availhw_num;
+    live->sw_sources_max = share->sources.maxsw_alloc;
+    live->sw_sources_free = share->sources.availsw_num;
+
+    live->ticks = share->tick_stats.ticks;
+    live->slices = share->tick_stats.slices;
+    live->carried = share->tick_stats.carried;
+    live->timer_parks = share->timer_stats.parks;
+    live->timer_rearms = share->timer_stats.rearms;
+    live->last_tick_us = tick_us;
+    if(tick_us > live->max_tick_us)
+        live->max_tick_us = tick_us;
+    live->total_tick_us += tick_us;
+    if(hold_us > live->max_hold_us)
+        live->max_hold_us = hold_us;
+    live->total_hold_us += hold_us;
+
+    live->updates++;
+}
+
+
 static DWORD CALLBACK DSShare_thread(void *dwUser)
 {
     DeviceShare *share = (DeviceShare*)dwUser;
     BYTE *scratch_mem = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, 2048);
-    ALsizei i;
 
     SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+    if(share->mix_stats)
+        TlsSetValue(MixStatsTls, &share->mix_alcalls);
 
     TRACE("Shared device (%p) message loop start\n", share);
-    while(WaitForSingleObject(share->timer_evt, INFINITE) == WAIT_OBJECT_0 && !share->quit_now)
+    while(WaitForSingleObject(share->timer_evt, DSShare_waittime(share)) != WAIT_FAILED &&
+          !share->quit_now)
     {
-        EnterCriticalSection(&share->crst);
-        setALContext(share->ctx);
+        LONGLONG tick_start = DSShare_now();
+        LONGLONG tick_hold = 0, now;
+        BOOL done, last;
 
-        for(i = 0;i < share->nprimaries;++i)
-        {
-            DSPrimary_triggernots(share->primaries[i]);
-            if(!HAS_EXTENSION(share, SOFTX_MAP_BUFFER))
-                DSPrimary_streamfeeder(share->primaries[i], scratch_mem);
-        }
+        if(UNLIKELY(share->mix_stats != NULL))
+            DSShare_mixstatswake(share, tick_start);
+
+        /* Release the lock between slices so app threads don't wait on the
+         * whole pass. If the tick runs over budget, finish the rest of the
+         * pass next time.
+         */
+        do {
+            LONGLONG hold_start, start;
+
+            start = DSShare_phasestart(share);
+            DSShare_Lock(share);
+            hold_start = DSShare_now();
+            DSShare_phaseend(share, MixPhaseLockWait, start);
+            setALContext(share->ctx);
+
+            /* A loopback device renders at the start of each pass, so the
+             * pass sees the state of the update that was just mixed.
+             */
+            if(share->loopback && share->tick_prim == 0 && !share->tick_streaming &&
+               share->tick_pos == 0)
+            {
+                start = DSShare_phasestart(share);
+                DSShare_render(share);
+                DSShare_phaseend(share, MixPhaseRender, start);
+            }
+            done = DSShare_mixslice(share, scratch_mem);
+
+            popALContext();
+            now = DSShare_now();
 
-        popALContext();
-        LeaveCriticalSection(&share->crst);
+            tick_hold += now - hold_start;
+            if(now - hold_start > share->tick_stats.max_slice_hold)
+                share->tick_stats.max_slice_hold = now - hold_start;
+            share->tick_stats.slices++;
+            last = done || (!share->loopback && now - tick_start >= share->tick_budget);
+
+            /* Finish the tick in the last slice's lock hold, rather than
+             * locking again for it.
+             */
+            if(last)
+            {
+                if(!done)
+                    share->tick_stats.carried++;
+                else if(DSShare_isidle(share))
+                    DSShare_stoptimer(share);
+                share->tick_stats.ticks++;
+                share->tick_stats.total_hold += tick_hold;
+                if(tick_hold > share->tick_stats.max_tick_hold)
+                    share->tick_stats.max_tick_hold = tick_hold;
+                if(UNLIKELY(share->live != NULL))
+                    DSShare_publishlive(share, now - tick_start, tick_hold);
+            }
+            DSShare_Unlock(share);
+        } while(!last);
+
+        if(UNLIKELY(LockStatsEnabled))
+            LockStats_Record("DSShare_thread (tick)", tick_hold);
+        if(UNLIKELY(share->mix_stats != NULL))
+            DSShare_mixstatstick(share, tick_start, now);
     }
     TRACE("Shared device (%p) message loop quit\n", share);
 
     HeapFree(GetProcessHeap(), 0, scratch_mem);
     scratch_mem = NULL;
 
+    if(share->mix_stats)
+        TlsSetValue(MixStatsTls, NULL);
     if(local_contexts)
     {
         set_context(NULL);
@@ -76,22 +480,51 @@ static DWORD CALLBACK DSShare_thread(void *dwUser)
 
 static void CALLBACK DSShare_timer(void *arg, BOOLEAN unused)
 {
+    DeviceShare *share = arg;
     (void)unused;
-    SetEvent((HANDLE)arg);
+    if(UNLIKELY(share->mix_stats != NULL))
+        InterlockedExchange64(&share->mix_stats->signaled, DSShare_now());
+    SetEvent(share->timer_evt);
 }
 
-static void DSShare_starttimer(DeviceShare *share)
+/* Starts the mixer timer if it isn't running. Must be called with crst held
+ * once the share is running.
+ */
+void DSShare_starttimer(DeviceShare *share)
 {
     DWORD triggertime;
 
+    if(share->loopback && LoopbackSpeed == 0)
+    {
+        if(!share->loopback_running)
+        {
+            share->timer_stats.rearms++;
+            share->loopback_running = TRUE;
+            SetEvent(share->timer_evt);
+        }
+        return;
+    }
     if(share->queue_timer)
         return;
+    share->timer_stats.rearms++;
 
-    triggertime = 1000 / share->refresh * 2 / 3;
+    /* Each loopback tick renders exactly one update, so pace those at the
+     * update rate times the speed-up.
+     */
+    if(share->loopback)
+        triggertime = 1000 / share->refresh / LoopbackSpeed;
+    else
+        triggertime = 1000 / share->refresh * 2 / 3;
+    if(triggertime < 1) triggertime = 1;
     TRACE("Calling timer every %lu ms for %d refreshes per second\n",
           triggertime, share->refresh);
 
-    CreateTimerQueueTimer(&share->queue_timer, NULL, DSShare_timer, share->timer_evt,
+    if(share->mix_stats)
+    {
+        share->mix_stats->period = share->tick_freq * triggertime / 1000;
+        share->mix_stats->last_wake = 0;
+    }
+    CreateTimerQueueTimer(&share->queue_timer, NULL, DSShare_timer, share,
                           triggertime, triggertime, WT_EXECUTEINTIMERTHREAD);
 }
 
@@ -99,6 +532,14 @@ static void DSShare_starttimer(DeviceShare *share)
 
 static DeviceShare **sharelist;
 static UINT sharelistsize;
+/* Live statistics slots in use, guarded by openal_crst. */
+static DWORD liveslots;
+/* The device writing to LoopbackOutput itself, and how many devices wrote to
+ * a numbered file next to it while another had it open. Guarded by
+ * openal_crst.
+ */
+static DeviceShare *loopback_owner;
+static DWORD loopback_numbered;
 
 static void DSShare_Destroy(DeviceShare *share)
 {
@@ -118,6 +559,8 @@ static void DSShare_Destroy(DeviceShare *share)
             break;
         }
     }
+    if(share->live_map)
+        liveslots &= ~(1u<<share->live_slot);
     LeaveCriticalSection(&openal_crst);
 
     if(share->queue_timer)
@@ -140,12 +583,49 @@ static void DSShare_Destroy(DeviceShare *share)
         CloseHandle(share->timer_evt);
     share->timer_evt = NULL;
 
+    if(share->tick_stats.ticks > 0)
+        TRACE("Mixer ticks: %lu, slices: %lu, carried over: %lu, lock held avg %.1fus, max tick %.1fus, max slice %.1fus\n",
+              share->tick_stats.ticks, share->tick_stats.slices, share->tick_stats.carried,
+              (double)share->tick_stats.total_hold * 1000000.0 / share->tick_freq /
+                  share->tick_stats.ticks,
+              (double)share->tick_stats.max_tick_hold * 1000000.0 / share->tick_freq,
+              (double)share->tick_stats.max_slice_hold * 1000000.0 / share->tick_freq);
+    TRACE("Mixer timer wakeups: %lu, parked: %lu, re-armed: %lu\n", share->tick_stats.ticks,
+          share->timer_stats.parks, share->timer_stats.rearms);
+    if(share->loopback)
+        TRACE("Loopback rendered %.1f seconds\n",
+              (double)share->loopback_frames / share->loopback_freq);
+    if(share->stream_stats.underruns > 0)
+        TRACE("Streaming underruns: %lu, queues deepened: %lu, shrunk: %lu\n",
+              share->stream_stats.underruns, share->stream_stats.deepened,
+              share->stream_stats.shrunk);
+    if(share->mix_stats)
+    {
+        if(share->tick_stats.ticks > 0)
+            DSShare_dumpmixstats(share);
+        if(share->mix_stats->dump_event)
+            CloseHandle(share->mix_stats->dump_event);
+        HeapFree(GetProcessHeap(), 0, share->mix_stats);
+        share->mix_stats = NULL;
+    }
+
+    if(share->live)
+    {
+        share->live->active = 0;
+        UnmapViewOfFile(share->live);
+        share->live = NULL;
+    }
+    if(share->live_map)
+        CloseHandle(share->live_map);
+    share->live_map = NULL;
+
     if(share->ctx)
     {
         /* Calling setALContext is not appropriate here, since we *have* to
          * unset the context before destroying it
          */
         EnterCriticalSection(&openal_crst);
+        UnsetALContextGlob();
         set_context(share->ctx);
 
         share->sources.maxhw_alloc = share->sources.maxsw_alloc = 0;
@@ -161,6 +641,21 @@ static void DSShare_Destroy(DeviceShare *share)
         alcCloseDevice(share->device);
     share->device = NULL;
 
+    if(share->loopback_file)
+    {
+        ULONGLONG size = share->loopback_frames * LOOPBACK_CHANNELS * sizeof(ALshort);
+        DSShare_writewavheader(share, (size > 0xffffffd0) ? 0xffffffd0 : (DWORD)size);
+        fclose(share->loopback_file);
+        share->loopback_file = NULL;
+
+        EnterCriticalSection(&openal_crst);
+        if(loopback_owner == share)
+            loopback_owner = NULL;
+        LeaveCriticalSection(&openal_crst);
+    }
+    HeapFree(GetProcessHeap(), 0, share->loopback_buf);
+    share->loopback_buf = NULL;
+
     DeleteCriticalSection(&share->crst);
 
     HeapFree(GetProcessHeap(), 0, share->primaries);
@@ -169,6 +664,64 @@ static void DSShare_Destroy(DeviceShare *share)
     TRACE("Closed shared device %p\n", share);
 }
 
+/* Maps the share's live statistics block in the first free slot. Called with
+ * openal_crst held. Failure only loses the statistics.
+ */
+static void DSShare_maplive(DeviceShare *share)
+{
+    DSoalLiveStats *live;
+    char name[64];
+    DWORD slot;
+
+    for(slot = 0;slot < DSOAL_LIVESTATS_SLOTS;++slot)
+    {
+        if(!(liveslots&(1u<<slot)))
+            break;
+    }
+    if(slot == DSOAL_LIVESTATS_SLOTS)
+    {
+        WARN("No free live statistics slots\n");
+        return;
+    }
+
+    snprintf(name, sizeof(name), DSOAL_LIVESTATS_NAME, GetCurrentProcessId(), slot);
+    share->live_map = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0,
+                                         sizeof(*live), name);
+    if(!share->live_map)
+    {
+        WARN("Failed to create live statistics mapping %s: %lu\n", name, GetLastError());
+        return;
+    }
+    live = MapViewOfFile(share->live_map, FILE_MAP_WRITE, 0, 0, sizeof(*live));
+    if(!live)
+    {
+        WARN("Failed to map live statistics %s: %lu\n", name, GetLastError());
+        CloseHandle(share->live_map);
+        share->live_map = NULL;
+        return;
+    }
+
+    /* A monitor may still hold the mapping of a device that was closed, so
+     * start from a clean block.
+     */
+    memset(live, 0, sizeof(*live));
+    live->magic = DSOAL_LIVESTATS_MAGIC;
+    live->version = DSOAL_LIVESTATS_VERSION;
+    live->size = sizeof(*live);
+    live->device = share->guid;
+    live->refresh = share->refresh;
+    live->hw_sources_max = share->sources.maxhw_alloc;
+    live->hw_sources_free = share->sources.availhw_num;
+    live->sw_sources_max = share->sources.maxsw_alloc;
+    live->sw_sources_free = share->sources.availsw_num;
+    live->active = 1;
+
+    liveslots |= 1u<<slot;
+    share->live_slot = slot;
+    share->live = live;
+    TRACE("Publishing live statistics as %s\n", name);
+}
+
 static HRESULT DSShare_Create(REFIID guid, DeviceShare **out)
 {
     static const struct {
@@ -181,12 +734,15 @@ static HRESULT DSShare_Create(REFIID guid, DeviceShare **out)
         { "AL_SOFT_deferred_updates",  SOFT_DEFERRED_UPDATES },
         { "AL_SOFT_source_spatialize", SOFT_SOURCE_SPATIALIZE },
         { "AL_SOFTX_map_buffer",       SOFTX_MAP_BUFFER },
+        { "AL_SOFT_source_start_delay", SOFT_SOURCE_START_DELAY },
+        { "ALC_SOFT_device_clock",     SOFT_DEVICE_CLOCK },
+        { "AL_SOFT_source_latency",    SOFT_SOURCE_LATENCY },
     };
     OLECHAR *guid_str = NULL;
     ALchar drv_name[64];
     DeviceShare *share;
     IMMDevice *mmdev;
-    ALCint attrs[7];
+    ALCint attrs[15];
     void *temp;
     HRESULT hr, cohr;
     ALsizei i;
@@ -276,6 +832,7 @@ static HRESULT DSShare_Create(REFIID guid, DeviceShare **out)
     }
 
     InitializeCriticalSection(&share->crst);
+    InitializeSRWLock(&share->params_lock);
 
     hr = StringFromCLSID(guid, &guid_str);
     if(FAILED(hr))
@@ -289,23 +846,92 @@ static HRESULT DSShare_Create(REFIID guid, DeviceShare **out)
     guid_str = NULL;
 
     hr = DSERR_NODRIVER;
-    share->device = alcOpenDevice(drv_name);
+    if(LoopbackOutput[0] && (!palcLoopbackOpenDeviceSOFT || !palcRenderSamplesSOFT))
+        WARN("ALC_SOFT_loopback not available, opening \"%s\" normally\n", drv_name);
+    else if(LoopbackOutput[0])
+    {
+        share->device = alcLoopbackOpenDeviceSOFT(NULL);
+        if(!share->device)
+        {
+            alcGetError(NULL);
+            WARN("Couldn't open loopback device\n");
+            goto fail;
+        }
+        share->loopback = TRUE;
+        share->loopback_freq = LOOPBACK_FREQ;
+        share->loopback_update = LOOPBACK_FREQ / FAKE_REFRESH_COUNT;
+        share->loopback_buf = HeapAlloc(GetProcessHeap(), 0,
+            share->loopback_update * LOOPBACK_CHANNELS * sizeof(ALshort));
+        if(!share->loopback_buf)
+        {
+            hr = DSERR_OUTOFMEMORY;
+            goto fail;
+        }
+        if(strcmp(LoopbackOutput, "1") != 0)
+        {
+            char path[MAX_PATH+16];
+
+            /* Another device is writing the output file, so this one gets its
+             * own, numbered before the extension (out.wav -> out.1.wav).
+             */
+            if(loopback_owner)
+            {
+                const char *ext = strrchr(LoopbackOutput, '.');
+                if(!ext || strpbrk(ext, "\\/"))
+                    ext = LoopbackOutput + strlen(LoopbackOutput);
+                snprintf(path, sizeof(path), "%.*s.%lu%s", (int)(ext-LoopbackOutput),
+                         LoopbackOutput, ++loopback_numbered, ext);
+                WARN("Loopback output %s in use, writing to %s\n", LoopbackOutput, path);
+            }
+            else
+                lstrcpynA(path, LoopbackOutput, sizeof(path));
+
+            share->loopback_file = fopen(path, "wb");
+            if(!share->loopback_file)
+                ERR("Failed to open loopback output %s\n", path);
+            else
+            {
+                if(!loopback_owner)
+                    loopback_owner = share;
+                DSShare_writewavheader(share, 0);
+            }
+        }
+        TRACE("Opened AL loopback device for \"%s\"\n", drv_name);
+    }
     if(!share->device)
     {
-        alcGetError(NULL);
-        WARN("Couldn't open device \"%s\"\n", drv_name);
-        goto fail;
+        share->device = alcOpenDevice(drv_name);
+        if(!share->device)
+        {
+            alcGetError(NULL);
+            WARN("Couldn't open device \"%s\"\n", drv_name);
+            goto fail;
+        }
+        TRACE("Opened AL device: %s\n",
+              alcIsExtensionPresent(share->device, "ALC_ENUMERATE_ALL_EXT") ?
+              alcGetString(share->device, ALC_ALL_DEVICES_SPECIFIER) :
+              alcGetString(share->device, ALC_DEVICE_SPECIFIER));
     }
-    TRACE("Opened AL device: %s\n",
-          alcIsExtensionPresent(share->device, "ALC_ENUMERATE_ALL_EXT") ?
-          alcGetString(share->device, ALC_ALL_DEVICES_SPECIFIER) :
-          alcGetString(share->device, ALC_DEVICE_SPECIFIER));
 
     i = 0;
     attrs[i++] = ALC_MONO_SOURCES;
     attrs[i++] = MAX_SOURCES;
     attrs[i++] = ALC_STEREO_SOURCES;
     attrs[i++] = 0;
+    if(share->loopback)
+    {
+        /* Loopback devices need the render format spelled out, and one
+         * update per tick of the mixer thread.
+         */
+        attrs[i++] = ALC_FORMAT_CHANNELS_SOFT;
+        attrs[i++] = ALC_STEREO_SOFT;
+        attrs[i++] = ALC_FORMAT_TYPE_SOFT;
+        attrs[i++] = ALC_SHORT_SOFT;
+        attrs[i++] = ALC_FREQUENCY;
+        attrs[i++] = share->loopback_freq;
+        attrs[i++] = ALC_REFRESH;
+        attrs[i++] = FAKE_REFRESH_COUNT;
+    }
     attrs[i++] = 0;
     share->ctx = alcCreateContext(share->device, attrs);
     if(!share->ctx)
@@ -321,11 +947,22 @@ static HRESULT DSShare_Create(REFIID guid, DeviceShare **out)
     alcGetIntegerv(share->device, ALC_REFRESH, 1, &share->refresh);
     checkALCError(share->device);
 
+    /* Give each mixer tick a quarter of the update period. */
+    {
+        LARGE_INTEGER freq;
+        if(!QueryPerformanceFrequency(&freq) || freq.QuadPart <= 0)
+            freq.QuadPart = 1000;
+        share->tick_freq = freq.QuadPart;
+        share->tick_budget = share->tick_freq / share->refresh / 4;
+        if(share->tick_budget < 1)
+            share->tick_budget = 1;
+    }
+
     for(i = 0;i < MAX_EXTENSIONS;i++)
     {
         if((strncmp(extensions[i].extname, "ALC", 3) == 0) ?
            alcIsExtensionPresent(share->device, extensions[i].extname) :
-           alIsExtensionPresent(extensions[i].extname))
+           alIsExtensionPresentDirect(share->ctx, extensions[i].extname))
         {
             TRACE("Found %s\n", extensions[i].extname);
             BITFIELD_SET(share->Exts, extensions[i].extenum);
@@ -380,6 +1017,24 @@ static HRESULT DSShare_Create(REFIID guid, DeviceShare **out)
 
     hr = E_FAIL;
 
+    if(MixStatsEnabled)
+    {
+        /* Signaling the dump event writes the profile of every device to
+         * the log, without waiting for exit.
+         */
+        char name[64];
+        share->mix_stats = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*share->mix_stats));
+        if(share->mix_stats)
+        {
+            snprintf(name, sizeof(name), "DSOAL_MixStatsDump.%lu", GetCurrentProcessId());
+            share->mix_stats->dump_event = CreateEventA(NULL, TRUE, FALSE, name);
+            share->mix_stats->dump_gen = MixStatsDumpGen;
+        }
+    }
+
+    if(LiveStatsEnabled)
+        DSShare_maplive(share);
+
     share->quit_now = FALSE;
     share->timer_evt = CreateEventA(NULL, FALSE, FALSE, NULL);
     if(!share->timer_evt) goto fail;
@@ -389,8 +1044,6 @@ static HRESULT DSShare_Create(REFIID guid, DeviceShare **out)
     share->thread_hdl = CreateThread(NULL, 0, DSShare_thread, share, 0, &share->thread_id);
     if(!share->thread_hdl) goto fail;
 
-    DSShare_starttimer(share);
-
     *out = share;
     return DS_OK;
 
@@ -508,11 +1161,13 @@ static void DSDevice_Destroy(DSDevice *This)
     DeviceShare *share = This->share;
 
     TRACE("Destroying device instance %p\n", This);
+    if(This->share)
+        APITRACE(DSTraceDeviceRelease, S_OK, This, NULL, NULL, 0, 0);
     if(share)
     {
         ALsizei i;
 
-        EnterCriticalSection(&share->crst);
+        DSShare_Lock(share);
 
         for(i = 0;i < share->nprimaries;++i)
         {
@@ -524,7 +1179,7 @@ static void DSDevice_Destroy(DSDevice *This)
             }
         }
 
-        LeaveCriticalSection(&share->crst);
+        DSShare_Unlock(share);
     }
 
     DSPrimary_Clear(&This->primary);
@@ -595,6 +1250,7 @@ static ULONG WINAPI DS8_Release(IDirectSound8 *iface)
 static HRESULT WINAPI DS8_CreateSoundBuffer(IDirectSound8 *iface, LPCDSBUFFERDESC desc, LPLPDIRECTSOUNDBUFFER buf, IUnknown *pUnkOuter)
 {
     DSDevice *This = impl_from_IDirectSound8(iface);
+    void *created = NULL;
     HRESULT hr;
 
     TRACE("(%p)->(%p, %p, %p)\n", iface, desc, buf, pUnkOuter);
@@ -660,7 +1316,7 @@ static HRESULT WINAPI DS8_CreateSoundBuffer(IDirectSound8 *iface, LPCDSBUFFERDES
         }
     }
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
     if((desc->dwFlags&DSBCAPS_PRIMARYBUFFER))
     {
         IDirectSoundBuffer *prim = &This->primary.IDirectSoundBuffer_iface;
@@ -676,6 +1332,7 @@ static HRESULT WINAPI DS8_CreateSoundBuffer(IDirectSound8 *iface, LPCDSBUFFERDES
             }
         }
         *buf = prim;
+        if(prim) created = &This->primary;
     }
     else
     {
@@ -692,10 +1349,14 @@ static HRESULT WINAPI DS8_CreateSoundBuffer(IDirectSound8 *iface, LPCDSBUFFERDES
             }
             if(FAILED(hr))
                 DSBuffer_Destroy(dsb);
+            else
+                created = dsb;
         }
     }
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
 
+    APITRACE(DSTraceCreateBuffer, hr, This, created, desc->lpwfxFormat,
+             ApiTrace_FormatSize(desc->lpwfxFormat), 2, desc->dwFlags, desc->dwBufferBytes);
     TRACE("%08lx\n", hr);
     return hr;
 }
@@ -703,7 +1364,6 @@ static HRESULT WINAPI DS8_CreateSoundBuffer(IDirectSound8 *iface, LPCDSBUFFERDES
 static HRESULT WINAPI DS8_GetCaps(IDirectSound8 *iface, LPDSCAPS caps)
 {
     DSDevice *This = impl_from_IDirectSound8(iface);
-    struct DSBufferGroup *bufgroup, *endgroup;
     DWORD free_bufs;
 
     TRACE("(%p)->(%p)\n", iface, caps);
@@ -720,27 +1380,13 @@ static HRESULT WINAPI DS8_GetCaps(IDirectSound8 *iface, LPDSCAPS caps)
         return DSERR_INVALIDPARAM;
     }
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
 
     free_bufs = This->share->sources.maxhw_alloc;
-    bufgroup = This->primary.BufferGroups;
-    endgroup = bufgroup + This->primary.NumBufferGroups;
-    for(;free_bufs && bufgroup != endgroup;++bufgroup)
-    {
-        DWORD64 usemask = ~bufgroup->FreeBuffers;
-        while(usemask)
-        {
-            int idx = CTZ64(usemask);
-            DSBuffer *buf = bufgroup->Buffers + idx;
-            usemask &= ~(U64(1) << idx);
-
-            if(buf->loc_status == DSBSTATUS_LOCHARDWARE)
-            {
-                if(!--free_bufs)
-                    break;
-            }
-        }
-    }
+    if(This->primary.nhw_voices < free_bufs)
+        free_bufs -= This->primary.nhw_voices;
+    else
+        free_bufs = 0;
 
     caps->dwFlags = DSCAPS_CONTINUOUSRATE | DSCAPS_CERTIFIED |
                     DSCAPS_PRIMARY16BIT | DSCAPS_PRIMARYSTEREO |
@@ -768,7 +1414,7 @@ static HRESULT WINAPI DS8_GetCaps(IDirectSound8 *iface, LPDSCAPS caps)
     caps->dwUnlockTransferRateHwBuffers = 4096;
     caps->dwPlayCpuOverheadSwBuffers = 0;
 
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
 
     return DS_OK;
 }
@@ -814,9 +1460,14 @@ static HRESULT WINAPI DS8_DuplicateSoundBuffer(IDirectSound8 *iface, IDirectSoun
         if(SUCCEEDED(hr))
             hr = DSBuffer_GetInterface(buf, &IID_IDirectSoundBuffer, (void**)out);
         if(FAILED(hr))
+        {
             DSBuffer_Destroy(buf);
+            buf = NULL;
+        }
     }
 
+    APITRACE(DSTraceDuplicateBuffer, hr, CONTAINING_RECORD(in, DSBuffer, IDirectSoundBuffer8_iface),
+             buf, NULL, 0, 0);
     return hr;
 }
 
@@ -839,7 +1490,7 @@ static HRESULT WINAPI DS8_SetCooperativeLevel(IDirectSound8 *iface, HWND hwnd, D
         return DSERR_INVALIDPARAM;
     }
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
     if(level == DSSCL_WRITEPRIMARY && (This->prio_level != DSSCL_WRITEPRIMARY))
     {
         struct DSBufferGroup *bufgroup = This->primary.BufferGroups;
@@ -910,8 +1561,9 @@ static HRESULT WINAPI DS8_SetCooperativeLevel(IDirectSound8 *iface, HWND hwnd, D
     if(SUCCEEDED(hr))
         This->prio_level = level;
 out:
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
 
+    APITRACE(DSTraceSetCooperativeLevel, hr, This, NULL, NULL, 0, 1, level);
     return hr;
 }
 
@@ -928,13 +1580,13 @@ static HRESULT WINAPI DS8_Compact(IDirectSound8 *iface)
         return DSERR_UNINITIALIZED;
     }
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
     if(This->prio_level < DSSCL_PRIORITY)
     {
         WARN("Coop level not high enough (%lu)\n", This->prio_level);
         hr = DSERR_PRIOLEVELNEEDED;
     }
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
 
     return hr;
 }
@@ -1046,7 +1698,7 @@ static HRESULT WINAPI DS8_Initialize(IDirectSound8 *iface, const GUID *devguid)
         DeviceShare *share = This->share;
         DSPrimary **prims;
 
-        EnterCriticalSection(&share->crst);
+        DSShare_Lock(share);
 
         prims = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
                           (share->nprimaries+1) * sizeof(*prims));
@@ -1064,7 +1716,7 @@ static HRESULT WINAPI DS8_Initialize(IDirectSound8 *iface, const GUID *devguid)
             share->nprimaries += 1;
         }
 
-        LeaveCriticalSection(&share->crst);
+        DSShare_Unlock(share);
     }
 
     if(FAILED(hr))
@@ -1075,6 +1727,8 @@ static HRESULT WINAPI DS8_Initialize(IDirectSound8 *iface, const GUID *devguid)
     }
 
     LeaveCriticalSection(&openal_crst);
+
+    APITRACE(DSTraceDeviceCreate, hr, This, NULL, &guid, sizeof(guid), 1, (DWORD)This->is_8);
     return hr;
 }
 
@@ -56,6 +56,10 @@
 
 
 int LogLevel = 1;
+DWORD WriteMargin = 2;
+BOOL CaptureChunks = FALSE;
+char LoopbackOutput[MAX_PATH];
+DWORD LoopbackSpeed = 1;
 FILE *LogFile;
 
 
@@ -204,6 +208,51 @@ LPALBUFFERSTORAGESOFT palBufferStorageSOFT = NULL;
 LPALMAPBUFFERSOFT palMapBufferSOFT = NULL;
 LPALUNMAPBUFFERSOFT palUnmapBufferSOFT = NULL;
 LPALFLUSHMAPPEDBUFFERSOFT palFlushMappedBufferSOFT = NULL;
+LPALSOURCEPLAYATTIMEVSOFT palSourcePlayAtTimevSOFT = NULL;
+LPALGETSOURCEDVSOFT palGetSourcedvSOFT = NULL;
+LPALGETSOURCEI64VSOFT palGetSourcei64vSOFT = NULL;
+LPALCGETINTEGER64VSOFT palcGetInteger64vSOFT = NULL;
+LPALCLOOPBACKOPENDEVICESOFT palcLoopbackOpenDeviceSOFT = NULL;
+LPALCRENDERSAMPLESSOFT palcRenderSamplesSOFT = NULL;
+
+BOOL direct_contexts;
+LPALGETERRORDIRECT palGetErrorDirect = NULL;
+LPALISEXTENSIONPRESENTDIRECT palIsExtensionPresentDirect = NULL;
+LPALGETENUMVALUEDIRECT palGetEnumValueDirect = NULL;
+LPALDOPPLERFACTORDIRECT palDopplerFactorDirect = NULL;
+LPALSPEEDOFSOUNDDIRECT palSpeedOfSoundDirect = NULL;
+LPALLISTENERFDIRECT palListenerfDirect = NULL;
+LPALLISTENER3FDIRECT palListener3fDirect = NULL;
+LPALLISTENERFVDIRECT palListenerfvDirect = NULL;
+LPALGETLISTENERFDIRECT palGetListenerfDirect = NULL;
+LPALGENSOURCESDIRECT palGenSourcesDirect = NULL;
+LPALDELETESOURCESDIRECT palDeleteSourcesDirect = NULL;
+LPALSOURCEFDIRECT palSourcefDirect = NULL;
+LPALSOURCE3FDIRECT palSource3fDirect = NULL;
+LPALSOURCEFVDIRECT palSourcefvDirect = NULL;
+LPALSOURCEIDIRECT palSourceiDirect = NULL;
+LPALGETSOURCEIDIRECT palGetSourceiDirect = NULL;
+LPALGETSOURCEDVDIRECTSOFT palGetSourcedvDirectSOFT = NULL;
+LPALGETSOURCEI64VDIRECTSOFT palGetSourcei64vDirectSOFT = NULL;
+LPALSOURCEPLAYDIRECT palSourcePlayDirect = NULL;
+LPALSOURCEPLAYVDIRECT palSourcePlayvDirect = NULL;
+LPALSOURCESTOPDIRECT palSourceStopDirect = NULL;
+LPALSOURCEREWINDDIRECT palSourceRewindDirect = NULL;
+LPALSOURCEPAUSEDIRECT palSourcePauseDirect = NULL;
+LPALSOURCEQUEUEBUFFERSDIRECT palSourceQueueBuffersDirect = NULL;
+LPALSOURCEUNQUEUEBUFFERSDIRECT palSourceUnqueueBuffersDirect = NULL;
+LPALGENBUFFERSDIRECT palGenBuffersDirect = NULL;
+LPALDELETEBUFFERSDIRECT palDeleteBuffersDirect = NULL;
+LPALBUFFERDATADIRECT palBufferDataDirect = NULL;
+LPALDEFERUPDATESDIRECTSOFT palDeferUpdatesDirectSOFT = NULL;
+LPALPROCESSUPDATESDIRECTSOFT palProcessUpdatesDirectSOFT = NULL;
+LPALBUFFERSTORAGEDIRECTSOFT palBufferStorageDirectSOFT = NULL;
+LPALMAPBUFFERDIRECTSOFT palMapBufferDirectSOFT = NULL;
+LPALUNMAPBUFFERDIRECTSOFT palUnmapBufferDirectSOFT = NULL;
+LPALFLUSHMAPPEDBUFFERDIRECTSOFT palFlushMappedBufferDirectSOFT = NULL;
+LPALSOURCEPLAYATTIMEVDIRECTSOFT palSourcePlayAtTimevDirectSOFT = NULL;
+LPEAXSETDIRECT pEAXSetDirect = NULL;
+LPEAXGETDIRECT pEAXGetDirect = NULL;
 
 LPALCMAKECONTEXTCURRENT set_context;
 LPALCGETCURRENTCONTEXT get_context;
@@ -215,15 +264,203 @@ static void AL_APIENTRY wrap_DeferUpdates(void)
 static void AL_APIENTRY wrap_ProcessUpdates(void)
 { alcProcessContext(alcGetCurrentContext()); }
 
+/* Fallbacks for the direct context functions, used when ALC_EXT_direct_context
+ * isn't available. The context is ignored since it's already set current by
+ * setALContext.
+ */
+static ALenum AL_APIENTRY wrap_GetErrorDirect(ALCcontext *ctx)
+{ (void)ctx; return alGetError(); }
+static ALboolean AL_APIENTRY wrap_IsExtensionPresentDirect(ALCcontext *ctx, const ALchar *extname)
+{ (void)ctx; return alIsExtensionPresent(extname); }
+static ALenum AL_APIENTRY wrap_GetEnumValueDirect(ALCcontext *ctx, const ALchar *ename)
+{ (void)ctx; return alGetEnumValue(ename); }
+static void AL_APIENTRY wrap_DopplerFactorDirect(ALCcontext *ctx, ALfloat value)
+{ (void)ctx; alDopplerFactor(value); }
+static void AL_APIENTRY wrap_SpeedOfSoundDirect(ALCcontext *ctx, ALfloat value)
+{ (void)ctx; alSpeedOfSound(value); }
+static void AL_APIENTRY wrap_ListenerfDirect(ALCcontext *ctx, ALenum param, ALfloat value)
+{ (void)ctx; alListenerf(param, value); }
+static void AL_APIENTRY wrap_Listener3fDirect(ALCcontext *ctx, ALenum param, ALfloat value1, ALfloat value2, ALfloat value3)
+{ (void)ctx; alListener3f(param, value1, value2, value3); }
+static void AL_APIENTRY wrap_ListenerfvDirect(ALCcontext *ctx, ALenum param, const ALfloat *values)
+{ (void)ctx; alListenerfv(param, values); }
+static void AL_APIENTRY wrap_GetListenerfDirect(ALCcontext *ctx, ALenum param, ALfloat *value)
+{ (void)ctx; alGetListenerf(param, value); }
+static void AL_APIENTRY wrap_GenSourcesDirect(ALCcontext *ctx, ALsizei n, ALuint *sources)
+{ (void)ctx; alGenSources(n, sources); }
+static void AL_APIENTRY wrap_DeleteSourcesDirect(ALCcontext *ctx, ALsizei n, const ALuint *sources)
+{ (void)ctx; alDeleteSources(n, sources); }
+static void AL_APIENTRY wrap_SourcefDirect(ALCcontext *ctx, ALuint source, ALenum param, ALfloat value)
+{ (void)ctx; alSourcef(source, param, value); }
+static void AL_APIENTRY wrap_Source3fDirect(ALCcontext *ctx, ALuint source, ALenum param, ALfloat value1, ALfloat value2, ALfloat value3)
+{ (void)ctx; alSource3f(source, param, value1, value2, value3); }
+static void AL_APIENTRY wrap_SourcefvDirect(ALCcontext *ctx, ALuint source, ALenum param, const ALfloat *values)
+{ (void)ctx; alSourcefv(source, param, values); }
+static void AL_APIENTRY wrap_SourceiDirect(ALCcontext *ctx, ALuint source, ALenum param, ALint value)
+{ (void)ctx; alSourcei(source, param, value); }
+static void AL_APIENTRY wrap_GetSourceiDirect(ALCcontext *ctx, ALuint source, ALenum param, ALint *value)
+{ (void)ctx; alGetSourcei(source, param, value); }
+static void AL_APIENTRY wrap_GetSourcedvDirect(ALCcontext *ctx, ALuint source, ALenum param, ALdouble *values)
+{ (void)ctx; alGetSourcedvSOFT(source, param, values); }
+static void AL_APIENTRY wrap_GetSourcei64vDirect(ALCcontext *ctx, ALuint source, ALenum param, ALint64SOFT *values)
+{ (void)ctx; alGetSourcei64vSOFT(source, param, values); }
+static void AL_APIENTRY wrap_SourcePlayDirect(ALCcontext *ctx, ALuint source)
+{ (void)ctx; alSourcePlay(source); }
+static void AL_APIENTRY wrap_SourcePlayvDirect(ALCcontext *ctx, ALsizei n, const ALuint *sources)
+{ (void)ctx; alSourcePlayv(n, sources); }
+static void AL_APIENTRY wrap_SourceStopDirect(ALCcontext *ctx, ALuint source)
+{ (void)ctx; alSourceStop(source); }
+static void AL_APIENTRY wrap_SourceRewindDirect(ALCcontext *ctx, ALuint source)
+{ (void)ctx; alSourceRewind(source); }
+static void AL_APIENTRY wrap_SourcePauseDirect(ALCcontext *ctx, ALuint source)
+{ (void)ctx; alSourcePause(source); }
+static void AL_APIENTRY wrap_SourceQueueBuffersDirect(ALCcontext *ctx, ALuint source, ALsizei nb, const ALuint *buffers)
+{ (void)ctx; alSourceQueueBuffers(source, nb, buffers); }
+static void AL_APIENTRY wrap_SourceUnqueueBuffersDirect(ALCcontext *ctx, ALuint source, ALsizei nb, ALuint *buffers)
+{ (void)ctx; alSourceUnqueueBuffers(source, nb, buffers); }
+static void AL_APIENTRY wrap_GenBuffersDirect(ALCcontext *ctx, ALsizei n, ALuint *buffers)
+{ (void)ctx; alGenBuffers(n, buffers); }
+static void AL_APIENTRY wrap_DeleteBuffersDirect(ALCcontext *ctx, ALsizei n, const ALuint *buffers)
+{ (void)ctx; alDeleteBuffers(n, buffers); }
+static void AL_APIENTRY wrap_BufferDataDirect(ALCcontext *ctx, ALuint buffer, ALenum format, const ALvoid *data, ALsizei size, ALsizei freq)
+{ (void)ctx; alBufferData(buffer, format, data, size, freq); }
+static void AL_APIENTRY wrap_DeferUpdatesDirect(ALCcontext *ctx)
+{ (void)ctx; alDeferUpdatesSOFT(); }
+static void AL_APIENTRY wrap_ProcessUpdatesDirect(ALCcontext *ctx)
+{ (void)ctx; alProcessUpdatesSOFT(); }
+static void AL_APIENTRY wrap_BufferStorageDirect(ALCcontext *ctx, ALuint buffer, ALenum format, const ALvoid *data, ALsizei size, ALsizei freq, ALbitfieldSOFT flags)
+{ (void)ctx; alBufferStorageSOFT(buffer, format, data, size, freq, flags); }
+static void* AL_APIENTRY wrap_MapBufferDirect(ALCcontext *ctx, ALuint buffer, ALsizei offset, ALsizei length, ALbitfieldSOFT access)
+{ (void)ctx; return alMapBufferSOFT(buffer, offset, length, access); }
+static void AL_APIENTRY wrap_UnmapBufferDirect(ALCcontext *ctx, ALuint buffer)
+{ (void)ctx; alUnmapBufferSOFT(buffer); }
+static void AL_APIENTRY wrap_FlushMappedBufferDirect(ALCcontext *ctx, ALuint buffer, ALsizei offset, ALsizei length)
+{ (void)ctx; alFlushMappedBufferSOFT(buffer, offset, length); }
+static void AL_APIENTRY wrap_SourcePlayAtTimevDirect(ALCcontext *ctx, ALsizei n, const ALuint *sources, ALint64SOFT start_time)
+{ (void)ctx; alSourcePlayAtTimevSOFT(n, sources, start_time); }
+static ALenum AL_APIENTRY wrap_EAXSetDirect(ALCcontext *ctx, const GUID *property_set_id, ALuint property_id, ALuint property_source_id, ALvoid *property_buffer, ALuint property_size)
+{ (void)ctx; return EAXSet(property_set_id, property_id, property_source_id, property_buffer, property_size); }
+static ALenum AL_APIENTRY wrap_EAXGetDirect(ALCcontext *ctx, const GUID *property_set_id, ALuint property_id, ALuint property_source_id, ALvoid *property_buffer, ALuint property_size)
+{ (void)ctx; return EAXGet(property_set_id, property_id, property_source_id, property_buffer, property_size); }
+
 static void EnterALSectionTLS(ALCcontext *ctx);
 static void LeaveALSectionTLS(void);
 static void EnterALSectionGlob(ALCcontext *ctx);
 static void LeaveALSectionGlob(void);
+static void EnterALSectionDirect(ALCcontext *ctx);
+static void LeaveALSectionDirect(void);
 
 DWORD TlsThreadPtr;
 void (*EnterALSection)(ALCcontext *ctx) = EnterALSectionGlob;
 void (*LeaveALSection)(void) = LeaveALSectionGlob;
 
+/* Without thread-local contexts, the current context is process-wide. Threads
+ * using the context that's already current only need to register themselves
+ * in glob_users, while changing the context requires openal_crst and waiting
+ * for the registered users to leave. A thread registers once for its outermost
+ * section, with its nesting depth kept in GlobDepthTls, so nested sections
+ * don't wait on themselves. glob_cur is the context last made current, which
+ * can't change while any thread is registered.
+ */
+static ALCcontext *volatile glob_ctx;
+static ALCcontext *glob_cur;
+static LONG glob_users;
+static DWORD GlobDepthTls = TLS_OUT_OF_INDEXES;
+/* Signaled when glob_users drops to 0 while a thread waits to switch. */
+static HANDLE glob_idle_evt;
+static volatile LONG glob_waiting;
+
+/* Contention counters for the above, modified with openal_crst held. */
+static LONG glob_switches;
+static LONG glob_contended;
+static LONG glob_waits;
+
+
+/* Lock hold time statistics. Entries are keyed by the entry point's name
+ * pointer and claimed on first use. Histogram bucket 0 counts holds under
+ * 1us, bucket N counts holds of [2^(N-1), 2^N)us, and the last bucket counts
+ * everything longer.
+ */
+#define LOCKSTATS_SIZE 256
+#define LOCKSTATS_BUCKETS 16
+typedef struct LockStat {
+    const char *volatile func;
+    LONG count;
+    LONG max_us;
+    LONG hist[LOCKSTATS_BUCKETS];
+} LockStat;
+static LockStat lock_stats[LOCKSTATS_SIZE];
+static LONGLONG lock_stats_freq = 1;
+BOOL LockStatsEnabled;
+
+void LockStats_Record(const char *func, LONGLONG ticks)
+{
+    LONGLONG us = ticks * 1000000 / lock_stats_freq;
+    size_t idx = ((size_t)func>>3) % LOCKSTATS_SIZE;
+    size_t i;
+
+    for(i = 0;i < LOCKSTATS_SIZE;++i)
+    {
+        LockStat *stat = &lock_stats[(idx+i) % LOCKSTATS_SIZE];
+        const char *cur = stat->func;
+        LONG oldmax, bucket = 0;
+
+        if(!cur)
+        {
+            cur = InterlockedCompareExchangePointer((void*volatile*)&stat->func, (void*)func, NULL);
+            if(!cur) cur = func;
+        }
+        if(cur != func)
+            continue;
+
+        if(us > 0x7fffffff) us = 0x7fffffff;
+        while(bucket < LOCKSTATS_BUCKETS-1 && (us>>bucket) != 0)
+            ++bucket;
+        InterlockedIncrement(&stat->hist[bucket]);
+        InterlockedIncrement(&stat->count);
+        while((oldmax=stat->max_us) < us)
+        {
+            if(InterlockedCompareExchange(&stat->max_us, (LONG)us, oldmax) == oldmax)
+                break;
+        }
+        return;
+    }
+}
+
+static void LockStats_Dump(void)
+{
+    size_t i;
+    int b;
+
+    if(!LockStatsEnabled)
+        return;
+
+    fprintf(LogFile, "Lock hold times (us, log2 buckets <1 <2 <4 ... >=16384):\n");
+    for(i = 0;i < LOCKSTATS_SIZE;++i)
+    {
+        const LockStat *stat = &lock_stats[i];
+        if(!stat->func) continue;
+
+        fprintf(LogFile, "  %-40s count %8ld max %8ld:", stat->func, stat->count, stat->max_us);
+        for(b = 0;b < LOCKSTATS_BUCKETS;++b)
+            fprintf(LogFile, " %ld", stat->hist[b]);
+        fprintf(LogFile, "\n");
+    }
+    fflush(LogFile);
+}
+
+
+BOOL MixStatsEnabled;
+DWORD MixStatsTls = TLS_OUT_OF_INDEXES;
+
+void MixStats_CountALCall(void)
+{
+    DWORD *count = TlsGetValue(MixStatsTls);
+    if(count) ++*count;
+}
+
+BOOL LiveStatsEnabled;
+
 
 static BOOL load_libopenal(void)
 {
@@ -234,6 +471,55 @@ static BOOL load_libopenal(void)
     if(str && *str)
         LogLevel = atoi(str);
 
+    str = getenv("DSOAL_LOGASYNC");
+    if(str && *str && atoi(str) != 0)
+        AsyncLog_Init();
+
+    str = getenv("DSOAL_WRITEMARGIN");
+    if(str && *str && atoi(str) >= 0)
+        WriteMargin = atoi(str);
+
+    str = getenv("DSOAL_CAPTURECHUNKS");
+    if(str && *str && atoi(str) != 0)
+        CaptureChunks = TRUE;
+
+    str = getenv("DSOAL_LOOPBACK");
+    if(str && *str)
+    {
+        lstrcpynA(LoopbackOutput, str, sizeof(LoopbackOutput));
+        str = getenv("DSOAL_LOOPBACK_SPEED");
+        if(str && *str && atoi(str) >= 0)
+            LoopbackSpeed = atoi(str);
+        TRACE("Loopback rendering to %s at speed %lu\n", LoopbackOutput, LoopbackSpeed);
+    }
+
+    str = getenv("DSOAL_LOCKSTATS");
+    if(str && *str && atoi(str) != 0)
+    {
+        LARGE_INTEGER freq;
+        if(QueryPerformanceFrequency(&freq) && freq.QuadPart > 0)
+        {
+            lock_stats_freq = freq.QuadPart;
+            LockStatsEnabled = TRUE;
+        }
+    }
+
+    str = getenv("DSOAL_MIXSTATS");
+    if(str && *str && atoi(str) != 0)
+    {
+        MixStatsTls = TlsAlloc();
+        if(MixStatsTls != TLS_OUT_OF_INDEXES)
+            MixStatsEnabled = TRUE;
+    }
+
+    str = getenv("DSOAL_LIVESTATS");
+    if(str && *str && atoi(str) != 0)
+        LiveStatsEnabled = TRUE;
+
+    str = getenv("DSOAL_APITRACE");
+    if(str && *str)
+        ApiTrace_Init(str);
+
     openal_handle = LoadLibraryW(aldriver_name);
     if(!openal_handle)
     {
@@ -365,6 +651,12 @@ static BOOL load_libopenal(void)
     LOAD_FUNCPTR(alMapBufferSOFT);
     LOAD_FUNCPTR(alUnmapBufferSOFT);
     LOAD_FUNCPTR(alFlushMappedBufferSOFT);
+    LOAD_FUNCPTR(alSourcePlayAtTimevSOFT);
+    LOAD_FUNCPTR(alGetSourcedvSOFT);
+    LOAD_FUNCPTR(alGetSourcei64vSOFT);
+    LOAD_FUNCPTR(alcGetInteger64vSOFT);
+    LOAD_FUNCPTR(alcLoopbackOpenDeviceSOFT);
+    LOAD_FUNCPTR(alcRenderSamplesSOFT);
 #undef LOAD_FUNCPTR
     if(!palDeferUpdatesSOFT || !palProcessUpdatesSOFT)
     {
@@ -372,6 +664,120 @@ static BOOL load_libopenal(void)
         palProcessUpdatesSOFT = wrap_ProcessUpdates;
     }
 
+    direct_contexts = alcIsExtensionPresent(NULL, "ALC_EXT_direct_context");
+    if(direct_contexts)
+    {
+        LPALCGETPROCADDRESS2 get_proc2;
+
+        TRACE("Found ALC_EXT_direct_context\n");
+
+        get_proc2 = alcGetProcAddress(NULL, "alcGetProcAddress2");
+        if(!get_proc2)
+        {
+            ERR("Direct contexts advertised but alcGetProcAddress2 not found\n");
+            direct_contexts = 0;
+        }
+        else
+        {
+#define LOAD_FUNCPTR(f) do {                                                 \
+    if((p##f = get_proc2(NULL, #f)) == NULL)                                 \
+    {                                                                        \
+        ERR("Couldn't lookup %s\n", #f);                                     \
+        direct_contexts = 0;                                                 \
+    }                                                                        \
+} while(0)
+            LOAD_FUNCPTR(alGetErrorDirect);
+            LOAD_FUNCPTR(alIsExtensionPresentDirect);
+            LOAD_FUNCPTR(alGetEnumValueDirect);
+            LOAD_FUNCPTR(alDopplerFactorDirect);
+            LOAD_FUNCPTR(alSpeedOfSoundDirect);
+            LOAD_FUNCPTR(alListenerfDirect);
+            LOAD_FUNCPTR(alListener3fDirect);
+            LOAD_FUNCPTR(alListenerfvDirect);
+            LOAD_FUNCPTR(alGetListenerfDirect);
+            LOAD_FUNCPTR(alGenSourcesDirect);
+            LOAD_FUNCPTR(alDeleteSourcesDirect);
+            LOAD_FUNCPTR(alSourcefDirect);
+            LOAD_FUNCPTR(alSource3fDirect);
+            LOAD_FUNCPTR(alSourcefvDirect);
+            LOAD_FUNCPTR(alSourceiDirect);
+            LOAD_FUNCPTR(alGetSourceiDirect);
+            LOAD_FUNCPTR(alSourcePlayDirect);
+            LOAD_FUNCPTR(alSourcePlayvDirect);
+            LOAD_FUNCPTR(alSourceStopDirect);
+            LOAD_FUNCPTR(alSourceRewindDirect);
+            LOAD_FUNCPTR(alSourcePauseDirect);
+            LOAD_FUNCPTR(alSourceQueueBuffersDirect);
+            LOAD_FUNCPTR(alSourceUnqueueBuffersDirect);
+            LOAD_FUNCPTR(alGenBuffersDirect);
+            LOAD_FUNCPTR(alDeleteBuffersDirect);
+            LOAD_FUNCPTR(alBufferDataDirect);
+            LOAD_FUNCPTR(alDeferUpdatesDirectSOFT);
+            LOAD_FUNCPTR(alProcessUpdatesDirectSOFT);
+            if(palBufferStorageSOFT)
+            {
+                LOAD_FUNCPTR(alBufferStorageDirectSOFT);
+                LOAD_FUNCPTR(alMapBufferDirectSOFT);
+                LOAD_FUNCPTR(alUnmapBufferDirectSOFT);
+                LOAD_FUNCPTR(alFlushMappedBufferDirectSOFT);
+            }
+            if(palSourcePlayAtTimevSOFT)
+                LOAD_FUNCPTR(alSourcePlayAtTimevDirectSOFT);
+            if(palGetSourcedvSOFT)
+                LOAD_FUNCPTR(alGetSourcedvDirectSOFT);
+            if(palGetSourcei64vSOFT)
+                LOAD_FUNCPTR(alGetSourcei64vDirectSOFT);
+            if(pEAXSet)
+            {
+                LOAD_FUNCPTR(EAXSetDirect);
+                LOAD_FUNCPTR(EAXGetDirect);
+            }
+#undef LOAD_FUNCPTR
+            if(!direct_contexts)
+                ERR("Missing direct context functions, disabling direct contexts\n");
+        }
+    }
+    if(!direct_contexts)
+    {
+        palGetErrorDirect = wrap_GetErrorDirect;
+        palIsExtensionPresentDirect = wrap_IsExtensionPresentDirect;
+        palGetEnumValueDirect = wrap_GetEnumValueDirect;
+        palDopplerFactorDirect = wrap_DopplerFactorDirect;
+        palSpeedOfSoundDirect = wrap_SpeedOfSoundDirect;
+        palListenerfDirect = wrap_ListenerfDirect;
+        palListener3fDirect = wrap_Listener3fDirect;
+        palListenerfvDirect = wrap_ListenerfvDirect;
+        palGetListenerfDirect = wrap_GetListenerfDirect;
+        palGenSourcesDirect = wrap_GenSourcesDirect;
+        palDeleteSourcesDirect = wrap_DeleteSourcesDirect;
+        palSourcefDirect = wrap_SourcefDirect;
+        palSource3fDirect = wrap_Source3fDirect;
+        palSourcefvDirect = wrap_SourcefvDirect;
+        palSourceiDirect = wrap_SourceiDirect;
+        palGetSourceiDirect = wrap_GetSourceiDirect;
+        palGetSourcedvDirectSOFT = wrap_GetSourcedvDirect;
+        palGetSourcei64vDirectSOFT = wrap_GetSourcei64vDirect;
+        palSourcePlayDirect = wrap_SourcePlayDirect;
+        palSourcePlayvDirect = wrap_SourcePlayvDirect;
+        palSourceStopDirect = wrap_SourceStopDirect;
+        palSourceRewindDirect = wrap_SourceRewindDirect;
+        palSourcePauseDirect = wrap_SourcePauseDirect;
+        palSourceQueueBuffersDirect = wrap_SourceQueueBuffersDirect;
+        palSourceUnqueueBuffersDirect = wrap_SourceUnqueueBuffersDirect;
+        palGenBuffersDirect = wrap_GenBuffersDirect;
+        palDeleteBuffersDirect = wrap_DeleteBuffersDirect;
+        palBufferDataDirect = wrap_BufferDataDirect;
+        palDeferUpdatesDirectSOFT = wrap_DeferUpdatesDirect;
+        palProcessUpdatesDirectSOFT = wrap_ProcessUpdatesDirect;
+        palBufferStorageDirectSOFT = wrap_BufferStorageDirect;
+        palMapBufferDirectSOFT = wrap_MapBufferDirect;
+        palUnmapBufferDirectSOFT = wrap_UnmapBufferDirect;
+        palFlushMappedBufferDirectSOFT = wrap_FlushMappedBufferDirect;
+        palSourcePlayAtTimevDirectSOFT = wrap_SourcePlayAtTimevDirect;
+        pEAXSetDirect = wrap_EAXSetDirect;
+        pEAXGetDirect = wrap_EAXGetDirect;
+    }
+
     local_contexts = alcIsExtensionPresent(NULL, "ALC_EXT_thread_local_context");
     if(local_contexts)
     {
@@ -390,7 +796,16 @@ static BOOL load_libopenal(void)
         set_context = alcMakeContextCurrent;
         get_context = alcGetCurrentContext;
     }
-    else
+
+    /* With direct contexts, every AL call is given its context explicitly so
+     * there's nothing to set or lock for a section.
+     */
+    if(direct_contexts)
+    {
+        EnterALSection = EnterALSectionDirect;
+        LeaveALSection = LeaveALSectionDirect;
+    }
+    else if(local_contexts)
     {
         EnterALSection = EnterALSectionTLS;
         LeaveALSection = LeaveALSectionTLS;
@@ -417,18 +832,95 @@ static void LeaveALSectionTLS(void)
 {
 }
 
+/* Drops a registration, waking a thread waiting to switch the context. */
+static void glob_release(void)
+{
+    if(InterlockedDecrement(&glob_users) == 0 && glob_waiting)
+        SetEvent(glob_idle_evt);
+}
+
+/* Waits for all sections using the current global context to leave, and
+ * prevents new ones from using it. Must be called with openal_crst held, by a
+ * thread not registered as a user.
+ */
+void UnsetALContextGlob(void)
+{
+    InterlockedExchangePointer((void*volatile*)&glob_ctx, NULL);
+    if(*(volatile LONG*)&glob_users > 0)
+    {
+        ++glob_waits;
+        InterlockedExchange(&glob_waiting, TRUE);
+        /* The event may be left signaled by an earlier release, so recheck. */
+        while(*(volatile LONG*)&glob_users > 0)
+            WaitForSingleObject(glob_idle_evt, INFINITE);
+        InterlockedExchange(&glob_waiting, FALSE);
+    }
+}
+
 static void EnterALSectionGlob(ALCcontext *ctx)
 {
-    EnterCriticalSection(&openal_crst);
-    if(UNLIKELY(alcMakeContextCurrent(ctx) == ALC_FALSE))
+    LONG_PTR depth = (LONG_PTR)TlsGetValue(GlobDepthTls);
+
+    TlsSetValue(GlobDepthTls, (void*)(depth+1));
+    if(depth > 0)
     {
-        ERR("Couldn't set current context!!\n");
-        checkALCError(alcGetContextsDevice(ctx));
+        /* Already registered, so the current context can't have changed. */
+        if(LIKELY(glob_cur == ctx))
+            return;
+        /* Nested on another context. Give up the outer registration so a
+         * thread waiting to switch can't block on this one, then switch like
+         * an outer section would. As before, the outer section continues on
+         * the new context.
+         */
+        glob_release();
     }
+    else
+    {
+        /* Register as a user first, then check the context. A thread changing
+         * the context clears glob_ctx before waiting for the users to leave,
+         * so either it sees this user or this sees the change.
+         */
+        InterlockedIncrement(&glob_users);
+        if(LIKELY(glob_ctx == ctx))
+            return;
+        glob_release();
+    }
+
+    if(!TryEnterCriticalSection(&openal_crst))
+    {
+        EnterCriticalSection(&openal_crst);
+        ++glob_contended;
+    }
+    if(glob_ctx != ctx)
+    {
+        UnsetALContextGlob();
+        if(UNLIKELY(alcMakeContextCurrent(ctx) == ALC_FALSE))
+        {
+            ERR("Couldn't set current context!!\n");
+            checkALCError(alcGetContextsDevice(ctx));
+        }
+        glob_cur = ctx;
+        ++glob_switches;
+    }
+    InterlockedIncrement(&glob_users);
+    InterlockedExchangePointer((void*volatile*)&glob_ctx, ctx);
+    LeaveCriticalSection(&openal_crst);
 }
 static void LeaveALSectionGlob(void)
 {
-    LeaveCriticalSection(&openal_crst);
+    LONG_PTR depth = (LONG_PTR)TlsGetValue(GlobDepthTls);
+
+    TlsSetValue(GlobDepthTls, (void*)(depth-1));
+    if(depth == 1)
+        glob_release();
+}
+
+static void EnterALSectionDirect(ALCcontext *ctx)
+{
+    (void)ctx;
+}
+static void LeaveALSectionDirect(void)
+{
 }
 
 
@@ -1371,6 +1863,8 @@ DECLSPEC_EXPORT BOOL WINAPI DllMain(HINSTANCE hInstDLL, DWORD fdwReason, LPVOID
         if(!load_libopenal())
             return FALSE;
         TlsThreadPtr = TlsAlloc();
+        GlobDepthTls = TlsAlloc();
+        glob_idle_evt = CreateEventW(NULL, FALSE, FALSE, NULL);
         InitializeCriticalSection(&openal_crst);
         /* Increase refcount on dsound by 1 */
         GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS, (LPCWSTR)hInstDLL, &hInstDLL);
@@ -1380,6 +1874,7 @@ DECLSPEC_EXPORT BOOL WINAPI DllMain(HINSTANCE hInstDLL, DWORD fdwReason, LPVOID
         break;
 
     case DLL_THREAD_DETACH:
+        AsyncLog_ThreadDetach();
         break;
 
     case DLL_PROCESS_DETACH:
@@ -1390,9 +1885,24 @@ DECLSPEC_EXPORT BOOL WINAPI DllMain(HINSTANCE hInstDLL, DWORD fdwReason, LPVOID
         CaptureDevices.Guids = NULL;
         CaptureDevices.Count = 0;
 
+        if(EnterALSection == EnterALSectionGlob)
+            TRACE("AL context switches: %ld, contended: %ld, waits: %ld\n",
+                  glob_switches, glob_contended, glob_waits);
+        /* Write out the queued messages before the reports go directly to
+         * the log.
+         */
+        ApiTrace_Shutdown();
+        AsyncLog_Shutdown();
+        LockStats_Dump();
+
         if(openal_handle)
             FreeLibrary(openal_handle);
         TlsFree(TlsThreadPtr);
+        TlsFree(GlobDepthTls);
+        if(glob_idle_evt)
+            CloseHandle(glob_idle_evt);
+        if(MixStatsTls != TLS_OUT_OF_INDEXES)
+            TlsFree(MixStatsTls);
         DeleteCriticalSection(&openal_crst);
         if(LogFile != stderr)
             fclose(LogFile);
@@ -40,6 +40,10 @@
 #include "alext.h"
 
 #include "eax.h"
+#include "livestats.h"
+#include "bufstats.h"
+#include "apitrace.h"
+#include "dscore.h"
 
 #ifndef AL_SOFT_map_buffer
 #define AL_SOFT_map_buffer 1
@@ -54,6 +58,13 @@ typedef void (AL_APIENTRY*LPALUNMAPBUFFERSOFT)(ALuint buffer);
 typedef void (AL_APIENTRY*LPALFLUSHMAPPEDBUFFERSOFT)(ALuint buffer, ALsizei offset, ALsizei length);
 #endif
 
+#ifndef AL_SOFT_source_start_delay
+#define AL_SOFT_source_start_delay 1
+typedef void (AL_APIENTRY*LPALSOURCEPLAYATTIMESOFT)(ALuint source, ALint64SOFT start_time);
+typedef void (AL_APIENTRY*LPALSOURCEPLAYATTIMEVSOFT)(ALsizei n, const ALuint *sources, ALint64SOFT start_time);
+typedef void (AL_APIENTRY*LPALSOURCEPLAYATTIMEVDIRECTSOFT)(ALCcontext *context, ALsizei n, const ALuint *sources, ALint64SOFT start_time);
+#endif
+
 
 #ifdef __GNUC__
 #define LIKELY(x) __builtin_expect(!!(x), !0)
@@ -66,10 +77,50 @@ typedef void (AL_APIENTRY*LPALFLUSHMAPPEDBUFFERSOFT)(ALuint buffer, ALsizei offs
 
 extern int LogLevel;
 extern FILE *LogFile;
+/* Safety margin, in milliseconds, kept between the mixing position and the
+ * reported write cursor.
+ */
+extern DWORD WriteMargin;
+/* Whether capture reads are put off while no notification is near. */
+extern BOOL CaptureChunks;
+/* Loopback render output (DSOAL_LOOPBACK), either a WAV file path or "1" to
+ * render to memory only. Empty when devices are opened normally.
+ */
+extern char LoopbackOutput[MAX_PATH];
+/* How many times faster than real time to render in loopback mode, or 0 for
+ * as fast as possible.
+ */
+extern DWORD LoopbackSpeed;
 
-#define DO_PRINT(a, ...) do {         \
-    fprintf(LogFile, a, __VA_ARGS__); \
-    fflush(LogFile);                  \
+/* Asynchronous logging, enabled with DSOAL_LOGASYNC. Each DO_PRINT has its
+ * own LogSite, which caches the argument types parsed from the format.
+ */
+#define ASYNCLOG_MAX_ARGS 12
+
+typedef struct LogSite {
+    const char *fmt;
+    volatile LONG state;
+    BYTE nargs;
+    BYTE types[ASYNCLOG_MAX_ARGS];
+} LogSite;
+
+extern BOOL AsyncLogEnabled;
+void AsyncLog_Init(void);
+void AsyncLog_Write(LogSite *site, ...);
+void AsyncLog_ThreadDetach(void);
+void AsyncLog_Shutdown(void);
+
+#define DO_PRINT(a, ...) do {                   \
+    if(AsyncLogEnabled)                         \
+    {                                           \
+        static LogSite log_site = { a };        \
+        AsyncLog_Write(&log_site, __VA_ARGS__); \
+    }                                           \
+    else                                        \
+    {                                           \
+        fprintf(LogFile, a, __VA_ARGS__);       \
+        fflush(LogFile);                        \
+    }                                           \
 } while(0)
 
 #ifdef _MSC_VER
@@ -411,6 +462,12 @@ extern LPALBUFFERSTORAGESOFT palBufferStorageSOFT;
 extern LPALMAPBUFFERSOFT palMapBufferSOFT;
 extern LPALUNMAPBUFFERSOFT palUnmapBufferSOFT;
 extern LPALFLUSHMAPPEDBUFFERSOFT palFlushMappedBufferSOFT;
+extern LPALSOURCEPLAYATTIMEVSOFT palSourcePlayAtTimevSOFT;
+extern LPALGETSOURCEDVSOFT palGetSourcedvSOFT;
+extern LPALGETSOURCEI64VSOFT palGetSourcei64vSOFT;
+extern LPALCGETINTEGER64VSOFT palcGetInteger64vSOFT;
+extern LPALCLOOPBACKOPENDEVICESOFT palcLoopbackOpenDeviceSOFT;
+extern LPALCRENDERSAMPLESSOFT palcRenderSamplesSOFT;
 
 #define EAXSet pEAXSet
 #define EAXGet pEAXGet
@@ -420,6 +477,137 @@ extern LPALFLUSHMAPPEDBUFFERSOFT palFlushMappedBufferSOFT;
 #define alMapBufferSOFT palMapBufferSOFT
 #define alUnmapBufferSOFT palUnmapBufferSOFT
 #define alFlushMappedBufferSOFT palFlushMappedBufferSOFT
+#define alSourcePlayAtTimevSOFT palSourcePlayAtTimevSOFT
+#define alGetSourcedvSOFT palGetSourcedvSOFT
+#define alGetSourcei64vSOFT palGetSourcei64vSOFT
+#define alcGetInteger64vSOFT palcGetInteger64vSOFT
+#define alcLoopbackOpenDeviceSOFT palcLoopbackOpenDeviceSOFT
+#define alcRenderSamplesSOFT palcRenderSamplesSOFT
+
+/* Direct context functions (ALC_EXT_direct_context). These take the context
+ * as an explicit parameter, so calls don't depend on which context is current.
+ * When the extension isn't available they're set to wrappers that ignore the
+ * context parameter, and setALContext must still be used around them.
+ */
+#ifndef ALC_EXT_direct_context
+#define ALC_EXT_direct_context 1
+typedef ALCvoid* (ALC_APIENTRY*LPALCGETPROCADDRESS2)(ALCdevice *device, const ALCchar *funcname);
+typedef ALenum (AL_APIENTRY*LPALGETERRORDIRECT)(ALCcontext *context);
+typedef ALboolean (AL_APIENTRY*LPALISEXTENSIONPRESENTDIRECT)(ALCcontext *context, const ALchar *extname);
+typedef ALenum (AL_APIENTRY*LPALGETENUMVALUEDIRECT)(ALCcontext *context, const ALchar *ename);
+typedef void (AL_APIENTRY*LPALDOPPLERFACTORDIRECT)(ALCcontext *context, ALfloat value);
+typedef void (AL_APIENTRY*LPALSPEEDOFSOUNDDIRECT)(ALCcontext *context, ALfloat value);
+typedef void (AL_APIENTRY*LPALLISTENERFDIRECT)(ALCcontext *context, ALenum param, ALfloat value);
+typedef void (AL_APIENTRY*LPALLISTENER3FDIRECT)(ALCcontext *context, ALenum param, ALfloat value1, ALfloat value2, ALfloat value3);
+typedef void (AL_APIENTRY*LPALLISTENERFVDIRECT)(ALCcontext *context, ALenum param, const ALfloat *values);
+typedef void (AL_APIENTRY*LPALGETLISTENERFDIRECT)(ALCcontext *context, ALenum param, ALfloat *value);
+typedef void (AL_APIENTRY*LPALGENSOURCESDIRECT)(ALCcontext *context, ALsizei n, ALuint *sources);
+typedef void (AL_APIENTRY*LPALDELETESOURCESDIRECT)(ALCcontext *context, ALsizei n, const ALuint *sources);
+typedef void (AL_APIENTRY*LPALSOURCEFDIRECT)(ALCcontext *context, ALuint source, ALenum param, ALfloat value);
+typedef void (AL_APIENTRY*LPALSOURCE3FDIRECT)(ALCcontext *context, ALuint source, ALenum param, ALfloat value1, ALfloat value2, ALfloat value3);
+typedef void (AL_APIENTRY*LPALSOURCEFVDIRECT)(ALCcontext *context, ALuint source, ALenum param, const ALfloat *values);
+typedef void (AL_APIENTRY*LPALSOURCEIDIRECT)(ALCcontext *context, ALuint source, ALenum param, ALint value);
+typedef void (AL_APIENTRY*LPALGETSOURCEIDIRECT)(ALCcontext *context, ALuint source, ALenum param, ALint *value);
+typedef void (AL_APIENTRY*LPALGETSOURCEDVDIRECTSOFT)(ALCcontext *context, ALuint source, ALenum param, ALdouble *values);
+typedef void (AL_APIENTRY*LPALGETSOURCEI64VDIRECTSOFT)(ALCcontext *context, ALuint source, ALenum param, ALint64SOFT *values);
+typedef void (AL_APIENTRY*LPALSOURCEPLAYDIRECT)(ALCcontext *context, ALuint source);
+typedef void (AL_APIENTRY*LPALSOURCEPLAYVDIRECT)(ALCcontext *context, ALsizei n, const ALuint *sources);
+typedef void (AL_APIENTRY*LPALSOURCESTOPDIRECT)(ALCcontext *context, ALuint source);
+typedef void (AL_APIENTRY*LPALSOURCEREWINDDIRECT)(ALCcontext *context, ALuint source);
+typedef void (AL_APIENTRY*LPALSOURCEPAUSEDIRECT)(ALCcontext *context, ALuint source);
+typedef void (AL_APIENTRY*LPALSOURCEQUEUEBUFFERSDIRECT)(ALCcontext *context, ALuint source, ALsizei nb, const ALuint *buffers);
+typedef void (AL_APIENTRY*LPALSOURCEUNQUEUEBUFFERSDIRECT)(ALCcontext *context, ALuint source, ALsizei nb, ALuint *buffers);
+typedef void (AL_APIENTRY*LPALGENBUFFERSDIRECT)(ALCcontext *context, ALsizei n, ALuint *buffers);
+typedef void (AL_APIENTRY*LPALDELETEBUFFERSDIRECT)(ALCcontext *context, ALsizei n, const ALuint *buffers);
+typedef void (AL_APIENTRY*LPALBUFFERDATADIRECT)(ALCcontext *context, ALuint buffer, ALenum format, const ALvoid *data, ALsizei size, ALsizei freq);
+typedef void (AL_APIENTRY*LPALDEFERUPDATESDIRECTSOFT)(ALCcontext *context);
+typedef void (AL_APIENTRY*LPALPROCESSUPDATESDIRECTSOFT)(ALCcontext *context);
+typedef void (AL_APIENTRY*LPALBUFFERSTORAGEDIRECTSOFT)(ALCcontext *context, ALuint buffer, ALenum format, const ALvoid *data, ALsizei size, ALsizei freq, ALbitfieldSOFT flags);
+typedef void* (AL_APIENTRY*LPALMAPBUFFERDIRECTSOFT)(ALCcontext *context, ALuint buffer, ALsizei offset, ALsizei length, ALbitfieldSOFT access);
+typedef void (AL_APIENTRY*LPALUNMAPBUFFERDIRECTSOFT)(ALCcontext *context, ALuint buffer);
+typedef void (AL_APIENTRY*LPALFLUSHMAPPEDBUFFERDIRECTSOFT)(ALCcontext *context, ALuint buffer, ALsizei offset, ALsizei length);
+typedef ALenum (AL_APIENTRY*LPEAXSETDIRECT)(ALCcontext *context, const GUID *property_set_id, ALuint property_id, ALuint property_source_id, ALvoid *property_buffer, ALuint property_size);
+typedef ALenum (AL_APIENTRY*LPEAXGETDIRECT)(ALCcontext *context, const GUID *property_set_id, ALuint property_id, ALuint property_source_id, ALvoid *property_buffer, ALuint property_size);
+#endif
+
+extern BOOL direct_contexts;
+extern LPALGETERRORDIRECT palGetErrorDirect;
+extern LPALISEXTENSIONPRESENTDIRECT palIsExtensionPresentDirect;
+extern LPALGETENUMVALUEDIRECT palGetEnumValueDirect;
+extern LPALDOPPLERFACTORDIRECT palDopplerFactorDirect;
+extern LPALSPEEDOFSOUNDDIRECT palSpeedOfSoundDirect;
+extern LPALLISTENERFDIRECT palListenerfDirect;
+extern LPALLISTENER3FDIRECT palListener3fDirect;
+extern LPALLISTENERFVDIRECT palListenerfvDirect;
+extern LPALGETLISTENERFDIRECT palGetListenerfDirect;
+extern LPALGENSOURCESDIRECT palGenSourcesDirect;
+extern LPALDELETESOURCESDIRECT palDeleteSourcesDirect;
+extern LPALSOURCEFDIRECT palSourcefDirect;
+extern LPALSOURCE3FDIRECT palSource3fDirect;
+extern LPALSOURCEFVDIRECT palSourcefvDirect;
+extern LPALSOURCEIDIRECT palSourceiDirect;
+extern LPALGETSOURCEIDIRECT palGetSourceiDirect;
+extern LPALGETSOURCEDVDIRECTSOFT palGetSourcedvDirectSOFT;
+extern LPALGETSOURCEI64VDIRECTSOFT palGetSourcei64vDirectSOFT;
+extern LPALSOURCEPLAYDIRECT palSourcePlayDirect;
+extern LPALSOURCEPLAYVDIRECT palSourcePlayvDirect;
+extern LPALSOURCESTOPDIRECT palSourceStopDirect;
+extern LPALSOURCEREWINDDIRECT palSourceRewindDirect;
+extern LPALSOURCEPAUSEDIRECT palSourcePauseDirect;
+extern LPALSOURCEQUEUEBUFFERSDIRECT palSourceQueueBuffersDirect;
+extern LPALSOURCEUNQUEUEBUFFERSDIRECT palSourceUnqueueBuffersDirect;
+extern LPALGENBUFFERSDIRECT palGenBuffersDirect;
+extern LPALDELETEBUFFERSDIRECT palDeleteBuffersDirect;
+extern LPALBUFFERDATADIRECT palBufferDataDirect;
+extern LPALDEFERUPDATESDIRECTSOFT palDeferUpdatesDirectSOFT;
+extern LPALPROCESSUPDATESDIRECTSOFT palProcessUpdatesDirectSOFT;
+extern LPALBUFFERSTORAGEDIRECTSOFT palBufferStorageDirectSOFT;
+extern LPALMAPBUFFERDIRECTSOFT palMapBufferDirectSOFT;
+extern LPALUNMAPBUFFERDIRECTSOFT palUnmapBufferDirectSOFT;
+extern LPALFLUSHMAPPEDBUFFERDIRECTSOFT palFlushMappedBufferDirectSOFT;
+extern LPALSOURCEPLAYATTIMEVDIRECTSOFT palSourcePlayAtTimevDirectSOFT;
+extern LPEAXSETDIRECT pEAXSetDirect;
+extern LPEAXGETDIRECT pEAXGetDirect;
+
+/* Calls through the Direct entry points are counted for the mixer profile. */
+#define AL_COUNTED(f) ((UNLIKELY(MixStatsEnabled) ? MixStats_CountALCall() : (void)0), f)
+#define alGetErrorDirect AL_COUNTED(palGetErrorDirect)
+#define alIsExtensionPresentDirect AL_COUNTED(palIsExtensionPresentDirect)
+#define alGetEnumValueDirect AL_COUNTED(palGetEnumValueDirect)
+#define alDopplerFactorDirect AL_COUNTED(palDopplerFactorDirect)
+#define alSpeedOfSoundDirect AL_COUNTED(palSpeedOfSoundDirect)
+#define alListenerfDirect AL_COUNTED(palListenerfDirect)
+#define alListener3fDirect AL_COUNTED(palListener3fDirect)
+#define alListenerfvDirect AL_COUNTED(palListenerfvDirect)
+#define alGetListenerfDirect AL_COUNTED(palGetListenerfDirect)
+#define alGenSourcesDirect AL_COUNTED(palGenSourcesDirect)
+#define alDeleteSourcesDirect AL_COUNTED(palDeleteSourcesDirect)
+#define alSourcefDirect AL_COUNTED(palSourcefDirect)
+#define alSource3fDirect AL_COUNTED(palSource3fDirect)
+#define alSourcefvDirect AL_COUNTED(palSourcefvDirect)
+#define alSourceiDirect AL_COUNTED(palSourceiDirect)
+#define alGetSourceiDirect AL_COUNTED(palGetSourceiDirect)
+#define alGetSourcedvDirectSOFT AL_COUNTED(palGetSourcedvDirectSOFT)
+#define alGetSourcei64vDirectSOFT AL_COUNTED(palGetSourcei64vDirectSOFT)
+#define alSourcePlayDirect AL_COUNTED(palSourcePlayDirect)
+#define alSourcePlayvDirect AL_COUNTED(palSourcePlayvDirect)
+#define alSourceStopDirect AL_COUNTED(palSourceStopDirect)
+#define alSourceRewindDirect AL_COUNTED(palSourceRewindDirect)
+#define alSourcePauseDirect AL_COUNTED(palSourcePauseDirect)
+#define alSourceQueueBuffersDirect AL_COUNTED(palSourceQueueBuffersDirect)
+#define alSourceUnqueueBuffersDirect AL_COUNTED(palSourceUnqueueBuffersDirect)
+#define alGenBuffersDirect AL_COUNTED(palGenBuffersDirect)
+#define alDeleteBuffersDirect AL_COUNTED(palDeleteBuffersDirect)
+#define alBufferDataDirect AL_COUNTED(palBufferDataDirect)
+#define alDeferUpdatesDirectSOFT AL_COUNTED(palDeferUpdatesDirectSOFT)
+#define alProcessUpdatesDirectSOFT AL_COUNTED(palProcessUpdatesDirectSOFT)
+#define alBufferStorageDirectSOFT AL_COUNTED(palBufferStorageDirectSOFT)
+#define alMapBufferDirectSOFT AL_COUNTED(palMapBufferDirectSOFT)
+#define alUnmapBufferDirectSOFT AL_COUNTED(palUnmapBufferDirectSOFT)
+#define alFlushMappedBufferDirectSOFT AL_COUNTED(palFlushMappedBufferDirectSOFT)
+#define alSourcePlayAtTimevDirectSOFT AL_COUNTED(palSourcePlayAtTimevDirectSOFT)
+#define EAXSetDirect AL_COUNTED(pEAXSetDirect)
+#define EAXGetDirect AL_COUNTED(pEAXGetDirect)
 
 
 #ifndef E_PROP_ID_UNSUPPORTED
@@ -461,6 +649,7 @@ extern BOOL local_contexts;
 extern DWORD TlsThreadPtr;
 extern void (*EnterALSection)(ALCcontext *ctx);
 extern void (*LeaveALSection)(void);
+void UnsetALContextGlob(void);
 
 
 typedef struct DSDevice DSDevice;
@@ -475,6 +664,9 @@ enum {
     SOFT_DEFERRED_UPDATES,
     SOFT_SOURCE_SPATIALIZE,
     SOFTX_MAP_BUFFER,
+    SOFT_SOURCE_START_DELAY,
+    SOFT_DEVICE_CLOCK,
+    SOFT_SOURCE_LATENCY,
 
     MAX_EXTENSIONS
 };
@@ -505,15 +697,89 @@ typedef struct DeviceShare {
     ALboolean Exts[BITFIELD_ARRAY_SIZE(MAX_EXTENSIONS)];
 
     CRITICAL_SECTION crst;
+    /* Guards the committed 3D listener/buffer parameters and the primary
+     * format, so getters can read them in shared mode instead of waiting on
+     * crst. Writers must also hold crst.
+     */
+    SRWLOCK params_lock;
+    /* Recursion depth and entry time of the outermost crst owner, for lock
+     * statistics. Only accessed with crst held.
+     */
+    LONG crst_depth;
+    LONGLONG crst_start;
 
     SourceCollection sources;
 
     HANDLE thread_hdl;
     DWORD thread_id;
 
+    /* The mixer timer only runs while there's something to mix. It's parked
+     * when a pass finds nothing playing, no notifications and no batched
+     * starts, and re-armed by Play. Only changed with crst held.
+     */
     HANDLE queue_timer;
     HANDLE timer_evt;
     volatile LONG quit_now;
+    struct {
+        DWORD parks;
+        DWORD rearms;
+    } timer_stats;
+
+    /* Loopback rendering. The mixer thread renders one update per tick, so
+     * the device's clock (loopback_frames) is virtual and everything that
+     * follows source offsets follows it. In unthrottled mode there's no
+     * timer, and loopback_running says whether the thread should keep going.
+     */
+    BOOL loopback;
+    FILE *loopback_file;
+    ALshort *loopback_buf;
+    ALCint loopback_freq;
+    DWORD loopback_update;
+    ULONGLONG loopback_frames;
+    volatile LONG loopback_running;
+
+    /* The mixer tick is processed in slices, releasing crst in between. Work
+     * left over when a tick runs out of time carries over to the next one.
+     * The cursor and stats are only accessed by the mixer thread, aside from
+     * the final report after it quits.
+     */
+    LONGLONG tick_budget;
+    LONGLONG tick_freq;
+    ALsizei tick_prim;
+    BOOL tick_streaming;
+    DWORD tick_pos;
+    struct {
+        DWORD ticks;
+        DWORD slices;
+        DWORD carried;
+        LONGLONG max_slice_hold;
+        LONGLONG max_tick_hold;
+        LONGLONG total_hold;
+    } tick_stats;
+
+    /* Streaming buffer underruns and the queue depth changes made for them,
+     * updated with the device lock held.
+     */
+    struct {
+        DWORD underruns;
+        DWORD deepened;
+        DWORD shrunk;
+    } stream_stats;
+
+    /* Mixer thread profile, only allocated when DSOAL_MIXSTATS is set.
+     * mix_alcalls counts the AL calls the mixer thread makes. It only goes
+     * up, so the calls made for some piece of work are the difference.
+     */
+    struct MixStats *mix_stats;
+    DWORD mix_alcalls;
+
+    /* Live statistics block, mapped when DSOAL_LIVESTATS is set. Event
+     * counters are bumped where the events happen, with the device lock held,
+     * and the census and tick timings are stored by the mixer thread.
+     */
+    DSoalLiveStats *live;
+    HANDLE live_map;
+    DWORD live_slot;
 
     ALsizei nprimaries;
     DSPrimary **primaries;
@@ -526,6 +792,120 @@ typedef struct DeviceShare {
 
 #define HAS_EXTENSION(s, e) BITFIELD_TEST((s)->Exts, e)
 
+/* Lock hold time statistics, enabled with DSOAL_LOCKSTATS. Hold times are
+ * recorded per entry point and dumped to the log on unload.
+ */
+extern BOOL LockStatsEnabled;
+void LockStats_Record(const char *func, LONGLONG ticks);
+
+static inline LONGLONG LockStats_Now(void)
+{
+    LARGE_INTEGER now;
+    if(LIKELY(!LockStatsEnabled))
+        return 0;
+    QueryPerformanceCounter(&now);
+    return now.QuadPart;
+}
+
+#define LIVESTATS_ADD(share, field, n) do {   \
+    if(UNLIKELY((share)->live != NULL))         \
+        (share)->live->field += (n);            \
+} while(0)
+
+static inline void DSShare_Lock(DeviceShare *share)
+{
+    if(UNLIKELY(share->live != NULL))
+    {
+        BOOL contended = !TryEnterCriticalSection(&share->crst);
+        if(contended)
+            EnterCriticalSection(&share->crst);
+        if(share->crst_depth == 0)
+        {
+            share->live->lock_acquires++;
+            share->live->lock_contended += contended;
+        }
+    }
+    else
+        EnterCriticalSection(&share->crst);
+    if(share->crst_depth++ == 0)
+        share->crst_start = LockStats_Now();
+}
+
+static inline void DSShare_UnlockFunc(DeviceShare *share, const char *func)
+{
+    if(--share->crst_depth == 0 && UNLIKELY(share->crst_start != 0))
+    {
+        LONGLONG ticks = LockStats_Now() - share->crst_start;
+        share->crst_start = 0;
+        LeaveCriticalSection(&share->crst);
+        LockStats_Record(func, ticks);
+        return;
+    }
+    LeaveCriticalSection(&share->crst);
+}
+#define DSShare_Unlock(s) DSShare_UnlockFunc((s), __FUNCTION__)
+
+/* Shared access to the parameters guarded by params_lock. Returns the start
+ * time to pass to DSShare_UnlockParams.
+ */
+static inline LONGLONG DSShare_LockParams(DeviceShare *share)
+{
+    AcquireSRWLockShared(&share->params_lock);
+    return LockStats_Now();
+}
+
+static inline void DSShare_UnlockParamsFunc(DeviceShare *share, LONGLONG start, const char *func)
+{
+    LONGLONG ticks = start ? LockStats_Now() - start : 0;
+    ReleaseSRWLockShared(&share->params_lock);
+    if(UNLIKELY(start != 0))
+        LockStats_Record(func, ticks);
+}
+#define DSShare_UnlockParams(s, t) DSShare_UnlockParamsFunc((s), (t), __FUNCTION__)
+
+/* Mixer thread profiling, enabled with DSOAL_MIXSTATS. MixStatsTls points to
+ * the calling mixer thread's AL call counter, and is NULL on other threads.
+ */
+extern BOOL MixStatsEnabled;
+extern DWORD MixStatsTls;
+void MixStats_CountALCall(void);
+
+/* Live statistics, published to external monitors with DSOAL_LIVESTATS. */
+extern BOOL LiveStatsEnabled;
+
+/* API call tracing to a file, enabled with DSOAL_APITRACE. Object ids are the
+ * implementation pointers; floats are passed through ApiTrace_Float.
+ */
+extern BOOL ApiTraceEnabled;
+void ApiTrace_Init(const char *path);
+void ApiTrace_Record(WORD call, HRESULT hr, const void *object, const void *object2,
+    const void *payload, DWORD payload_size, DWORD nargs, ...);
+void ApiTrace_RecordUnlock(const void *object, HRESULT hr, const BYTE *base,
+    const void *ptr1, DWORD len1, const void *ptr2, DWORD len2);
+void ApiTrace_Shutdown(void);
+
+static inline DWORD ApiTrace_Float(float f)
+{
+    union { float f; DWORD d; } u;
+    u.f = f;
+    return u.d;
+}
+
+/* The size of a format as the app passed it, for recording. PCM formats may
+ * be a PCMWAVEFORMAT, without cbSize.
+ */
+static inline DWORD ApiTrace_FormatSize(const WAVEFORMATEX *wfx)
+{
+    if(!wfx) return 0;
+    if(wfx->wFormatTag == WAVE_FORMAT_PCM) return sizeof(PCMWAVEFORMAT);
+    return sizeof(*wfx) + wfx->cbSize;
+}
+
+#define APITRACE(...) do {                      \
+    if(UNLIKELY(ApiTraceEnabled))               \
+        ApiTrace_Record(__VA_ARGS__);           \
+} while(0)
+
 
 typedef struct DSData {
     LONG ref;
@@ -543,10 +923,6 @@ typedef struct DSData {
     BYTE *data;
     ALuint bid;
 } DSData;
-/* Amount of buffers that have to be queued when
- * bufferdatastatic and buffersubdata are not available */
-#define QBUFFERS 4
-
 union BufferParamFlags {
     LONG flags;
     struct {
@@ -583,12 +959,45 @@ struct DSBuffer {
     ALsizei data_offset;
     ALsizei queue_base;
     ALsizei curidx;
-    ALuint stream_bids[QBUFFERS];
+    ALuint stream_bids[QBUFFERS_MAX];
+
+    /* Number of segments kept queued, raised when the source runs dry while
+     * playing and lowered again after QBUFFERS_STABLE_MS without that. The
+     * stream_bids ring always cycles through all QBUFFERS_MAX buffers, so the
+     * depth can change with segments still queued.
+     */
+    ALint queue_depth;
+    DWORD underruns;
+    DWORD last_underrun;
+
+    /* Counters for DSPROPSETID_DSOAL_BufferStats. Lock and Unlock don't take
+     * the device lock, so their counters are updated with interlocked adds.
+     * The rest are updated with the device lock held.
+     */
+    struct {
+        ULONGLONG bytes_streamed;
+        DWORD buffer_data_calls;
+        DWORD notifications;
+        DWORD mixer_al_calls;
+        volatile LONG lock_calls;
+        volatile LONGLONG lock_time;
+    } stats;
 
     BOOL init_done : 1;
     BOOL isplaying : 1;
     BOOL islooping : 1;
     BOOL bufferlost : 1;
+    BOOL start_pending : 1;
+
+    /* Play cursor interpolation between mixer updates. clock_lag is the
+     * smallest seen difference between QPC time and the device clock (in
+     * nanoseconds), sampled since clock_lag_time. lastcursor is the last
+     * interpolated play position reported, when cursor_valid is set. These
+     * are only touched with the device lock held.
+     */
+    LONGLONG clock_lag, clock_lag_time;
+    ALsizei lastcursor;
+    BOOL cursor_valid;
 
     /* Must be 0 (deferred, not yet placed), DSBSTATUS_LOCSOFTWARE, or
      * DSBSTATUS_LOCHARDWARE.
@@ -660,6 +1069,13 @@ struct DSPrimary {
     DSBuffer **notifies;
     DWORD nnotifies, sizenotifies;
 
+    /* Static buffers whose start is batched, so they can be started together
+     * with one call. See DSBuffer_Play.
+     */
+    DSBuffer **pending_starts;
+    ALuint *pending_srcs;
+    DWORD npending_starts, sizepending_starts;
+
     ALint primary_idx;
 
     struct {
@@ -672,8 +1088,29 @@ struct DSPrimary {
 
     DWORD NumBufferGroups;
     struct DSBufferGroup *BufferGroups;
+
+    /* Voice census, kept up to date with the device lock held so status and
+     * caps queries don't have to scan every buffer.
+     */
+    DWORD nplaying;
+    DWORD nhw_voices;
+    DWORD nsw_voices;
 };
 
+/* Changes a buffer's playing flag and the primary's census with it. Must be
+ * called with the device lock held.
+ */
+static inline void DSBuffer_SetPlaying(DSBuffer *buf, BOOL playing)
+{
+    if(!buf->isplaying == !playing)
+        return;
+    buf->isplaying = !!playing;
+    if(playing)
+        buf->primary->nplaying++;
+    else
+        buf->primary->nplaying--;
+}
+
 
 /* Device implementation */
 struct DSDevice {
@@ -713,14 +1150,19 @@ DEFINE_GUID(DSPROPSETID_I3DL2_BufferProperties,   0xda0f0521, 0x300a, 0x11d3, 0x
 DEFINE_GUID(DSPROPSETID_VoiceManager, 0x62a69bae, 0xdf9d, 0x11d1, 0x99, 0xa6, 0x00, 0xc0, 0x4f, 0xc9, 0x9d, 0x46);
 
 
+void DSShare_starttimer(DeviceShare *share);
+
 HRESULT DSPrimary_PreInit(DSPrimary *prim, DSDevice *parent);
 void DSPrimary_Clear(DSPrimary *prim);
-void DSPrimary_triggernots(DSPrimary *prim);
-void DSPrimary_streamfeeder(DSPrimary *prim, BYTE *scratch_mem/*2K non-permanent memory*/);
+BOOL DSPrimary_triggernots(DSPrimary *prim, DWORD *pos, DWORD count);
+void DSPrimary_startpending(DSPrimary *prim);
+void DSPrimary_cancelstart(DSPrimary *prim, DSBuffer *buf);
+BOOL DSPrimary_streamfeeder(DSPrimary *prim, DWORD *group, BYTE *scratch_mem/*2K non-permanent memory*/);
 HRESULT WINAPI DSPrimary_Initialize(IDirectSoundBuffer *iface, IDirectSound *ds, const DSBUFFERDESC *desc);
 HRESULT WINAPI DSPrimary3D_CommitDeferredSettings(IDirectSound3DListener *iface);
 
 HRESULT DSBuffer_Create(DSBuffer **ppv, DSPrimary *parent, IDirectSoundBuffer *orig);
+void DSBuffer_stream(DSBuffer *buf, BYTE *scratch_mem/*2K non-permanent memory*/);
 void DSBuffer_Destroy(DSBuffer *buf);
 HRESULT DSBuffer_GetInterface(DSBuffer *buf, REFIID riid, void **ppv);
 void DSBuffer_SetParams(DSBuffer *buffer, const DS3DBUFFER *params, LONG flags);
@@ -745,14 +1187,9 @@ HRESULT VoiceMan_Query(DSBuffer *buf, DWORD propid, ULONG *pTypeSupport);
 HRESULT VoiceMan_Set(DSBuffer *buf, DWORD propid, void *pPropData, ULONG cbPropData);
 HRESULT VoiceMan_Get(DSBuffer *buf, DWORD propid, void *pPropData, ULONG cbPropData, ULONG *pcbReturned);
 
-static inline LONG gain_to_mB(float gain)
-{
-    return (gain > 1e-5f) ? (LONG)(log10f(gain) * 2000.0f) : -10000l;
-}
-static inline float mB_to_gain(float millibels)
-{
-    return (millibels > -10000.0f) ? powf(10.0f, millibels/2000.0f) : 0.0f;
-}
+HRESULT BufStats_Query(DSBuffer *buf, DWORD propid, ULONG *pTypeSupport);
+HRESULT BufStats_Set(DSBuffer *buf, DWORD propid, void *pPropData, ULONG cbPropData);
+HRESULT BufStats_Get(DSBuffer *buf, DWORD propid, void *pPropData, ULONG cbPropData, ULONG *pcbReturned);
 
 static inline LONG clampI(LONG val, LONG minval, LONG maxval)
 {
@@ -782,11 +1219,11 @@ static inline float maxF(float a, float b)
 { return (a > b) ? a : b; }
 
 
-#define checkALError() do {                                                   \
-    ALenum err = alGetError();                                                \
+#define checkALError(ctx) do {                                                \
+    ALenum err = alGetErrorDirect(ctx);                                       \
     if(err != AL_NO_ERROR)                                                    \
         ERR(">>>>>>>>>>>> Received AL error %#x on context %p, %s:%u\n",      \
-            err, get_context(), __FUNCTION__, __LINE__);                      \
+            err, ctx, __FUNCTION__, __LINE__);                                \
 } while (0)
 
 #define checkALCError(dev) do {                                               \
@@ -0,0 +1,99 @@
+/* Live statistics shared with external monitors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef DSOAL_LIVESTATS_H
+#define DSOAL_LIVESTATS_H
+
+/* With DSOAL_LIVESTATS set, each opened device publishes a DSoalLiveStats
+ * block in a named file mapping, "DSOAL_LiveStats.<pid>.<slot>", with slot
+ * ranging from 0 to DSOAL_LIVESTATS_SLOTS-1. A monitor opens the mapping
+ * read-only and polls it.
+ *
+ * Every field is a 32-bit value written with a single aligned store, so a
+ * reader never sees a torn value, though fields may be from different
+ * updates. Counters only go up and wrap around, so readers should take
+ * unsigned differences between samples to get rates. New fields are only
+ * ever added at the end, with the version bumped; readers should check the
+ * magic, and that size covers the fields they use.
+ */
+#define DSOAL_LIVESTATS_MAGIC   0x534c5344 /* "DSLS" */
+#define DSOAL_LIVESTATS_VERSION 1
+#define DSOAL_LIVESTATS_SLOTS   16
+#define DSOAL_LIVESTATS_NAME    "DSOAL_LiveStats.%lu.%lu"
+
+typedef struct DSoalLiveStats {
+    DWORD magic;
+    DWORD version;
+    DWORD size;
+    /* Cleared when the device is closed. The block stays readable as long as
+     * a monitor has it mapped.
+     */
+    volatile DWORD active;
+    GUID device;
+    DWORD refresh;
+
+    /* Incremented after each mixer tick's update. */
+    volatile DWORD updates;
+
+    /* Voice census, summed over the device's primary buffers and updated
+     * every mixer tick. Virtual voices are buffers that don't hold a
+     * hardware or software voice (deferred location, not yet played).
+     */
+    volatile DWORD buffers;
+    volatile DWORD playing;
+    volatile DWORD hw_voices;
+    volatile DWORD sw_voices;
+    volatile DWORD virtual_voices;
+    volatile DWORD hw_sources_max;
+    volatile DWORD hw_sources_free;
+    volatile DWORD sw_sources_max;
+    volatile DWORD sw_sources_free;
+
+    /* Streaming buffers. */
+    volatile DWORD stream_bytes;
+    volatile DWORD stream_refills;
+    volatile DWORD stream_underruns;
+    volatile DWORD stream_deepened;
+    volatile DWORD stream_shrunk;
+
+    /* Mixer thread, times in microseconds. */
+    volatile DWORD ticks;
+    volatile DWORD slices;
+    volatile DWORD carried;
+    volatile DWORD timer_parks;
+    volatile DWORD timer_rearms;
+    volatile DWORD last_tick_us;
+    volatile DWORD max_tick_us;
+    volatile DWORD total_tick_us;
+    volatile DWORD max_hold_us;
+    volatile DWORD total_hold_us;
+
+    /* Notification events signaled. */
+    volatile DWORD notifications;
+
+    /* Outermost acquisitions of the device lock, and how many of those had
+     * to wait for another thread.
+     */
+    volatile DWORD lock_acquires;
+    volatile DWORD lock_contended;
+
+    /* EAX property sets, and how many of those failed. */
+    volatile DWORD eax_sets;
+    volatile DWORD eax_set_errors;
+} DSoalLiveStats;
+
+#endif /* DSOAL_LIVESTATS_H */
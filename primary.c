@@ -66,24 +66,17 @@ static void trigger_elapsed_notifies(DSBuffer *buf, DWORD lastpos, DWORD curpos)
     DSBPOSITIONNOTIFY *not_end = not + buf->nnotify;
     for(;not != not_end;++not)
     {
-        HANDLE event = not->hEventNotify;
         DWORD ofs = not->dwOffset;
 
         if(ofs == (DWORD)DSBPN_OFFSETSTOP)
             continue;
 
-        if(curpos < lastpos) /* Wraparound case */
-        {
-            if(ofs < curpos || ofs >= lastpos)
-            {
-                TRACE("Triggering notification %d from buffer %p\n", (int)(not-buf->notify), buf);
-                SetEvent(event);
-            }
-        }
-        else if(ofs >= lastpos && ofs < curpos) /* Normal case */
+        if(DSCore_Reached(ofs, lastpos, curpos))
         {
             TRACE("Triggering notification %d from buffer %p\n", (int)(not-buf->notify), buf);
-            SetEvent(event);
+            SetEvent(not->hEventNotify);
+            buf->stats.notifications++;
+            LIVESTATS_ADD(buf->share, notifications, 1);
         }
     }
 }
@@ -98,56 +91,71 @@ static void trigger_stop_notifies(DSBuffer *buf)
             continue;
         TRACE("Triggering notification %d from buffer %p\n", (int)(not-buf->notify), buf);
         SetEvent(not->hEventNotify);
+        buf->stats.notifications++;
+        LIVESTATS_ADD(buf->share, notifications, 1);
     }
 }
 
-void DSPrimary_triggernots(DSPrimary *prim)
+/* Checks up to count buffers in the notification list, starting at *pos.
+ * Updates *pos to where the next call should continue and returns TRUE once
+ * the end of the list was reached.
+ */
+BOOL DSPrimary_triggernots(DSPrimary *prim, DWORD *pos, DWORD count)
 {
     DSBuffer **curnot, **endnot;
 
-    curnot = prim->notifies;
-    endnot = curnot + prim->nnotifies;
-    while(curnot != endnot)
+    if(*pos >= prim->nnotifies)
+        return TRUE;
+
+    curnot = prim->notifies + *pos;
+    endnot = prim->notifies + prim->nnotifies;
+    while(curnot != endnot && count-- > 0)
     {
         DSBuffer *buf = *curnot;
         DSData *data = buf->buffer;
         DWORD curpos = buf->lastpos;
+        DWORD alcalls;
         ALint state = 0;
         ALint ofs;
 
-        alGetSourcei(buf->source, AL_BYTE_OFFSET, &ofs);
-        alGetSourcei(buf->source, AL_SOURCE_STATE, &state);
+        /* Not started yet, so nothing to check. */
+        if(buf->start_pending)
+        {
+            curnot++;
+            continue;
+        }
+        alcalls = prim->share->mix_alcalls;
+
+        alGetSourceiDirect(prim->ctx, buf->source, AL_BYTE_OFFSET, &ofs);
+        alGetSourceiDirect(prim->ctx, buf->source, AL_SOURCE_STATE, &state);
         if(buf->segsize == 0)
             curpos = (state == AL_STOPPED) ? data->buf_size : ofs;
         else
         {
-            if(state != AL_STOPPED)
-                curpos = ofs + buf->queue_base;
-            else
+            if(state == AL_STOPPED)
             {
                 ALint queued;
-                alGetSourcei(buf->source, AL_BUFFERS_QUEUED, &queued);
-                curpos = buf->segsize*queued + buf->queue_base;
+                alGetSourceiDirect(prim->ctx, buf->source, AL_BUFFERS_QUEUED, &queued);
+                ofs = buf->segsize*queued;
             }
 
-            if(curpos >= (DWORD)data->buf_size)
+            if(DSCore_StreamPosition(ofs, buf->queue_base, data->buf_size, buf->islooping,
+                                     &curpos))
             {
-                if(buf->islooping)
-                    curpos %= (DWORD)data->buf_size;
-                else if(buf->isplaying)
+                if(buf->isplaying)
                 {
-                    curpos = data->buf_size;
-                    alSourceStop(buf->source);
-                    alSourcei(buf->source, AL_BUFFER, 0);
+                    alSourceStopDirect(prim->ctx, buf->source);
+                    alSourceiDirect(prim->ctx, buf->source, AL_BUFFER, 0);
                     buf->curidx = 0;
-                    buf->isplaying = FALSE;
+                    DSBuffer_SetPlaying(buf, FALSE);
                 }
             }
 
             if(state != AL_PLAYING)
                 state = buf->isplaying ? AL_PLAYING : AL_PAUSED;
         }
-        checkALError();
+        checkALError(prim->ctx);
+        buf->stats.mixer_al_calls += prim->share->mix_alcalls - alcalls;
 
         if(buf->lastpos != curpos)
         {
@@ -159,6 +167,8 @@ void DSPrimary_triggernots(DSPrimary *prim)
             /* Remove this buffer from list and put another at the current
              * position; don't increment i
              */
+            if(buf->segsize == 0)
+                DSBuffer_SetPlaying(buf, FALSE);
             trigger_stop_notifies(buf);
             *curnot = *(--endnot);
             prim->nnotifies--;
@@ -166,87 +176,71 @@ void DSPrimary_triggernots(DSPrimary *prim)
         }
         curnot++;
     }
-    checkALError();
+    checkALError(prim->ctx);
+
+    *pos = (DWORD)(curnot - prim->notifies);
+    return curnot == endnot;
 }
 
-static void do_buffer_stream(DSBuffer *buf, BYTE *scratch_mem)
+/* Starts the sources of all batched Play calls with one call. With
+ * AL_SOFT_source_start_delay, they're scheduled at a common device clock
+ * time, one device update ahead so the mixer hasn't already passed it and
+ * none of them start late relative to the others. Should be called with
+ * critsect held and context set.
+ */
+void DSPrimary_startpending(DSPrimary *prim)
 {
-    DSData *data = buf->buffer;
-    ALint ofs, done = 0, queued = QBUFFERS, state = AL_PLAYING;
-    ALuint which;
+    DeviceShare *share = prim->share;
+    DWORD i, count = prim->npending_starts;
 
-    alGetSourcei(buf->source, AL_BUFFERS_QUEUED, &queued);
-    alGetSourcei(buf->source, AL_SOURCE_STATE, &state);
-    alGetSourcei(buf->source, AL_BUFFERS_PROCESSED, &done);
+    if(!count)
+        return;
 
-    if(done > 0)
+    for(i = 0;i < count;++i)
     {
-        ALuint bids[QBUFFERS];
-        queued -= done;
-
-        alSourceUnqueueBuffers(buf->source, done, bids);
-        buf->queue_base = (buf->queue_base + buf->segsize*done) % data->buf_size;
+        prim->pending_srcs[i] = prim->pending_starts[i]->source;
+        prim->pending_starts[i]->start_pending = FALSE;
     }
-    while(queued < QBUFFERS)
-    {
-        which = buf->stream_bids[buf->curidx];
-        ofs = buf->data_offset;
+    prim->npending_starts = 0;
 
-        if(buf->segsize < data->buf_size - ofs)
-        {
-            alBufferData(which, data->buf_format, data->data + ofs, buf->segsize,
-                         data->format.Format.nSamplesPerSec);
-            buf->data_offset = ofs + buf->segsize;
-        }
-        else if(buf->islooping)
-        {
-            ALsizei rem = data->buf_size - ofs;
-            if(rem > 2048) rem = 2048;
+    TRACE("Starting %lu batched sources\n", count);
+    if(HAS_EXTENSION(share, SOFT_SOURCE_START_DELAY) && HAS_EXTENSION(share, SOFT_DEVICE_CLOCK))
+    {
+        ALCint64SOFT clock = 0;
+        alcGetInteger64vSOFT(share->device, ALC_DEVICE_CLOCK_SOFT, 1, &clock);
+        clock += 1000000000 / prim->refresh;
+        alSourcePlayAtTimevDirectSOFT(prim->ctx, count, prim->pending_srcs, clock);
+    }
+    else
+        alSourcePlayvDirect(prim->ctx, count, prim->pending_srcs);
+    checkALError(prim->ctx);
+}
 
-            memcpy(scratch_mem, data->data + ofs, rem);
-            while(rem < buf->segsize)
-            {
-                ALsizei todo = buf->segsize - rem;
-                if(todo > data->buf_size)
-                    todo = data->buf_size;
-                memcpy(scratch_mem + rem, data->data, todo);
-                rem += todo;
-            }
-            alBufferData(which, data->buf_format, scratch_mem, buf->segsize,
-                         data->format.Format.nSamplesPerSec);
-            buf->data_offset = (ofs+buf->segsize) % data->buf_size;
-        }
-        else
-        {
-            ALsizei rem = data->buf_size - ofs;
-            if(rem > 2048) rem = 2048;
-            if(rem == 0) break;
-
-            memcpy(scratch_mem, data->data + ofs, rem);
-            memset(scratch_mem+rem, (data->format.Format.wBitsPerSample==8) ? 128 : 0,
-                   buf->segsize - rem);
-            alBufferData(which, data->buf_format, scratch_mem, buf->segsize,
-                         data->format.Format.nSamplesPerSec);
-            buf->data_offset = data->buf_size;
-        }
+/* Removes a buffer from the batched starts. Should be called with critsect
+ * held.
+ */
+void DSPrimary_cancelstart(DSPrimary *prim, DSBuffer *buf)
+{
+    DWORD i;
 
-        alSourceQueueBuffers(buf->source, 1, &which);
-        buf->curidx = (buf->curidx+1)%QBUFFERS;
-        queued++;
-    }
+    if(!buf->start_pending)
+        return;
+    buf->start_pending = FALSE;
 
-    if(!queued)
+    for(i = 0;i < prim->npending_starts;++i)
     {
-        buf->data_offset = 0;
-        buf->queue_base = data->buf_size;
-        buf->curidx = 0;
-        buf->isplaying = FALSE;
+        if(prim->pending_starts[i] == buf)
+        {
+            prim->pending_starts[i] = prim->pending_starts[--prim->npending_starts];
+            break;
+        }
     }
-    else if(state != AL_PLAYING)
-        alSourcePlay(buf->source);
 }
 
-void DSPrimary_streamfeeder(DSPrimary *prim, BYTE *scratch_mem)
+/* Feeds the streaming buffers of the buffer group at *group, and advances
+ * *group. Returns TRUE once all groups were handled.
+ */
+BOOL DSPrimary_streamfeeder(DSPrimary *prim, DWORD *group, BYTE *scratch_mem)
 {
     /* OpenAL doesn't support our lovely buffer extensions so just make sure
      * enough buffers are queued for streaming
@@ -255,27 +249,31 @@ void DSPrimary_streamfeeder(DSPrimary *prim, BYTE *scratch_mem)
     {
         DSBuffer *buf = CONTAINING_RECORD(prim->write_emu, DSBuffer, IDirectSoundBuffer8_iface);
         if(buf->segsize != 0 && buf->isplaying)
-            do_buffer_stream(buf, scratch_mem);
+            DSBuffer_stream(buf, scratch_mem);
+        *group = 0;
     }
-    else
+    else if(*group < prim->NumBufferGroups)
     {
-        struct DSBufferGroup *bufgroup = prim->BufferGroups;
-        struct DSBufferGroup *endgroup = bufgroup + prim->NumBufferGroups;
-        for(;bufgroup != endgroup;++bufgroup)
+        struct DSBufferGroup *bufgroup = prim->BufferGroups + *group;
+        DWORD64 usemask = ~bufgroup->FreeBuffers;
+        while(usemask)
         {
-            DWORD64 usemask = ~bufgroup->FreeBuffers;
-            while(usemask)
-            {
-                int idx = CTZ64(usemask);
-                DSBuffer *buf = bufgroup->Buffers + idx;
-                usemask &= ~(U64(1) << idx);
+            int idx = CTZ64(usemask);
+            DSBuffer *buf = bufgroup->Buffers + idx;
+            usemask &= ~(U64(1) << idx);
 
-                if(buf->segsize != 0 && buf->isplaying)
-                    do_buffer_stream(buf, scratch_mem);
-            }
+            if(buf->segsize != 0 && buf->isplaying)
+                DSBuffer_stream(buf, scratch_mem);
+        }
+        if(++*group < prim->NumBufferGroups)
+        {
+            checkALError(prim->ctx);
+            return FALSE;
         }
+        *group = 0;
     }
-    checkALError();
+    checkALError(prim->ctx);
+    return TRUE;
 }
 
 
@@ -320,6 +318,11 @@ HRESULT DSPrimary_PreInit(DSPrimary *This, DSDevice *parent)
     if(!This->notifies) goto fail;
     This->sizenotifies = num_srcs;
 
+    This->pending_starts = HeapAlloc(GetProcessHeap(), 0, num_srcs*sizeof(*This->pending_starts));
+    This->pending_srcs = HeapAlloc(GetProcessHeap(), 0, num_srcs*sizeof(*This->pending_srcs));
+    if(!This->pending_starts || !This->pending_srcs) goto fail;
+    This->sizepending_starts = num_srcs;
+
     count = (MAX_HWBUFFERS+63) / 64;
     This->BufferGroups = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
                                    count*sizeof(*This->BufferGroups));
@@ -373,6 +376,8 @@ void DSPrimary_Clear(DSPrimary *This)
 
     HeapFree(GetProcessHeap(), 0, This->BufferGroups);
     HeapFree(GetProcessHeap(), 0, This->notifies);
+    HeapFree(GetProcessHeap(), 0, This->pending_starts);
+    HeapFree(GetProcessHeap(), 0, This->pending_srcs);
     memset(This, 0, sizeof(*This));
 }
 
@@ -461,10 +466,10 @@ static HRESULT WINAPI DSPrimary_GetCurrentPosition(IDirectSoundBuffer *iface, DW
     DSPrimary *This = impl_from_IDirectSoundBuffer(iface);
     HRESULT hr = DSERR_PRIOLEVELNEEDED;
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
     if(This->write_emu)
         hr = IDirectSoundBuffer_GetCurrentPosition(This->write_emu, playpos, curpos);
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
 
     return hr;
 }
@@ -472,6 +477,7 @@ static HRESULT WINAPI DSPrimary_GetCurrentPosition(IDirectSoundBuffer *iface, DW
 static HRESULT WINAPI DSPrimary_GetFormat(IDirectSoundBuffer *iface, WAVEFORMATEX *wfx, DWORD allocated, DWORD *written)
 {
     DSPrimary *This = impl_from_IDirectSoundBuffer(iface);
+    LONGLONG lockstart;
     HRESULT hr = S_OK;
     UINT size;
 
@@ -481,7 +487,7 @@ static HRESULT WINAPI DSPrimary_GetFormat(IDirectSoundBuffer *iface, WAVEFORMATE
         return DSERR_INVALIDPARAM;
     }
 
-    EnterCriticalSection(&This->share->crst);
+    lockstart = DSShare_LockParams(This->share);
     size = sizeof(This->format.Format) + This->format.Format.cbSize;
     if(written)
         *written = size;
@@ -492,7 +498,7 @@ static HRESULT WINAPI DSPrimary_GetFormat(IDirectSoundBuffer *iface, WAVEFORMATE
         else
             memcpy(wfx, &This->format.Format, size);
     }
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_UnlockParams(This->share, lockstart);
 
     return hr;
 }
@@ -512,8 +518,8 @@ static HRESULT WINAPI DSPrimary_GetVolume(IDirectSoundBuffer *iface, LONG *volum
         return DSERR_CONTROLUNAVAIL;
 
     setALContext(This->ctx);
-    alGetListenerf(AL_GAIN, &gain);
-    checkALError();
+    alGetListenerfDirect(This->ctx, AL_GAIN, &gain);
+    checkALError(This->ctx);
     popALContext();
 
     *volume = clampI(gain_to_mB(gain), DSBVOLUME_MIN, DSBVOLUME_MAX);
@@ -530,14 +536,14 @@ static HRESULT WINAPI DSPrimary_GetPan(IDirectSoundBuffer *iface, LONG *pan)
     if(!pan)
         return DSERR_INVALIDPARAM;
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
     if(This->write_emu)
         hr = IDirectSoundBuffer_GetPan(This->write_emu, pan);
     else if(!(This->flags & DSBCAPS_CTRLPAN))
         hr = DSERR_CONTROLUNAVAIL;
     else
         *pan = 0;
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
 
     return hr;
 }
@@ -545,6 +551,7 @@ static HRESULT WINAPI DSPrimary_GetPan(IDirectSoundBuffer *iface, LONG *pan)
 static HRESULT WINAPI DSPrimary_GetFrequency(IDirectSoundBuffer *iface, DWORD *freq)
 {
     DSPrimary *This = impl_from_IDirectSoundBuffer(iface);
+    LONGLONG lockstart;
     HRESULT hr = DS_OK;
 
     WARN("(%p)->(%p): semi-stub\n", iface, freq);
@@ -555,9 +562,9 @@ static HRESULT WINAPI DSPrimary_GetFrequency(IDirectSoundBuffer *iface, DWORD *f
     if(!(This->flags&DSBCAPS_CTRLFREQUENCY))
         return DSERR_CONTROLUNAVAIL;
 
-    EnterCriticalSection(&This->share->crst);
+    lockstart = DSShare_LockParams(This->share);
     *freq = This->format.Format.nSamplesPerSec;
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_UnlockParams(This->share, lockstart);
 
     return hr;
 }
@@ -571,37 +578,17 @@ static HRESULT WINAPI DSPrimary_GetStatus(IDirectSoundBuffer *iface, DWORD *stat
     if(!status)
         return DSERR_INVALIDPARAM;
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
     *status = DSBSTATUS_PLAYING|DSBSTATUS_LOOPING;
     if((This->flags&DSBCAPS_LOCDEFER))
         *status |= DSBSTATUS_LOCHARDWARE;
 
-    if(This->stopped)
+    if(This->stopped && This->nplaying == 0)
     {
-        struct DSBufferGroup *bufgroup = This->BufferGroups;
-        DWORD i, state = 0;
-        HRESULT hr;
-
-        for(i = 0;i < This->NumBufferGroups;++i)
-        {
-            DWORD64 usemask = ~bufgroup[i].FreeBuffers;
-            while(usemask)
-            {
-                int idx = CTZ64(usemask);
-                DSBuffer *buf = bufgroup[i].Buffers + idx;
-                usemask &= ~(U64(1) << idx);
-
-                hr = DSBuffer_GetStatus(&buf->IDirectSoundBuffer8_iface, &state);
-                if(SUCCEEDED(hr) && (state&DSBSTATUS_PLAYING)) break;
-            }
-        }
-        if(!(state&DSBSTATUS_PLAYING))
-        {
-            /* Primary stopped and no buffers playing.. */
-            *status = 0;
-        }
+        /* Primary stopped and no buffers playing.. */
+        *status = 0;
     }
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
 
     return DS_OK;
 }
@@ -706,10 +693,10 @@ static HRESULT WINAPI DSPrimary_Lock(IDirectSoundBuffer *iface, DWORD ofs, DWORD
 
     TRACE("(%p)->(%lu, %lu, %p, %p, %p, %p, %lu)\n", iface, ofs, bytes, ptr1, len1, ptr2, len2, flags);
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
     if(This->write_emu)
         hr = IDirectSoundBuffer_Lock(This->write_emu, ofs, bytes, ptr1, len1, ptr2, len2, flags);
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
 
     return hr;
 }
@@ -727,14 +714,15 @@ static HRESULT WINAPI DSPrimary_Play(IDirectSoundBuffer *iface, DWORD res1, DWOR
         return DSERR_INVALIDPARAM;
     }
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
     hr = S_OK;
     if(This->write_emu)
         hr = IDirectSoundBuffer_Play(This->write_emu, res1, res2, flags);
     if(SUCCEEDED(hr))
         This->stopped = FALSE;
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
 
+    APITRACE(DSTracePlay, hr, This, NULL, NULL, 0, 2, res2, flags);
     return hr;
 }
 
@@ -856,7 +844,7 @@ static HRESULT WINAPI DSPrimary_SetFormat(IDirectSoundBuffer *iface, const WAVEF
         return DSERR_INVALIDPARAM;
     }
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
 
     if(This->parent->prio_level < DSSCL_PRIORITY)
     {
@@ -875,7 +863,9 @@ static HRESULT WINAPI DSPrimary_SetFormat(IDirectSoundBuffer *iface, const WAVEF
           wfx->nSamplesPerSec, wfx->nAvgBytesPerSec,
           wfx->nBlockAlign, wfx->wBitsPerSample);
 
+    AcquireSRWLockExclusive(&This->share->params_lock);
     hr = copy_waveformat(&This->format.Format, wfx);
+    ReleaseSRWLockExclusive(&This->share->params_lock);
     if(SUCCEEDED(hr) && This->write_emu)
     {
         DSBuffer *buf;
@@ -903,7 +893,8 @@ static HRESULT WINAPI DSPrimary_SetFormat(IDirectSoundBuffer *iface, const WAVEF
     }
 
 out:
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
+    APITRACE(DSTraceSetFormat, hr, This, NULL, wfx, ApiTrace_FormatSize(wfx), 0);
     return hr;
 }
 
@@ -923,9 +914,10 @@ static HRESULT WINAPI DSPrimary_SetVolume(IDirectSoundBuffer *iface, LONG vol)
         return DSERR_CONTROLUNAVAIL;
 
     setALContext(This->ctx);
-    alListenerf(AL_GAIN, mB_to_gain((float)vol));
+    alListenerfDirect(This->ctx, AL_GAIN, mB_to_gain((float)vol));
     popALContext();
 
+    APITRACE(DSTraceSetVolume, DS_OK, This, NULL, NULL, 0, 1, (DWORD)vol);
     return DS_OK;
 }
 
@@ -942,7 +934,7 @@ static HRESULT WINAPI DSPrimary_SetPan(IDirectSoundBuffer *iface, LONG pan)
         return DSERR_INVALIDPARAM;
     }
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
     if(!(This->flags&DSBCAPS_CTRLPAN))
     {
         WARN("control unavailable\n");
@@ -955,8 +947,9 @@ static HRESULT WINAPI DSPrimary_SetPan(IDirectSoundBuffer *iface, LONG pan)
         FIXME("Not supported\n");
         hr = E_NOTIMPL;
     }
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
 
+    APITRACE(DSTraceSetPan, hr, This, NULL, NULL, 0, 1, (DWORD)pan);
     return hr;
 }
 
@@ -973,13 +966,14 @@ static HRESULT WINAPI DSPrimary_Stop(IDirectSoundBuffer *iface)
 
     TRACE("(%p)->()\n", iface);
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
     if(This->write_emu)
         hr = IDirectSoundBuffer_Stop(This->write_emu);
     if(SUCCEEDED(hr))
         This->stopped = TRUE;
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
 
+    APITRACE(DSTraceStop, hr, This, NULL, NULL, 0, 0);
     return hr;
 }
 
@@ -990,10 +984,10 @@ static HRESULT WINAPI DSPrimary_Unlock(IDirectSoundBuffer *iface, void *ptr1, DW
 
     TRACE("(%p)->(%p, %lu, %p, %lu)\n", iface, ptr1, len1, ptr2, len2);
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
     if(This->write_emu)
         hr = IDirectSoundBuffer_Unlock(This->write_emu, ptr1, len1, ptr2, len2);
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
 
     return hr;
 }
@@ -1005,10 +999,10 @@ static HRESULT WINAPI DSPrimary_Restore(IDirectSoundBuffer *iface)
 
     TRACE("(%p)->()\n", iface);
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
     if(This->write_emu)
         hr = IDirectSoundBuffer_Restore(This->write_emu);
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
 
     return hr;
 }
@@ -1044,6 +1038,7 @@ static void DSPrimary_SetParams(DSPrimary *This, const DS3DLISTENER *params, LON
     union PrimaryParamFlags dirty = { flags };
     DWORD i;
 
+    AcquireSRWLockExclusive(&This->share->params_lock);
     if(dirty.bit.pos)
         This->current.ds3d.vPosition = params->vPosition;
     if(dirty.bit.vel)
@@ -1059,23 +1054,24 @@ static void DSPrimary_SetParams(DSPrimary *This, const DS3DLISTENER *params, LON
         This->current.ds3d.flRolloffFactor = params->flRolloffFactor;
     if(dirty.bit.dopplerfactor)
         This->current.ds3d.flDopplerFactor = params->flDopplerFactor;
+    ReleaseSRWLockExclusive(&This->share->params_lock);
 
     if(dirty.bit.pos)
-        alListener3f(AL_POSITION, params->vPosition.x, params->vPosition.y,
-                                 -params->vPosition.z);
+        alListener3fDirect(This->ctx, AL_POSITION, params->vPosition.x, params->vPosition.y,
+                                                  -params->vPosition.z);
     if(dirty.bit.vel)
-        alListener3f(AL_VELOCITY, params->vVelocity.x, params->vVelocity.y,
-                                 -params->vVelocity.z);
+        alListener3fDirect(This->ctx, AL_VELOCITY, params->vVelocity.x, params->vVelocity.y,
+                                                  -params->vVelocity.z);
     if(dirty.bit.orientation)
     {
         ALfloat orient[6] = {
             params->vOrientFront.x, params->vOrientFront.y, -params->vOrientFront.z,
             params->vOrientTop.x, params->vOrientTop.y, -params->vOrientTop.z
         };
-        alListenerfv(AL_ORIENTATION, orient);
+        alListenerfvDirect(This->ctx, AL_ORIENTATION, orient);
     }
     if(dirty.bit.distancefactor)
-        alSpeedOfSound(343.3f/params->flDistanceFactor);
+        alSpeedOfSoundDirect(This->ctx, 343.3f/params->flDistanceFactor);
     if(dirty.bit.rollofffactor)
     {
         struct DSBufferGroup *bufgroup = This->BufferGroups;
@@ -1091,12 +1087,12 @@ static void DSPrimary_SetParams(DSPrimary *This, const DS3DLISTENER *params, LON
                 usemask &= ~(U64(1) << idx);
 
                 if(buf->source)
-                    alSourcef(buf->source, AL_ROLLOFF_FACTOR, rolloff);
+                    alSourcefDirect(This->ctx, buf->source, AL_ROLLOFF_FACTOR, rolloff);
             }
         }
     }
     if(dirty.bit.dopplerfactor)
-        alDopplerFactor(params->flDopplerFactor);
+        alDopplerFactorDirect(This->ctx, params->flDopplerFactor);
 }
 
 static HRESULT WINAPI DSPrimary3D_QueryInterface(IDirectSound3DListener *iface, REFIID riid, void **ppv)
@@ -1163,6 +1159,7 @@ static HRESULT WINAPI DSPrimary3D_GetDopplerFactor(IDirectSound3DListener *iface
 static HRESULT WINAPI DSPrimary3D_GetOrientation(IDirectSound3DListener *iface, D3DVECTOR *front, D3DVECTOR *top)
 {
     DSPrimary *This = impl_from_IDirectSound3DListener(iface);
+    LONGLONG lockstart;
 
     TRACE("(%p)->(%p, %p)\n", iface, front, top);
 
@@ -1172,16 +1169,17 @@ static HRESULT WINAPI DSPrimary3D_GetOrientation(IDirectSound3DListener *iface,
         return DSERR_INVALIDPARAM;
     }
 
-    EnterCriticalSection(&This->share->crst);
+    lockstart = DSShare_LockParams(This->share);
     *front = This->current.ds3d.vOrientFront;
     *top = This->current.ds3d.vOrientTop;
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_UnlockParams(This->share, lockstart);
     return S_OK;
 }
 
 static HRESULT WINAPI DSPrimary3D_GetPosition(IDirectSound3DListener *iface, D3DVECTOR *pos)
 {
     DSPrimary *This = impl_from_IDirectSound3DListener(iface);
+    LONGLONG lockstart;
 
     TRACE("(%p)->(%p)\n", iface, pos);
 
@@ -1191,9 +1189,9 @@ static HRESULT WINAPI DSPrimary3D_GetPosition(IDirectSound3DListener *iface, D3D
         return DSERR_INVALIDPARAM;
     }
 
-    EnterCriticalSection(&This->share->crst);
+    lockstart = DSShare_LockParams(This->share);
     *pos = This->current.ds3d.vPosition;
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_UnlockParams(This->share, lockstart);
     return S_OK;
 }
 
@@ -1216,6 +1214,7 @@ static HRESULT WINAPI DSPrimary3D_GetRolloffFactor(IDirectSound3DListener *iface
 static HRESULT WINAPI DSPrimary3D_GetVelocity(IDirectSound3DListener *iface, D3DVECTOR *velocity)
 {
     DSPrimary *This = impl_from_IDirectSound3DListener(iface);
+    LONGLONG lockstart;
 
     TRACE("(%p)->(%p)\n", iface, velocity);
 
@@ -1225,15 +1224,16 @@ static HRESULT WINAPI DSPrimary3D_GetVelocity(IDirectSound3DListener *iface, D3D
         return DSERR_INVALIDPARAM;
     }
 
-    EnterCriticalSection(&This->share->crst);
+    lockstart = DSShare_LockParams(This->share);
     *velocity = This->current.ds3d.vVelocity;
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_UnlockParams(This->share, lockstart);
     return S_OK;
 }
 
 static HRESULT WINAPI DSPrimary3D_GetAllParameters(IDirectSound3DListener *iface, DS3DLISTENER *listener)
 {
     DSPrimary *This = impl_from_IDirectSound3DListener(iface);
+    LONGLONG lockstart;
 
     TRACE("(%p)->(%p)\n", iface, listener);
 
@@ -1243,7 +1243,7 @@ static HRESULT WINAPI DSPrimary3D_GetAllParameters(IDirectSound3DListener *iface
         return DSERR_INVALIDPARAM;
     }
 
-    EnterCriticalSection(&This->share->crst);
+    lockstart = DSShare_LockParams(This->share);
     listener->vPosition = This->current.ds3d.vPosition;
     listener->vVelocity = This->current.ds3d.vVelocity;
     listener->vOrientFront = This->current.ds3d.vOrientFront;
@@ -1251,7 +1251,7 @@ static HRESULT WINAPI DSPrimary3D_GetAllParameters(IDirectSound3DListener *iface
     listener->flDistanceFactor = This->current.ds3d.flDistanceFactor;
     listener->flRolloffFactor = This->current.ds3d.flRolloffFactor;
     listener->flDopplerFactor = This->current.ds3d.flDopplerFactor;
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_UnlockParams(This->share, lockstart);
 
     return DS_OK;
 }
@@ -1270,7 +1270,7 @@ static HRESULT WINAPI DSPrimary3D_SetDistanceFactor(IDirectSound3DListener *ifac
         return DSERR_INVALIDPARAM;
     }
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
     if(apply == DS3D_DEFERRED)
     {
         This->deferred.ds3d.flDistanceFactor = factor;
@@ -1279,13 +1279,17 @@ static HRESULT WINAPI DSPrimary3D_SetDistanceFactor(IDirectSound3DListener *ifac
     else
     {
         setALContext(This->ctx);
+        AcquireSRWLockExclusive(&This->share->params_lock);
         This->current.ds3d.flDistanceFactor = factor;
-        alSpeedOfSound(343.3f/factor);
-        checkALError();
+        ReleaseSRWLockExclusive(&This->share->params_lock);
+        alSpeedOfSoundDirect(This->ctx, 343.3f/factor);
+        checkALError(This->ctx);
         popALContext();
     }
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
 
+    APITRACE(DSTraceListenerSetDistanceFactor, S_OK, This, NULL, NULL, 0, 2,
+             ApiTrace_Float(factor), apply);
     return S_OK;
 }
 
@@ -1302,7 +1306,7 @@ static HRESULT WINAPI DSPrimary3D_SetDopplerFactor(IDirectSound3DListener *iface
         return DSERR_INVALIDPARAM;
     }
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
     if(apply == DS3D_DEFERRED)
     {
         This->deferred.ds3d.flDopplerFactor = factor;
@@ -1311,13 +1315,17 @@ static HRESULT WINAPI DSPrimary3D_SetDopplerFactor(IDirectSound3DListener *iface
     else
     {
         setALContext(This->ctx);
+        AcquireSRWLockExclusive(&This->share->params_lock);
         This->current.ds3d.flDopplerFactor = factor;
-        alDopplerFactor(factor);
-        checkALError();
+        ReleaseSRWLockExclusive(&This->share->params_lock);
+        alDopplerFactorDirect(This->ctx, factor);
+        checkALError(This->ctx);
         popALContext();
     }
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
 
+    APITRACE(DSTraceListenerSetDopplerFactor, S_OK, This, NULL, NULL, 0, 2,
+             ApiTrace_Float(factor), apply);
     return S_OK;
 }
 
@@ -1327,7 +1335,7 @@ static HRESULT WINAPI DSPrimary3D_SetOrientation(IDirectSound3DListener *iface,
 
     TRACE("(%p)->(%f, %f, %f, %f, %f, %f, %lu)\n", iface, xFront, yFront, zFront, xTop, yTop, zTop, apply);
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
     if(apply == DS3D_DEFERRED)
     {
         This->deferred.ds3d.vOrientFront.x = xFront;
@@ -1344,20 +1352,25 @@ static HRESULT WINAPI DSPrimary3D_SetOrientation(IDirectSound3DListener *iface,
             xFront, yFront, -zFront,
             xTop, yTop, -zTop
         };
+        AcquireSRWLockExclusive(&This->share->params_lock);
         This->current.ds3d.vOrientFront.x = xFront;
         This->current.ds3d.vOrientFront.y = yFront;
         This->current.ds3d.vOrientFront.z = zFront;
         This->current.ds3d.vOrientTop.x = xTop;
         This->current.ds3d.vOrientTop.y = yTop;
         This->current.ds3d.vOrientTop.z = zTop;
+        ReleaseSRWLockExclusive(&This->share->params_lock);
 
         setALContext(This->ctx);
-        alListenerfv(AL_ORIENTATION, orient);
-        checkALError();
+        alListenerfvDirect(This->ctx, AL_ORIENTATION, orient);
+        checkALError(This->ctx);
         popALContext();
     }
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
 
+    APITRACE(DSTraceListenerSetOrientation, S_OK, This, NULL, NULL, 0, 7,
+             ApiTrace_Float(xFront), ApiTrace_Float(yFront), ApiTrace_Float(zFront), ApiTrace_Float(xTop), ApiTrace_Float(yTop),
+             ApiTrace_Float(zTop), apply);
     return S_OK;
 }
 
@@ -1367,7 +1380,7 @@ static HRESULT WINAPI DSPrimary3D_SetPosition(IDirectSound3DListener *iface, D3D
 
     TRACE("(%p)->(%f, %f, %f, %lu)\n", iface, x, y, z, apply);
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
     if(apply == DS3D_DEFERRED)
     {
         This->deferred.ds3d.vPosition.x = x;
@@ -1378,15 +1391,19 @@ static HRESULT WINAPI DSPrimary3D_SetPosition(IDirectSound3DListener *iface, D3D
     else
     {
         setALContext(This->ctx);
+        AcquireSRWLockExclusive(&This->share->params_lock);
         This->current.ds3d.vPosition.x = x;
         This->current.ds3d.vPosition.y = y;
         This->current.ds3d.vPosition.z = z;
-        alListener3f(AL_POSITION, x, y, -z);
-        checkALError();
+        ReleaseSRWLockExclusive(&This->share->params_lock);
+        alListener3fDirect(This->ctx, AL_POSITION, x, y, -z);
+        checkALError(This->ctx);
         popALContext();
     }
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
 
+    APITRACE(DSTraceListenerSetPosition, S_OK, This, NULL, NULL, 0, 4,
+             ApiTrace_Float(x), ApiTrace_Float(y), ApiTrace_Float(z), apply);
     return S_OK;
 }
 
@@ -1403,7 +1420,7 @@ static HRESULT WINAPI DSPrimary3D_SetRolloffFactor(IDirectSound3DListener *iface
         return DSERR_INVALIDPARAM;
     }
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
     if(apply == DS3D_DEFERRED)
     {
         This->deferred.ds3d.flRolloffFactor = factor;
@@ -1414,7 +1431,9 @@ static HRESULT WINAPI DSPrimary3D_SetRolloffFactor(IDirectSound3DListener *iface
         struct DSBufferGroup *bufgroup = This->BufferGroups;
         DWORD i;
 
+        AcquireSRWLockExclusive(&This->share->params_lock);
         This->current.ds3d.flRolloffFactor = factor;
+        ReleaseSRWLockExclusive(&This->share->params_lock);
 
         setALContext(This->ctx);
         for(i = 0;i < This->NumBufferGroups;++i)
@@ -1427,14 +1446,16 @@ static HRESULT WINAPI DSPrimary3D_SetRolloffFactor(IDirectSound3DListener *iface
                 usemask &= ~(U64(1) << idx);
 
                 if(buf->source)
-                    alSourcef(buf->source, AL_ROLLOFF_FACTOR, factor);
+                    alSourcefDirect(This->ctx, buf->source, AL_ROLLOFF_FACTOR, factor);
             }
         }
-        checkALError();
+        checkALError(This->ctx);
         popALContext();
     }
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
 
+    APITRACE(DSTraceListenerSetRolloffFactor, S_OK, This, NULL, NULL, 0, 2,
+             ApiTrace_Float(factor), apply);
     return S_OK;
 }
 
@@ -1444,7 +1465,7 @@ static HRESULT WINAPI DSPrimary3D_SetVelocity(IDirectSound3DListener *iface, D3D
 
     TRACE("(%p)->(%f, %f, %f, %lu)\n", iface, x, y, z, apply);
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
     if(apply == DS3D_DEFERRED)
     {
         This->deferred.ds3d.vVelocity.x = x;
@@ -1455,15 +1476,19 @@ static HRESULT WINAPI DSPrimary3D_SetVelocity(IDirectSound3DListener *iface, D3D
     else
     {
         setALContext(This->ctx);
+        AcquireSRWLockExclusive(&This->share->params_lock);
         This->current.ds3d.vVelocity.x = x;
         This->current.ds3d.vVelocity.y = y;
         This->current.ds3d.vVelocity.z = z;
-        alListener3f(AL_VELOCITY, x, y, -z);
-        checkALError();
+        ReleaseSRWLockExclusive(&This->share->params_lock);
+        alListener3fDirect(This->ctx, AL_VELOCITY, x, y, -z);
+        checkALError(This->ctx);
         popALContext();
     }
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
 
+    APITRACE(DSTraceListenerSetVelocity, S_OK, This, NULL, NULL, 0, 4,
+             ApiTrace_Float(x), ApiTrace_Float(y), ApiTrace_Float(z), apply);
     return S_OK;
 }
 
@@ -1502,7 +1527,7 @@ static HRESULT WINAPI DSPrimary3D_SetAllParameters(IDirectSound3DListener *iface
 
     if(apply == DS3D_DEFERRED)
     {
-        EnterCriticalSection(&This->share->crst);
+        DSShare_Lock(This->share);
         This->deferred.ds3d = *listen;
         This->deferred.ds3d.dwSize = sizeof(This->deferred.ds3d);
         This->dirty.bit.pos = 1;
@@ -1511,7 +1536,7 @@ static HRESULT WINAPI DSPrimary3D_SetAllParameters(IDirectSound3DListener *iface
         This->dirty.bit.distancefactor = 1;
         This->dirty.bit.rollofffactor = 1;
         This->dirty.bit.dopplerfactor = 1;
-        LeaveCriticalSection(&This->share->crst);
+        DSShare_Unlock(This->share);
     }
     else
     {
@@ -1523,14 +1548,16 @@ static HRESULT WINAPI DSPrimary3D_SetAllParameters(IDirectSound3DListener *iface
         dirty.bit.rollofffactor = 1;
         dirty.bit.dopplerfactor = 1;
 
-        EnterCriticalSection(&This->share->crst);
+        DSShare_Lock(This->share);
         setALContext(This->ctx);
         DSPrimary_SetParams(This, listen, dirty.flags);
-        checkALError();
+        checkALError(This->ctx);
         popALContext();
-        LeaveCriticalSection(&This->share->crst);
+        DSShare_Unlock(This->share);
     }
 
+    APITRACE(DSTraceListenerSetAllParameters, S_OK, This, NULL, listen, sizeof(*listen), 1,
+             apply);
     return S_OK;
 }
 
@@ -1541,15 +1568,15 @@ HRESULT WINAPI DSPrimary3D_CommitDeferredSettings(IDirectSound3DListener *iface)
     LONG flags;
     DWORD i;
 
-    EnterCriticalSection(&This->share->crst);
+    DSShare_Lock(This->share);
     setALContext(This->ctx);
-    alDeferUpdatesSOFT();
+    alDeferUpdatesDirectSOFT(This->ctx);
 
     if((flags=InterlockedExchange(&This->dirty.flags, 0)) != 0)
     {
         DSPrimary_SetParams(This, &This->deferred.ds3d, flags);
         /* checkALError is here for debugging */
-        checkALError();
+        checkALError(This->ctx);
     }
     TRACE("Dirty flags was: 0x%02lx\n", flags);
 
@@ -1567,15 +1594,28 @@ HRESULT WINAPI DSPrimary3D_CommitDeferredSettings(IDirectSound3DListener *iface)
                 DSBuffer_SetParams(buf, &buf->deferred.ds3d, flags);
         }
     }
-    alProcessUpdatesSOFT();
-    checkALError();
+    /* Buffers played while settings were deferred start with them. */
+    DSPrimary_startpending(This);
+    alProcessUpdatesDirectSOFT(This->ctx);
+    checkALError(This->ctx);
 
     popALContext();
-    LeaveCriticalSection(&This->share->crst);
+    DSShare_Unlock(This->share);
 
     return DS_OK;
 }
 
+/* EAX property sets commit through DSPrimary3D_CommitDeferredSettings too, so
+ * only the app's calls are traced.
+ */
+static HRESULT WINAPI DSPrimary3D_AppCommitDeferredSettings(IDirectSound3DListener *iface)
+{
+    HRESULT hr = DSPrimary3D_CommitDeferredSettings(iface);
+    APITRACE(DSTraceCommitDeferredSettings, hr, impl_from_IDirectSound3DListener(iface), NULL,
+             NULL, 0, 0);
+    return hr;
+}
+
 static IDirectSound3DListenerVtbl DSPrimary3D_Vtbl =
 {
     DSPrimary3D_QueryInterface,
@@ -1595,7 +1635,7 @@ static IDirectSound3DListenerVtbl DSPrimary3D_Vtbl =
     DSPrimary3D_SetPosition,
     DSPrimary3D_SetRolloffFactor,
     DSPrimary3D_SetVelocity,
-    DSPrimary3D_CommitDeferredSettings
+    DSPrimary3D_AppCommitDeferredSettings
 };
 
 
@@ -0,0 +1,164 @@
+/* DSOAL AL call count tests
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/* Checks how many OpenAL calls DirectSound operations make, by running the
+ * dsound.dll next to this executable on the recording driver (fakeal). The
+ * driver's path is given on the command line and it's loaded first, so
+ * dsound.dll's load of dsoal-aldrv.dll gets it instead of the real one.
+ *
+ * Returns 0 if all checks passed, 1 if any failed, and 77 (skipped) if no
+ * device could be opened.
+ */
+
+#define INITGUID
+#include <stdio.h>
+
+#include <windows.h>
+#include <dsound.h>
+#include <mmsystem.h>
+
+#include "common.h"
+#include "fakeal.h"
+
+
+#define SKIPPED 77
+
+static LPFAKEALRESET fake_reset;
+static LPFAKEALCALLCOUNT fake_count;
+static LPFAKEALNUMCALLS fake_num_calls;
+static LPFAKEALGETCALL fake_get_call;
+static LPFAKEALSETMANUALCLOCK fake_set_manual_clock;
+
+static int failures;
+
+
+/* Checks the number of calls to the named function (or all calls, if NULL)
+ * since the last reset, listing the recorded calls if it's wrong.
+ */
+static void check_calls(const char *what, const char *name, ULONG expected)
+{
+    ULONG count = fake_count(name);
+    ULONG i, n;
+
+    if(count == expected)
+        return;
+
+    fprintf(stderr, "%s: expected %lu call(s) to %s, got %lu:\n", what, expected,
+            name ? name : "OpenAL", count);
+    n = fake_num_calls();
+    for(i = 0;i < n;++i)
+        fprintf(stderr, "  %s\n", fake_get_call(i));
+    ++failures;
+}
+
+static void test_setposition(IDirectSound8 *ds)
+{
+    WAVEFORMATEX wfx = { WAVE_FORMAT_PCM, 1, 22050, 22050*2, 2, 16, 0 };
+    DSBUFFERDESC desc = { sizeof(desc) };
+    IDirectSoundBuffer *buf = NULL;
+    IDirectSound3DBuffer *buf3d = NULL;
+    HRESULT hr;
+
+    desc.dwFlags = DSBCAPS_CTRL3D;
+    desc.dwBufferBytes = wfx.nAvgBytesPerSec;
+    desc.lpwfxFormat = &wfx;
+    hr = IDirectSound8_CreateSoundBuffer(ds, &desc, &buf, NULL);
+    if(SUCCEEDED(hr))
+        hr = IDirectSoundBuffer_QueryInterface(buf, &IID_IDirectSound3DBuffer, (void**)&buf3d);
+    if(FAILED(hr))
+    {
+        fprintf(stderr, "Failed to create a 3D buffer: 0x%08lx\n", hr);
+        ++failures;
+        if(buf) IDirectSoundBuffer_Release(buf);
+        return;
+    }
+
+    /* A new position goes to the source. */
+    fake_reset();
+    IDirectSound3DBuffer_SetPosition(buf3d, 1.0f, 2.0f, 3.0f, DS3D_IMMEDIATE);
+    check_calls("SetPosition with new values", "alSource3f", 1);
+
+    /* The same position again needs nothing from OpenAL. */
+    fake_reset();
+    IDirectSound3DBuffer_SetPosition(buf3d, 1.0f, 2.0f, 3.0f, DS3D_IMMEDIATE);
+    check_calls("SetPosition with unchanged values", NULL, 0);
+
+    IDirectSound3DBuffer_Release(buf3d);
+    IDirectSoundBuffer_Release(buf);
+}
+
+
+int main(int argc, char *argv[])
+{
+    IDirectSound8 *ds = NULL;
+    HMODULE fakeal, dsound;
+    HRESULT hr;
+
+    if(argc != 2)
+    {
+        fprintf(stderr, "Usage: %s <path to fakeal's dsoal-aldrv.dll>\n", argv[0]);
+        return 1;
+    }
+
+    fakeal = LoadLibraryA(argv[1]);
+    if(!fakeal)
+    {
+        fprintf(stderr, "Failed to load %s\n", argv[1]);
+        return 1;
+    }
+    fake_reset = (LPFAKEALRESET)GetProcAddress(fakeal, "fakeal_reset");
+    fake_count = (LPFAKEALCALLCOUNT)GetProcAddress(fakeal, "fakeal_call_count");
+    fake_num_calls = (LPFAKEALNUMCALLS)GetProcAddress(fakeal, "fakeal_num_calls");
+    fake_get_call = (LPFAKEALGETCALL)GetProcAddress(fakeal, "fakeal_get_call");
+    fake_set_manual_clock = (LPFAKEALSETMANUALCLOCK)GetProcAddress(fakeal,
+        "fakeal_set_manual_clock");
+    if(!fake_reset || !fake_count || !fake_num_calls || !fake_get_call ||
+       !fake_set_manual_clock)
+    {
+        fprintf(stderr, "%s isn't the recording driver\n", argv[1]);
+        return 1;
+    }
+    /* Nothing plays, so sources stay put between checks. */
+    fake_set_manual_clock(TRUE);
+
+    dsound = load_dsound();
+    if(!dsound)
+        return 1;
+
+    hr = pDirectSoundCreate8(NULL, &ds, NULL);
+    if(FAILED(hr))
+    {
+        fprintf(stderr, "No device to test with: 0x%08lx\n", hr);
+        FreeLibrary(dsound);
+        return SKIPPED;
+    }
+    IDirectSound8_SetCooperativeLevel(ds, GetDesktopWindow(), DSSCL_PRIORITY);
+
+    test_setposition(ds);
+
+    IDirectSound8_Release(ds);
+    FreeLibrary(dsound);
+    FreeLibrary(fakeal);
+
+    if(failures)
+    {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
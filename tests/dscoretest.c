@@ -0,0 +1,285 @@
+/* DSOAL core tests
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/* Checks the platform-independent core (dscore.c, convert.c) natively. Built and
+ * registered with CTest by DSOAL_NATIVE_CORE. Prints each failed check and
+ * returns non-zero if any failed.
+ */
+
+#include <stdio.h>
+
+#include "dscore.h"
+#include "convert.h"
+
+
+static int failures;
+
+#define CHECK(cond) do {                                            \
+    if(!(cond))                                                     \
+    {                                                               \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__,      \
+                __LINE__, #cond);                                   \
+        ++failures;                                                 \
+    }                                                               \
+} while(0)
+
+static BYTE data[8192];
+static BYTE scratch[2048];
+
+
+/* Whether a segment matches the buffer's data starting at ofs, for len
+ * bytes, wrapping around at size.
+ */
+static BOOL segment_is(const BYTE *seg, DWORD ofs, DWORD size, DWORD len)
+{
+    DWORD i;
+    for(i = 0;i < len;++i)
+    {
+        if(seg[i] != data[(ofs+i) % size])
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static void test_stream_segment(void)
+{
+    const BYTE *seg;
+    DWORD ofs, i;
+
+    /* A segment that doesn't reach the end is returned in place. */
+    ofs = 0;
+    seg = DSCore_StreamSegment(data, 5000, &ofs, 2048, TRUE, 0, scratch);
+    CHECK(seg == data);
+    CHECK(ofs == 2048);
+
+    /* One ending exactly at the end is copied out, and the offset wraps to
+     * the start for a looping buffer.
+     */
+    ofs = 2048;
+    seg = DSCore_StreamSegment(data, 4096, &ofs, 2048, TRUE, 0, scratch);
+    CHECK(seg == scratch);
+    CHECK(segment_is(seg, 2048, 4096, 2048));
+    CHECK(ofs == 0);
+
+    /* Looping past the end wraps around to the start. */
+    ofs = 4000;
+    seg = DSCore_StreamSegment(data, 5000, &ofs, 2048, TRUE, 0, scratch);
+    CHECK(seg == scratch);
+    CHECK(segment_is(seg, 4000, 5000, 2048));
+    CHECK(ofs == 1048);
+
+    /* A looping buffer smaller than a segment repeats within it. */
+    ofs = 500;
+    seg = DSCore_StreamSegment(data, 1000, &ofs, 2048, TRUE, 0, scratch);
+    CHECK(seg == scratch);
+    CHECK(segment_is(seg, 500, 1000, 2048));
+    CHECK(ofs == 548);
+
+    /* A non-looping buffer is padded with silence at the end, then has no
+     * more data.
+     */
+    ofs = 4000;
+    seg = DSCore_StreamSegment(data, 5000, &ofs, 2048, FALSE, 0x80, scratch);
+    CHECK(seg == scratch);
+    CHECK(segment_is(seg, 4000, 5000, 1000));
+    for(i = 1000;i < 2048;++i)
+    {
+        if(seg[i] != 0x80)
+            break;
+    }
+    CHECK(i == 2048);
+    CHECK(ofs == 5000);
+    seg = DSCore_StreamSegment(data, 5000, &ofs, 2048, FALSE, 0x80, scratch);
+    CHECK(seg == NULL);
+    CHECK(ofs == 5000);
+}
+
+static void test_stream_depth(void)
+{
+    DWORD last = 1000;
+    LONG depth = QBUFFERS;
+
+    /* Underruns deepen the queue up to the maximum. */
+    depth = DSCore_StreamDepth(depth, TRUE, 2000, &last);
+    CHECK(depth == QBUFFERS+1);
+    CHECK(last == 2000);
+    depth = DSCore_StreamDepth(QBUFFERS_MAX, TRUE, 3000, &last);
+    CHECK(depth == QBUFFERS_MAX);
+    CHECK(last == 3000);
+
+    /* A segment is given back only after a stable period, one at a time. */
+    depth = DSCore_StreamDepth(depth, FALSE, 3000 + QBUFFERS_STABLE_MS - 1, &last);
+    CHECK(depth == QBUFFERS_MAX);
+    CHECK(last == 3000);
+    depth = DSCore_StreamDepth(depth, FALSE, 3000 + QBUFFERS_STABLE_MS, &last);
+    CHECK(depth == QBUFFERS_MAX-1);
+    CHECK(last == 3000 + QBUFFERS_STABLE_MS);
+
+    /* Never below the base depth, across the tick count wrapping. */
+    last = 0xffffff00;
+    depth = DSCore_StreamDepth(QBUFFERS+1, FALSE, QBUFFERS_STABLE_MS, &last);
+    CHECK(depth == QBUFFERS);
+    depth = DSCore_StreamDepth(depth, FALSE, 5*QBUFFERS_STABLE_MS, &last);
+    CHECK(depth == QBUFFERS);
+
+    /* Stopping at the end of a non-looping buffer isn't an underrun, and
+     * nothing underruns unless it's playing.
+     */
+    CHECK(DSCore_StreamUnderran(TRUE, TRUE, TRUE, 5000, 5000));
+    CHECK(DSCore_StreamUnderran(TRUE, TRUE, FALSE, 4096, 5000));
+    CHECK(!DSCore_StreamUnderran(TRUE, TRUE, FALSE, 5000, 5000));
+    CHECK(!DSCore_StreamUnderran(TRUE, FALSE, TRUE, 0, 5000));
+    CHECK(!DSCore_StreamUnderran(FALSE, TRUE, TRUE, 0, 5000));
+}
+
+static void test_stream_position(void)
+{
+    DWORD pos = 0;
+
+    CHECK(!DSCore_StreamPosition(1000, 2048, 5000, FALSE, &pos));
+    CHECK(pos == 3048);
+
+    /* A looping buffer wraps around. */
+    CHECK(!DSCore_StreamPosition(4096, 4096, 5000, TRUE, &pos));
+    CHECK(pos == 3192);
+    CHECK(!DSCore_StreamPosition(904, 4096, 5000, TRUE, &pos));
+    CHECK(pos == 0);
+
+    /* A non-looping one ends there. */
+    CHECK(DSCore_StreamPosition(904, 4096, 5000, FALSE, &pos));
+    CHECK(pos == 5000);
+    CHECK(DSCore_StreamPosition(8192, 4096, 5000, FALSE, &pos));
+    CHECK(pos == 5000);
+}
+
+static void test_reached(void)
+{
+    /* The start of the range is included, the end isn't. */
+    CHECK(DSCore_Reached(100, 100, 200));
+    CHECK(DSCore_Reached(199, 100, 200));
+    CHECK(!DSCore_Reached(200, 100, 200));
+    CHECK(!DSCore_Reached(99, 100, 200));
+
+    /* Wrapping around from 900 to 100. */
+    CHECK(DSCore_Reached(900, 900, 100));
+    CHECK(DSCore_Reached(950, 900, 100));
+    CHECK(DSCore_Reached(0, 900, 100));
+    CHECK(DSCore_Reached(99, 900, 100));
+    CHECK(!DSCore_Reached(100, 900, 100));
+    CHECK(!DSCore_Reached(500, 900, 100));
+
+    /* No movement reaches nothing. */
+    CHECK(!DSCore_Reached(100, 100, 100));
+}
+
+static void test_params(void)
+{
+    float pos[3];
+
+    CHECK(DSCore_Pitch(0, 44100) == 1.0f);
+    CHECK(DSCore_Pitch(22050, 44100) == 0.5f);
+
+    DSCore_PanPosition(0, pos);
+    CHECK(pos[0] == 0.0f && pos[1] == 0.0f && pos[2] == -1.0f);
+    DSCore_PanPosition(-10000, pos);
+    CHECK(pos[0] == -0.5f && pos[2] < 0.0f);
+    DSCore_PanPosition(10000, pos);
+    CHECK(pos[0] == 0.5f && pos[2] < 0.0f);
+
+    CHECK(mB_to_gain(0.0f) == 1.0f);
+    CHECK(mB_to_gain(-10000.0f) == 0.0f);
+    CHECK(gain_to_mB(1.0f) == 0);
+    CHECK(gain_to_mB(0.0f) == -10000);
+}
+
+/* Each value is converted at every position of a run that's one short of two
+ * SSE2 vectors, so it goes through both the vector body and the scalar tail.
+ */
+#define CONVERT_RUN 7
+
+static void test_convert(void)
+{
+    static const struct {
+        float in;
+        int out;
+    } f32_s32[] = {
+        { 0.0f, 0 },
+        /* Truncated toward zero. */
+        { 1.75f / 2147483648.0f, 1 },
+        { -1.75f / 2147483648.0f, -1 },
+        { 2.5f / 2147483648.0f, 2 },
+        { 0.5f, 1073741824 },
+        /* Clamped, with NaN going to the maximum. */
+        { 1.0f, 2147483520 },
+        { 4.0f, 2147483520 },
+        { -1.0f, -2147483647-1 },
+        { -4.0f, -2147483647-1 },
+        { NAN, 2147483520 },
+    };
+    static const short s16[] = { 0, 1, -1, 32767, -32768 };
+    float fin[CONVERT_RUN], fout[CONVERT_RUN];
+    short s16in[CONVERT_RUN];
+    int iout[CONVERT_RUN];
+    size_t v;
+    int i;
+
+    for(v = 0;v < sizeof(f32_s32)/sizeof(f32_s32[0]);++v)
+    {
+        for(i = 0;i < CONVERT_RUN;++i)
+            fin[i] = f32_s32[v].in;
+        convert_f32_s32(iout, fin, CONVERT_RUN);
+        for(i = 0;i < CONVERT_RUN;++i)
+            CHECK(iout[i] == f32_s32[v].out);
+    }
+
+    for(v = 0;v < sizeof(s16)/sizeof(s16[0]);++v)
+    {
+        for(i = 0;i < CONVERT_RUN;++i)
+            s16in[i] = s16[v];
+        convert_s16_f32(fout, s16in, CONVERT_RUN);
+        convert_s16_s32(iout, s16in, CONVERT_RUN);
+        for(i = 0;i < CONVERT_RUN;++i)
+        {
+            CHECK(fout[i] == s16[v] / 32768.0f);
+            CHECK(iout[i] == s16[v] * 65536);
+        }
+    }
+}
+
+
+int main(void)
+{
+    DWORD i;
+
+    for(i = 0;i < sizeof(data);++i)
+        data[i] = (BYTE)(i*7 + i/256);
+
+    test_stream_segment();
+    test_stream_depth();
+    test_stream_position();
+    test_reached();
+    test_params();
+    test_convert();
+
+    if(failures)
+    {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,110 @@
+/* Shared helpers for the DSOAL tools
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <windows.h>
+#include <dsound.h>
+
+#include "common.h"
+
+
+LPDSCREATE8 pDirectSoundCreate8;
+LPDSCAPTURECREATE8 pDirectSoundCaptureCreate8;
+
+static LARGE_INTEGER qpc_freq;
+
+
+HMODULE load_dsound(void)
+{
+    WCHAR path[MAX_PATH], *slash;
+    HMODULE dsound;
+
+    QueryPerformanceFrequency(&qpc_freq);
+
+    GetModuleFileNameW(NULL, path, MAX_PATH);
+    slash = wcsrchr(path, '\\');
+    if(slash) slash[1] = 0;
+    else path[0] = 0;
+    wcsncat(path, L"dsound.dll", MAX_PATH - wcslen(path) - 1);
+
+    dsound = LoadLibraryW(path);
+    if(!dsound)
+    {
+        fprintf(stderr, "Failed to load %ls\n", path);
+        return NULL;
+    }
+    pDirectSoundCreate8 = (LPDSCREATE8)GetProcAddress(dsound, "DirectSoundCreate8");
+    pDirectSoundCaptureCreate8 = (LPDSCAPTURECREATE8)GetProcAddress(dsound,
+        "DirectSoundCaptureCreate8");
+    if(!pDirectSoundCreate8)
+    {
+        fprintf(stderr, "No DirectSoundCreate8 in %ls\n", path);
+        FreeLibrary(dsound);
+        return NULL;
+    }
+    return dsound;
+}
+
+LONGLONG now_ns(void)
+{
+    LARGE_INTEGER cnt;
+    QueryPerformanceCounter(&cnt);
+    return cnt.QuadPart / qpc_freq.QuadPart * 1000000000 +
+           cnt.QuadPart % qpc_freq.QuadPart * 1000000000 / qpc_freq.QuadPart;
+}
+
+
+void samples_add(Samples *s, LONGLONG val)
+{
+    if(s->count == s->capacity)
+    {
+        DWORD newcap = s->capacity ? s->capacity*2 : 1024;
+        LONGLONG *vals = realloc(s->vals, newcap*sizeof(*vals));
+        if(!vals) return;
+        s->vals = vals;
+        s->capacity = newcap;
+    }
+    s->vals[s->count++] = val;
+    s->total += val;
+}
+
+static int compare_ll(const void *a, const void *b)
+{
+    LONGLONG lhs = *(const LONGLONG*)a, rhs = *(const LONGLONG*)b;
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+LONGLONG samples_percentile(Samples *s, double pct)
+{
+    DWORD idx;
+
+    if(!s->count)
+        return 0;
+    qsort(s->vals, s->count, sizeof(*s->vals), compare_ll);
+    idx = (DWORD)(pct/100.0 * (s->count-1) + 0.5);
+    return s->vals[idx];
+}
+
+void samples_clear(Samples *s)
+{
+    free(s->vals);
+    s->vals = NULL;
+    s->count = s->capacity = 0;
+    s->total = 0;
+}
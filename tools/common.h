@@ -0,0 +1,51 @@
+/* Shared helpers for the DSOAL tools
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef DSOAL_TOOLS_COMMON_H
+#define DSOAL_TOOLS_COMMON_H
+
+#include <windows.h>
+#include <dsound.h>
+
+typedef HRESULT (WINAPI *LPDSCREATE8)(LPCGUID, IDirectSound8**, IUnknown*);
+typedef HRESULT (WINAPI *LPDSCAPTURECREATE8)(LPCGUID, IDirectSoundCapture8**, IUnknown*);
+
+extern LPDSCREATE8 pDirectSoundCreate8;
+extern LPDSCAPTURECREATE8 pDirectSoundCaptureCreate8;
+
+/* Loads the dsound.dll in the executable's directory, rather than the system
+ * one, and fills in the entry points above. Returns NULL on failure, after
+ * printing why.
+ */
+HMODULE load_dsound(void);
+
+/* QueryPerformanceCounter time in nanoseconds. */
+LONGLONG now_ns(void);
+
+/* A growable set of timing samples, for percentiles. */
+typedef struct Samples {
+    LONGLONG *vals;
+    DWORD count, capacity;
+    LONGLONG total;
+} Samples;
+
+void samples_add(Samples *s, LONGLONG val);
+/* Sorts the samples, so it's only meant for the final report. */
+LONGLONG samples_percentile(Samples *s, double pct);
+void samples_clear(Samples *s);
+
+#endif /* DSOAL_TOOLS_COMMON_H */
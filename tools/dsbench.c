@@ -0,0 +1,656 @@
+/* DirectSound API micro-benchmarks
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/* Times the hot DirectSound calls against the dsound.dll sitting next to this
+ * executable, and writes one CSV row per measurement:
+ *
+ *   benchmark,param,iterations,ns_per_op,max_ns
+ *
+ * param is benchmark-specific (buffer count, sample count, etc.), or 0. Run it
+ * with DSOAL_LOOPBACK=1 to benchmark without an audio device.
+ */
+
+#define INITGUID
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <windows.h>
+#include <dsound.h>
+#include <mmsystem.h>
+
+#include "eax.h"
+#include "convert.h"
+#include "common.h"
+
+
+static FILE *out;
+static DWORD iterations = 10000;
+
+#define BUFFER_BYTES 65536
+#define LOCK_BYTES   4096
+
+
+static void report(const char *name, DWORD param, DWORD iters, LONGLONG total, LONGLONG maxval)
+{
+    fprintf(out, "%s,%lu,%lu,%.1f,%.1f\n", name, param, iters,
+            (double)total / (double)(iters ? iters : 1), (double)maxval);
+    fflush(out);
+}
+
+static void skip(const char *name, HRESULT hr)
+{
+    fprintf(stderr, "Skipping %s: 0x%08lx\n", name, hr);
+}
+
+
+static void init_format(WAVEFORMATEX *wfx, DWORD rate, WORD channels)
+{
+    memset(wfx, 0, sizeof(*wfx));
+    wfx->wFormatTag = WAVE_FORMAT_PCM;
+    wfx->nChannels = channels;
+    wfx->nSamplesPerSec = rate;
+    wfx->wBitsPerSample = 16;
+    wfx->nBlockAlign = channels * 2;
+    wfx->nAvgBytesPerSec = rate * wfx->nBlockAlign;
+}
+
+static HRESULT create_buffer(IDirectSound8 *ds, DWORD flags, IDirectSoundBuffer **buf)
+{
+    DSBUFFERDESC desc;
+    WAVEFORMATEX wfx;
+
+    /* 3D buffers must be mono. */
+    init_format(&wfx, 44100, (flags&DSBCAPS_CTRL3D) ? 1 : 2);
+    memset(&desc, 0, sizeof(desc));
+    desc.dwSize = sizeof(desc);
+    desc.dwFlags = flags;
+    desc.dwBufferBytes = BUFFER_BYTES;
+    desc.lpwfxFormat = &wfx;
+    return IDirectSound8_CreateSoundBuffer(ds, &desc, buf, NULL);
+}
+
+static void fill_buffer(IDirectSoundBuffer *buf)
+{
+    void *ptr1, *ptr2;
+    DWORD len1, len2;
+
+    if(SUCCEEDED(IDirectSoundBuffer_Lock(buf, 0, 0, &ptr1, &len1, &ptr2, &len2, DSBLOCK_ENTIREBUFFER)))
+    {
+        memset(ptr1, 0, len1);
+        IDirectSoundBuffer_Unlock(buf, ptr1, len1, ptr2, len2);
+    }
+}
+
+
+static void bench_create(IDirectSound8 *ds, const char *name, DWORD flags)
+{
+    IDirectSoundBuffer *buf;
+    LONGLONG total = 0, maxval = 0;
+    DWORD count = iterations / 10;
+    DWORD i;
+
+    for(i = 0;i < count;++i)
+    {
+        LONGLONG start = now_ns(), t;
+        HRESULT hr = create_buffer(ds, flags, &buf);
+        t = now_ns() - start;
+        if(FAILED(hr))
+        {
+            skip(name, hr);
+            return;
+        }
+        IDirectSoundBuffer_Release(buf);
+        total += t;
+        if(t > maxval) maxval = t;
+    }
+    report(name, 0, count, total, maxval);
+}
+
+static void bench_duplicate(IDirectSound8 *ds)
+{
+    IDirectSoundBuffer *orig, *dup;
+    LONGLONG total = 0, maxval = 0;
+    DWORD count = iterations / 10;
+    DWORD i;
+    HRESULT hr;
+
+    hr = create_buffer(ds, DSBCAPS_STATIC|DSBCAPS_CTRLVOLUME, &orig);
+    if(FAILED(hr)) { skip("duplicate", hr); return; }
+    fill_buffer(orig);
+
+    for(i = 0;i < count;++i)
+    {
+        LONGLONG start = now_ns(), t;
+        hr = IDirectSound8_DuplicateSoundBuffer(ds, orig, &dup);
+        t = now_ns() - start;
+        if(FAILED(hr))
+        {
+            skip("duplicate", hr);
+            break;
+        }
+        IDirectSoundBuffer_Release(dup);
+        total += t;
+        if(t > maxval) maxval = t;
+    }
+    if(i == count)
+        report("duplicate", 0, count, total, maxval);
+    IDirectSoundBuffer_Release(orig);
+}
+
+static void bench_lock(IDirectSound8 *ds, const char *name, DWORD flags)
+{
+    IDirectSoundBuffer *buf;
+    LONGLONG total = 0, maxval = 0;
+    DWORD ofs = 0;
+    DWORD i;
+    HRESULT hr;
+
+    hr = create_buffer(ds, flags, &buf);
+    if(FAILED(hr)) { skip(name, hr); return; }
+
+    /* Lock while playing, as a streaming app would, so the calls contend with
+     * the mixer.
+     */
+    fill_buffer(buf);
+    IDirectSoundBuffer_Play(buf, 0, 0, DSBPLAY_LOOPING);
+    for(i = 0;i < iterations;++i)
+    {
+        void *ptr1, *ptr2;
+        DWORD len1, len2;
+        LONGLONG start = now_ns(), t;
+
+        hr = IDirectSoundBuffer_Lock(buf, ofs, LOCK_BYTES, &ptr1, &len1, &ptr2, &len2, 0);
+        if(SUCCEEDED(hr))
+            hr = IDirectSoundBuffer_Unlock(buf, ptr1, len1, ptr2, len2);
+        t = now_ns() - start;
+        if(FAILED(hr))
+        {
+            skip(name, hr);
+            break;
+        }
+        total += t;
+        if(t > maxval) maxval = t;
+        ofs = (ofs + LOCK_BYTES + 4) % BUFFER_BYTES;
+    }
+    IDirectSoundBuffer_Stop(buf);
+    if(i == iterations)
+        report(name, LOCK_BYTES, iterations, total, maxval);
+    IDirectSoundBuffer_Release(buf);
+}
+
+static void bench_playstop(IDirectSound8 *ds)
+{
+    IDirectSoundBuffer *buf;
+    LONGLONG total = 0, maxval = 0;
+    DWORD count = iterations / 10;
+    DWORD i;
+    HRESULT hr;
+
+    hr = create_buffer(ds, DSBCAPS_STATIC, &buf);
+    if(FAILED(hr)) { skip("play_stop", hr); return; }
+    fill_buffer(buf);
+
+    for(i = 0;i < count;++i)
+    {
+        LONGLONG start = now_ns(), t;
+        IDirectSoundBuffer_Play(buf, 0, 0, 0);
+        IDirectSoundBuffer_Stop(buf);
+        t = now_ns() - start;
+        total += t;
+        if(t > maxval) maxval = t;
+    }
+    report("play_stop", 0, count, total, maxval);
+    IDirectSoundBuffer_Release(buf);
+}
+
+static void bench_setvolume(IDirectSound8 *ds)
+{
+    IDirectSoundBuffer *buf;
+    LONGLONG total = 0, maxval = 0;
+    DWORD i;
+    HRESULT hr;
+
+    hr = create_buffer(ds, DSBCAPS_CTRLVOLUME, &buf);
+    if(FAILED(hr)) { skip("set_volume", hr); return; }
+
+    for(i = 0;i < iterations;++i)
+    {
+        LONGLONG start = now_ns(), t;
+        IDirectSoundBuffer_SetVolume(buf, -(LONG)(i&1023));
+        t = now_ns() - start;
+        total += t;
+        if(t > maxval) maxval = t;
+    }
+    report("set_volume", 0, iterations, total, maxval);
+    IDirectSoundBuffer_Release(buf);
+}
+
+static void bench_setposition(IDirectSound8 *ds)
+{
+    IDirectSoundBuffer *buf;
+    IDirectSound3DBuffer *buf3d;
+    LONGLONG total = 0, maxval = 0;
+    DWORD i;
+    HRESULT hr;
+
+    hr = create_buffer(ds, DSBCAPS_CTRL3D, &buf);
+    if(FAILED(hr)) { skip("set_position", hr); return; }
+    hr = IDirectSoundBuffer_QueryInterface(buf, &IID_IDirectSound3DBuffer, (void**)&buf3d);
+    if(FAILED(hr))
+    {
+        skip("set_position", hr);
+        IDirectSoundBuffer_Release(buf);
+        return;
+    }
+
+    for(i = 0;i < iterations;++i)
+    {
+        LONGLONG start = now_ns(), t;
+        IDirectSound3DBuffer_SetPosition(buf3d, (float)(i&255), 0.0f, 1.0f, DS3D_IMMEDIATE);
+        t = now_ns() - start;
+        total += t;
+        if(t > maxval) maxval = t;
+    }
+    report("set_position", 0, iterations, total, maxval);
+    IDirectSound3DBuffer_Release(buf3d);
+    IDirectSoundBuffer_Release(buf);
+}
+
+static void bench_commit(IDirectSound8 *ds, DWORD nbufs)
+{
+    IDirectSoundBuffer **bufs;
+    IDirectSound3DBuffer **bufs3d;
+    IDirectSoundBuffer *primary;
+    IDirectSound3DListener *listener = NULL;
+    DSBUFFERDESC desc;
+    LONGLONG total = 0, maxval = 0;
+    DWORD count = iterations / 10;
+    DWORD made = 0, i, j;
+    HRESULT hr;
+
+    memset(&desc, 0, sizeof(desc));
+    desc.dwSize = sizeof(desc);
+    desc.dwFlags = DSBCAPS_PRIMARYBUFFER | DSBCAPS_CTRL3D;
+    hr = IDirectSound8_CreateSoundBuffer(ds, &desc, &primary, NULL);
+    if(SUCCEEDED(hr))
+    {
+        hr = IDirectSoundBuffer_QueryInterface(primary, &IID_IDirectSound3DListener,
+                                               (void**)&listener);
+        IDirectSoundBuffer_Release(primary);
+    }
+    if(FAILED(hr)) { skip("commit_deferred", hr); return; }
+
+    bufs = calloc(nbufs, sizeof(*bufs));
+    bufs3d = calloc(nbufs, sizeof(*bufs3d));
+    for(;made < nbufs;++made)
+    {
+        hr = create_buffer(ds, DSBCAPS_CTRL3D, &bufs[made]);
+        if(SUCCEEDED(hr))
+        {
+            hr = IDirectSoundBuffer_QueryInterface(bufs[made], &IID_IDirectSound3DBuffer,
+                                                   (void**)&bufs3d[made]);
+            if(FAILED(hr)) IDirectSoundBuffer_Release(bufs[made]);
+        }
+        if(FAILED(hr)) break;
+    }
+
+    if(made < nbufs)
+        skip("commit_deferred", hr);
+    else for(i = 0;i < count;++i)
+    {
+        LONGLONG start, t;
+
+        /* Only the commit is timed; the deferred sets just queue changes. */
+        for(j = 0;j < nbufs;++j)
+            IDirectSound3DBuffer_SetPosition(bufs3d[j], (float)j, (float)(i&255), 1.0f,
+                                             DS3D_DEFERRED);
+        start = now_ns();
+        IDirectSound3DListener_CommitDeferredSettings(listener);
+        t = now_ns() - start;
+        total += t;
+        if(t > maxval) maxval = t;
+    }
+    if(made == nbufs)
+        report("commit_deferred", nbufs, count, total, maxval);
+
+    while(made > 0)
+    {
+        --made;
+        IDirectSound3DBuffer_Release(bufs3d[made]);
+        IDirectSoundBuffer_Release(bufs[made]);
+    }
+    free(bufs3d);
+    free(bufs);
+    IDirectSound3DListener_Release(listener);
+}
+
+static void bench_getposition(IDirectSound8 *ds, const char *name, DWORD flags)
+{
+    IDirectSoundBuffer *buf;
+    LONGLONG total = 0, maxval = 0;
+    DWORD i;
+    HRESULT hr;
+
+    hr = create_buffer(ds, flags, &buf);
+    if(FAILED(hr)) { skip(name, hr); return; }
+    fill_buffer(buf);
+    IDirectSoundBuffer_Play(buf, 0, 0, DSBPLAY_LOOPING);
+
+    for(i = 0;i < iterations;++i)
+    {
+        DWORD play, write;
+        LONGLONG start = now_ns(), t;
+        IDirectSoundBuffer_GetCurrentPosition(buf, &play, &write);
+        t = now_ns() - start;
+        total += t;
+        if(t > maxval) maxval = t;
+    }
+    report(name, 0, iterations, total, maxval);
+    IDirectSoundBuffer_Stop(buf);
+    IDirectSoundBuffer_Release(buf);
+}
+
+static void bench_eax(IDirectSound8 *ds)
+{
+    IDirectSoundBuffer *buf;
+    IKsPropertySet *props;
+    LONGLONG settotal = 0, setmax = 0;
+    LONGLONG gettotal = 0, getmax = 0;
+    ULONG support = 0;
+    DWORD i;
+    HRESULT hr;
+
+    hr = create_buffer(ds, DSBCAPS_CTRL3D, &buf);
+    if(FAILED(hr)) { skip("eax", hr); return; }
+    hr = IDirectSoundBuffer_QueryInterface(buf, &IID_IKsPropertySet, (void**)&props);
+    if(FAILED(hr))
+    {
+        skip("eax", hr);
+        IDirectSoundBuffer_Release(buf);
+        return;
+    }
+    hr = IKsPropertySet_QuerySupport(props, &DSPROPSETID_EAX20_ListenerProperties,
+                                     DSPROPERTY_EAX20LISTENER_ROOM, &support);
+    if(FAILED(hr) || (support&(KSPROPERTY_SUPPORT_GET|KSPROPERTY_SUPPORT_SET)) !=
+                     (KSPROPERTY_SUPPORT_GET|KSPROPERTY_SUPPORT_SET))
+    {
+        skip("eax", FAILED(hr) ? hr : E_NOTIMPL);
+        goto done;
+    }
+
+    for(i = 0;i < iterations;++i)
+    {
+        LONG room = -(LONG)(i&1023);
+        ULONG retlen = 0;
+        LONGLONG start, t;
+
+        start = now_ns();
+        IKsPropertySet_Set(props, &DSPROPSETID_EAX20_ListenerProperties,
+                           DSPROPERTY_EAX20LISTENER_ROOM, NULL, 0, &room, sizeof(room));
+        t = now_ns() - start;
+        settotal += t;
+        if(t > setmax) setmax = t;
+
+        start = now_ns();
+        IKsPropertySet_Get(props, &DSPROPSETID_EAX20_ListenerProperties,
+                           DSPROPERTY_EAX20LISTENER_ROOM, NULL, 0, &room, sizeof(room),
+                           &retlen);
+        t = now_ns() - start;
+        gettotal += t;
+        if(t > getmax) getmax = t;
+    }
+    report("eax_set", 0, iterations, settotal, setmax);
+    report("eax_get", 0, iterations, gettotal, getmax);
+
+done:
+    IKsPropertySet_Release(props);
+    IDirectSoundBuffer_Release(buf);
+}
+
+static void bench_notify(IDirectSound8 *ds)
+{
+    DSBPOSITIONNOTIFY notes[8];
+    IDirectSoundBuffer *buf;
+    IDirectSoundNotify *notify;
+    HANDLE event;
+    LONGLONG total = 0, maxval = 0;
+    DWORD count = iterations / 10;
+    DWORD i;
+    HRESULT hr;
+
+    hr = create_buffer(ds, DSBCAPS_CTRLPOSITIONNOTIFY, &buf);
+    if(FAILED(hr)) { skip("set_notification_positions", hr); return; }
+    hr = IDirectSoundBuffer_QueryInterface(buf, &IID_IDirectSoundNotify, (void**)&notify);
+    if(FAILED(hr))
+    {
+        skip("set_notification_positions", hr);
+        IDirectSoundBuffer_Release(buf);
+        return;
+    }
+
+    event = CreateEventW(NULL, FALSE, FALSE, NULL);
+    for(i = 0;i < 8;++i)
+    {
+        notes[i].dwOffset = BUFFER_BYTES/8*i;
+        notes[i].hEventNotify = event;
+    }
+    for(i = 0;i < count;++i)
+    {
+        LONGLONG start = now_ns(), t;
+        IDirectSoundNotify_SetNotificationPositions(notify, 8, notes);
+        t = now_ns() - start;
+        total += t;
+        if(t > maxval) maxval = t;
+    }
+    report("set_notification_positions", 8, count, total, maxval);
+
+    CloseHandle(event);
+    IDirectSoundNotify_Release(notify);
+    IDirectSoundBuffer_Release(buf);
+}
+
+/* Time from Play until the play cursor first moves. */
+static void bench_startlatency(IDirectSound8 *ds)
+{
+    IDirectSoundBuffer *buf;
+    LONGLONG total = 0, maxval = 0;
+    DWORD count = 20;
+    DWORD i;
+    HRESULT hr;
+
+    hr = create_buffer(ds, 0, &buf);
+    if(FAILED(hr)) { skip("start_latency", hr); return; }
+    fill_buffer(buf);
+
+    for(i = 0;i < count;++i)
+    {
+        LONGLONG start, t;
+        DWORD play = 0;
+
+        IDirectSoundBuffer_SetCurrentPosition(buf, 0);
+        start = now_ns();
+        IDirectSoundBuffer_Play(buf, 0, 0, DSBPLAY_LOOPING);
+        do {
+            IDirectSoundBuffer_GetCurrentPosition(buf, &play, NULL);
+            t = now_ns() - start;
+            if(!play) Sleep(0);
+        } while(!play && t < 1000000000);
+        IDirectSoundBuffer_Stop(buf);
+
+        total += t;
+        if(t > maxval) maxval = t;
+    }
+    report("start_latency", 0, count, total, maxval);
+    IDirectSoundBuffer_Release(buf);
+}
+
+/* Captures 48khz stereo for two seconds, polling the capture position at
+ * roughly 1khz the way a voice chat client would.
+ */
+static void bench_capture(void)
+{
+    IDirectSoundCapture8 *dsc;
+    IDirectSoundCaptureBuffer *buf;
+    DSCBUFFERDESC desc;
+    WAVEFORMATEX wfx;
+    LONGLONG total = 0, maxval = 0, end;
+    DWORD count = 0;
+    HRESULT hr;
+
+    if(!pDirectSoundCaptureCreate8)
+    {
+        skip("capture_poll", E_NOTIMPL);
+        return;
+    }
+    hr = pDirectSoundCaptureCreate8(NULL, &dsc, NULL);
+    if(FAILED(hr)) { skip("capture_poll", hr); return; }
+
+    init_format(&wfx, 48000, 2);
+    memset(&desc, 0, sizeof(desc));
+    desc.dwSize = sizeof(desc);
+    desc.dwBufferBytes = wfx.nAvgBytesPerSec / 2;
+    desc.lpwfxFormat = &wfx;
+    hr = IDirectSoundCapture_CreateCaptureBuffer(dsc, &desc, &buf, NULL);
+    if(FAILED(hr))
+    {
+        skip("capture_poll", hr);
+        IDirectSoundCapture_Release(dsc);
+        return;
+    }
+
+    timeBeginPeriod(1);
+    IDirectSoundCaptureBuffer_Start(buf, DSCBSTART_LOOPING);
+    end = now_ns() + 2000000000;
+    while(now_ns() < end)
+    {
+        DWORD cappos, readpos;
+        LONGLONG start = now_ns(), t;
+        IDirectSoundCaptureBuffer_GetCurrentPosition(buf, &cappos, &readpos);
+        t = now_ns() - start;
+        total += t;
+        if(t > maxval) maxval = t;
+        ++count;
+        Sleep(1);
+    }
+    IDirectSoundCaptureBuffer_Stop(buf);
+    timeEndPeriod(1);
+
+    report("capture_poll", 48000, count, total, maxval);
+    IDirectSoundCaptureBuffer_Release(buf);
+    IDirectSoundCapture_Release(dsc);
+}
+
+static void bench_convert(const char *name, SampleConverter convert, size_t srcsize,
+                          size_t dstsize)
+{
+    const DWORD samples = 1<<20;
+    LONGLONG total = 0, maxval = 0;
+    DWORD count = 20;
+    void *src, *dst;
+    DWORD i;
+
+    src = calloc(samples, srcsize);
+    dst = calloc(samples, dstsize);
+    for(i = 0;i < count;++i)
+    {
+        LONGLONG start = now_ns(), t;
+        convert(dst, src, samples);
+        t = now_ns() - start;
+        total += t;
+        if(t > maxval) maxval = t;
+    }
+    /* Reported per sample, since that's what scales with the app's format. */
+    report(name, samples, count*samples, total, maxval/samples);
+    free(dst);
+    free(src);
+}
+
+
+int main(int argc, char *argv[])
+{
+    static const DWORD commit_counts[] = { 1, 16, 64, 128 };
+    IDirectSound8 *ds;
+    HMODULE dsound;
+    HRESULT hr;
+    int i;
+
+    out = stdout;
+    for(i = 1;i < argc;++i)
+    {
+        if(strcmp(argv[i], "-o") == 0 && i+1 < argc)
+        {
+            out = fopen(argv[++i], "w");
+            if(!out)
+            {
+                fprintf(stderr, "Failed to open %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if(strcmp(argv[i], "-n") == 0 && i+1 < argc)
+            iterations = strtoul(argv[++i], NULL, 0);
+        else
+        {
+            fprintf(stderr, "Usage: %s [-o output.csv] [-n iterations]\n", argv[0]);
+            return 1;
+        }
+    }
+    if(iterations < 10) iterations = 10;
+
+    dsound = load_dsound();
+    if(!dsound)
+        return 1;
+    CoInitialize(NULL);
+
+    hr = pDirectSoundCreate8(NULL, &ds, NULL);
+    if(FAILED(hr))
+    {
+        fprintf(stderr, "DirectSoundCreate8 failed: 0x%08lx\n", hr);
+        return 1;
+    }
+    IDirectSound8_SetCooperativeLevel(ds, GetDesktopWindow(), DSSCL_PRIORITY);
+
+    fprintf(out, "benchmark,param,iterations,ns_per_op,max_ns\n");
+    bench_create(ds, "create_static", DSBCAPS_STATIC|DSBCAPS_CTRLVOLUME);
+    bench_create(ds, "create_streaming", DSBCAPS_CTRLVOLUME|DSBCAPS_GETCURRENTPOSITION2);
+    bench_duplicate(ds);
+    bench_lock(ds, "lock_unlock_static", DSBCAPS_STATIC);
+    bench_lock(ds, "lock_unlock_streaming", DSBCAPS_GETCURRENTPOSITION2);
+    bench_playstop(ds);
+    bench_setvolume(ds);
+    bench_setposition(ds);
+    for(i = 0;i < (int)(sizeof(commit_counts)/sizeof(commit_counts[0]));++i)
+        bench_commit(ds, commit_counts[i]);
+    bench_getposition(ds, "get_position_static", DSBCAPS_STATIC|DSBCAPS_GETCURRENTPOSITION2);
+    bench_getposition(ds, "get_position_streaming", DSBCAPS_GETCURRENTPOSITION2);
+    bench_eax(ds);
+    bench_notify(ds);
+    bench_startlatency(ds);
+    IDirectSound8_Release(ds);
+
+    bench_capture();
+    bench_convert("convert_s16_f32", convert_s16_f32, sizeof(short), sizeof(float));
+    bench_convert("convert_s16_s32", convert_s16_s32, sizeof(short), sizeof(int));
+    bench_convert("convert_f32_s32", convert_f32_s32, sizeof(float), sizeof(int));
+
+    CoUninitialize();
+    FreeLibrary(dsound);
+    if(out != stdout)
+        fclose(out);
+    return 0;
+}
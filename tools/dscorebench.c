@@ -0,0 +1,243 @@
+/* DSOAL core benchmark
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/* Runs the mixer's platform-independent work (dscore.c, convert.c) the way a
+ * busy mixer tick does, with no DLL, device or OpenAL, so it can be run under
+ * perf, cachegrind or the sanitizers natively. Writes the same CSV as dsbench:
+ *
+ *   benchmark,param,iterations,ns_per_op,max_ns
+ *
+ * Each op is one simulated tick over param buffers, or for the converters,
+ * one sample.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "dscore.h"
+#include "convert.h"
+
+
+#define BUFFERS      64
+/* Not a multiple of the segment size, so looping streams wrap unevenly. */
+#define BUFFER_BYTES 65000
+#define SEGMENT      2048
+#define NOTIFIES     4
+
+static FILE *out;
+static DWORD iterations = 10000;
+/* Keeps the compiler from dropping work whose result is otherwise unused. */
+static volatile DWORD sink;
+
+
+static LONGLONG now_ns(void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+    if(!freq.QuadPart) QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return now.QuadPart/freq.QuadPart*1000000000 +
+           now.QuadPart%freq.QuadPart*1000000000/freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (LONGLONG)ts.tv_sec*1000000000 + ts.tv_nsec;
+#endif
+}
+
+static void report(const char *name, DWORD param, DWORD iters, LONGLONG total, LONGLONG maxval)
+{
+    fprintf(out, "%s,%lu,%lu,%.1f,%.1f\n", name, (unsigned long)param, (unsigned long)iters,
+            (double)total / (double)(iters ? iters : 1), (double)maxval);
+    fflush(out);
+}
+
+/* One refill per stream per tick, as DSPrimary_streamfeeder does. */
+static void bench_stream(const char *name, BOOL looping)
+{
+    static BYTE data[BUFFER_BYTES];
+    BYTE scratch[SEGMENT];
+    DWORD ofs[BUFFERS] = { 0 };
+    LONGLONG total = 0, maxval = 0;
+    DWORD i, b, sum = 0;
+
+    for(i = 0;i < BUFFER_BYTES;++i)
+        data[i] = (BYTE)i;
+    /* Stagger the streams so wraps don't all land on the same tick. */
+    for(b = 0;b < BUFFERS;++b)
+        ofs[b] = b*997 % BUFFER_BYTES;
+
+    for(i = 0;i < iterations;++i)
+    {
+        LONGLONG start = now_ns(), t;
+        for(b = 0;b < BUFFERS;++b)
+        {
+            const BYTE *seg = DSCore_StreamSegment(data, BUFFER_BYTES, &ofs[b], SEGMENT,
+                                                   looping, 0, scratch);
+            if(!seg)
+            {
+                ofs[b] = 0;
+                continue;
+            }
+            sum += seg[SEGMENT-1];
+        }
+        t = now_ns() - start;
+        total += t;
+        if(t > maxval) maxval = t;
+    }
+    sink = sum;
+    report(name, BUFFERS, iterations, total, maxval);
+}
+
+/* Position notification checks for each buffer's advance over a tick. */
+static void bench_notify(void)
+{
+    DWORD offsets[BUFFERS][NOTIFIES];
+    DWORD pos[BUFFERS];
+    LONGLONG total = 0, maxval = 0;
+    DWORD i, b, n, hits = 0;
+
+    for(b = 0;b < BUFFERS;++b)
+    {
+        pos[b] = b*997 % BUFFER_BYTES;
+        for(n = 0;n < NOTIFIES;++n)
+            offsets[b][n] = BUFFER_BYTES/NOTIFIES*n + b;
+    }
+
+    for(i = 0;i < iterations;++i)
+    {
+        LONGLONG start = now_ns(), t;
+        for(b = 0;b < BUFFERS;++b)
+        {
+            DWORD lastpos = pos[b];
+            DWORD curpos = (lastpos + 1764 + (i&63)) % BUFFER_BYTES;
+            for(n = 0;n < NOTIFIES;++n)
+                hits += DSCore_Reached(offsets[b][n], lastpos, curpos);
+            pos[b] = curpos;
+        }
+        t = now_ns() - start;
+        total += t;
+        if(t > maxval) maxval = t;
+    }
+    sink = hits;
+    report("notify_check", BUFFERS, iterations, total, maxval);
+}
+
+/* Volume, pan and frequency changes, as a CommitDeferredSettings with every
+ * buffer dirty converts them.
+ */
+static void bench_params(void)
+{
+    LONGLONG total = 0, maxval = 0;
+    float acc = 0.0f;
+    DWORD i, b;
+
+    for(i = 0;i < iterations;++i)
+    {
+        LONGLONG start = now_ns(), t;
+        for(b = 0;b < BUFFERS;++b)
+        {
+            float pos[3];
+            LONG vol = -(LONG)((i*37 + b*101) % 10000);
+            LONG pan = (LONG)((i*53 + b*211) % 20001) - 10000;
+
+            acc += mB_to_gain((float)vol);
+            DSCore_PanPosition(pan, pos);
+            acc += pos[0] + pos[2];
+            acc += DSCore_Pitch(22050 + (i+b)%22050, 44100);
+        }
+        t = now_ns() - start;
+        total += t;
+        if(t > maxval) maxval = t;
+    }
+    sink = (DWORD)acc;
+    report("param_convert", BUFFERS, iterations, total, maxval);
+}
+
+static void bench_convert(const char *name, SampleConverter convert, size_t srcsize,
+                          size_t dstsize)
+{
+    const DWORD samples = 1<<20;
+    LONGLONG total = 0, maxval = 0;
+    DWORD count = 20;
+    void *src, *dst;
+    DWORD i;
+
+    src = calloc(samples, srcsize);
+    dst = calloc(samples, dstsize);
+    for(i = 0;i < count;++i)
+    {
+        LONGLONG start = now_ns(), t;
+        convert(dst, src, samples);
+        t = now_ns() - start;
+        total += t;
+        if(t > maxval) maxval = t;
+    }
+    /* Reported per sample, since that's what scales with the app's format. */
+    report(name, samples, count*samples, total, maxval/samples);
+    free(dst);
+    free(src);
+}
+
+
+int main(int argc, char *argv[])
+{
+    int i;
+
+    out = stdout;
+    for(i = 1;i < argc;++i)
+    {
+        if(strcmp(argv[i], "-o") == 0 && i+1 < argc)
+        {
+            out = fopen(argv[++i], "w");
+            if(!out)
+            {
+                fprintf(stderr, "Failed to open %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if(strcmp(argv[i], "-n") == 0 && i+1 < argc)
+            iterations = strtoul(argv[++i], NULL, 0);
+        else
+        {
+            fprintf(stderr, "Usage: %s [-o output.csv] [-n iterations]\n", argv[0]);
+            return 1;
+        }
+    }
+    if(iterations < 10) iterations = 10;
+
+    fprintf(out, "benchmark,param,iterations,ns_per_op,max_ns\n");
+    bench_stream("stream_segment_loop", TRUE);
+    bench_stream("stream_segment_once", FALSE);
+    bench_notify();
+    bench_params();
+    bench_convert("convert_s16_f32", convert_s16_f32, sizeof(short), sizeof(float));
+    bench_convert("convert_s16_s32", convert_s16_s32, sizeof(short), sizeof(int));
+    bench_convert("convert_f32_s32", convert_f32_s32, sizeof(float), sizeof(int));
+
+    if(out != stdout)
+        fclose(out);
+    return 0;
+}
@@ -0,0 +1,593 @@
+/* DSOAL API trace replay
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/* Plays a trace recorded with DSOAL_APITRACE back through the dsound.dll next
+ * to this executable, as fast as possible or, with -realtime, at the times the
+ * calls were originally made. Calls are made in recorded order from a single
+ * thread, on the default device. Unlocks of traces recorded without
+ * DSOAL_APITRACE_DATA write silence. Reports each call's latency as CSV:
+ *
+ *   call,count,mean_ns,p50_ns,p90_ns,p99_ns,max_ns
+ *
+ * followed by the wall time of the whole replay in the mean column of an
+ * "elapsed" row, and counts of the calls that returned a different result
+ * than when recorded and of those skipped, on objects the trace never made.
+ */
+
+#define INITGUID
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <windows.h>
+#include <dsound.h>
+
+#include "apitrace.h"
+#include "common.h"
+
+
+/* Enough for every distinct object address a long session would use. */
+#define OBJECT_TABLE_SIZE 65536
+
+typedef struct Object {
+    ULONGLONG id;
+    BOOL live;
+    IDirectSound8 *ds;
+    /* The device a buffer belongs to, NULL for devices. */
+    struct Object *device;
+    IDirectSoundBuffer *buf;
+    IDirectSound3DBuffer *b3d;
+    IDirectSound3DListener *listener;
+    IDirectSoundNotify *notify;
+    IKsPropertySet *props;
+    HANDLE *events;
+    DWORD nevents;
+} Object;
+
+static Object objects[OBJECT_TABLE_SIZE];
+
+static const char *const call_names[DSTraceCallCount] = {
+    "DeviceCreate", "DeviceRelease", "SetCooperativeLevel", "CreateBuffer",
+    "DuplicateBuffer", "BufferRelease", "Play", "Stop", "SetVolume", "SetPan",
+    "SetFrequency", "SetCurrentPosition", "GetCurrentPosition", "GetStatus",
+    "SetFormat", "Unlock", "SetNotificationPositions", "3DSetPosition",
+    "3DSetVelocity", "3DSetMinDistance", "3DSetMaxDistance", "3DSetMode",
+    "3DSetConeAngles", "3DSetConeOrientation", "3DSetConeOutsideVolume",
+    "3DSetAllParameters", "ListenerSetPosition", "ListenerSetVelocity",
+    "ListenerSetOrientation", "ListenerSetDistanceFactor",
+    "ListenerSetRolloffFactor", "ListenerSetDopplerFactor",
+    "ListenerSetAllParameters", "CommitDeferredSettings", "PropertySet"
+};
+
+static Samples call_times[DSTraceCallCount];
+static DWORD mismatched, skipped;
+
+
+static float to_float(DWORD bits)
+{
+    union { DWORD d; float f; } u;
+    u.d = bits;
+    return u.f;
+}
+
+/* Finds the object with the given id, or the slot to put it in. Released
+ * objects keep their slot, since the same address is likely to come back.
+ */
+static Object *find_object(ULONGLONG id)
+{
+    DWORD idx = (DWORD)((id>>4) ^ (id>>20)) & (OBJECT_TABLE_SIZE-1);
+    DWORD n;
+
+    for(n = 0;n < OBJECT_TABLE_SIZE;++n)
+    {
+        Object *obj = &objects[(idx+n) & (OBJECT_TABLE_SIZE-1)];
+        if(obj->id == id || obj->id == 0)
+            return obj;
+    }
+    return NULL;
+}
+
+static Object *get_object(ULONGLONG id)
+{
+    Object *obj = id ? find_object(id) : NULL;
+    if(!obj || obj->id != id || !obj->live)
+        return NULL;
+    return obj;
+}
+
+/* Drops a buffer object's interfaces, releasing them if release is set. They
+ * aren't released once their device is, since DSOAL frees a device's buffers
+ * along with it.
+ */
+static void drop_object(Object *obj, BOOL release)
+{
+    DWORD i;
+
+    if(release)
+    {
+        if(obj->props) IKsPropertySet_Release(obj->props);
+        if(obj->notify) IDirectSoundNotify_Release(obj->notify);
+        if(obj->b3d) IDirectSound3DBuffer_Release(obj->b3d);
+        if(obj->listener) IDirectSound3DListener_Release(obj->listener);
+        if(obj->buf) IDirectSoundBuffer_Release(obj->buf);
+    }
+    for(i = 0;i < obj->nevents;++i)
+        CloseHandle(obj->events[i]);
+    free(obj->events);
+    obj->props = NULL;
+    obj->notify = NULL;
+    obj->b3d = NULL;
+    obj->listener = NULL;
+    obj->buf = NULL;
+    obj->events = NULL;
+    obj->nevents = 0;
+    obj->live = FALSE;
+}
+
+/* Makes a live object for a new id, dropping whatever had it before. */
+static Object *new_object(ULONGLONG id, IDirectSound8 *ds, Object *device)
+{
+    Object *obj = id ? find_object(id) : NULL;
+
+    if(!obj)
+    {
+        fprintf(stderr, "Too many objects in the trace\n");
+        exit(1);
+    }
+    if(obj->live)
+        drop_object(obj, TRUE);
+    obj->id = id;
+    obj->live = TRUE;
+    obj->ds = ds;
+    obj->device = device;
+    return obj;
+}
+
+static void add_interfaces(Object *obj, DWORD flags)
+{
+    if((flags&DSBCAPS_PRIMARYBUFFER))
+    {
+        if((flags&DSBCAPS_CTRL3D))
+            IDirectSoundBuffer_QueryInterface(obj->buf, &IID_IDirectSound3DListener,
+                                              (void**)&obj->listener);
+        return;
+    }
+    if((flags&DSBCAPS_CTRL3D))
+        IDirectSoundBuffer_QueryInterface(obj->buf, &IID_IDirectSound3DBuffer,
+                                          (void**)&obj->b3d);
+    if((flags&DSBCAPS_CTRLPOSITIONNOTIFY))
+        IDirectSoundBuffer_QueryInterface(obj->buf, &IID_IDirectSoundNotify,
+                                          (void**)&obj->notify);
+    IDirectSoundBuffer_QueryInterface(obj->buf, &IID_IKsPropertySet, (void**)&obj->props);
+}
+
+/* Gets the format in a record's payload, or NULL if it has none. A PCM
+ * format is recorded as a PCMWAVEFORMAT, so it's copied into pcm with cbSize
+ * cleared.
+ */
+static WAVEFORMATEX *record_format(const DSoalTraceRecord *rec, WAVEFORMATEX *pcm)
+{
+    WAVEFORMATEX *wfx = (WAVEFORMATEX*)(rec+1);
+
+    if(rec->size - sizeof(*rec) < sizeof(PCMWAVEFORMAT))
+        return NULL;
+    if(wfx->wFormatTag == WAVE_FORMAT_PCM)
+    {
+        memcpy(pcm, wfx, sizeof(PCMWAVEFORMAT));
+        pcm->cbSize = 0;
+        return pcm;
+    }
+    if(rec->size - sizeof(*rec) < sizeof(WAVEFORMATEX))
+        return NULL;
+    return wfx;
+}
+
+static HRESULT create_buffer(const DSoalTraceRecord *rec, Object *dev)
+{
+    IDirectSoundBuffer *buf;
+    DSBUFFERDESC desc;
+    WAVEFORMATEX pcm;
+    HRESULT hr;
+
+    memset(&desc, 0, sizeof(desc));
+    desc.dwSize = sizeof(desc);
+    desc.dwFlags = rec->args[0];
+    desc.dwBufferBytes = rec->args[1];
+    desc.lpwfxFormat = record_format(rec, &pcm);
+
+    hr = IDirectSound8_CreateSoundBuffer(dev->ds, &desc, &buf, NULL);
+    if(SUCCEEDED(hr) && rec->object2)
+    {
+        Object *obj = new_object(rec->object2, dev->ds, dev);
+        obj->buf = buf;
+        add_interfaces(obj, desc.dwFlags);
+    }
+    else if(SUCCEEDED(hr))
+        IDirectSoundBuffer_Release(buf);
+    return hr;
+}
+
+static HRESULT duplicate_buffer(const DSoalTraceRecord *rec, Object *src)
+{
+    IDirectSoundBuffer *buf;
+    DSBCAPS caps;
+    HRESULT hr;
+
+    hr = IDirectSound8_DuplicateSoundBuffer(src->ds, src->buf, &buf);
+    if(SUCCEEDED(hr) && rec->object2)
+    {
+        Object *obj = new_object(rec->object2, src->ds, src->device);
+        obj->buf = buf;
+        caps.dwSize = sizeof(caps);
+        IDirectSoundBuffer_GetCaps(buf, &caps);
+        add_interfaces(obj, caps.dwFlags);
+    }
+    else if(SUCCEEDED(hr))
+        IDirectSoundBuffer_Release(buf);
+    return hr;
+}
+
+static HRESULT unlock(const DSoalTraceRecord *rec, Object *obj, BOOL has_data)
+{
+    const BYTE *data = (const BYTE*)(rec+1);
+    void *ptr1, *ptr2;
+    DWORD len1, len2;
+    HRESULT hr;
+
+    hr = IDirectSoundBuffer_Lock(obj->buf, rec->args[0], rec->args[1] + rec->args[3],
+                                 &ptr1, &len1, &ptr2, &len2, 0);
+    if(FAILED(hr)) return hr;
+
+    if(len1 > rec->args[1]) len1 = rec->args[1];
+    if(len2 > rec->args[3]) len2 = rec->args[3];
+    if(has_data)
+    {
+        memcpy(ptr1, data, len1);
+        if(ptr2) memcpy(ptr2, data + rec->args[1], len2);
+    }
+    else
+    {
+        memset(ptr1, 0, len1);
+        if(ptr2) memset(ptr2, 0, len2);
+    }
+    return IDirectSoundBuffer_Unlock(obj->buf, ptr1, len1, ptr2, ptr2 ? len2 : 0);
+}
+
+static HRESULT set_notifications(const DSoalTraceRecord *rec, Object *obj)
+{
+    const BYTE *data = (const BYTE*)(rec+1);
+    DSBPOSITIONNOTIFY *nots;
+    DWORD count = rec->args[0], stride = rec->args[1], i;
+    HRESULT hr;
+
+    if(count == 0 || stride < sizeof(DWORD))
+        return IDirectSoundNotify_SetNotificationPositions(obj->notify, 0, NULL);
+
+    for(i = 0;i < obj->nevents;++i)
+        CloseHandle(obj->events[i]);
+    free(obj->events);
+    obj->events = calloc(count, sizeof(*obj->events));
+    obj->nevents = count;
+    nots = calloc(count, sizeof(*nots));
+    for(i = 0;i < count;++i)
+    {
+        obj->events[i] = CreateEventW(NULL, FALSE, FALSE, NULL);
+        memcpy(&nots[i].dwOffset, data + i*stride, sizeof(DWORD));
+        nots[i].hEventNotify = obj->events[i];
+    }
+    hr = IDirectSoundNotify_SetNotificationPositions(obj->notify, count, nots);
+    free(nots);
+    return hr;
+}
+
+static HRESULT replay_call(const DSoalTraceRecord *rec, BOOL has_data)
+{
+    const DWORD *a = rec->args;
+    WAVEFORMATEX pcm, *wfx;
+    Object *obj;
+    DWORD dummy[2];
+    DWORD i;
+
+    if(rec->call == DSTraceDeviceCreate)
+    {
+        IDirectSound8 *ds;
+        HRESULT hr = pDirectSoundCreate8(NULL, &ds, NULL);
+        if(SUCCEEDED(hr))
+            new_object(rec->object, ds, NULL);
+        return hr;
+    }
+
+    obj = get_object(rec->object);
+    if(!obj)
+        return S_FALSE;
+
+    switch(rec->call)
+    {
+    case DSTraceDeviceRelease:
+        if(obj->device)
+            return S_FALSE;
+        for(i = 0;i < OBJECT_TABLE_SIZE;++i)
+        {
+            if(objects[i].live && objects[i].device == obj)
+                drop_object(&objects[i], FALSE);
+        }
+        IDirectSound8_Release(obj->ds);
+        obj->ds = NULL;
+        obj->live = FALSE;
+        return DS_OK;
+    case DSTraceSetCooperativeLevel:
+        return IDirectSound8_SetCooperativeLevel(obj->ds, GetDesktopWindow(), a[0]);
+    case DSTraceCreateBuffer:
+        return create_buffer(rec, obj);
+    case DSTraceDuplicateBuffer:
+        return obj->buf ? duplicate_buffer(rec, obj) : S_FALSE;
+    case DSTraceBufferRelease:
+        if(!obj->device)
+            return S_FALSE;
+        drop_object(obj, TRUE);
+        return DS_OK;
+    }
+
+    if(!obj->buf)
+        return S_FALSE;
+    switch(rec->call)
+    {
+    case DSTracePlay:
+        return IDirectSoundBuffer_Play(obj->buf, 0, a[0], a[1]);
+    case DSTraceStop:
+        return IDirectSoundBuffer_Stop(obj->buf);
+    case DSTraceSetVolume:
+        return IDirectSoundBuffer_SetVolume(obj->buf, (LONG)a[0]);
+    case DSTraceSetPan:
+        return IDirectSoundBuffer_SetPan(obj->buf, (LONG)a[0]);
+    case DSTraceSetFrequency:
+        return IDirectSoundBuffer_SetFrequency(obj->buf, a[0]);
+    case DSTraceSetCurrentPosition:
+        return IDirectSoundBuffer_SetCurrentPosition(obj->buf, a[0]);
+    case DSTraceGetCurrentPosition:
+        return IDirectSoundBuffer_GetCurrentPosition(obj->buf, &dummy[0], &dummy[1]);
+    case DSTraceGetStatus:
+        return IDirectSoundBuffer_GetStatus(obj->buf, &dummy[0]);
+    case DSTraceSetFormat:
+        if(!(wfx = record_format(rec, &pcm)))
+            return S_FALSE;
+        return IDirectSoundBuffer_SetFormat(obj->buf, wfx);
+    case DSTraceUnlock:
+        return unlock(rec, obj, has_data);
+    case DSTraceSetNotificationPositions:
+        return obj->notify ? set_notifications(rec, obj) : S_FALSE;
+    case DSTracePropertySet:
+        if(!obj->props) return S_FALSE;
+        return IKsPropertySet_Set(obj->props, (const GUID*)&a[1], a[0], NULL, 0,
+                                  (void*)(rec+1), rec->size - sizeof(*rec));
+    }
+
+    if(obj->b3d)
+    {
+        IDirectSound3DBuffer *b3d = obj->b3d;
+        switch(rec->call)
+        {
+        case DSTrace3DSetPosition:
+            return IDirectSound3DBuffer_SetPosition(b3d, to_float(a[0]), to_float(a[1]),
+                                                    to_float(a[2]), a[3]);
+        case DSTrace3DSetVelocity:
+            return IDirectSound3DBuffer_SetVelocity(b3d, to_float(a[0]), to_float(a[1]),
+                                                    to_float(a[2]), a[3]);
+        case DSTrace3DSetMinDistance:
+            return IDirectSound3DBuffer_SetMinDistance(b3d, to_float(a[0]), a[1]);
+        case DSTrace3DSetMaxDistance:
+            return IDirectSound3DBuffer_SetMaxDistance(b3d, to_float(a[0]), a[1]);
+        case DSTrace3DSetMode:
+            return IDirectSound3DBuffer_SetMode(b3d, a[0], a[1]);
+        case DSTrace3DSetConeAngles:
+            return IDirectSound3DBuffer_SetConeAngles(b3d, a[0], a[1], a[2]);
+        case DSTrace3DSetConeOrientation:
+            return IDirectSound3DBuffer_SetConeOrientation(b3d, to_float(a[0]),
+                to_float(a[1]), to_float(a[2]), a[3]);
+        case DSTrace3DSetConeOutsideVolume:
+            return IDirectSound3DBuffer_SetConeOutsideVolume(b3d, (LONG)a[0], a[1]);
+        case DSTrace3DSetAllParameters:
+            return IDirectSound3DBuffer_SetAllParameters(b3d, (const DS3DBUFFER*)(rec+1), a[0]);
+        }
+    }
+
+    if(obj->listener)
+    {
+        IDirectSound3DListener *l = obj->listener;
+        switch(rec->call)
+        {
+        case DSTraceListenerSetPosition:
+            return IDirectSound3DListener_SetPosition(l, to_float(a[0]), to_float(a[1]),
+                                                      to_float(a[2]), a[3]);
+        case DSTraceListenerSetVelocity:
+            return IDirectSound3DListener_SetVelocity(l, to_float(a[0]), to_float(a[1]),
+                                                      to_float(a[2]), a[3]);
+        case DSTraceListenerSetOrientation:
+            return IDirectSound3DListener_SetOrientation(l, to_float(a[0]), to_float(a[1]),
+                to_float(a[2]), to_float(a[3]), to_float(a[4]), to_float(a[5]), a[6]);
+        case DSTraceListenerSetDistanceFactor:
+            return IDirectSound3DListener_SetDistanceFactor(l, to_float(a[0]), a[1]);
+        case DSTraceListenerSetRolloffFactor:
+            return IDirectSound3DListener_SetRolloffFactor(l, to_float(a[0]), a[1]);
+        case DSTraceListenerSetDopplerFactor:
+            return IDirectSound3DListener_SetDopplerFactor(l, to_float(a[0]), a[1]);
+        case DSTraceListenerSetAllParameters:
+            return IDirectSound3DListener_SetAllParameters(l, (const DS3DLISTENER*)(rec+1),
+                                                           a[0]);
+        case DSTraceCommitDeferredSettings:
+            return IDirectSound3DListener_CommitDeferredSettings(l);
+        }
+    }
+
+    return S_FALSE;
+}
+
+/* Waits until the given time since start, sleeping for most of it and
+ * spinning for the rest, since Sleep is only as accurate as the timer.
+ */
+static void wait_until(LONGLONG start, LONGLONG when)
+{
+    LONGLONG left;
+
+    while((left=start+when - now_ns()) > 0)
+    {
+        if(left > 2000000)
+            Sleep((DWORD)(left/1000000) - 1);
+    }
+}
+
+static void report(FILE *out, const char *name, Samples *s)
+{
+    if(!s->count)
+        return;
+    fprintf(out, "%s,%lu,%.1f,%.1f,%.1f,%.1f,%.1f\n", name, s->count,
+            (double)s->total / s->count, (double)samples_percentile(s, 50.0),
+            (double)samples_percentile(s, 90.0), (double)samples_percentile(s, 99.0),
+            (double)samples_percentile(s, 100.0));
+}
+
+int main(int argc, char *argv[])
+{
+    const DSoalTraceHeader *hdr;
+    const BYTE *view, *recs;
+    const char *path = NULL;
+    BOOL realtime = FALSE;
+    FILE *out = stdout;
+    LARGE_INTEGER size;
+    ULONGLONG used, ofs;
+    LONGLONG start, total;
+    HANDLE file, map;
+    DWORD calls = 0, i;
+    int a;
+
+    for(a = 1;a < argc;++a)
+    {
+        if(strcmp(argv[a], "-realtime") == 0)
+            realtime = TRUE;
+        else if(strcmp(argv[a], "-o") == 0 && a+1 < argc)
+        {
+            out = fopen(argv[++a], "w");
+            if(!out)
+            {
+                fprintf(stderr, "Failed to open %s\n", argv[a]);
+                return 1;
+            }
+        }
+        else if(argv[a][0] != '-' && !path)
+            path = argv[a];
+        else
+        {
+            path = NULL;
+            break;
+        }
+    }
+    if(!path)
+    {
+        fprintf(stderr, "Usage: %s [-realtime] [-o output.csv] trace\n", argv[0]);
+        return 1;
+    }
+
+    file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+    if(file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &size) ||
+       size.QuadPart < (LONGLONG)sizeof(*hdr))
+    {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return 1;
+    }
+    map = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    view = map ? MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if(!view)
+    {
+        fprintf(stderr, "Failed to map %s: %lu\n", path, GetLastError());
+        return 1;
+    }
+
+    hdr = (const DSoalTraceHeader*)view;
+    if(hdr->magic != DSOAL_TRACE_MAGIC || hdr->version != DSOAL_TRACE_VERSION ||
+       hdr->header_size > (ULONGLONG)size.QuadPart)
+    {
+        fprintf(stderr, "%s isn't a version %d DSOAL API trace\n", path, DSOAL_TRACE_VERSION);
+        return 1;
+    }
+    recs = view + hdr->header_size;
+    used = hdr->used;
+    if(!used)
+    {
+        /* Not finalized, so it's all zeros after the last record. */
+        used = size.QuadPart - hdr->header_size;
+        fprintf(stderr, "Trace wasn't closed cleanly; replaying up to the last record\n");
+    }
+    if(hdr->dropped)
+        fprintf(stderr, "Trace dropped %lu calls at the end\n", hdr->dropped);
+
+    if(!load_dsound())
+        return 1;
+    CoInitialize(NULL);
+
+    start = now_ns();
+    for(ofs = 0;ofs + sizeof(DSoalTraceRecord) <= used;)
+    {
+        const DSoalTraceRecord *rec = (const DSoalTraceRecord*)(recs + ofs);
+        LONGLONG t0;
+        HRESULT hr;
+
+        if(rec->size < sizeof(*rec) || rec->size > used - ofs)
+            break;
+        ofs += rec->size;
+        if(rec->call >= DSTraceCallCount)
+            continue;
+
+        if(realtime)
+            wait_until(start, rec->time);
+        t0 = now_ns();
+        hr = replay_call(rec, (hdr->flags&DSOAL_TRACE_DATA) != 0);
+        if(hr == S_FALSE)
+        {
+            ++skipped;
+            continue;
+        }
+        samples_add(&call_times[rec->call], now_ns() - t0);
+        if(hr != rec->result)
+            ++mismatched;
+        ++calls;
+    }
+    total = now_ns() - start;
+
+    fprintf(out, "call,count,mean_ns,p50_ns,p90_ns,p99_ns,max_ns\n");
+    for(i = 0;i < DSTraceCallCount;++i)
+        report(out, call_names[i], &call_times[i]);
+    fprintf(out, "elapsed,%lu,%.1f,,,,\n", calls, (double)total);
+    fprintf(out, "result_mismatches,%lu,,,,,\n", mismatched);
+    fprintf(out, "skipped,%lu,,,,,\n", skipped);
+    if(out != stdout)
+        fclose(out);
+
+    for(i = 0;i < OBJECT_TABLE_SIZE;++i)
+    {
+        if(objects[i].live && objects[i].device)
+            drop_object(&objects[i], TRUE);
+    }
+    for(i = 0;i < OBJECT_TABLE_SIZE;++i)
+    {
+        if(objects[i].live && !objects[i].device)
+            IDirectSound8_Release(objects[i].ds);
+    }
+    UnmapViewOfFile(view);
+    CloseHandle(map);
+    CloseHandle(file);
+    return 0;
+}
@@ -0,0 +1,207 @@
+/* DSOAL live statistics viewer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/* Attaches to the live statistics blocks a process running with
+ * DSOAL_LIVESTATS=1 publishes, and prints one line per device each interval.
+ * Counters are shown as rates over the interval. Devices opened after the
+ * viewer starts are picked up as they appear.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <windows.h>
+
+#include "livestats.h"
+
+typedef struct Slot {
+    HANDLE map;
+    const DSoalLiveStats *live;
+    DSoalLiveStats prev;
+    DWORD prev_time;
+} Slot;
+
+static Slot slots[DSOAL_LIVESTATS_SLOTS];
+
+static void open_slot(DWORD pid, DWORD idx)
+{
+    Slot *slot = &slots[idx];
+    char name[64];
+
+    snprintf(name, sizeof(name), DSOAL_LIVESTATS_NAME, pid, idx);
+    slot->map = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+    if(!slot->map) return;
+
+    slot->live = MapViewOfFile(slot->map, FILE_MAP_READ, 0, 0, 0);
+    if(!slot->live || slot->live->magic != DSOAL_LIVESTATS_MAGIC ||
+       slot->live->size < sizeof(DSoalLiveStats))
+    {
+        if(slot->live)
+        {
+            fprintf(stderr, "Slot %lu: unsupported statistics block (version %lu)\n", idx,
+                    slot->live->version);
+            UnmapViewOfFile(slot->live);
+        }
+        CloseHandle(slot->map);
+        slot->map = NULL;
+        slot->live = NULL;
+        return;
+    }
+    memcpy(&slot->prev, slot->live, sizeof(slot->prev));
+    slot->prev_time = GetTickCount();
+}
+
+static void close_slot(DWORD idx)
+{
+    Slot *slot = &slots[idx];
+
+    UnmapViewOfFile(slot->live);
+    CloseHandle(slot->map);
+    slot->map = NULL;
+    slot->live = NULL;
+}
+
+static double rate(DWORD cur, DWORD prev, DWORD ms)
+{
+    return (double)(cur - prev) * 1000.0 / ms;
+}
+
+static void print_header(void)
+{
+    printf("%4s %5s %5s %4s %4s %5s %9s %9s %8s %5s %8s %8s %8s %7s %8s %7s %8s\n",
+           "slot", "bufs", "play", "hw", "sw", "virt", "hw free", "sw free", "KB/s",
+           "undr", "ticks/s", "tick us", "max us", "carried", "notify/s", "lock %",
+           "eax/s");
+}
+
+static void print_slot(DWORD idx)
+{
+    Slot *slot = &slots[idx];
+    DSoalLiveStats cur;
+    DWORD now, ms;
+    DWORD ticks, acquires;
+
+    memcpy(&cur, slot->live, sizeof(cur));
+    now = GetTickCount();
+    /* The slot was reused by a newly opened device. */
+    if(cur.updates < slot->prev.updates)
+        slot->prev = cur;
+    ms = now - slot->prev_time;
+    if(ms == 0) ms = 1;
+
+    ticks = cur.ticks - slot->prev.ticks;
+    acquires = cur.lock_acquires - slot->prev.lock_acquires;
+    printf("%4lu %5lu %5lu %4lu %4lu %5lu %4lu/%-4lu %4lu/%-4lu %8.1f %5lu %8.1f %8.1f %8lu %7lu %8.1f %7.2f %8.1f\n",
+           idx, cur.buffers, cur.playing, cur.hw_voices, cur.sw_voices, cur.virtual_voices,
+           cur.hw_sources_free, cur.hw_sources_max, cur.sw_sources_free, cur.sw_sources_max,
+           rate(cur.stream_bytes, slot->prev.stream_bytes, ms) / 1024.0,
+           cur.stream_underruns - slot->prev.stream_underruns,
+           rate(cur.ticks, slot->prev.ticks, ms),
+           ticks ? (double)(cur.total_tick_us - slot->prev.total_tick_us) / ticks : 0.0,
+           cur.max_tick_us, cur.carried - slot->prev.carried,
+           rate(cur.notifications, slot->prev.notifications, ms),
+           acquires ? (cur.lock_contended - slot->prev.lock_contended) * 100.0 / acquires : 0.0,
+           rate(cur.eax_sets, slot->prev.eax_sets, ms));
+
+    slot->prev = cur;
+    slot->prev_time = now;
+}
+
+int main(int argc, char *argv[])
+{
+    DWORD pid = 0, interval = 1000, samples = 0, lines = 0, n, i;
+    BOOL dump = FALSE;
+    int a;
+
+    for(a = 1;a < argc;++a)
+    {
+        if(strcmp(argv[a], "-i") == 0 && a+1 < argc)
+            interval = strtoul(argv[++a], NULL, 0);
+        else if(strcmp(argv[a], "-n") == 0 && a+1 < argc)
+            samples = strtoul(argv[++a], NULL, 0);
+        else if(strcmp(argv[a], "-d") == 0)
+            dump = TRUE;
+        else if(argv[a][0] != '-' && !pid)
+            pid = strtoul(argv[a], NULL, 0);
+        else
+        {
+            pid = 0;
+            break;
+        }
+    }
+    if(!pid)
+    {
+        fprintf(stderr, "Usage: %s [-i interval_ms] [-n samples] [-d] pid\n"
+                "  -d  signal the process to write its DSOAL_MIXSTATS profile to the log\n",
+                argv[0]);
+        return 1;
+    }
+    if(interval < 50) interval = 50;
+
+    if(dump)
+    {
+        char name[64];
+        HANDLE evt;
+
+        snprintf(name, sizeof(name), "DSOAL_MixStatsDump.%lu", pid);
+        evt = OpenEventA(EVENT_MODIFY_STATE, FALSE, name);
+        if(!evt)
+        {
+            fprintf(stderr, "Process %lu isn't running with DSOAL_MIXSTATS\n", pid);
+            return 1;
+        }
+        SetEvent(evt);
+        CloseHandle(evt);
+        return 0;
+    }
+
+    for(n = 0;!samples || n < samples;++n)
+    {
+        DWORD active = 0;
+
+        Sleep(interval);
+        for(i = 0;i < DSOAL_LIVESTATS_SLOTS;++i)
+        {
+            if(!slots[i].live)
+            {
+                open_slot(pid, i);
+                if(!slots[i].live) continue;
+            }
+            if(!slots[i].live->active)
+            {
+                close_slot(i);
+                continue;
+            }
+
+            if(lines++ % 20 == 0)
+                print_header();
+            print_slot(i);
+            ++active;
+        }
+        if(!active)
+            printf("No active devices\n");
+        fflush(stdout);
+    }
+
+    for(i = 0;i < DSOAL_LIVESTATS_SLOTS;++i)
+    {
+        if(slots[i].live)
+            close_slot(i);
+    }
+    return 0;
+}
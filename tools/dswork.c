@@ -0,0 +1,554 @@
+/* DirectSound game workload generator
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/* Drives the dsound.dll next to this executable the way a game frame loop
+ * does: notification-driven streams on their own thread, looping 3D sources
+ * moved with deferred updates and committed once per frame, one-shots made
+ * with DuplicateSoundBuffer, and EAX occlusion changes. Reports API latency
+ * percentiles and frame timing as CSV:
+ *
+ *   metric,count,mean_ns,p50_ns,p90_ns,p99_ns,max_ns
+ *
+ * Counters are reported with only the count filled in.
+ */
+
+#define INITGUID
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <windows.h>
+#include <dsound.h>
+#include <mmsystem.h>
+
+#include "eax.h"
+#include "common.h"
+#include "fakeal.h"
+
+
+/* The stream thread waits on one event per stream, plus the quit event. */
+#define MAX_STREAMS    (MAXIMUM_WAIT_OBJECTS-1)
+#define MAX_ONESHOTS   256
+#define STREAM_NOTIFIES 4
+
+typedef struct Scenario {
+    DWORD seconds;
+    DWORD fps;
+    DWORD streams;
+    DWORD sources;
+    DWORD oneshots;
+    DWORD occlusions;
+} Scenario;
+
+typedef struct Stream {
+    IDirectSoundBuffer *buf;
+    HANDLE event;
+    DWORD size;
+    DWORD writepos;
+    DWORD lastplay;
+    DWORD phase;
+} Stream;
+
+typedef struct Source {
+    IDirectSoundBuffer *buf;
+    IDirectSound3DBuffer *buf3d;
+    IKsPropertySet *props;
+} Source;
+
+static Scenario scenario = { 10, 60, 4, 32, 20, 4 };
+
+static Stream streams[MAX_STREAMS];
+static HANDLE stream_quit;
+static DWORD late_refills;
+static Samples stream_lock_times;
+
+static Samples commit_times, dup_times, play_times, occlusion_times;
+static Samples frame_work_times, frame_lateness;
+
+
+static void init_format(WAVEFORMATEX *wfx, WORD channels)
+{
+    memset(wfx, 0, sizeof(*wfx));
+    wfx->wFormatTag = WAVE_FORMAT_PCM;
+    wfx->nChannels = channels;
+    wfx->nSamplesPerSec = 44100;
+    wfx->wBitsPerSample = 16;
+    wfx->nBlockAlign = channels * 2;
+    wfx->nAvgBytesPerSec = 44100 * wfx->nBlockAlign;
+}
+
+static HRESULT create_buffer(IDirectSound8 *ds, DWORD flags, DWORD bytes, IDirectSoundBuffer **buf)
+{
+    DSBUFFERDESC desc;
+    WAVEFORMATEX wfx;
+
+    init_format(&wfx, (flags&DSBCAPS_CTRL3D) ? 1 : 2);
+    memset(&desc, 0, sizeof(desc));
+    desc.dwSize = sizeof(desc);
+    desc.dwFlags = flags;
+    desc.dwBufferBytes = bytes;
+    desc.lpwfxFormat = &wfx;
+    return IDirectSound8_CreateSoundBuffer(ds, &desc, buf, NULL);
+}
+
+/* Fills with a quiet tone, so the output is audible but not unpleasant when
+ * running against a real device.
+ */
+static void write_tone(short *data, DWORD count, DWORD *phase)
+{
+    DWORD i;
+    for(i = 0;i < count;++i)
+    {
+        data[i] = (short)(sin(*phase * 0.0314) * 1000.0);
+        *phase = (*phase + 1) % 200;
+    }
+}
+
+static void fill_buffer(IDirectSoundBuffer *buf)
+{
+    void *ptr1, *ptr2;
+    DWORD len1, len2, phase = 0;
+
+    if(SUCCEEDED(IDirectSoundBuffer_Lock(buf, 0, 0, &ptr1, &len1, &ptr2, &len2, DSBLOCK_ENTIREBUFFER)))
+    {
+        write_tone(ptr1, len1/sizeof(short), &phase);
+        IDirectSoundBuffer_Unlock(buf, ptr1, len1, ptr2, len2);
+    }
+}
+
+static void report(FILE *out, const char *name, Samples *s)
+{
+    if(!s->count)
+        return;
+    fprintf(out, "%s,%lu,%.1f,%.1f,%.1f,%.1f,%.1f\n", name, s->count,
+            (double)s->total / s->count, (double)samples_percentile(s, 50.0),
+            (double)samples_percentile(s, 90.0), (double)samples_percentile(s, 99.0),
+            (double)samples_percentile(s, 100.0));
+}
+
+static void report_count(FILE *out, const char *name, DWORD count)
+{
+    fprintf(out, "%s,%lu,,,,,\n", name, count);
+}
+
+
+/* Refills everything the play cursor has moved past since the last refill.
+ * If it moved through most of the buffer, the refill came too late for some
+ * of it to be heard.
+ */
+static void stream_refill(Stream *stream)
+{
+    void *ptr1, *ptr2;
+    DWORD len1, len2, play, todo;
+    LONGLONG start, t;
+
+    if(FAILED(IDirectSoundBuffer_GetCurrentPosition(stream->buf, &play, NULL)))
+        return;
+    if((play + stream->size - stream->lastplay) % stream->size > stream->size/STREAM_NOTIFIES*3)
+        late_refills++;
+    stream->lastplay = play;
+
+    todo = (play + stream->size - stream->writepos) % stream->size;
+    if(!todo) return;
+
+    start = now_ns();
+    if(SUCCEEDED(IDirectSoundBuffer_Lock(stream->buf, stream->writepos, todo, &ptr1, &len1,
+                                         &ptr2, &len2, 0)))
+    {
+        t = now_ns() - start;
+        write_tone(ptr1, len1/sizeof(short), &stream->phase);
+        if(ptr2) write_tone(ptr2, len2/sizeof(short), &stream->phase);
+        start = now_ns();
+        IDirectSoundBuffer_Unlock(stream->buf, ptr1, len1, ptr2, len2);
+        samples_add(&stream_lock_times, t + now_ns() - start);
+        stream->writepos = play;
+    }
+}
+
+static DWORD CALLBACK stream_thread(void *arg)
+{
+    HANDLE events[MAXIMUM_WAIT_OBJECTS];
+    DWORD count = scenario.streams;
+    DWORD i, ret;
+
+    (void)arg;
+    events[0] = stream_quit;
+    for(i = 0;i < count;++i)
+        events[i+1] = streams[i].event;
+
+    while((ret=WaitForMultipleObjects(count+1, events, FALSE, INFINITE)) != WAIT_OBJECT_0)
+    {
+        if(ret > WAIT_OBJECT_0 && ret <= WAIT_OBJECT_0+count)
+            stream_refill(&streams[ret-WAIT_OBJECT_0-1]);
+        else
+            break;
+    }
+    return 0;
+}
+
+static HRESULT stream_start(IDirectSound8 *ds, Stream *stream)
+{
+    DSBPOSITIONNOTIFY notes[STREAM_NOTIFIES];
+    IDirectSoundNotify *notify;
+    HRESULT hr;
+    DWORD i;
+
+    /* One second, with a notification at each quarter. */
+    stream->size = 44100 * 4;
+    hr = create_buffer(ds, DSBCAPS_CTRLPOSITIONNOTIFY|DSBCAPS_GETCURRENTPOSITION2|
+                           DSBCAPS_CTRLVOLUME, stream->size, &stream->buf);
+    if(FAILED(hr)) return hr;
+
+    stream->event = CreateEventW(NULL, FALSE, FALSE, NULL);
+    for(i = 0;i < STREAM_NOTIFIES;++i)
+    {
+        notes[i].dwOffset = stream->size/STREAM_NOTIFIES*i;
+        notes[i].hEventNotify = stream->event;
+    }
+    hr = IDirectSoundBuffer_QueryInterface(stream->buf, &IID_IDirectSoundNotify, (void**)&notify);
+    if(SUCCEEDED(hr))
+    {
+        hr = IDirectSoundNotify_SetNotificationPositions(notify, STREAM_NOTIFIES, notes);
+        IDirectSoundNotify_Release(notify);
+    }
+    if(FAILED(hr)) return hr;
+
+    fill_buffer(stream->buf);
+    stream->writepos = stream->lastplay = 0;
+    return IDirectSoundBuffer_Play(stream->buf, 0, 0, DSBPLAY_LOOPING);
+}
+
+
+static HRESULT source_init(IDirectSound8 *ds, IDirectSoundBuffer *orig, Source *src)
+{
+    HRESULT hr;
+
+    memset(src, 0, sizeof(*src));
+    hr = IDirectSound8_DuplicateSoundBuffer(ds, orig, &src->buf);
+    if(FAILED(hr)) return hr;
+    hr = IDirectSoundBuffer_QueryInterface(src->buf, &IID_IDirectSound3DBuffer, (void**)&src->buf3d);
+    if(FAILED(hr)) return hr;
+    /* EAX may not be available, in which case occlusion updates are skipped. */
+    if(FAILED(IDirectSoundBuffer_QueryInterface(src->buf, &IID_IKsPropertySet, (void**)&src->props)))
+        src->props = NULL;
+    return S_OK;
+}
+
+static void source_release(Source *src)
+{
+    if(src->props) IKsPropertySet_Release(src->props);
+    if(src->buf3d) IDirectSound3DBuffer_Release(src->buf3d);
+    if(src->buf) IDirectSoundBuffer_Release(src->buf);
+}
+
+static void run_frames(IDirectSound8 *ds, IDirectSound3DListener *listener, IDirectSoundBuffer *loop,
+                       IDirectSoundBuffer *shot, DWORD *played, DWORD *dropped)
+{
+    Source *sources = calloc(scenario.sources, sizeof(*sources));
+    IDirectSoundBuffer *active[MAX_ONESHOTS];
+    const LONGLONG frame_ns = 1000000000 / scenario.fps;
+    const DWORD frames = scenario.seconds * scenario.fps;
+    DWORD nsources = 0, nactive = 0, occl_idx = 0;
+    double due = 0.0;
+    LONGLONG next;
+    DWORD frame, i;
+
+    for(;nsources < scenario.sources;++nsources)
+    {
+        if(FAILED(source_init(ds, loop, &sources[nsources])))
+        {
+            source_release(&sources[nsources]);
+            fprintf(stderr, "Only %lu of %lu 3D sources could be made\n", nsources,
+                    scenario.sources);
+            break;
+        }
+        IDirectSoundBuffer_Play(sources[nsources].buf, 0, 0, DSBPLAY_LOOPING);
+    }
+
+    next = now_ns();
+    for(frame = 0;frame < frames;++frame)
+    {
+        const float angle = (float)frame / scenario.fps;
+        LONGLONG start = now_ns(), t;
+
+        /* Move the listener and every source, then apply it all at once. */
+        IDirectSound3DListener_SetOrientation(listener, sinf(angle), 0.0f, cosf(angle),
+                                              0.0f, 1.0f, 0.0f, DS3D_DEFERRED);
+        for(i = 0;i < nsources;++i)
+        {
+            const float a = angle + (float)i;
+            IDirectSound3DBuffer_SetPosition(sources[i].buf3d, cosf(a)*(1.0f+i), 0.0f,
+                                             sinf(a)*(1.0f+i), DS3D_DEFERRED);
+        }
+        for(i = 0;i < scenario.occlusions && nsources > 0;++i)
+        {
+            Source *src = &sources[occl_idx++ % nsources];
+            LONG occlusion = -(LONG)((frame*37 + i*101) % 5000);
+            if(!src->props) continue;
+            t = now_ns();
+            IKsPropertySet_Set(src->props, &DSPROPSETID_EAX20_BufferProperties,
+                               DSPROPERTY_EAX20BUFFER_OCCLUSION, NULL, 0, &occlusion,
+                               sizeof(occlusion));
+            samples_add(&occlusion_times, now_ns() - t);
+        }
+        t = now_ns();
+        IDirectSound3DListener_CommitDeferredSettings(listener);
+        samples_add(&commit_times, now_ns() - t);
+
+        /* Reap finished one-shots, then start the ones due this frame. */
+        for(i = 0;i < nactive;)
+        {
+            DWORD status = 0;
+            IDirectSoundBuffer_GetStatus(active[i], &status);
+            if(!(status&DSBSTATUS_PLAYING))
+            {
+                IDirectSoundBuffer_Release(active[i]);
+                active[i] = active[--nactive];
+            }
+            else
+                ++i;
+        }
+        due += (double)scenario.oneshots / scenario.fps;
+        for(;due >= 1.0;due -= 1.0)
+        {
+            IDirectSoundBuffer *dup;
+            IDirectSound3DBuffer *dup3d;
+
+            if(nactive == MAX_ONESHOTS)
+            {
+                (*dropped)++;
+                continue;
+            }
+            t = now_ns();
+            if(FAILED(IDirectSound8_DuplicateSoundBuffer(ds, shot, &dup)))
+            {
+                (*dropped)++;
+                continue;
+            }
+            samples_add(&dup_times, now_ns() - t);
+            if(SUCCEEDED(IDirectSoundBuffer_QueryInterface(dup, &IID_IDirectSound3DBuffer,
+                                                           (void**)&dup3d)))
+            {
+                IDirectSound3DBuffer_SetPosition(dup3d, (float)(frame%16), 0.0f, 2.0f,
+                                                 DS3D_IMMEDIATE);
+                IDirectSound3DBuffer_Release(dup3d);
+            }
+            t = now_ns();
+            IDirectSoundBuffer_Play(dup, 0, 0, 0);
+            samples_add(&play_times, now_ns() - t);
+            active[nactive++] = dup;
+            (*played)++;
+        }
+
+        t = now_ns();
+        samples_add(&frame_work_times, t - start);
+
+        /* Wait for the next frame, and note how late it was when we woke. */
+        next += frame_ns;
+        if(next > t)
+            Sleep((DWORD)((next - t) / 1000000));
+        t = now_ns();
+        samples_add(&frame_lateness, (t > next) ? t - next : 0);
+        if(t - next > frame_ns)
+            next = t;
+    }
+
+    while(nactive > 0)
+        IDirectSoundBuffer_Release(active[--nactive]);
+    while(nsources > 0)
+        source_release(&sources[--nsources]);
+    free(sources);
+}
+
+
+static BOOL parse_args(int argc, char *argv[], FILE **out)
+{
+    int i;
+
+    for(i = 1;i < argc;++i)
+    {
+        DWORD *opt = NULL;
+
+        if(strcmp(argv[i], "-o") == 0 && i+1 < argc)
+        {
+            *out = fopen(argv[++i], "w");
+            if(!*out)
+            {
+                fprintf(stderr, "Failed to open %s\n", argv[i]);
+                return FALSE;
+            }
+            continue;
+        }
+        if(strcmp(argv[i], "-seconds") == 0) opt = &scenario.seconds;
+        else if(strcmp(argv[i], "-fps") == 0) opt = &scenario.fps;
+        else if(strcmp(argv[i], "-streams") == 0) opt = &scenario.streams;
+        else if(strcmp(argv[i], "-sources") == 0) opt = &scenario.sources;
+        else if(strcmp(argv[i], "-oneshots") == 0) opt = &scenario.oneshots;
+        else if(strcmp(argv[i], "-occlusions") == 0) opt = &scenario.occlusions;
+        if(!opt || i+1 >= argc)
+        {
+            fprintf(stderr, "Usage: %s [-o output.csv] [-seconds n] [-fps n] [-streams n]\n"
+                            "    [-sources n] [-oneshots per_second] [-occlusions per_frame]\n",
+                    argv[0]);
+            return FALSE;
+        }
+        *opt = strtoul(argv[++i], NULL, 0);
+    }
+
+    if(scenario.fps < 1) scenario.fps = 1;
+    if(scenario.streams > MAX_STREAMS)
+    {
+        fprintf(stderr, "Limiting to %d streams\n", MAX_STREAMS);
+        scenario.streams = MAX_STREAMS;
+    }
+    return TRUE;
+}
+
+int main(int argc, char *argv[])
+{
+    IDirectSoundBuffer *primary, *loop = NULL, *shot = NULL;
+    IDirectSound3DListener *listener = NULL;
+    IDirectSound8 *ds;
+    DSBUFFERDESC desc;
+    HANDLE thread = NULL;
+    DWORD played = 0, dropped = 0, nstreams = 0, tid;
+    LPFAKEALRESET fake_reset;
+    LPFAKEALCALLCOUNT fake_count;
+    ULONG al_calls = 0;
+    FILE *out = stdout;
+    HMODULE dsound;
+    HRESULT hr;
+
+    if(!parse_args(argc, argv, &out))
+        return 1;
+
+    dsound = load_dsound();
+    if(!dsound)
+        return 1;
+    CoInitialize(NULL);
+
+    hr = pDirectSoundCreate8(NULL, &ds, NULL);
+    if(FAILED(hr))
+    {
+        fprintf(stderr, "DirectSoundCreate8 failed: 0x%08lx\n", hr);
+        return 1;
+    }
+    IDirectSound8_SetCooperativeLevel(ds, GetDesktopWindow(), DSSCL_PRIORITY);
+
+    memset(&desc, 0, sizeof(desc));
+    desc.dwSize = sizeof(desc);
+    desc.dwFlags = DSBCAPS_PRIMARYBUFFER | DSBCAPS_CTRL3D;
+    hr = IDirectSound8_CreateSoundBuffer(ds, &desc, &primary, NULL);
+    if(SUCCEEDED(hr))
+    {
+        hr = IDirectSoundBuffer_QueryInterface(primary, &IID_IDirectSound3DListener,
+                                               (void**)&listener);
+        IDirectSoundBuffer_Release(primary);
+    }
+    /* A half-second loop for the persistent sources, and a quarter-second
+     * one-shot to duplicate.
+     */
+    if(SUCCEEDED(hr))
+        hr = create_buffer(ds, DSBCAPS_CTRL3D|DSBCAPS_STATIC|DSBCAPS_CTRLVOLUME, 44100, &loop);
+    if(SUCCEEDED(hr))
+        hr = create_buffer(ds, DSBCAPS_CTRL3D|DSBCAPS_STATIC|DSBCAPS_CTRLVOLUME, 22050, &shot);
+    if(FAILED(hr))
+    {
+        fprintf(stderr, "Failed to set up the scene: 0x%08lx\n", hr);
+        return 1;
+    }
+    fill_buffer(loop);
+    fill_buffer(shot);
+
+    for(;nstreams < scenario.streams;++nstreams)
+    {
+        hr = stream_start(ds, &streams[nstreams]);
+        if(FAILED(hr))
+        {
+            fprintf(stderr, "Failed to start stream %lu: 0x%08lx\n", nstreams, hr);
+            if(streams[nstreams].buf) IDirectSoundBuffer_Release(streams[nstreams].buf);
+            if(streams[nstreams].event) CloseHandle(streams[nstreams].event);
+            break;
+        }
+    }
+    scenario.streams = nstreams;
+    stream_quit = CreateEventW(NULL, FALSE, FALSE, NULL);
+    if(nstreams > 0)
+        thread = CreateThread(NULL, 0, stream_thread, NULL, 0, &tid);
+
+    /* When running on the recording driver, count the AL calls made during
+     * the frames.
+     */
+    fake_reset = (LPFAKEALRESET)GetProcAddress(GetModuleHandleW(L"dsoal-aldrv.dll"),
+                                               "fakeal_reset");
+    fake_count = (LPFAKEALCALLCOUNT)GetProcAddress(GetModuleHandleW(L"dsoal-aldrv.dll"),
+                                                   "fakeal_call_count");
+    if(fake_reset && fake_count)
+        fake_reset();
+
+    timeBeginPeriod(1);
+    run_frames(ds, listener, loop, shot, &played, &dropped);
+    timeEndPeriod(1);
+
+    if(fake_reset && fake_count)
+        al_calls = fake_count(NULL);
+
+    SetEvent(stream_quit);
+    if(thread)
+    {
+        WaitForSingleObject(thread, INFINITE);
+        CloseHandle(thread);
+    }
+    CloseHandle(stream_quit);
+    while(nstreams > 0)
+    {
+        --nstreams;
+        IDirectSoundBuffer_Stop(streams[nstreams].buf);
+        IDirectSoundBuffer_Release(streams[nstreams].buf);
+        CloseHandle(streams[nstreams].event);
+    }
+
+    fprintf(out, "metric,count,mean_ns,p50_ns,p90_ns,p99_ns,max_ns\n");
+    report(out, "frame_work", &frame_work_times);
+    report(out, "frame_lateness", &frame_lateness);
+    report(out, "commit_deferred", &commit_times);
+    report(out, "duplicate", &dup_times);
+    report(out, "play", &play_times);
+    report(out, "eax_occlusion_set", &occlusion_times);
+    report(out, "stream_lock_unlock", &stream_lock_times);
+    report_count(out, "oneshots_played", played);
+    report_count(out, "oneshots_dropped", dropped);
+    report_count(out, "late_refills", late_refills);
+    if(fake_reset && fake_count)
+    {
+        report_count(out, "al_calls", al_calls);
+        fprintf(out, "al_calls_per_frame,%lu,%.1f,,,,\n", scenario.seconds*scenario.fps,
+                (double)al_calls / (scenario.seconds*scenario.fps));
+    }
+
+    IDirectSoundBuffer_Release(shot);
+    IDirectSoundBuffer_Release(loop);
+    IDirectSound3DListener_Release(listener);
+    IDirectSound8_Release(ds);
+    CoUninitialize();
+    FreeLibrary(dsound);
+    if(out != stdout)
+        fclose(out);
+    return 0;
+}
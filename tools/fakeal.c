@@ -0,0 +1,1538 @@
+/* Recording OpenAL driver for DSOAL tests
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <float.h>
+
+#include <windows.h>
+
+#define AL_API __declspec(dllexport)
+#define ALC_API __declspec(dllexport)
+#include "al.h"
+#include "alc.h"
+
+#include "fakeal.h"
+
+#define FAKEAL_API __declspec(dllexport)
+
+
+#define MAX_FAKE_SOURCES 1024
+#define MAX_FAKE_BUFFERS 8192
+#define MAX_FAKE_QUEUE   16
+#define MAX_FAKE_PARAMS  24
+#define MAX_FAKE_FUNCS   128
+#define MAX_RECORDED     (1<<20)
+#define RECORD_LEN       112
+/* Records are allocated in chunks as they're needed, so their text stays put
+ * as more are added.
+ */
+#define RECORD_CHUNK     4096
+
+#define FAKE_FREQUENCY 44100
+#define FAKE_REFRESH   50
+#define FAKE_MONO      255
+#define FAKE_STEREO    1
+
+typedef struct FakeParam {
+    ALenum param;
+    ALfloat vals[6];
+} FakeParam;
+
+typedef struct FakeParams {
+    FakeParam params[MAX_FAKE_PARAMS];
+    ALsizei count;
+} FakeParams;
+
+typedef struct FakeBuffer {
+    ALboolean used;
+    ALint freq, channels, bits;
+    ALsizei size, frames;
+} FakeBuffer;
+
+/* Positions are in frames counted from the start of the first buffer ever
+ * queued: base is where the current queue starts (buffers before it were
+ * unqueued), and a playing source is at origin plus the time since start_ns.
+ */
+typedef struct FakeSource {
+    ALboolean used;
+    ALenum state;
+    ALenum type;
+    ALboolean looping;
+    ALuint queue[MAX_FAKE_QUEUE];
+    ALsizei nqueued;
+    ULONGLONG base, origin, cur;
+    LONGLONG start_ns;
+    ALsizei pending;
+    FakeParams params;
+} FakeSource;
+
+typedef struct FakeDevice {
+    ALboolean capture;
+    ALCint refresh, mono, stereo, freq;
+    /* Capture only. */
+    ALCsizei cap_size, cap_framesize;
+    BYTE cap_silence;
+    ALboolean capturing;
+    LONGLONG cap_start_ns;
+    ULONGLONG cap_taken;
+} FakeDevice;
+
+typedef struct FakeContext {
+    FakeDevice *device;
+} FakeContext;
+
+typedef struct FakeCall {
+    const char *func;
+    ULONG count;
+} FakeCall;
+
+
+static CRITICAL_SECTION fake_crst;
+static HMODULE fake_module;
+
+static FakeSource sources[MAX_FAKE_SOURCES];
+static FakeBuffer buffers[MAX_FAKE_BUFFERS];
+static FakeParams listener;
+static FakeContext *current_ctx;
+static ALenum al_error = AL_NO_ERROR;
+static ALCenum alc_error = ALC_NO_ERROR;
+
+static FakeCall call_counts[MAX_FAKE_FUNCS];
+static ULONG num_counted, total_calls;
+static char (*records[MAX_RECORDED/RECORD_CHUNK])[RECORD_LEN];
+static ULONG num_records;
+
+static BOOL manual_clock;
+static LONGLONG manual_ns;
+static LARGE_INTEGER qpc_freq;
+
+
+static LONGLONG clock_ns(void)
+{
+    LARGE_INTEGER cnt;
+    if(manual_clock)
+        return manual_ns;
+    QueryPerformanceCounter(&cnt);
+    return cnt.QuadPart / qpc_freq.QuadPart * 1000000000 +
+           cnt.QuadPart % qpc_freq.QuadPart * 1000000000 / qpc_freq.QuadPart;
+}
+
+/* Counts and records a call. Must be called with fake_crst held. */
+static void record(const char *func, const char *fmt, ...)
+{
+    ULONG i;
+
+    total_calls++;
+    for(i = 0;i < num_counted;++i)
+    {
+        if(call_counts[i].func == func)
+            break;
+    }
+    if(i == num_counted && num_counted < MAX_FAKE_FUNCS)
+        call_counts[num_counted++].func = func;
+    if(i < num_counted)
+        call_counts[i].count++;
+
+    if(num_records >= MAX_RECORDED)
+        return;
+    i = num_records / RECORD_CHUNK;
+    if(!records[i])
+        records[i] = HeapAlloc(GetProcessHeap(), 0, sizeof(*records[i]) * RECORD_CHUNK);
+    if(records[i])
+    {
+        char *text = records[i][num_records++ % RECORD_CHUNK];
+        int len = snprintf(text, RECORD_LEN, "%s(", func);
+        va_list args;
+
+        if(len < 0 || len >= RECORD_LEN-2) len = RECORD_LEN-2;
+        va_start(args, fmt);
+        vsnprintf(text+len, RECORD_LEN-len-1, fmt, args);
+        va_end(args);
+        text[RECORD_LEN-2] = 0;
+        strcat(text, ")");
+    }
+}
+
+#define RECORD(...) record(__func__, __VA_ARGS__)
+#define LOCK() EnterCriticalSection(&fake_crst)
+#define UNLOCK() LeaveCriticalSection(&fake_crst)
+
+static void set_error(ALenum err)
+{
+    if(al_error == AL_NO_ERROR)
+        al_error = err;
+}
+
+
+static FakeSource *get_source(ALuint id)
+{
+    if(id == 0 || id > MAX_FAKE_SOURCES || !sources[id-1].used)
+        return NULL;
+    return &sources[id-1];
+}
+
+static FakeBuffer *get_buffer(ALuint id)
+{
+    if(id == 0 || id > MAX_FAKE_BUFFERS || !buffers[id-1].used)
+        return NULL;
+    return &buffers[id-1];
+}
+
+static ALsizei frame_size(FakeBuffer *buf)
+{
+    return buf->channels * buf->bits / 8;
+}
+
+static ULONGLONG queue_frames(FakeSource *src)
+{
+    ULONGLONG total = 0;
+    ALsizei i;
+    for(i = 0;i < src->nqueued;++i)
+        total += buffers[src->queue[i]-1].frames;
+    return total;
+}
+
+static FakeBuffer *first_buffer(FakeSource *src)
+{
+    return src->nqueued ? &buffers[src->queue[0]-1] : NULL;
+}
+
+/* Brings a playing source's position up to the clock, looping or stopping
+ * at the end of its queue.
+ */
+static void source_update(FakeSource *src)
+{
+    FakeBuffer *buf = first_buffer(src);
+    ULONGLONG end;
+    LONGLONG now;
+
+    if(src->state != AL_PLAYING || !buf || buf->freq <= 0)
+        return;
+
+    now = clock_ns();
+    src->cur = src->origin + (ULONGLONG)(now - src->start_ns) * buf->freq / 1000000000;
+    end = src->base + queue_frames(src);
+    if(src->cur < end)
+        return;
+
+    if(src->looping && end > src->base)
+    {
+        src->cur = src->base + (src->cur - src->base) % (end - src->base);
+        src->origin = src->cur;
+        src->start_ns = now;
+    }
+    else
+    {
+        src->state = AL_STOPPED;
+        src->cur = src->origin = end;
+    }
+}
+
+/* The index of the buffer being played and the frame offset into the queue,
+ * or 0s when not playing or paused.
+ */
+static void source_position(FakeSource *src, ALsizei *idx, ULONGLONG *offset)
+{
+    ULONGLONG pos;
+    ALsizei i;
+
+    *idx = 0;
+    *offset = 0;
+    source_update(src);
+    if(src->state == AL_STOPPED)
+        *idx = src->nqueued;
+    if(src->state != AL_PLAYING && src->state != AL_PAUSED)
+        return;
+
+    pos = src->cur - src->base;
+    *offset = pos;
+    for(i = 0;i < src->nqueued;++i)
+    {
+        ALsizei frames = buffers[src->queue[i]-1].frames;
+        if(pos < (ULONGLONG)frames)
+            break;
+        pos -= frames;
+    }
+    *idx = i;
+}
+
+static void source_play(FakeSource *src)
+{
+    source_update(src);
+    if(src->state != AL_PAUSED)
+        src->origin = src->cur = src->base + src->pending;
+    src->pending = 0;
+    src->start_ns = clock_ns();
+    src->state = src->nqueued ? AL_PLAYING : AL_STOPPED;
+}
+
+static void source_pause(FakeSource *src)
+{
+    source_update(src);
+    if(src->state == AL_PLAYING)
+    {
+        src->origin = src->cur;
+        src->state = AL_PAUSED;
+    }
+}
+
+static void source_stop(FakeSource *src)
+{
+    source_update(src);
+    if(src->state != AL_INITIAL)
+    {
+        src->state = AL_STOPPED;
+        src->cur = src->origin = src->base + queue_frames(src);
+    }
+    src->pending = 0;
+}
+
+static void source_rewind(FakeSource *src)
+{
+    src->state = AL_INITIAL;
+    src->cur = src->origin = src->base;
+    src->pending = 0;
+}
+
+static void source_setoffset(FakeSource *src, ALsizei frames)
+{
+    source_update(src);
+    if(src->state == AL_PLAYING || src->state == AL_PAUSED)
+    {
+        src->origin = src->cur = src->base + frames;
+        src->start_ns = clock_ns();
+    }
+    else
+        src->pending = frames;
+}
+
+
+static FakeParam *find_param(FakeParams *params, ALenum param, ALboolean add)
+{
+    ALsizei i;
+    for(i = 0;i < params->count;++i)
+    {
+        if(params->params[i].param == param)
+            return &params->params[i];
+    }
+    if(!add || params->count == MAX_FAKE_PARAMS)
+        return NULL;
+    params->params[i].param = param;
+    params->count++;
+    return &params->params[i];
+}
+
+static void set_param(FakeParams *params, ALenum param, const ALfloat *vals, ALsizei count)
+{
+    FakeParam *p = find_param(params, param, AL_TRUE);
+    if(p) memcpy(p->vals, vals, count*sizeof(*vals));
+}
+
+static void get_param(FakeParams *params, ALenum param, ALfloat *vals, ALsizei count)
+{
+    static const ALfloat orientation[6] = { 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f };
+    FakeParam *p = find_param(params, param, AL_FALSE);
+    ALsizei i;
+
+    if(p)
+    {
+        memcpy(vals, p->vals, count*sizeof(*vals));
+        return;
+    }
+    for(i = 0;i < count;++i)
+    {
+        switch(param)
+        {
+            case AL_GAIN: case AL_MAX_GAIN: case AL_PITCH:
+            case AL_REFERENCE_DISTANCE: case AL_ROLLOFF_FACTOR:
+                vals[i] = 1.0f; break;
+            case AL_MAX_DISTANCE: vals[i] = FLT_MAX; break;
+            case AL_CONE_INNER_ANGLE: case AL_CONE_OUTER_ANGLE: vals[i] = 360.0f; break;
+            case AL_ORIENTATION: vals[i] = orientation[i]; break;
+            default: vals[i] = 0.0f;
+        }
+    }
+}
+
+/* Source parameters with behavior of their own. Returns false for ones that
+ * are just stored.
+ */
+static ALboolean source_seti(FakeSource *src, ALenum param, ALint value)
+{
+    FakeBuffer *buf;
+
+    switch(param)
+    {
+    case AL_LOOPING:
+        source_update(src);
+        src->looping = value ? AL_TRUE : AL_FALSE;
+        return AL_TRUE;
+    case AL_BUFFER:
+        if(value && !get_buffer(value))
+        {
+            set_error(AL_INVALID_VALUE);
+            return AL_TRUE;
+        }
+        src->nqueued = 0;
+        if(value) src->queue[src->nqueued++] = value;
+        src->type = value ? AL_STATIC : AL_UNDETERMINED;
+        src->base = src->origin = src->cur = 0;
+        src->state = AL_INITIAL;
+        return AL_TRUE;
+    case AL_BYTE_OFFSET:
+        if((buf=first_buffer(src)) != NULL)
+            source_setoffset(src, value / frame_size(buf));
+        return AL_TRUE;
+    case AL_SAMPLE_OFFSET:
+        source_setoffset(src, value);
+        return AL_TRUE;
+    }
+    return AL_FALSE;
+}
+
+static ALboolean source_geti(FakeSource *src, ALenum param, ALint *value)
+{
+    FakeBuffer *buf = first_buffer(src);
+    ULONGLONG offset;
+    ALsizei idx;
+
+    switch(param)
+    {
+    case AL_SOURCE_STATE:
+        source_update(src);
+        *value = src->state;
+        return AL_TRUE;
+    case AL_SOURCE_TYPE:
+        *value = src->type;
+        return AL_TRUE;
+    case AL_LOOPING:
+        *value = src->looping;
+        return AL_TRUE;
+    case AL_BUFFER:
+        source_position(src, &idx, &offset);
+        *value = (idx < src->nqueued) ? (ALint)src->queue[idx] : 0;
+        return AL_TRUE;
+    case AL_BUFFERS_QUEUED:
+        *value = src->nqueued;
+        return AL_TRUE;
+    case AL_BUFFERS_PROCESSED:
+        source_position(src, &idx, &offset);
+        *value = src->looping ? 0 : idx;
+        return AL_TRUE;
+    case AL_BYTE_OFFSET:
+        source_position(src, &idx, &offset);
+        *value = buf ? (ALint)(offset * frame_size(buf)) : 0;
+        return AL_TRUE;
+    case AL_SAMPLE_OFFSET:
+        source_position(src, &idx, &offset);
+        *value = (ALint)offset;
+        return AL_TRUE;
+    }
+    return AL_FALSE;
+}
+
+
+/* Test interface. */
+FAKEAL_API void __cdecl fakeal_reset(void)
+{
+    LOCK();
+    memset(call_counts, 0, sizeof(call_counts));
+    num_counted = total_calls = 0;
+    num_records = 0;
+    UNLOCK();
+}
+
+FAKEAL_API ULONG __cdecl fakeal_call_count(const char *name)
+{
+    ULONG count = 0, i;
+
+    LOCK();
+    if(!name)
+        count = total_calls;
+    else for(i = 0;i < num_counted;++i)
+    {
+        if(strcmp(call_counts[i].func, name) == 0)
+        {
+            count = call_counts[i].count;
+            break;
+        }
+    }
+    UNLOCK();
+    return count;
+}
+
+FAKEAL_API ULONG __cdecl fakeal_num_calls(void)
+{
+    ULONG count;
+
+    LOCK();
+    count = num_records;
+    UNLOCK();
+    return count;
+}
+
+FAKEAL_API const char* __cdecl fakeal_get_call(ULONG idx)
+{
+    const char *text = NULL;
+
+    LOCK();
+    if(idx < num_records)
+        text = records[idx / RECORD_CHUNK][idx % RECORD_CHUNK];
+    UNLOCK();
+    return text;
+}
+
+FAKEAL_API void __cdecl fakeal_set_manual_clock(BOOL manual)
+{
+    LONGLONG now;
+    ALsizei i;
+
+    LOCK();
+    if(!manual != !manual_clock)
+    {
+        /* Rebase playing sources on the new clock, so they carry on from
+         * where they are.
+         */
+        for(i = 0;i < MAX_FAKE_SOURCES;++i)
+        {
+            if(sources[i].used && sources[i].state == AL_PLAYING)
+            {
+                source_update(&sources[i]);
+                sources[i].origin = sources[i].cur;
+            }
+        }
+        now = clock_ns();
+        manual_clock = manual;
+        if(manual) manual_ns = now;
+        for(i = 0;i < MAX_FAKE_SOURCES;++i)
+            sources[i].start_ns = now;
+    }
+    UNLOCK();
+}
+
+FAKEAL_API void __cdecl fakeal_advance_clock(ULONGLONG nanoseconds)
+{
+    LOCK();
+    manual_ns += nanoseconds;
+    UNLOCK();
+}
+
+
+/* Devices and contexts. */
+ALC_API ALCdevice* ALC_APIENTRY alcOpenDevice(const ALCchar *devicename)
+{
+    FakeDevice *dev;
+
+    LOCK();
+    RECORD("\"%s\"", devicename ? devicename : "");
+    dev = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*dev));
+    if(dev)
+    {
+        dev->refresh = FAKE_REFRESH;
+        dev->mono = FAKE_MONO;
+        dev->stereo = FAKE_STEREO;
+        dev->freq = FAKE_FREQUENCY;
+    }
+    UNLOCK();
+    return (ALCdevice*)dev;
+}
+
+ALC_API ALCboolean ALC_APIENTRY alcCloseDevice(ALCdevice *device)
+{
+    LOCK();
+    RECORD("%p", device);
+    HeapFree(GetProcessHeap(), 0, device);
+    UNLOCK();
+    return ALC_TRUE;
+}
+
+ALC_API ALCcontext* ALC_APIENTRY alcCreateContext(ALCdevice *device, const ALCint *attrlist)
+{
+    FakeDevice *dev = (FakeDevice*)device;
+    FakeContext *ctx;
+
+    LOCK();
+    RECORD("%p, %p", device, attrlist);
+    while(attrlist && attrlist[0])
+    {
+        if(attrlist[0] == ALC_REFRESH && attrlist[1] > 0)
+            dev->refresh = attrlist[1];
+        else if(attrlist[0] == ALC_FREQUENCY && attrlist[1] > 0)
+            dev->freq = attrlist[1];
+        else if(attrlist[0] == ALC_MONO_SOURCES)
+            dev->mono = (attrlist[1] < MAX_FAKE_SOURCES) ? attrlist[1] : MAX_FAKE_SOURCES-1;
+        attrlist += 2;
+    }
+    dev->stereo = MAX_FAKE_SOURCES - dev->mono;
+    if(dev->stereo > FAKE_STEREO) dev->stereo = FAKE_STEREO;
+    ctx = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*ctx));
+    if(ctx) ctx->device = dev;
+    UNLOCK();
+    return (ALCcontext*)ctx;
+}
+
+ALC_API ALCboolean ALC_APIENTRY alcMakeContextCurrent(ALCcontext *context)
+{
+    LOCK();
+    RECORD("%p", context);
+    current_ctx = (FakeContext*)context;
+    UNLOCK();
+    return ALC_TRUE;
+}
+
+ALC_API void ALC_APIENTRY alcProcessContext(ALCcontext *context)
+{
+    LOCK();
+    RECORD("%p", context);
+    UNLOCK();
+}
+
+ALC_API void ALC_APIENTRY alcSuspendContext(ALCcontext *context)
+{
+    LOCK();
+    RECORD("%p", context);
+    UNLOCK();
+}
+
+ALC_API void ALC_APIENTRY alcDestroyContext(ALCcontext *context)
+{
+    LOCK();
+    RECORD("%p", context);
+    if(current_ctx == (FakeContext*)context)
+        current_ctx = NULL;
+    HeapFree(GetProcessHeap(), 0, context);
+    UNLOCK();
+}
+
+ALC_API ALCcontext* ALC_APIENTRY alcGetCurrentContext(void)
+{
+    ALCcontext *ctx;
+    LOCK();
+    RECORD("");
+    ctx = (ALCcontext*)current_ctx;
+    UNLOCK();
+    return ctx;
+}
+
+ALC_API ALCdevice* ALC_APIENTRY alcGetContextsDevice(ALCcontext *context)
+{
+    ALCdevice *dev;
+    LOCK();
+    RECORD("%p", context);
+    dev = context ? (ALCdevice*)((FakeContext*)context)->device : NULL;
+    UNLOCK();
+    return dev;
+}
+
+ALC_API ALCenum ALC_APIENTRY alcGetError(ALCdevice *device)
+{
+    ALCenum err;
+    LOCK();
+    RECORD("%p", device);
+    err = alc_error;
+    alc_error = ALC_NO_ERROR;
+    UNLOCK();
+    return err;
+}
+
+ALC_API ALCboolean ALC_APIENTRY alcIsExtensionPresent(ALCdevice *device, const ALCchar *extname)
+{
+    LOCK();
+    RECORD("%p, \"%s\"", device, extname ? extname : "");
+    UNLOCK();
+    return ALC_FALSE;
+}
+
+/* Only the exports are available, so a test can find the fakeal_ functions
+ * this way too.
+ */
+ALC_API void* ALC_APIENTRY alcGetProcAddress(ALCdevice *device, const ALCchar *funcname)
+{
+    void *proc;
+    LOCK();
+    RECORD("%p, \"%s\"", device, funcname ? funcname : "");
+    proc = funcname ? (void*)GetProcAddress(fake_module, funcname) : NULL;
+    UNLOCK();
+    return proc;
+}
+
+ALC_API ALCenum ALC_APIENTRY alcGetEnumValue(ALCdevice *device, const ALCchar *enumname)
+{
+    LOCK();
+    RECORD("%p, \"%s\"", device, enumname ? enumname : "");
+    UNLOCK();
+    return 0;
+}
+
+ALC_API const ALCchar* ALC_APIENTRY alcGetString(ALCdevice *device, ALCenum param)
+{
+    const ALCchar *ret = "";
+
+    LOCK();
+    RECORD("%p, 0x%04x", device, param);
+    switch(param)
+    {
+    case ALC_DEVICE_SPECIFIER:
+    case ALC_DEFAULT_DEVICE_SPECIFIER:
+        ret = device ? "Fake Device" : "Fake Device\0";
+        break;
+    case ALC_CAPTURE_DEVICE_SPECIFIER:
+    case ALC_CAPTURE_DEFAULT_DEVICE_SPECIFIER:
+        ret = device ? "Fake Capture" : "Fake Capture\0";
+        break;
+    case ALC_NO_ERROR: ret = "No Error"; break;
+    case ALC_INVALID_DEVICE: ret = "Invalid Device"; break;
+    case ALC_INVALID_CONTEXT: ret = "Invalid Context"; break;
+    case ALC_INVALID_ENUM: ret = "Invalid Enum"; break;
+    case ALC_INVALID_VALUE: ret = "Invalid Value"; break;
+    case ALC_OUT_OF_MEMORY: ret = "Out of Memory"; break;
+    }
+    UNLOCK();
+    return ret;
+}
+
+static ALCint capture_available(FakeDevice *dev)
+{
+    ULONGLONG captured;
+
+    if(!dev->capturing)
+        return 0;
+    captured = (ULONGLONG)(clock_ns() - dev->cap_start_ns) * dev->freq / 1000000000;
+    if(captured - dev->cap_taken > (ULONGLONG)dev->cap_size)
+        dev->cap_taken = captured - dev->cap_size;
+    return (ALCint)(captured - dev->cap_taken);
+}
+
+ALC_API void ALC_APIENTRY alcGetIntegerv(ALCdevice *device, ALCenum param, ALCsizei size, ALCint *values)
+{
+    FakeDevice *dev = (FakeDevice*)device;
+
+    LOCK();
+    RECORD("%p, 0x%04x, %d", device, param, size);
+    if(!values || size < 1)
+        alc_error = ALC_INVALID_VALUE;
+    else switch(param)
+    {
+    case ALC_MAJOR_VERSION: values[0] = 1; break;
+    case ALC_MINOR_VERSION: values[0] = 1; break;
+    case ALC_REFRESH: values[0] = dev ? dev->refresh : 0; break;
+    case ALC_FREQUENCY: values[0] = dev ? dev->freq : 0; break;
+    case ALC_MONO_SOURCES: values[0] = dev ? dev->mono : 0; break;
+    case ALC_STEREO_SOURCES: values[0] = dev ? dev->stereo : 0; break;
+    case ALC_CAPTURE_SAMPLES: values[0] = (dev && dev->capture) ? capture_available(dev) : 0; break;
+    default:
+        values[0] = 0;
+        alc_error = ALC_INVALID_ENUM;
+    }
+    UNLOCK();
+}
+
+ALC_API ALCdevice* ALC_APIENTRY alcCaptureOpenDevice(const ALCchar *devicename, ALCuint frequency, ALCenum format, ALCsizei buffersize)
+{
+    FakeDevice *dev;
+    ALCsizei framesize;
+
+    LOCK();
+    RECORD("\"%s\", %u, 0x%04x, %d", devicename ? devicename : "", frequency, format, buffersize);
+    switch(format)
+    {
+    case AL_FORMAT_MONO8: framesize = 1; break;
+    case AL_FORMAT_MONO16: case AL_FORMAT_STEREO8: framesize = 2; break;
+    case AL_FORMAT_STEREO16: framesize = 4; break;
+    default: framesize = 0;
+    }
+    dev = framesize ? HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*dev)) : NULL;
+    if(dev)
+    {
+        dev->capture = AL_TRUE;
+        dev->freq = frequency;
+        dev->cap_size = buffersize;
+        dev->cap_framesize = framesize;
+        dev->cap_silence = (format == AL_FORMAT_MONO8 || format == AL_FORMAT_STEREO8) ? 0x80 : 0;
+    }
+    else
+        alc_error = ALC_INVALID_VALUE;
+    UNLOCK();
+    return (ALCdevice*)dev;
+}
+
+ALC_API ALCboolean ALC_APIENTRY alcCaptureCloseDevice(ALCdevice *device)
+{
+    LOCK();
+    RECORD("%p", device);
+    HeapFree(GetProcessHeap(), 0, device);
+    UNLOCK();
+    return ALC_TRUE;
+}
+
+ALC_API void ALC_APIENTRY alcCaptureStart(ALCdevice *device)
+{
+    FakeDevice *dev = (FakeDevice*)device;
+    LOCK();
+    RECORD("%p", device);
+    if(!dev->capturing)
+    {
+        dev->capturing = AL_TRUE;
+        dev->cap_start_ns = clock_ns();
+        dev->cap_taken = 0;
+    }
+    UNLOCK();
+}
+
+ALC_API void ALC_APIENTRY alcCaptureStop(ALCdevice *device)
+{
+    FakeDevice *dev = (FakeDevice*)device;
+    LOCK();
+    RECORD("%p", device);
+    dev->capturing = AL_FALSE;
+    UNLOCK();
+}
+
+/* Captures silence. */
+ALC_API void ALC_APIENTRY alcCaptureSamples(ALCdevice *device, ALCvoid *buffer, ALCsizei samples)
+{
+    FakeDevice *dev = (FakeDevice*)device;
+    LOCK();
+    RECORD("%p, %p, %d", device, buffer, samples);
+    if(samples > capture_available(dev))
+        alc_error = ALC_INVALID_VALUE;
+    else
+    {
+        memset(buffer, dev->cap_silence, (size_t)samples * dev->cap_framesize);
+        dev->cap_taken += samples;
+    }
+    UNLOCK();
+}
+
+
+/* Global state. */
+AL_API void AL_APIENTRY alEnable(ALenum capability)
+{ LOCK(); RECORD("0x%04x", capability); UNLOCK(); }
+AL_API void AL_APIENTRY alDisable(ALenum capability)
+{ LOCK(); RECORD("0x%04x", capability); UNLOCK(); }
+AL_API ALboolean AL_APIENTRY alIsEnabled(ALenum capability)
+{ LOCK(); RECORD("0x%04x", capability); UNLOCK(); return AL_FALSE; }
+
+AL_API const ALchar* AL_APIENTRY alGetString(ALenum param)
+{
+    const ALchar *ret = "";
+    LOCK();
+    RECORD("0x%04x", param);
+    switch(param)
+    {
+    case AL_VENDOR: ret = "DSOAL"; break;
+    case AL_VERSION: ret = "1.1 fake"; break;
+    case AL_RENDERER: ret = "Recording fake driver"; break;
+    case AL_EXTENSIONS: ret = ""; break;
+    default: set_error(AL_INVALID_ENUM);
+    }
+    UNLOCK();
+    return ret;
+}
+
+static ALdouble get_state(ALenum param)
+{
+    switch(param)
+    {
+    case AL_DOPPLER_FACTOR: case AL_DOPPLER_VELOCITY: return 1.0;
+    case AL_SPEED_OF_SOUND: return 343.3;
+    case AL_DISTANCE_MODEL: return AL_INVERSE_DISTANCE_CLAMPED;
+    }
+    set_error(AL_INVALID_ENUM);
+    return 0.0;
+}
+
+AL_API void AL_APIENTRY alGetBooleanv(ALenum param, ALboolean *values)
+{ LOCK(); RECORD("0x%04x", param); *values = get_state(param) != 0.0; UNLOCK(); }
+AL_API void AL_APIENTRY alGetIntegerv(ALenum param, ALint *values)
+{ LOCK(); RECORD("0x%04x", param); *values = (ALint)get_state(param); UNLOCK(); }
+AL_API void AL_APIENTRY alGetFloatv(ALenum param, ALfloat *values)
+{ LOCK(); RECORD("0x%04x", param); *values = (ALfloat)get_state(param); UNLOCK(); }
+AL_API void AL_APIENTRY alGetDoublev(ALenum param, ALdouble *values)
+{ LOCK(); RECORD("0x%04x", param); *values = get_state(param); UNLOCK(); }
+
+AL_API ALboolean AL_APIENTRY alGetBoolean(ALenum param)
+{ ALboolean ret; LOCK(); RECORD("0x%04x", param); ret = get_state(param) != 0.0; UNLOCK(); return ret; }
+AL_API ALint AL_APIENTRY alGetInteger(ALenum param)
+{ ALint ret; LOCK(); RECORD("0x%04x", param); ret = (ALint)get_state(param); UNLOCK(); return ret; }
+AL_API ALfloat AL_APIENTRY alGetFloat(ALenum param)
+{ ALfloat ret; LOCK(); RECORD("0x%04x", param); ret = (ALfloat)get_state(param); UNLOCK(); return ret; }
+AL_API ALdouble AL_APIENTRY alGetDouble(ALenum param)
+{ ALdouble ret; LOCK(); RECORD("0x%04x", param); ret = get_state(param); UNLOCK(); return ret; }
+
+AL_API ALenum AL_APIENTRY alGetError(void)
+{
+    ALenum err;
+    LOCK();
+    RECORD("");
+    err = al_error;
+    al_error = AL_NO_ERROR;
+    UNLOCK();
+    return err;
+}
+
+AL_API ALboolean AL_APIENTRY alIsExtensionPresent(const ALchar *extname)
+{
+    LOCK();
+    RECORD("\"%s\"", extname ? extname : "");
+    UNLOCK();
+    return AL_FALSE;
+}
+
+AL_API void* AL_APIENTRY alGetProcAddress(const ALchar *fname)
+{
+    void *proc;
+    LOCK();
+    RECORD("\"%s\"", fname ? fname : "");
+    proc = fname ? (void*)GetProcAddress(fake_module, fname) : NULL;
+    UNLOCK();
+    return proc;
+}
+
+AL_API ALenum AL_APIENTRY alGetEnumValue(const ALchar *ename)
+{
+    static const struct {
+        const char *name;
+        ALenum value;
+    } formats[] = {
+        { "AL_FORMAT_MONO8", AL_FORMAT_MONO8 },
+        { "AL_FORMAT_MONO16", AL_FORMAT_MONO16 },
+        { "AL_FORMAT_STEREO8", AL_FORMAT_STEREO8 },
+        { "AL_FORMAT_STEREO16", AL_FORMAT_STEREO16 },
+    };
+    ALenum ret = 0;
+    size_t i;
+
+    LOCK();
+    RECORD("\"%s\"", ename ? ename : "");
+    for(i = 0;ename && i < sizeof(formats)/sizeof(formats[0]);++i)
+    {
+        if(strcmp(formats[i].name, ename) == 0)
+            ret = formats[i].value;
+    }
+    UNLOCK();
+    return ret;
+}
+
+AL_API void AL_APIENTRY alDopplerFactor(ALfloat value)
+{ LOCK(); RECORD("%g", value); UNLOCK(); }
+AL_API void AL_APIENTRY alDopplerVelocity(ALfloat value)
+{ LOCK(); RECORD("%g", value); UNLOCK(); }
+AL_API void AL_APIENTRY alSpeedOfSound(ALfloat value)
+{ LOCK(); RECORD("%g", value); UNLOCK(); }
+AL_API void AL_APIENTRY alDistanceModel(ALenum distanceModel)
+{ LOCK(); RECORD("0x%04x", distanceModel); UNLOCK(); }
+
+
+/* Listener. */
+AL_API void AL_APIENTRY alListenerf(ALenum param, ALfloat value)
+{ LOCK(); RECORD("0x%04x, %g", param, value); set_param(&listener, param, &value, 1); UNLOCK(); }
+
+AL_API void AL_APIENTRY alListener3f(ALenum param, ALfloat value1, ALfloat value2, ALfloat value3)
+{
+    ALfloat vals[3] = { value1, value2, value3 };
+    LOCK();
+    RECORD("0x%04x, %g, %g, %g", param, value1, value2, value3);
+    set_param(&listener, param, vals, 3);
+    UNLOCK();
+}
+
+AL_API void AL_APIENTRY alListenerfv(ALenum param, const ALfloat *values)
+{
+    LOCK();
+    RECORD("0x%04x, {%g, %g, %g, ...}", param, values[0], values[1], values[2]);
+    set_param(&listener, param, values, (param == AL_ORIENTATION) ? 6 : 3);
+    UNLOCK();
+}
+
+AL_API void AL_APIENTRY alListeneri(ALenum param, ALint value)
+{
+    ALfloat val = (ALfloat)value;
+    LOCK(); RECORD("0x%04x, %d", param, value); set_param(&listener, param, &val, 1); UNLOCK();
+}
+
+AL_API void AL_APIENTRY alListener3i(ALenum param, ALint value1, ALint value2, ALint value3)
+{
+    ALfloat vals[3] = { (ALfloat)value1, (ALfloat)value2, (ALfloat)value3 };
+    LOCK();
+    RECORD("0x%04x, %d, %d, %d", param, value1, value2, value3);
+    set_param(&listener, param, vals, 3);
+    UNLOCK();
+}
+
+AL_API void AL_APIENTRY alListeneriv(ALenum param, const ALint *values)
+{
+    ALfloat vals[6];
+    ALsizei count = (param == AL_ORIENTATION) ? 6 : 3, i;
+    for(i = 0;i < count;++i)
+        vals[i] = (ALfloat)values[i];
+    LOCK();
+    RECORD("0x%04x, {%d, %d, %d, ...}", param, values[0], values[1], values[2]);
+    set_param(&listener, param, vals, count);
+    UNLOCK();
+}
+
+AL_API void AL_APIENTRY alGetListenerf(ALenum param, ALfloat *value)
+{ LOCK(); RECORD("0x%04x", param); get_param(&listener, param, value, 1); UNLOCK(); }
+
+AL_API void AL_APIENTRY alGetListener3f(ALenum param, ALfloat *value1, ALfloat *value2, ALfloat *value3)
+{
+    ALfloat vals[3];
+    LOCK();
+    RECORD("0x%04x", param);
+    get_param(&listener, param, vals, 3);
+    UNLOCK();
+    *value1 = vals[0]; *value2 = vals[1]; *value3 = vals[2];
+}
+
+AL_API void AL_APIENTRY alGetListenerfv(ALenum param, ALfloat *values)
+{
+    LOCK();
+    RECORD("0x%04x", param);
+    get_param(&listener, param, values, (param == AL_ORIENTATION) ? 6 : 3);
+    UNLOCK();
+}
+
+AL_API void AL_APIENTRY alGetListeneri(ALenum param, ALint *value)
+{
+    ALfloat val;
+    LOCK(); RECORD("0x%04x", param); get_param(&listener, param, &val, 1); UNLOCK();
+    *value = (ALint)val;
+}
+
+AL_API void AL_APIENTRY alGetListener3i(ALenum param, ALint *value1, ALint *value2, ALint *value3)
+{
+    ALfloat vals[3];
+    LOCK(); RECORD("0x%04x", param); get_param(&listener, param, vals, 3); UNLOCK();
+    *value1 = (ALint)vals[0]; *value2 = (ALint)vals[1]; *value3 = (ALint)vals[2];
+}
+
+AL_API void AL_APIENTRY alGetListeneriv(ALenum param, ALint *values)
+{
+    ALfloat vals[6];
+    ALsizei count = (param == AL_ORIENTATION) ? 6 : 3, i;
+    LOCK(); RECORD("0x%04x", param); get_param(&listener, param, vals, count); UNLOCK();
+    for(i = 0;i < count;++i)
+        values[i] = (ALint)vals[i];
+}
+
+
+/* Sources. */
+AL_API void AL_APIENTRY alGenSources(ALsizei n, ALuint *ids)
+{
+    ALsizei i, j = 0;
+
+    LOCK();
+    RECORD("%d", n);
+    for(i = 0;i < MAX_FAKE_SOURCES && j < n;++i)
+    {
+        if(sources[i].used) continue;
+        memset(&sources[i], 0, sizeof(sources[i]));
+        sources[i].used = AL_TRUE;
+        sources[i].state = AL_INITIAL;
+        sources[i].type = AL_UNDETERMINED;
+        ids[j++] = i+1;
+    }
+    if(j < n)
+    {
+        while(j > 0)
+            sources[ids[--j]-1].used = AL_FALSE;
+        set_error(AL_OUT_OF_MEMORY);
+    }
+    UNLOCK();
+}
+
+AL_API void AL_APIENTRY alDeleteSources(ALsizei n, const ALuint *ids)
+{
+    ALsizei i;
+    LOCK();
+    RECORD("%d, {%u, ...}", n, n > 0 ? ids[0] : 0);
+    for(i = 0;i < n;++i)
+    {
+        FakeSource *src = get_source(ids[i]);
+        if(src) src->used = AL_FALSE;
+        else set_error(AL_INVALID_NAME);
+    }
+    UNLOCK();
+}
+
+AL_API ALboolean AL_APIENTRY alIsSource(ALuint source)
+{
+    ALboolean ret;
+    LOCK(); RECORD("%u", source); ret = get_source(source) != NULL; UNLOCK();
+    return ret;
+}
+
+/* Looks up the source for a call, flagging an error if it's invalid. */
+#define GET_SOURCE(src, id) do {               \
+    if(((src) = get_source(id)) == NULL)       \
+    {                                          \
+        set_error(AL_INVALID_NAME);            \
+        UNLOCK();                              \
+        return;                                \
+    }                                          \
+} while(0)
+
+AL_API void AL_APIENTRY alSourcef(ALuint source, ALenum param, ALfloat value)
+{
+    FakeSource *src;
+    LOCK();
+    RECORD("%u, 0x%04x, %g", source, param, value);
+    GET_SOURCE(src, source);
+    if(param == AL_SEC_OFFSET)
+    {
+        FakeBuffer *buf = first_buffer(src);
+        if(buf) source_setoffset(src, (ALsizei)(value * buf->freq));
+    }
+    else
+        set_param(&src->params, param, &value, 1);
+    UNLOCK();
+}
+
+AL_API void AL_APIENTRY alSource3f(ALuint source, ALenum param, ALfloat value1, ALfloat value2, ALfloat value3)
+{
+    ALfloat vals[3] = { value1, value2, value3 };
+    FakeSource *src;
+    LOCK();
+    RECORD("%u, 0x%04x, %g, %g, %g", source, param, value1, value2, value3);
+    GET_SOURCE(src, source);
+    set_param(&src->params, param, vals, 3);
+    UNLOCK();
+}
+
+AL_API void AL_APIENTRY alSourcefv(ALuint source, ALenum param, const ALfloat *values)
+{
+    FakeSource *src;
+    LOCK();
+    RECORD("%u, 0x%04x, {%g, ...}", source, param, values[0]);
+    GET_SOURCE(src, source);
+    set_param(&src->params, param, values, 3);
+    UNLOCK();
+}
+
+AL_API void AL_APIENTRY alSourcei(ALuint source, ALenum param, ALint value)
+{
+    FakeSource *src;
+    LOCK();
+    RECORD("%u, 0x%04x, %d", source, param, value);
+    GET_SOURCE(src, source);
+    if(!source_seti(src, param, value))
+    {
+        ALfloat val = (ALfloat)value;
+        set_param(&src->params, param, &val, 1);
+    }
+    UNLOCK();
+}
+
+AL_API void AL_APIENTRY alSource3i(ALuint source, ALenum param, ALint value1, ALint value2, ALint value3)
+{
+    ALfloat vals[3] = { (ALfloat)value1, (ALfloat)value2, (ALfloat)value3 };
+    FakeSource *src;
+    LOCK();
+    RECORD("%u, 0x%04x, %d, %d, %d", source, param, value1, value2, value3);
+    GET_SOURCE(src, source);
+    set_param(&src->params, param, vals, 3);
+    UNLOCK();
+}
+
+AL_API void AL_APIENTRY alSourceiv(ALuint source, ALenum param, const ALint *values)
+{
+    FakeSource *src;
+    LOCK();
+    RECORD("%u, 0x%04x, {%d, ...}", source, param, values[0]);
+    GET_SOURCE(src, source);
+    if(!source_seti(src, param, values[0]))
+    {
+        ALfloat vals[3] = { (ALfloat)values[0], (ALfloat)values[1], (ALfloat)values[2] };
+        set_param(&src->params, param, vals, 3);
+    }
+    UNLOCK();
+}
+
+AL_API void AL_APIENTRY alGetSourcef(ALuint source, ALenum param, ALfloat *value)
+{
+    FakeSource *src;
+    ALint ival;
+    LOCK();
+    RECORD("%u, 0x%04x", source, param);
+    GET_SOURCE(src, source);
+    if(param == AL_SEC_OFFSET)
+    {
+        FakeBuffer *buf = first_buffer(src);
+        source_geti(src, AL_SAMPLE_OFFSET, &ival);
+        *value = (buf && buf->freq) ? (ALfloat)ival / buf->freq : 0.0f;
+    }
+    else if(source_geti(src, param, &ival))
+        *value = (ALfloat)ival;
+    else
+        get_param(&src->params, param, value, 1);
+    UNLOCK();
+}
+
+AL_API void AL_APIENTRY alGetSource3f(ALuint source, ALenum param, ALfloat *value1, ALfloat *value2, ALfloat *value3)
+{
+    ALfloat vals[3];
+    FakeSource *src;
+    LOCK();
+    RECORD("%u, 0x%04x", source, param);
+    GET_SOURCE(src, source);
+    get_param(&src->params, param, vals, 3);
+    UNLOCK();
+    *value1 = vals[0]; *value2 = vals[1]; *value3 = vals[2];
+}
+
+AL_API void AL_APIENTRY alGetSourcefv(ALuint source, ALenum param, ALfloat *values)
+{
+    FakeSource *src;
+    LOCK();
+    RECORD("%u, 0x%04x", source, param);
+    GET_SOURCE(src, source);
+    get_param(&src->params, param, values, 3);
+    UNLOCK();
+}
+
+AL_API void AL_APIENTRY alGetSourcei(ALuint source, ALenum param, ALint *value)
+{
+    FakeSource *src;
+    LOCK();
+    RECORD("%u, 0x%04x", source, param);
+    GET_SOURCE(src, source);
+    if(!source_geti(src, param, value))
+    {
+        ALfloat val;
+        get_param(&src->params, param, &val, 1);
+        *value = (ALint)val;
+    }
+    UNLOCK();
+}
+
+AL_API void AL_APIENTRY alGetSource3i(ALuint source, ALenum param, ALint *value1, ALint *value2, ALint *value3)
+{
+    ALfloat vals[3];
+    FakeSource *src;
+    LOCK();
+    RECORD("%u, 0x%04x", source, param);
+    GET_SOURCE(src, source);
+    get_param(&src->params, param, vals, 3);
+    UNLOCK();
+    *value1 = (ALint)vals[0]; *value2 = (ALint)vals[1]; *value3 = (ALint)vals[2];
+}
+
+AL_API void AL_APIENTRY alGetSourceiv(ALuint source, ALenum param, ALint *values)
+{
+    FakeSource *src;
+    LOCK();
+    RECORD("%u, 0x%04x", source, param);
+    GET_SOURCE(src, source);
+    if(!source_geti(src, param, values))
+    {
+        ALfloat vals[3];
+        get_param(&src->params, param, vals, 3);
+        values[0] = (ALint)vals[0]; values[1] = (ALint)vals[1]; values[2] = (ALint)vals[2];
+    }
+    UNLOCK();
+}
+
+/* Applies fn to each source, flagging an error and doing nothing if any is
+ * invalid.
+ */
+static void for_each_source(ALsizei n, const ALuint *ids, void (*fn)(FakeSource*))
+{
+    ALsizei i;
+    for(i = 0;i < n;++i)
+    {
+        if(!get_source(ids[i]))
+        {
+            set_error(AL_INVALID_NAME);
+            return;
+        }
+    }
+    for(i = 0;i < n;++i)
+        fn(get_source(ids[i]));
+}
+
+AL_API void AL_APIENTRY alSourcePlayv(ALsizei n, const ALuint *sources)
+{ LOCK(); RECORD("%d, {%u, ...}", n, n > 0 ? sources[0] : 0); for_each_source(n, sources, source_play); UNLOCK(); }
+AL_API void AL_APIENTRY alSourceStopv(ALsizei n, const ALuint *sources)
+{ LOCK(); RECORD("%d, {%u, ...}", n, n > 0 ? sources[0] : 0); for_each_source(n, sources, source_stop); UNLOCK(); }
+AL_API void AL_APIENTRY alSourceRewindv(ALsizei n, const ALuint *sources)
+{ LOCK(); RECORD("%d, {%u, ...}", n, n > 0 ? sources[0] : 0); for_each_source(n, sources, source_rewind); UNLOCK(); }
+AL_API void AL_APIENTRY alSourcePausev(ALsizei n, const ALuint *sources)
+{ LOCK(); RECORD("%d, {%u, ...}", n, n > 0 ? sources[0] : 0); for_each_source(n, sources, source_pause); UNLOCK(); }
+
+AL_API void AL_APIENTRY alSourcePlay(ALuint source)
+{ LOCK(); RECORD("%u", source); for_each_source(1, &source, source_play); UNLOCK(); }
+AL_API void AL_APIENTRY alSourceStop(ALuint source)
+{ LOCK(); RECORD("%u", source); for_each_source(1, &source, source_stop); UNLOCK(); }
+AL_API void AL_APIENTRY alSourceRewind(ALuint source)
+{ LOCK(); RECORD("%u", source); for_each_source(1, &source, source_rewind); UNLOCK(); }
+AL_API void AL_APIENTRY alSourcePause(ALuint source)
+{ LOCK(); RECORD("%u", source); for_each_source(1, &source, source_pause); UNLOCK(); }
+
+AL_API void AL_APIENTRY alSourceQueueBuffers(ALuint source, ALsizei nb, const ALuint *buffers)
+{
+    FakeSource *src;
+    ALsizei i;
+
+    LOCK();
+    RECORD("%u, %d, {%u, ...}", source, nb, nb > 0 ? buffers[0] : 0);
+    GET_SOURCE(src, source);
+    if(src->type == AL_STATIC || src->nqueued+nb > MAX_FAKE_QUEUE)
+        set_error(AL_INVALID_OPERATION);
+    else
+    {
+        for(i = 0;i < nb;++i)
+        {
+            if(!get_buffer(buffers[i]))
+            {
+                set_error(AL_INVALID_NAME);
+                break;
+            }
+        }
+        if(i == nb)
+        {
+            /* Bring the position up to date first, so a stopped source
+             * doesn't appear to have played the new buffers too.
+             */
+            source_update(src);
+            for(i = 0;i < nb;++i)
+                src->queue[src->nqueued++] = buffers[i];
+            src->type = AL_STREAMING;
+        }
+    }
+    UNLOCK();
+}
+
+AL_API void AL_APIENTRY alSourceUnqueueBuffers(ALuint source, ALsizei nb, ALuint *buffers)
+{
+    ULONGLONG offset;
+    FakeSource *src;
+    ALsizei idx, i;
+
+    LOCK();
+    RECORD("%u, %d", source, nb);
+    GET_SOURCE(src, source);
+    source_position(src, &idx, &offset);
+    if(src->type != AL_STREAMING || src->looping || nb > idx)
+        set_error(AL_INVALID_VALUE);
+    else
+    {
+        for(i = 0;i < nb;++i)
+        {
+            buffers[i] = src->queue[i];
+            src->base += get_buffer(buffers[i])->frames;
+        }
+        memmove(src->queue, src->queue+nb, (src->nqueued-nb)*sizeof(src->queue[0]));
+        src->nqueued -= nb;
+        if(src->state == AL_STOPPED || src->state == AL_INITIAL)
+            src->cur = src->origin = src->base + ((src->state == AL_STOPPED) ? queue_frames(src) : 0);
+    }
+    UNLOCK();
+}
+
+
+/* Buffers. */
+AL_API void AL_APIENTRY alGenBuffers(ALsizei n, ALuint *ids)
+{
+    ALsizei i, j = 0;
+
+    LOCK();
+    RECORD("%d", n);
+    for(i = 0;i < MAX_FAKE_BUFFERS && j < n;++i)
+    {
+        if(buffers[i].used) continue;
+        memset(&buffers[i], 0, sizeof(buffers[i]));
+        buffers[i].used = AL_TRUE;
+        buffers[i].channels = 1;
+        buffers[i].bits = 16;
+        buffers[i].freq = FAKE_FREQUENCY;
+        ids[j++] = i+1;
+    }
+    if(j < n)
+    {
+        while(j > 0)
+            buffers[ids[--j]-1].used = AL_FALSE;
+        set_error(AL_OUT_OF_MEMORY);
+    }
+    UNLOCK();
+}
+
+AL_API void AL_APIENTRY alDeleteBuffers(ALsizei n, const ALuint *ids)
+{
+    ALsizei i;
+    LOCK();
+    RECORD("%d, {%u, ...}", n, n > 0 ? ids[0] : 0);
+    for(i = 0;i < n;++i)
+    {
+        FakeBuffer *buf = get_buffer(ids[i]);
+        if(buf) buf->used = AL_FALSE;
+        else if(ids[i]) set_error(AL_INVALID_NAME);
+    }
+    UNLOCK();
+}
+
+AL_API ALboolean AL_APIENTRY alIsBuffer(ALuint buffer)
+{
+    ALboolean ret;
+    LOCK(); RECORD("%u", buffer); ret = get_buffer(buffer) != NULL; UNLOCK();
+    return ret;
+}
+
+/* Only the size and format are kept, since nothing is ever mixed. */
+AL_API void AL_APIENTRY alBufferData(ALuint buffer, ALenum format, const ALvoid *data, ALsizei size, ALsizei freq)
+{
+    FakeBuffer *buf;
+
+    LOCK();
+    RECORD("%u, 0x%04x, %p, %d, %d", buffer, format, data, size, freq);
+    if(!(buf=get_buffer(buffer)))
+        set_error(AL_INVALID_NAME);
+    else
+    {
+        switch(format)
+        {
+        case AL_FORMAT_MONO8: buf->channels = 1; buf->bits = 8; break;
+        case AL_FORMAT_MONO16: buf->channels = 1; buf->bits = 16; break;
+        case AL_FORMAT_STEREO8: buf->channels = 2; buf->bits = 8; break;
+        case AL_FORMAT_STEREO16: buf->channels = 2; buf->bits = 16; break;
+        default:
+            set_error(AL_INVALID_ENUM);
+            UNLOCK();
+            return;
+        }
+        buf->freq = freq;
+        buf->size = size;
+        buf->frames = size / frame_size(buf);
+    }
+    UNLOCK();
+}
+
+static ALint buffer_geti(FakeBuffer *buf, ALenum param)
+{
+    switch(param)
+    {
+    case AL_FREQUENCY: return buf->freq;
+    case AL_BITS: return buf->bits;
+    case AL_CHANNELS: return buf->channels;
+    case AL_SIZE: return buf->size;
+    }
+    set_error(AL_INVALID_ENUM);
+    return 0;
+}
+
+/* Buffers have no settable properties in core AL, so the setters only check
+ * the name.
+ */
+#define BUFFER_SETTER(name, args, fmt, ...)                     \
+AL_API void AL_APIENTRY name args                               \
+{                                                               \
+    LOCK();                                                     \
+    RECORD(fmt, __VA_ARGS__);                                   \
+    if(!get_buffer(buffer)) set_error(AL_INVALID_NAME);         \
+    else set_error(AL_INVALID_ENUM);                            \
+    UNLOCK();                                                   \
+}
+BUFFER_SETTER(alBufferf, (ALuint buffer, ALenum param, ALfloat value), "%u, 0x%04x, %g", buffer, param, value)
+BUFFER_SETTER(alBuffer3f, (ALuint buffer, ALenum param, ALfloat value1, ALfloat value2, ALfloat value3), "%u, 0x%04x, %g, %g, %g", buffer, param, value1, value2, value3)
+BUFFER_SETTER(alBufferfv, (ALuint buffer, ALenum param, const ALfloat *values), "%u, 0x%04x, %p", buffer, param, values)
+BUFFER_SETTER(alBufferi, (ALuint buffer, ALenum param, ALint value), "%u, 0x%04x, %d", buffer, param, value)
+BUFFER_SETTER(alBuffer3i, (ALuint buffer, ALenum param, ALint value1, ALint value2, ALint value3), "%u, 0x%04x, %d, %d, %d", buffer, param, value1, value2, value3)
+BUFFER_SETTER(alBufferiv, (ALuint buffer, ALenum param, const ALint *values), "%u, 0x%04x, %p", buffer, param, values)
+#undef BUFFER_SETTER
+
+AL_API void AL_APIENTRY alGetBufferi(ALuint buffer, ALenum param, ALint *value)
+{
+    FakeBuffer *buf;
+    LOCK();
+    RECORD("%u, 0x%04x", buffer, param);
+    if(!(buf=get_buffer(buffer))) set_error(AL_INVALID_NAME);
+    else *value = buffer_geti(buf, param);
+    UNLOCK();
+}
+
+AL_API void AL_APIENTRY alGetBufferiv(ALuint buffer, ALenum param, ALint *values)
+{
+    FakeBuffer *buf;
+    LOCK();
+    RECORD("%u, 0x%04x", buffer, param);
+    if(!(buf=get_buffer(buffer))) set_error(AL_INVALID_NAME);
+    else values[0] = buffer_geti(buf, param);
+    UNLOCK();
+}
+
+AL_API void AL_APIENTRY alGetBuffer3i(ALuint buffer, ALenum param, ALint *value1, ALint *value2, ALint *value3)
+{
+    LOCK();
+    RECORD("%u, 0x%04x", buffer, param);
+    *value1 = *value2 = *value3 = 0;
+    set_error(get_buffer(buffer) ? AL_INVALID_ENUM : AL_INVALID_NAME);
+    UNLOCK();
+}
+
+AL_API void AL_APIENTRY alGetBufferf(ALuint buffer, ALenum param, ALfloat *value)
+{
+    LOCK();
+    RECORD("%u, 0x%04x", buffer, param);
+    *value = 0.0f;
+    set_error(get_buffer(buffer) ? AL_INVALID_ENUM : AL_INVALID_NAME);
+    UNLOCK();
+}
+
+AL_API void AL_APIENTRY alGetBuffer3f(ALuint buffer, ALenum param, ALfloat *value1, ALfloat *value2, ALfloat *value3)
+{
+    LOCK();
+    RECORD("%u, 0x%04x", buffer, param);
+    *value1 = *value2 = *value3 = 0.0f;
+    set_error(get_buffer(buffer) ? AL_INVALID_ENUM : AL_INVALID_NAME);
+    UNLOCK();
+}
+
+AL_API void AL_APIENTRY alGetBufferfv(ALuint buffer, ALenum param, ALfloat *values)
+{
+    LOCK();
+    RECORD("%u, 0x%04x", buffer, param);
+    values[0] = 0.0f;
+    set_error(get_buffer(buffer) ? AL_INVALID_ENUM : AL_INVALID_NAME);
+    UNLOCK();
+}
+
+
+BOOL WINAPI DllMain(HINSTANCE hInstDLL, DWORD fdwReason, LPVOID lpvReserved)
+{
+    ULONG i;
+
+    (void)lpvReserved;
+    switch(fdwReason)
+    {
+    case DLL_PROCESS_ATTACH:
+        fake_module = hInstDLL;
+        QueryPerformanceFrequency(&qpc_freq);
+        InitializeCriticalSection(&fake_crst);
+        break;
+    case DLL_PROCESS_DETACH:
+        DeleteCriticalSection(&fake_crst);
+        for(i = 0;i < MAX_RECORDED/RECORD_CHUNK;++i)
+        {
+            HeapFree(GetProcessHeap(), 0, records[i]);
+            records[i] = NULL;
+        }
+        break;
+    }
+    return TRUE;
+}
@@ -0,0 +1,46 @@
+/* Recording OpenAL driver for DSOAL tests
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef DSOAL_FAKEAL_H
+#define DSOAL_FAKEAL_H
+
+/* fakeal builds as a dsoal-aldrv.dll that implements the core OpenAL 1.1 API
+ * in memory, without any audio output and without advertising extensions.
+ * Every call is recorded with its arguments, and sources advance through
+ * their buffers following a clock that's either real time or stepped by the
+ * test. Copy it over the real dsoal-aldrv.dll and look up the functions below
+ * with GetProcAddress to inspect what dsound.dll did.
+ */
+
+/* Clears the call record. */
+typedef void (__cdecl *LPFAKEALRESET)(void);
+/* Number of recorded calls to the named function, or of all calls if name is
+ * NULL. Calls are counted even after the record is full.
+ */
+typedef ULONG (__cdecl *LPFAKEALCALLCOUNT)(const char *name);
+/* Number of calls in the record, and the text of one, formatted like
+ * "alSourcef(3, 0x100a, 0.5)". The text is valid until the next reset.
+ */
+typedef ULONG (__cdecl *LPFAKEALNUMCALLS)(void);
+typedef const char* (__cdecl *LPFAKEALGETCALL)(ULONG idx);
+/* With a manual clock, time only moves when fakeal_advance_clock is called,
+ * making source offsets, capture and anything following them deterministic.
+ */
+typedef void (__cdecl *LPFAKEALSETMANUALCLOCK)(BOOL manual);
+typedef void (__cdecl *LPFAKEALADVANCECLOCK)(ULONGLONG nanoseconds);
+
+#endif /* DSOAL_FAKEAL_H */